@@ -0,0 +1,863 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include "compare.h"
+#include "replay.h"
+#include "sweep.h"
+#include "scenario.h"
+#include "runs.h"
+
+/* Verdict on a single metric */
+typedef enum {
+  COMPARE_OK,
+  COMPARE_BETTER,
+  COMPARE_NOISE,          /* beyond the tolerance but not significant */
+  COMPARE_REGRESSED
+} sky_verdict;
+
+static const char *verdict_names[] = {"ok", "better", "noise", "REGRESSED"};
+static const char *kind_names[] = {"phase", "query"};
+
+SKY_RESULT *sky_result_new(void) {
+  SKY_RESULT *result;
+
+  if ((result = malloc(sizeof(*result))) == NULL)
+    return NULL;
+
+  result->entries = NULL;
+  result->size = 0;
+  result->capacity = 0;
+  return result;
+}
+
+void sky_result_free(SKY_RESULT *result) {
+  if (result == NULL)
+    return;
+
+  for (uint32_t i = 0; i < result->size; i++)
+    free(result->entries[i].name);
+
+  free(result->entries);
+  free(result);
+}
+
+SKY_RESULT_ENTRY *sky_result_add(SKY_RESULT *result, sky_result_kind kind,
+                                 const char *name) {
+  SKY_RESULT_ENTRY *entry;
+
+  if (result->size == result->capacity) {
+    uint32_t capacity = (result->capacity) ? result->capacity * 2 :
+                                             RESULT_INITIAL_CAPACITY;
+
+    entry = realloc(result->entries, capacity * sizeof(*entry));
+
+    if (entry == NULL)
+      return NULL;
+
+    result->entries = entry;
+    result->capacity = capacity;
+  }
+
+  entry = &result->entries[result->size];
+  memset(entry, 0, sizeof(*entry));
+  entry->kind = kind;
+
+  if ((entry->name = strdup(name)) == NULL)
+    return NULL;
+
+  result->size++;
+  return entry;
+}
+
+const SKY_RESULT_ENTRY *sky_result_find(const SKY_RESULT *result,
+                                        sky_result_kind kind,
+                                        const char *name) {
+  for (uint32_t i = 0; i < result->size; i++) {
+    if (result->entries[i].kind == kind &&
+        strcmp(result->entries[i].name, name) == 0)
+      return &result->entries[i];
+  }
+  return NULL;
+}
+
+static bool is_word_char(char c) {
+  return (isalnum((unsigned char)c) || c == '_' || c == '$');
+}
+
+size_t query_fingerprint(const char *query, char *buffer, size_t buflen) {
+  assert(query && buffer && buflen > 0);
+
+  const char *pos = query;
+  size_t length = 0;
+
+  while (*pos != '\0' && length < buflen - 1) {
+    char c = *pos;
+
+    if (isspace((unsigned char)c)) {
+      /* squeeze whitespace into a single space */
+      while (isspace((unsigned char)*pos))
+        pos++;
+      if (length > 0 && buffer[length - 1] != ' ')
+        buffer[length++] = ' ';
+      continue;
+    }
+
+    if (c == '\'' || c == '"') {
+      /* skip the quoted literal, honoring escapes and doubled quotes */
+      for (pos++; *pos != '\0'; pos++) {
+        if (*pos == '\\' && pos[1] != '\0') {
+          pos++;
+        } else if (*pos == c) {
+          if (pos[1] != c)
+            break;
+          pos++;
+        }
+      }
+      if (*pos != '\0')
+        pos++;
+      c = '?';
+    } else if (isdigit((unsigned char)c) &&
+               (length == 0 || !is_word_char(buffer[length - 1]))) {
+      /* numbers, including decimals, exponents and hex */
+      while (isalnum((unsigned char)*pos) || *pos == '.')
+        pos++;
+      c = '?';
+    } else {
+      buffer[length++] = tolower((unsigned char)c);
+      pos++;
+      continue;
+    }
+
+    buffer[length++] = c;
+
+    /* collapse lists of literals, e.g. 'in (?, ?, ?)' becomes 'in (?)' */
+    if (length >= 4 && strncmp(buffer + length - 4, "?, ?", 4) == 0)
+      length -= 3;
+    else if (length >= 3 && strncmp(buffer + length - 3, "?,?", 3) == 0)
+      length -= 2;
+  }
+
+  /* the statement terminator is not part of the statement */
+  while (length > 0 && (buffer[length - 1] == ' ' || buffer[length - 1] == ';'))
+    length--;
+
+  buffer[length] = '\0';
+  return length;
+}
+
+bool build_fingerprints(SKY_SHARE *share) {
+  assert(share && share->read_queries);
+
+  SKY_LIST_NODE *current = share->read_queries->head;
+  char fingerprint[SKY_STRSIZ];
+
+  share->fingerprints = calloc(share->read_queries->size, sizeof(char *));
+
+  if (share->fingerprints == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+
+  for (; current != NULL; current = current->next) {
+    uint32_t i;
+
+    query_fingerprint(current->data, fingerprint, SKY_STRSIZ);
+
+    for (i = 0; i < share->nfingerprints; i++) {
+      if (strcmp(share->fingerprints[i], fingerprint) == 0)
+        break;
+    }
+
+    if (i == share->nfingerprints) {
+      if ((share->fingerprints[i] = strdup(fingerprint)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      share->nfingerprints++;
+    }
+    current->fingerprint = i;
+  }
+  return true;
+}
+
+/* Fills in the latency figures of an entry. 'elapsed' is the
+   wall-clock time in usec it took to record them, if known */
+static void set_entry(SKY_RESULT_ENTRY *entry, const SKY_HISTOGRAM *hist,
+                      uint64_t elapsed) {
+  entry->count = hist->count;
+  entry->qps = (elapsed) ? (double)hist->count / elapsed * 1000000 : 0;
+  entry->mean = sky_histogram_mean(hist);
+  entry->stddev = sky_histogram_stddev(hist);
+  entry->p50 = sky_histogram_percentile(hist, 50.0);
+  entry->p95 = sky_histogram_percentile(hist, 95.0);
+  entry->p99 = sky_histogram_percentile(hist, 99.0);
+}
+
+static SKY_HISTOGRAM *phase_histogram(SKY_WORKER *worker, sky_phase phase) {
+  switch (phase) {
+  case SKY_PHASE_INSERT:
+    return &worker->insert_latency;
+  case SKY_PHASE_WRITE:
+    return &worker->write_latency;
+  case SKY_PHASE_READ:
+    return &worker->read_latency;
+  default:
+    return &worker->replay_latency;
+  }
+}
+
+/* Adds a phase entry out of the histograms of every worker */
+static bool add_phase(SKY_RESULT *result, SKY_WORKER **workers,
+                      sky_phase phase, uint64_t elapsed) {
+  SKY_SHARE *share = workers[0]->share;
+  SKY_RESULT_ENTRY *entry;
+  SKY_HISTOGRAM *merged;
+
+  if ((merged = calloc(1, sizeof(*merged))) == NULL)
+    return false;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    if (!workers[i]->aborted)
+      sky_histogram_merge(merged, phase_histogram(workers[i], phase));
+  }
+
+  entry = sky_result_add(result, SKY_RESULT_PHASE, phase_name(phase));
+
+  if (entry != NULL)
+    set_entry(entry, merged, elapsed);
+
+  free(merged);
+  return (entry != NULL);
+}
+
+SKY_RESULT *collect_results(SKY_WORKER **workers) {
+  assert(workers);
+
+  SKY_SHARE *share = workers[0]->share;
+  SKY_RESULT *result;
+  SKY_HISTOGRAM *merged;
+  uint64_t insert_elapsed = 0, write_elapsed = 0, file_elapsed = 0;
+  uint64_t replay_end = 0;
+  bool rv = true;
+
+  if ((result = sky_result_new()) == NULL)
+    return NULL;
+
+  /* the phases ran in parallel, so the slowest worker sets the pace */
+  for (int i = 0; i < share->concurrency; i++) {
+    if (workers[i]->aborted)
+      continue;
+    if (workers[i]->insert_elapsed > insert_elapsed)
+      insert_elapsed = workers[i]->insert_elapsed;
+    if (workers[i]->write_elapsed > write_elapsed)
+      write_elapsed = workers[i]->write_elapsed;
+    if (workers[i]->file_elapsed > file_elapsed)
+      file_elapsed = workers[i]->file_elapsed;
+    if (workers[i]->replay_end_time > replay_end)
+      replay_end = workers[i]->replay_end_time;
+  }
+
+  if (phase_enabled(share, SKY_PHASE_INSERT))
+    rv = add_phase(result, workers, SKY_PHASE_INSERT, insert_elapsed);
+
+  if (rv && phase_enabled(share, SKY_PHASE_WRITE))
+    rv = add_phase(result, workers, SKY_PHASE_WRITE, write_elapsed);
+
+  if (rv && phase_enabled(share, SKY_PHASE_READ)) {
+    SKY_RUN_SUMMARY runs;
+
+    rv = add_phase(result, workers, SKY_PHASE_READ, file_elapsed);
+
+    /* repeated runs tell how noisy the throughput is. the throughput
+       itself is worked out as for a single run so that the two can
+       be compared */
+    if (rv && summarize_throughput(workers, &runs)) {
+      SKY_RESULT_ENTRY *entry = &result->entries[result->size - 1];
+
+      entry->runs = runs.n;
+      entry->qps_stddev = runs.stddev;
+    }
+  }
+
+  if (rv && phase_enabled(share, SKY_PHASE_REPLAY) &&
+      replay_end > share->replay->start_time)
+    rv = add_phase(result, workers, SKY_PHASE_REPLAY,
+                   replay_end - share->replay->start_time);
+
+  for (uint32_t i = 0; rv && share->sweep_results && i < share->nsweep; i++) {
+    SKY_SWEEP_LEVEL *level = &share->sweep_results[i];
+    SKY_RESULT_ENTRY *entry;
+    char name[32];
+
+    snprintf(name, sizeof(name), "sweep-%u", level->concurrency);
+
+    if ((entry = sky_result_add(result, SKY_RESULT_PHASE, name)) == NULL) {
+      rv = false;
+      break;
+    }
+
+    entry->count = level->queries;
+    entry->qps = level->qps;
+    entry->mean = level->mean;
+    entry->p99 = level->p99;
+  }
+
+  /* the search is compared by where it ended up */
+  if (rv && share->search_results && share->search_point >= 0) {
+    SKY_SWEEP_LEVEL *level = &share->search_results[share->search_point];
+    SKY_RESULT_ENTRY *entry;
+
+    if ((entry = sky_result_add(result, SKY_RESULT_PHASE, "search")) == NULL) {
+      rv = false;
+    } else {
+      entry->count = level->queries;
+      entry->qps = level->qps;
+      entry->mean = level->mean;
+      entry->p99 = level->p99;
+    }
+  }
+
+  /* warmups and phases cut short aren't comparable */
+  for (uint32_t i = 0; rv && share->scenario && i < share->scenario->nphases;
+       i++) {
+    SKY_SCENARIO_PHASE *phase = &share->scenario->phases[i];
+    SKY_RESULT_ENTRY *entry;
+    char name[SKY_STRSIZ];
+
+    if (!phase->measure || !phase->completed)
+      continue;
+
+    snprintf(name, sizeof(name), "%s%s", SCENARIO_LABEL, phase->name);
+
+    if ((entry = sky_result_add(result, SKY_RESULT_PHASE, name)) == NULL) {
+      rv = false;
+      break;
+    }
+
+    entry->count = phase->count[SKY_OP_READ] + phase->count[SKY_OP_INSERT];
+    entry->qps = phase->qps;
+    entry->mean = phase->mean;
+    entry->p99 = phase->p99;
+  }
+
+  /* the read queries are broken down by their fingerprint */
+  if (rv && share->nfingerprints > 0 &&
+      phase_enabled(share, SKY_PHASE_READ)) {
+    if ((merged = malloc(sizeof(*merged))) == NULL)
+      rv = false;
+
+    for (uint32_t f = 0; rv && f < share->nfingerprints; f++) {
+      SKY_RESULT_ENTRY *entry;
+
+      sky_histogram_reset(merged);
+
+      for (int i = 0; i < share->concurrency; i++) {
+        if (!workers[i]->aborted && workers[i]->query_latency)
+          sky_histogram_merge(merged, &workers[i]->query_latency[f]);
+      }
+
+      entry = sky_result_add(result, SKY_RESULT_QUERY, share->fingerprints[f]);
+
+      if (entry == NULL)
+        rv = false;
+      else
+        set_entry(entry, merged, file_elapsed);
+    }
+    free(merged);
+  }
+
+  if (!rv) {
+    sky_result_free(result);
+    return NULL;
+  }
+  return result;
+}
+
+static void write_json_string(FILE *file, const char *string) {
+  fputc('"', file);
+
+  for (const char *pos = string; *pos != '\0'; pos++) {
+    unsigned char c = (unsigned char)*pos;
+
+    if (c == '"' || c == '\\')
+      fprintf(file, "\\%c", c);
+    else if (c == '\n')
+      fputs("\\n", file);
+    else if (c == '\t')
+      fputs("\\t", file);
+    else if (c < 0x20)
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+bool write_result_file(const char *path, const SKY_RESULT *result) {
+  assert(path && result);
+
+  FILE *file;
+
+  if ((file = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "failed to open (%s) for writing\n", path);
+    return false;
+  }
+
+  fprintf(file, "{\n  \"format\": %d,\n  \"results\": [",
+          RESULT_FORMAT_VERSION);
+
+  for (uint32_t i = 0; i < result->size; i++) {
+    const SKY_RESULT_ENTRY *entry = &result->entries[i];
+
+    fprintf(file, "%s\n    {\"kind\": \"%s\", \"name\": ",
+            (i > 0) ? "," : "", kind_names[entry->kind]);
+    write_json_string(file, entry->name);
+    fprintf(file, ", \"count\": %llu, \"qps\": %.3lf, \"mean_usec\": %.3lf, "
+            "\"stddev_usec\": %.3lf, \"p50_usec\": %llu, \"p95_usec\": %llu, "
+            "\"p99_usec\": %llu, \"runs\": %u, \"qps_stddev\": %.3lf}",
+            (unsigned long long)entry->count, entry->qps, entry->mean,
+            entry->stddev, (unsigned long long)entry->p50,
+            (unsigned long long)entry->p95, (unsigned long long)entry->p99,
+            entry->runs, entry->qps_stddev);
+  }
+
+  fprintf(file, "\n  ]\n}\n");
+
+  if (fclose(file) != 0) {
+    fprintf(stderr, "failed to write (%s)\n", path);
+    return false;
+  }
+  return true;
+}
+
+/* Minimal JSON reader, just enough for the files written above.
+   Members it doesn't know about are skipped */
+typedef struct {
+  const char *pos;
+} SKY_JSON;
+
+static void json_skip_space(SKY_JSON *json) {
+  while (isspace((unsigned char)*json->pos))
+    json->pos++;
+}
+
+static bool json_expect(SKY_JSON *json, char c) {
+  json_skip_space(json);
+
+  if (*json->pos != c)
+    return false;
+
+  json->pos++;
+  return true;
+}
+
+/* parses a string into a newly allocated buffer */
+static char *json_string(SKY_JSON *json) {
+  const char *pos;
+  char *string, *write_ptr;
+
+  if (!json_expect(json, '"'))
+    return NULL;
+
+  for (pos = json->pos; *pos != '"'; pos++) {
+    if (*pos == '\0')
+      return NULL;
+    if (*pos == '\\' && pos[1] != '\0')
+      pos++;
+  }
+
+  if ((string = malloc(pos - json->pos + 1)) == NULL)
+    return NULL;
+
+  for (write_ptr = string; *json->pos != '"'; json->pos++) {
+    char c = *json->pos;
+
+    if (c == '\\') {
+      c = *++json->pos;
+
+      if (c == 'n') {
+        c = '\n';
+      } else if (c == 't') {
+        c = '\t';
+      } else if (c == 'r') {
+        c = '\r';
+      } else if (c == 'u') {
+        /* only the control characters written above are expected */
+        unsigned int code = 0;
+        if (sscanf(json->pos + 1, "%4x", &code) == 1 &&
+            strspn(json->pos + 1, "0123456789abcdefABCDEF") >= 4)
+          json->pos += 4;
+        c = (code < 0x80) ? (char)code : '?';
+      }
+    }
+    *write_ptr++ = c;
+  }
+
+  *write_ptr = '\0';
+  json->pos++;
+  return string;
+}
+
+static bool json_number(SKY_JSON *json, double *value) {
+  char *end;
+
+  json_skip_space(json);
+  *value = strtod(json->pos, &end);
+
+  if (end == json->pos)
+    return false;
+
+  json->pos = end;
+  return true;
+}
+
+/* skips over a value of any type */
+static bool json_skip_value(SKY_JSON *json) {
+  double number;
+  char *string;
+
+  json_skip_space(json);
+
+  switch (*json->pos) {
+  case '"':
+    if ((string = json_string(json)) == NULL)
+      return false;
+    free(string);
+    return true;
+  case '{':
+  case '[': {
+    char close = (*json->pos == '{') ? '}' : ']';
+
+    json->pos++;
+    if (json_expect(json, close))
+      return true;
+
+    do {
+      if (close == '}') {
+        if ((string = json_string(json)) == NULL)
+          return false;
+        free(string);
+        if (!json_expect(json, ':'))
+          return false;
+      }
+      if (!json_skip_value(json))
+        return false;
+    } while (json_expect(json, ','));
+
+    return json_expect(json, close);
+  }
+  case 't':
+  case 'n':
+    if (strncmp(json->pos, "true", 4) != 0 &&
+        strncmp(json->pos, "null", 4) != 0)
+      return false;
+    json->pos += 4;
+    return true;
+  case 'f':
+    if (strncmp(json->pos, "false", 5) != 0)
+      return false;
+    json->pos += 5;
+    return true;
+  default:
+    return json_number(json, &number);
+  }
+}
+
+/* parses a single result entry object */
+static bool json_entry(SKY_JSON *json, SKY_RESULT *result) {
+  SKY_RESULT_ENTRY entry;
+  char *kind = NULL;
+  bool rv = true;
+
+  memset(&entry, 0, sizeof(entry));
+
+  if (!json_expect(json, '{'))
+    return false;
+
+  if (!json_expect(json, '}')) {
+    do {
+      char *key = json_string(json);
+      double number = 0;
+
+      if (key == NULL || !json_expect(json, ':')) {
+        free(key);
+        rv = false;
+        break;
+      }
+
+      if (strcmp(key, "kind") == 0) {
+        free(kind);
+        rv = ((kind = json_string(json)) != NULL);
+      } else if (strcmp(key, "name") == 0) {
+        free(entry.name);
+        rv = ((entry.name = json_string(json)) != NULL);
+      } else if (strcmp(key, "count") == 0) {
+        rv = json_number(json, &number);
+        entry.count = (uint64_t)number;
+      } else if (strcmp(key, "qps") == 0) {
+        rv = json_number(json, &entry.qps);
+      } else if (strcmp(key, "mean_usec") == 0) {
+        rv = json_number(json, &entry.mean);
+      } else if (strcmp(key, "stddev_usec") == 0) {
+        rv = json_number(json, &entry.stddev);
+      } else if (strcmp(key, "p50_usec") == 0) {
+        rv = json_number(json, &number);
+        entry.p50 = (uint64_t)number;
+      } else if (strcmp(key, "p95_usec") == 0) {
+        rv = json_number(json, &number);
+        entry.p95 = (uint64_t)number;
+      } else if (strcmp(key, "p99_usec") == 0) {
+        rv = json_number(json, &number);
+        entry.p99 = (uint64_t)number;
+      } else if (strcmp(key, "runs") == 0) {
+        rv = json_number(json, &number);
+        entry.runs = (uint32_t)number;
+      } else if (strcmp(key, "qps_stddev") == 0) {
+        rv = json_number(json, &entry.qps_stddev);
+      } else {
+        rv = json_skip_value(json);
+      }
+      free(key);
+    } while (rv && json_expect(json, ','));
+
+    if (rv)
+      rv = json_expect(json, '}');
+  }
+
+  if (rv && (kind == NULL || entry.name == NULL))
+    rv = false;
+
+  if (rv) {
+    SKY_RESULT_ENTRY *added;
+    sky_result_kind type = (strcmp(kind, "query") == 0) ? SKY_RESULT_QUERY :
+                                                          SKY_RESULT_PHASE;
+
+    if ((added = sky_result_add(result, type, entry.name)) == NULL) {
+      rv = false;
+    } else {
+      char *name = added->name;
+      *added = entry;
+      added->kind = type;
+      added->name = name;
+    }
+  }
+
+  free(kind);
+  free(entry.name);
+  return rv;
+}
+
+static SKY_RESULT *parse_result(const char *text) {
+  SKY_JSON json = {text};
+  SKY_RESULT *result;
+  bool rv = true;
+
+  if ((result = sky_result_new()) == NULL)
+    return NULL;
+
+  if (!json_expect(&json, '{'))
+    rv = false;
+
+  while (rv && !json_expect(&json, '}')) {
+    char *key = json_string(&json);
+
+    if (key == NULL || !json_expect(&json, ':')) {
+      free(key);
+      rv = false;
+      break;
+    }
+
+    if (strcmp(key, "results") == 0) {
+      rv = json_expect(&json, '[');
+
+      if (rv && !json_expect(&json, ']')) {
+        do {
+          rv = json_entry(&json, result);
+        } while (rv && json_expect(&json, ','));
+
+        if (rv)
+          rv = json_expect(&json, ']');
+      }
+    } else {
+      rv = json_skip_value(&json);
+    }
+    free(key);
+
+    if (rv && json_expect(&json, ','))
+      continue;
+  }
+
+  if (!rv) {
+    sky_result_free(result);
+    return NULL;
+  }
+  return result;
+}
+
+SKY_RESULT *load_result_file(const char *path) {
+  assert(path);
+
+  SKY_RESULT *result;
+  FILE *file;
+  char *text;
+  long size;
+
+  if ((file = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "failed to open (%s)\n", path);
+    return NULL;
+  }
+
+  if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+      fseek(file, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "failed to read (%s)\n", path);
+    fclose(file);
+    return NULL;
+  }
+
+  if ((text = malloc(size + 1)) == NULL) {
+    report_error("out of memory");
+    fclose(file);
+    return NULL;
+  }
+
+  text[fread(text, 1, size, file)] = '\0';
+  fclose(file);
+
+  if ((result = parse_result(text)) == NULL)
+    fprintf(stderr, "failed to parse (%s)\n", path);
+
+  free(text);
+  return result;
+}
+
+/* Judges the change of a metric. 'significant' tells whether the
+   change stands out from the noise */
+static sky_verdict judge(double base, double current, bool higher_is_better,
+                         double tolerance, bool significant) {
+  double change = (current - base) / base * 100;
+
+  if (higher_is_better)
+    change = -change;
+
+  if (change > tolerance)
+    return (significant) ? COMPARE_REGRESSED : COMPARE_NOISE;
+  if (change < -tolerance)
+    return COMPARE_BETTER;
+  return COMPARE_OK;
+}
+
+static void print_metric(const char *label, const char *metric, double base,
+                         double current, sky_verdict verdict) {
+  printf("  %-34.34s %-6s %12.1lf %12.1lf %+8.1lf%%  %s\n", label, metric,
+         base, current, (current - base) / base * 100,
+         verdict_names[verdict]);
+}
+
+uint32_t compare_results(SKY_SHARE *share, const SKY_RESULT *baseline,
+                         const SKY_RESULT *current) {
+  assert(share && baseline && current);
+
+  uint32_t regressions = 0;
+
+  printf("\n");
+  printf("[ BASELINE COMPARISON ]\n");
+  if (share->compare_path)
+    printf("  Baseline File          : %s\n", share->compare_path);
+  printf("  Tolerance              : %.1lf%%\n", share->tolerance);
+  printf("  Noise Threshold        : %u usec, z >= %.1lf\n",
+         share->noise_floor, share->noise_z);
+  printf("\n");
+  printf("  %-34s %-6s %12s %12s %9s  %s\n", "Entry", "Metric", "Baseline",
+         "Current", "Change", "Status");
+
+  for (uint32_t i = 0; i < baseline->size; i++) {
+    const SKY_RESULT_ENTRY *base = &baseline->entries[i];
+    const SKY_RESULT_ENTRY *cur = sky_result_find(current, base->kind,
+                                                  base->name);
+    char label[SKY_STRSIZ];
+    sky_verdict verdict;
+
+    snprintf(label, sizeof(label), "%s:%s", kind_names[base->kind],
+             base->name);
+
+    /* an entry the current run lost can't be let through as if it
+       had passed, nor can one that fell short of the samples the
+       baseline had */
+    if (cur == NULL) {
+      printf("  %-34.34s %-6s %12s %12s %9s  %s\n", label, "-", "-", "-", "-",
+             "MISSING");
+      regressions++;
+      continue;
+    }
+
+    if (base->count < COMPARE_MIN_SAMPLES || cur->count < COMPARE_MIN_SAMPLES) {
+      bool lost = (base->count >= COMPARE_MIN_SAMPLES);
+
+      printf("  %-34.34s %-6s %12llu %12llu %9s  %s\n", label, "count",
+             (unsigned long long)base->count, (unsigned long long)cur->count,
+             "-", (lost) ? "TOO FEW SAMPLES" : "too few samples");
+      regressions += lost;
+      continue;
+    }
+
+    /* throughput is a single sample unless both sides ran the read
+       file several times. then the drop must also stand out from the
+       spread of the runs */
+    if (base->qps > 0 && cur->qps > 0) {
+      bool significant = true;
+
+      if (base->runs > 1 && cur->runs > 1) {
+        double error = sqrt(base->qps_stddev * base->qps_stddev / base->runs +
+                            cur->qps_stddev * cur->qps_stddev / cur->runs);
+        significant = (error > 0) ?
+          (base->qps - cur->qps) / error >= share->noise_z : true;
+      }
+
+      verdict = judge(base->qps, cur->qps, true, share->tolerance,
+                      significant);
+      print_metric(label, "qps", base->qps, cur->qps, verdict);
+      regressions += (verdict == COMPARE_REGRESSED);
+    }
+
+    /* the mean must move by more than the sampling error allows */
+    if (base->mean > 0 && cur->mean > 0) {
+      double error = sqrt(base->stddev * base->stddev / base->count +
+                          cur->stddev * cur->stddev / cur->count);
+      bool significant = (error > 0) ?
+        (cur->mean - base->mean) / error >= share->noise_z : true;
+
+      verdict = judge(base->mean, cur->mean, false, share->tolerance,
+                      significant);
+      print_metric(label, "mean", base->mean, cur->mean, verdict);
+      regressions += (verdict == COMPARE_REGRESSED);
+    }
+
+    /* the percentiles must move by more than the noise floor */
+    const char *names[] = {"p50", "p95", "p99"};
+    uint64_t base_values[] = {base->p50, base->p95, base->p99};
+    uint64_t cur_values[] = {cur->p50, cur->p95, cur->p99};
+
+    for (int j = 0; j < 3; j++) {
+      if (base_values[j] == 0 || cur_values[j] == 0)
+        continue;
+
+      bool significant = (cur_values[j] >= base_values[j] + share->noise_floor);
+
+      verdict = judge(base_values[j], cur_values[j], false, share->tolerance,
+                      significant);
+      print_metric(label, names[j], base_values[j], cur_values[j], verdict);
+      regressions += (verdict == COMPARE_REGRESSED);
+    }
+  }
+
+  printf("\n");
+  printf("  Regressions            : %u\n", regressions);
+  return regressions;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_COMPARE_H__
+#define __SKYLOAD_COMPARE_H__
+
+#include "skyload.h"
+
+#define COMPARE_MIN_SAMPLES 30 /* statements needed to judge an entry */
+#define SKY_EXIT_REGRESSION 2  /* exit status when --compare fails */
+
+#define RESULT_INITIAL_CAPACITY 16
+#define RESULT_FORMAT_VERSION   1
+
+/* What a result entry describes */
+typedef enum {
+  SKY_RESULT_PHASE,       /* a stage of the run, e.g. 'insert' */
+  SKY_RESULT_QUERY        /* a read query fingerprint */
+} sky_result_kind;
+
+/* Throughput and latency of a phase or of a query fingerprint */
+typedef struct {
+  sky_result_kind kind;
+  char *name;             /* phase name or normalized query */
+  uint64_t count;         /* statements measured */
+  double qps;             /* 0 when not measured */
+  uint32_t runs;          /* runs behind 'qps', if more than one */
+  double qps_stddev;      /* spread of 'qps' over the runs */
+  double mean;            /* usec */
+  double stddev;          /* usec */
+  uint64_t p50;           /* usec */
+  uint64_t p95;           /* usec */
+  uint64_t p99;           /* usec */
+} SKY_RESULT_ENTRY;
+
+/* The results of a run as saved with --json */
+typedef struct {
+  SKY_RESULT_ENTRY *entries;
+  uint32_t size;
+  uint32_t capacity;
+} SKY_RESULT;
+
+/* allocator and deallocator of the result object */
+SKY_RESULT *sky_result_new(void);
+void sky_result_free(SKY_RESULT *result);
+
+/* appends a zeroed entry. returns NULL if out of memory */
+SKY_RESULT_ENTRY *sky_result_add(SKY_RESULT *result, sky_result_kind kind,
+                                 const char *name);
+
+/* returns the entry of the given kind and name or NULL */
+const SKY_RESULT_ENTRY *sky_result_find(const SKY_RESULT *result,
+                                        sky_result_kind kind,
+                                        const char *name);
+
+/* writes the normalized form of a query to 'buffer': literals become
+   '?', lists of literals collapse into one, whitespace is squeezed
+   and keywords are lowercased. returns the length written */
+size_t query_fingerprint(const char *query, char *buffer, size_t buflen);
+
+/* assigns every read query to a fingerprint */
+bool build_fingerprints(SKY_SHARE *share);
+
+/* summarizes the measurements of the workers that didn't abort */
+SKY_RESULT *collect_results(SKY_WORKER **workers);
+
+/* saves the results in JSON */
+bool write_result_file(const char *path, const SKY_RESULT *result);
+
+/* reads results saved with write_result_file() */
+SKY_RESULT *load_result_file(const char *path);
+
+/* prints how the current results differ from the baseline and
+   returns the number of regressions found. an entry missing from the
+   current results, or short of the samples the baseline had, counts
+   as one */
+uint32_t compare_results(SKY_SHARE *share, const SKY_RESULT *baseline,
+                         const SKY_RESULT *current);
+
+#endif
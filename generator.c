@@ -6,11 +6,294 @@
  * BSD license. See the COPYING file for full text.
  */
 
+#include <math.h>
 #include "generator.h"
+#include "payload.h"
+#include "splitter.h"
 
-static uint32_t next_id(SKY_WORKER *worker, uint32_t col_num) {
+/* The key the n-th row of a table gets with interleaved keys.
+   worker 'w' hands out w + c, w + 2c, ... (where c is the level of
+   concurrency) and the last worker also takes the remainder rows */
+static uint64_t interleaved_key(SKY_SHARE *share, SKY_TABLE *table,
+                                uint64_t n) {
+  uint64_t c = share->concurrency;
+  uint64_t base = table->nwrite / c;
+
+  if (n < base * c)
+    return n + 1 + c;
+  return c + (base + 1 + (n - base * c)) * c;
+}
+
+/* The inverse of interleaved_key(), i.e. the row a key belongs to */
+static uint64_t interleaved_row(SKY_SHARE *share, SKY_TABLE *table,
+                                uint64_t key) {
+  uint64_t c = share->concurrency;
+  uint64_t base = table->nwrite / c;
+
+  if (key <= c + base * c)
+    return key - c - 1;
+  return base * c + (key - c) / c - base - 1;
+}
+
+/* A round of the Feistel network, which only has to scramble its
+   input well. this is the finalizer of splitmix64 */
+static uint64_t feistel_round(uint64_t value, uint64_t round) {
+  value += (round + 1) * 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+uint64_t permute_key(uint64_t n, uint64_t size, uint64_t seed) {
+  assert(n < size);
+
+  uint32_t half = 1;
+  uint64_t mask;
+
+  /* the network works on an even number of bits covering the keys */
+  while (half < 32 && ((uint64_t)1 << (2 * half)) < size)
+    half++;
+
+  mask = ((uint64_t)1 << half) - 1;
+
+  /* a value outside of the keys is sent through again until it lands
+     on one. as the network is a permutation of its own range, that
+     keeps the keys a permutation too */
+  do {
+    uint64_t left = n >> half, right = n & mask;
+
+    for (uint64_t round = 0; round < FEISTEL_ROUNDS; round++) {
+      uint64_t next = left ^ (feistel_round(right ^ seed, round) & mask);
+
+      left = right;
+      right = next;
+    }
+    n = (left << half) | right;
+  } while (n >= size);
+
+  return n;
+}
+
+uint64_t table_key(SKY_SHARE *share, SKY_TABLE *table, uint64_t n) {
+  assert(share && table);
+
+  uint64_t c = share->concurrency;
+  uint64_t base = table->nwrite / c;
+
+  /* the rows are numbered in the order the workers take them, which
+     is the interleaved one, and laid out on 1 .. nwrite otherwise */
+  switch (share->key_order) {
+  case SKY_KEYS_PARTITIONED:
+    if (n < base * c)
+      return (n % c) * base + n / c + 1;
+    return n + 1;
+  case SKY_KEYS_DESCENDING:
+    return table->nwrite - n;
+  case SKY_KEYS_RANDOM:
+    return permute_key(n, table->nwrite,
+                       SKY_RAND_SEED + (table - share->tables)) + 1;
+  default:
+    return interleaved_key(share, table, n);
+  }
+}
+
+uint64_t next_free_key(SKY_SHARE *share, SKY_TABLE *table) {
+  assert(share && table && table->nwrite > 0);
+
+  /* interleaved keys are the largest of any layout */
+  return interleaved_key(share, table, table->nwrite - 1) + 1;
+}
+
+static uint64_t next_id(SKY_WORKER *worker, uint32_t col_num) {
   assert(worker);
-  return worker->current_seq_id[col_num] += worker->share->concurrency;
+  SKY_SHARE *share = worker->share;
+  SKY_TABLE *table = worker->table;
+  uint32_t stride = (worker->seq_stride) ? worker->seq_stride :
+                                          share->concurrency;
+  uint64_t value = worker->current_seq_id[col_num] += stride;
+
+  /* the counter hands out interleaved keys. those of the populated
+     rows are laid out by --key-order and the ones past them, as the
+     phases of a scenario insert, simply follow in sequence */
+  if (share->key_order == SKY_KEYS_INTERLEAVED ||
+      value >= next_free_key(share, table))
+    return value;
+
+  return table_key(share, table, interleaved_row(share, table, value));
+}
+
+/* picks a random key out of the ones generated for the referenced
+   table. the table number follows the placeholder, e.g. '%ref1' */
+static uint64_t ref_id(SKY_WORKER *worker, const char *placeholder,
+                       const char **end) {
+  char *pos;
+  long parent = strtol(placeholder + PLACEHOLDER_REF_LEN, &pos, 10) - 1;
+  SKY_TABLE *table = &worker->share->tables[parent];
+
+  /* random() only covers 31 bits, which a large table outgrows */
+  uint64_t draw = ((uint64_t)random() << 31) | (uint64_t)random();
+
+  *end = pos;
+  return table_key(worker->share, table, draw % table->nwrite);
+}
+
+double zipf_zeta(uint64_t n, double theta) {
+  uint64_t exact = (n < ZIPF_EXACT_TERMS) ? n : ZIPF_EXACT_TERMS;
+  double sum = 0;
+
+  for (uint64_t i = 1; i <= exact; i++)
+    sum += pow((double)i, -theta);
+
+  /* the rest is close to the integral of x^-theta around its terms */
+  if (n > exact)
+    sum += (pow(n + 0.5, 1 - theta) - pow(exact + 0.5, 1 - theta)) /
+           (1 - theta);
+  return sum;
+}
+
+void prepare_key_dist(SKY_SHARE *share) {
+  assert(share);
+
+  for (int i = 0; i < share->ntables; i++) {
+    SKY_TABLE *table = &share->tables[i];
+
+    if (share->key_dist == SKY_DIST_ZIPFIAN && table->nwrite > 0 &&
+        (table->write_tmpl[SKY_WRITE_UPDATE] ||
+         table->write_tmpl[SKY_WRITE_DELETE]))
+      table->zeta = zipf_zeta(table->nwrite, share->zipf_theta);
+  }
+}
+
+/* Draws the number of a row with the zipfian generator of Gray et al.
+   that YCSB uses. row 0 is the most popular */
+static uint64_t zipf_row(SKY_SHARE *share, SKY_TABLE *table) {
+  double theta = share->zipf_theta;
+  double n = table->nwrite;
+  double zeta2 = 1 + pow(0.5, theta);
+  double u = random() / ((double)RAND_MAX + 1);
+  double eta, uz = u * table->zeta;
+  uint64_t row;
+
+  if (uz < 1 || table->nwrite < 2)
+    return 0;
+  if (uz < zeta2)
+    return 1;
+
+  eta = (1 - pow(2 / n, 1 - theta)) / (1 - zeta2 / table->zeta);
+  row = (uint64_t)(n * pow(eta * u - eta + 1, 1 / (1 - theta)));
+  return (row < table->nwrite) ? row : table->nwrite - 1;
+}
+
+uint64_t draw_key(SKY_SHARE *share, SKY_TABLE *table) {
+  assert(share && table && table->nwrite > 0);
+
+  uint64_t row;
+
+  if (share->key_dist == SKY_DIST_ZIPFIAN) {
+    row = zipf_row(share, table);
+  } else {
+    /* random() only covers 31 bits, which a large table outgrows */
+    row = (((uint64_t)random() << 31) | (uint64_t)random()) % table->nwrite;
+  }
+  return table_key(share, table, row);
+}
+
+size_t write_query_size(SKY_TABLE *table, sky_write kind) {
+  assert(table && table->write_tmpl[kind]);
+
+  const char *tmpl = table->write_tmpl[kind];
+
+  /* every placeholder turns into a 64 bit value at most */
+  return strlen(tmpl) + string_occurrence(tmpl, "%") * 20 + 1;
+}
+
+size_t next_write_query(SKY_WORKER *worker, SKY_TABLE *table,
+                        sky_write kind, char *buffer, size_t buflen) {
+  assert(worker && table && buffer && table->write_tmpl[kind]);
+
+  const char *pos = table->write_tmpl[kind];
+  size_t length = 0;
+  bool keyed = false;
+
+  while (*pos != '\0') {
+    const char *mark = strchr(pos, SKY_PLACEHOLDER_SYM);
+    size_t text = (mark) ? (size_t)(mark - pos) : strlen(pos);
+    uint64_t value;
+    int written;
+
+    /* the text up to the next placeholder is copied as it is */
+    if (length + text >= buflen) {
+      report_error("supplied UPDATE or DELETE template is too long");
+      return 0;
+    }
+
+    memcpy(buffer + length, pos, text);
+    length += text;
+    pos += text;
+
+    if (mark == NULL)
+      break;
+
+    if (strncmp(pos, PLACEHOLDER_KEY, PLACEHOLDER_KEY_LEN) == 0) {
+      value = draw_key(worker->share, table);
+      pos += PLACEHOLDER_KEY_LEN;
+
+      /* the first key identifies the row when routing by key */
+      if (!keyed)
+        worker->row_key = value;
+      keyed = true;
+    } else if (strncmp(pos, PLACEHOLDER_RAND, PLACEHOLDER_RAND_LEN) == 0) {
+      value = (random() % DEFAULT_RAND_MOD) + 1;
+      pos += PLACEHOLDER_RAND_LEN;
+    } else if (strncmp(pos, PLACEHOLDER_REF, PLACEHOLDER_REF_LEN) == 0) {
+      value = ref_id(worker, pos, &pos);
+    } else {
+      /* not a placeholder, e.g. a LIKE pattern */
+      if (length + 1 >= buflen)
+        return 0;
+      buffer[length++] = *pos++;
+      continue;
+    }
+
+    written = snprintf(buffer + length, buflen - length, "%llu",
+                       (unsigned long long)value);
+
+    if (written < 0 || length + written >= buflen)
+      return 0;
+    length += written;
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+/* Strips a leading weight annotation, i.e. a comment that reads
+   weight=N, off a statement. The weight is left as it is if there's
+   none */
+static const char *strip_weight(const char *query, uint32_t *weight) {
+  const char *pos = query;
+  char *end;
+
+  while (*pos == ' ' || *pos == '\t')
+    pos++;
+
+  if (strncasecmp(pos, WEIGHT_ANNOTATION, WEIGHT_ANNOTATION_LEN) != 0)
+    return query;
+
+  unsigned long value = strtoul(pos + WEIGHT_ANNOTATION_LEN, &end, 10);
+
+  while (*end == ' ')
+    end++;
+
+  if (end == pos + WEIGHT_ANNOTATION_LEN || strncmp(end, "*/", 2) != 0)
+    return query;
+
+  *weight = value;
+  end += 2;
+
+  while (*end == ' ' || *end == '\t')
+    end++;
+  return end;
 }
 
 /* Read a given file and create a list with it's contents */
@@ -42,42 +325,97 @@ static SKY_LIST *load_file_to_list(const char *path) {
       query_len--;
     }
 
+    uint32_t weight = 1;
+    const char *query = strip_weight(buffer, &weight);
+
+    query_len -= query - buffer;
+
     if (!query_len) 
       continue;
 
-    if (!sky_list_push(list, buffer, query_len)) {
+    if (!sky_list_push(list, query, query_len)) {
       sky_list_free(list);
       fclose(sql_file);
       return NULL;
     }
+    list->tail->weight = weight;
     num_loaded++;
   }
 
   fclose(sql_file);
+
+  /* the workers pick the statements by their index */
+  if (!sky_list_index(list)) {
+    report_error("out of memory");
+    sky_list_free(list);
+    return NULL;
+  }
   return list;
 }
 
-size_t next_insert_query(SKY_WORKER *worker, char *buffer, size_t buflen) {
+size_t insert_query_size(SKY_TABLE *table) {
+  assert(table && table->insert_tmpl);
+
+  /* every placeholder turns into a quoted 64 bit value and a comma,
+     plus the bytes of the payloads if there are any */
+  return strlen(table->insert_tmpl) + table->columns * 23 +
+         table->payload_size + 1;
+}
+
+/* Cuts the next payload out of the payload source. Its size is
+   uniformly distributed over --payload-size */
+static size_t next_payload(SKY_SHARE *share, const char **data) {
+  SKY_PAYLOAD *payload = share->payload;
+  uint64_t size = share->payload_min;
+  uint64_t offset;
+
+  if (share->payload_max > share->payload_min)
+    size += random() % (share->payload_max - share->payload_min + 1);
+
+  offset = ((uint64_t)random() << 31) | random();
+  *data = payload->data + offset % (payload->size - size + 1);
+  return size;
+}
+
+static void add_piece(SKY_PIECES *pieces, const char *base, size_t length) {
+  pieces->piece[pieces->count].iov_base = (void *)base;
+  pieces->piece[pieces->count].iov_len = length;
+  pieces->count++;
+}
+
+/* Generates the next row of the table. The payloads are copied into
+   the buffer unless the query is to be sent in pieces */
+static size_t generate_insert(SKY_WORKER *worker, char *buffer,
+                              size_t buflen, SKY_PIECES *pieces) {
+  assert(worker && worker->table);
+
+  SKY_TABLE *table = worker->table;
   size_t query_length;  
-  char *pos, *write_ptr;
+  const char *pos;
+  char *write_ptr;
+  char *piece_start;
 
   /* copy everything up to the values. e.g. 'INSERT INTO t1 VALUES (' */
   write_ptr = buffer;
-  pos = strchr(worker->share->insert_tmpl, SKY_PLACEHOLDER_SYM);
+  piece_start = buffer;
+  pos = strchr(table->insert_tmpl, SKY_PLACEHOLDER_SYM);
   query_length = 0;
 
+  if (pieces)
+    pieces->count = 0;
+
   if (pos == NULL)
     return 0;
 
-  size_t temp = pos - worker->share->insert_tmpl;
+  size_t temp = pos - table->insert_tmpl;
   size_t free_space = buflen - temp;
 
-  if (temp > SKY_STRSIZ) {
+  if (temp >= buflen) {
     report_error("supplied INSERT query template is too long");
     return 0;
   }
 
-  strncpy(write_ptr, worker->share->insert_tmpl, temp);
+  strncpy(write_ptr, table->insert_tmpl, temp);
   write_ptr += temp;
   query_length += temp;
 
@@ -85,7 +423,7 @@ size_t next_insert_query(SKY_WORKER *worker, char *buffer, size_t buflen) {
   pos--; 
 
   /* now we look for placeholders and generate values for it */
-  for (int i = 0; i < worker->share->columns; i++) {
+  for (int i = 0; i < table->columns; i++) {
     pos = strchr(pos, SKY_PLACEHOLDER_SYM);
 
     if (pos == NULL) {
@@ -93,17 +431,59 @@ size_t next_insert_query(SKY_WORKER *worker, char *buffer, size_t buflen) {
       return 0;
     }
 
+    uint64_t value;
+
+    if (strncmp(pos, PLACEHOLDER_PAYLOAD, PLACEHOLDER_PAYLOAD_LEN) == 0) {
+      const char *data;
+      size_t size = next_payload(worker->share, &data);
+
+      pos += PLACEHOLDER_PAYLOAD_LEN;
+
+      if (size + 3 > free_space && pieces == NULL) {
+        report_error("supplied INSERT query template is too long");
+        return 0;
+      }
+
+      /* the text so far ends with the opening quote */
+      *write_ptr++ = '"';
+      free_space--;
+
+      if (pieces) {
+        add_piece(pieces, piece_start, write_ptr - piece_start);
+        add_piece(pieces, data, size);
+        piece_start = write_ptr;
+      } else {
+        memcpy(write_ptr, data, size);
+        write_ptr += size;
+        free_space -= size;
+      }
+
+      memcpy(write_ptr, "\",", 2);
+      write_ptr += 2;
+      free_space -= 2;
+      query_length += size + 3;
+      continue;
+    }
+
     if (strncmp(pos, PLACEHOLDER_RAND, PLACEHOLDER_RAND_LEN) == 0) {
-      temp = snprintf(write_ptr, free_space, "\"%ld\",",
-                      (random() % DEFAULT_RAND_MOD) + 1);
+      value = (random() % DEFAULT_RAND_MOD) + 1;
       pos += PLACEHOLDER_RAND_LEN;
     } else if (strncmp(pos, PLACEHOLDER_SEQ, PLACEHOLDER_SEQ_LEN) == 0) {
-      temp = snprintf(write_ptr, free_space, "\"%d\",", next_id(worker, i));
+      value = next_id(worker, i);
       pos += PLACEHOLDER_SEQ_LEN;
+    } else if (strncmp(pos, PLACEHOLDER_REF, PLACEHOLDER_REF_LEN) == 0) {
+      value = ref_id(worker, pos, &pos);
     } else {
       return 0;
     }
 
+    /* the first value identifies the row when routing by key */
+    if (i == 0)
+      worker->row_key = value;
+
+    temp = snprintf(write_ptr, free_space, "\"%llu\",",
+                    (unsigned long long)value);
+
     write_ptr += temp;
     query_length += temp;
     free_space -= temp;
@@ -111,12 +491,29 @@ size_t next_insert_query(SKY_WORKER *worker, char *buffer, size_t buflen) {
 
   /* rewind 1 byte to ignore the final comma */
   write_ptr--;
+  query_length--;
+  free_space++;
 
   /* copy everything up to the end of the statement */
-  strncpy(write_ptr, pos, buflen-query_length);
+  strncpy(write_ptr, pos, free_space);
+  query_length += strlen(pos);
+
+  if (pieces)
+    add_piece(pieces, piece_start, write_ptr + strlen(pos) - piece_start);
+
   return query_length;
 }
 
+size_t next_insert_query(SKY_WORKER *worker, char *buffer, size_t buflen) {
+  return generate_insert(worker, buffer, buflen, NULL);
+}
+
+size_t next_insert_pieces(SKY_WORKER *worker, char *buffer, size_t buflen,
+                          SKY_PIECES *pieces) {
+  assert(pieces);
+  return generate_insert(worker, buffer, buflen, pieces);
+}
+
 bool preload_sql_file(SKY_SHARE *share) {
   assert(share);
 
@@ -124,12 +521,94 @@ bool preload_sql_file(SKY_SHARE *share) {
     share->read_queries = load_file_to_list(share->read_file_path);
     if (share->read_queries == NULL)
       return false;
+
+    /* every reader picks its statements out of the file */
+    if (share->read_queries->size == 0) {
+      report_error("the specified SQL file has no statements");
+      sky_list_free(share->read_queries);
+      share->read_queries = NULL;
+      return false;
+    }
   }
 
   if (share->load_file_path) {
-    share->load_queries = load_file_to_list(share->load_file_path);
+    share->load_queries = split_file_to_list(share->load_file_path);
     if (share->load_queries == NULL)
       return false;
   }
   return true;
 }
+
+uint32_t weighted_pick(const SKY_LIST *list, uint64_t draw) {
+  assert(list && list->cumulative && list->size > 0);
+
+  uint64_t total = list->cumulative[list->size - 1];
+  size_t low = 0, high = list->size - 1;
+
+  /* without any weight every statement is as likely */
+  if (total == 0)
+    return draw % list->size;
+
+  draw %= total;
+
+  /* the first statement whose running total exceeds the draw */
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+
+    if (list->cumulative[middle] > draw)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return low;
+}
+
+bool plan_read_order(SKY_WORKER *worker) {
+  assert(worker && worker->share->read_queries);
+
+  SKY_SHARE *share = worker->share;
+  SKY_LIST *list = share->read_queries;
+  uint32_t *order = worker->read_order;
+  size_t n = list->size;
+  size_t offset;
+
+  if (order == NULL) {
+    if ((order = malloc(sizeof(uint32_t) * n)) == NULL)
+      return false;
+    worker->read_order = order;
+  }
+
+  switch (share->read_order) {
+  case SKY_ORDER_OFFSET:
+    /* the workers start spread evenly over the file */
+    offset = (size_t)(worker->unique_id - 1) * n / share->concurrency;
+    for (size_t i = 0; i < n; i++)
+      order[i] = (offset + i) % n;
+    break;
+  case SKY_ORDER_RANDOM:
+    for (size_t i = 0; i < n; i++)
+      order[i] = random() % n;
+    break;
+  case SKY_ORDER_WEIGHTED:
+    for (size_t i = 0; i < n; i++)
+      order[i] = weighted_pick(list, (uint64_t)random() << 31 | random());
+    break;
+  case SKY_ORDER_SHUFFLE:
+    /* Fisher-Yates */
+    for (size_t i = 0; i < n; i++)
+      order[i] = i;
+    for (size_t i = n - 1; i > 0; i--) {
+      size_t j = random() % (i + 1);
+      uint32_t temp = order[i];
+
+      order[i] = order[j];
+      order[j] = temp;
+    }
+    break;
+  default:
+    for (size_t i = 0; i < n; i++)
+      order[i] = i;
+    break;
+  }
+  return true;
+}
@@ -9,24 +9,104 @@
 #ifndef __SKYFALL_GENERATOR_H__
 #define __SKYFALL_GENERATOR_H__
 
+#include <sys/uio.h>
 #include "skyload.h"
 
 #define PLACEHOLDER_SEQ  "%seq"
 #define PLACEHOLDER_RAND "%rand"
+#define PLACEHOLDER_REF  "%ref"
+#define PLACEHOLDER_PAYLOAD "%payload"
+#define PLACEHOLDER_KEY  "%key"
 #define PLACEHOLDER_SEQ_LEN  4
 #define PLACEHOLDER_RAND_LEN 5
+#define PLACEHOLDER_REF_LEN  4
+#define PLACEHOLDER_PAYLOAD_LEN 8
+#define PLACEHOLDER_KEY_LEN  4
+
+/* text around every payload plus the payloads themselves */
+#define SKY_MAX_PIECES (2 * SKY_MAX_COLS + 1)
+
+/* A generated query broken down into the pieces it's sent in. The
+   text is written to the caller's buffer while the %payload values
+   point into the payload source, so they're never copied */
+typedef struct {
+  struct iovec piece[SKY_MAX_PIECES];
+  int count;
+} SKY_PIECES;
+
+/* statements of a file may start with a weight=N comment */
+#define WEIGHT_ANNOTATION     "/* weight="
+#define WEIGHT_ANNOTATION_LEN 10
 
 #define DEFAULT_RAND_MOD 10000 
+#define FEISTEL_ROUNDS   4
+#define ZIPF_EXACT_TERMS 1000000 /* terms of zeta(n) summed one by one */
 #define MAX_LOADABLE_QUERIES 10000000
 
-/* creates the next INSERT query for the given worker object.
+/* returns the key that the n-th row of the given table received
+   for its %seq columns, according to --key-order */
+uint64_t table_key(SKY_SHARE *share, SKY_TABLE *table, uint64_t n);
+
+/* returns the first key past the populated rows of the table */
+uint64_t next_free_key(SKY_SHARE *share, SKY_TABLE *table);
+
+/* returns where 'n' lands in a pseudo-random permutation of 0 .. size-1
+   chosen by the seed. the permutation is computed by a Feistel network
+   rather than stored, so any key space can be shuffled for free */
+uint64_t permute_key(uint64_t n, uint64_t size, uint64_t seed);
+
+/* returns the size of a buffer that any INSERT query generated from
+   the template of the given table fits in */
+size_t insert_query_size(SKY_TABLE *table);
+
+/* creates the next INSERT query for the table that the given worker
+   is currently populating.
    on success, the return value of this function is the length
    of the generated query and 0 on failure */
 size_t next_insert_query(SKY_WORKER *worker, char *buffer, size_t buflen);
 
+/* same as next_insert_query() but leaves the %payload values out of
+   the buffer and describes the query as pieces instead */
+size_t next_insert_pieces(SKY_WORKER *worker, char *buffer, size_t buflen,
+                          SKY_PIECES *pieces);
+
+/* returns the sum of 1/i^theta for i = 1 .. n. the terms past
+   ZIPF_EXACT_TERMS are approximated by an integral */
+double zipf_zeta(uint64_t n, double theta);
+
+/* prepares the tables with UPDATE or DELETE templates for drawing
+   keys from --key-dist */
+void prepare_key_dist(SKY_SHARE *share);
+
+/* returns the key of an existing row of the table, drawn from the
+   distribution chosen with --key-dist */
+uint64_t draw_key(SKY_SHARE *share, SKY_TABLE *table);
+
+/* returns the size of a buffer that any query generated from the
+   UPDATE or DELETE template of the table fits in */
+size_t write_query_size(SKY_TABLE *table, sky_write kind);
+
+/* creates the next UPDATE or DELETE query for the given table. %key
+   stands for the key of an existing row of the table, %rand and %refN
+   are the same as in INSERT templates, and the values are written out
+   unquoted. the first %key is kept as the worker's row key. returns
+   the length of the query and 0 on failure */
+size_t next_write_query(SKY_WORKER *worker, SKY_TABLE *table,
+                        sky_write kind, char *buffer, size_t buflen);
+
 /* read the provided external SQL file and convert the content
    into skyload's internal representation. The internal representation
    is a singly linked list (SKY_LIST) of queries. */
 bool preload_sql_file(SKY_SHARE *share);
 
+/* returns the index of the read statement that the given draw of
+   a uniformly distributed random number falls on, weighted by the
+   weight annotations of the statements */
+uint32_t weighted_pick(const SKY_LIST *list, uint64_t draw);
+
+/* fills the order the worker runs the read statements in during
+   its next run, according to --read-order. every run is as long
+   as the file. returns false if out of memory */
+bool plan_read_order(SKY_WORKER *worker);
+
 #endif
@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "metrics.h"
+
+/* Upper bounds of the exported latency buckets in usec */
+static const uint64_t latency_bounds[] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+  500000, 1000000, 2500000, 5000000, 10000000
+};
+
+#define METRICS_NBOUNDS (sizeof(latency_bounds) / sizeof(latency_bounds[0]))
+
+/* Listens on a Unix domain socket, replacing one left behind by an
+   earlier run */
+static int listen_unix(const char *path) {
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+
+  if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    return -1;
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, METRICS_BACKLOG) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Listens on [host:]port, the host defaulting to SKY_METRICS_HOST so
+   that the endpoint isn't exposed unless asked for */
+static int listen_tcp(const char *address) {
+  const char *colon = strrchr(address, ':');
+  const char *port = (colon) ? colon + 1 : address;
+  char host[SKY_STRSIZ];
+  struct addrinfo hints, *list, *ai;
+  char *end;
+  long number = strtol(port, &end, 10);
+  int fd = -1, on = 1;
+
+  if (*port == '\0' || *end != '\0' || number < 1 || number > 65535)
+    return -1;
+
+  if (colon == NULL || colon == address) {
+    snprintf(host, sizeof(host), "%s", SKY_METRICS_HOST);
+  } else if (address[0] == '[' && colon[-1] == ']') {
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - address - 2),
+             address + 1);
+  } else {
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - address), address);
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  if (getaddrinfo(host, port, &hints, &list) != 0)
+    return -1;
+
+  for (ai = list; ai != NULL && fd < 0; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+      continue;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 ||
+        listen(fd, METRICS_BACKLOG) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  freeaddrinfo(list);
+  return fd;
+}
+
+SKY_METRICS *sky_metrics_new(SKY_SHARE *share, SKY_WORKER **workers) {
+  assert(share && workers && share->metrics_addr);
+
+  const char *address = share->metrics_addr;
+  SKY_METRICS *metrics;
+
+  if ((metrics = calloc(1, sizeof(*metrics))) == NULL)
+    return NULL;
+
+  metrics->share = share;
+  metrics->workers = workers;
+  metrics->fd = -1;
+  pthread_mutex_init(&metrics->lock, NULL);
+
+  if (strchr(address, '/')) {
+    if ((metrics->path = strdup(address)) == NULL) {
+      sky_metrics_free(metrics);
+      return NULL;
+    }
+    metrics->fd = listen_unix(address);
+  } else {
+    metrics->fd = listen_tcp(address);
+  }
+
+  if (metrics->fd < 0) {
+    fprintf(stderr, "failed to listen on (%s)\n", address);
+    sky_metrics_free(metrics);
+    return NULL;
+  }
+  return metrics;
+}
+
+void sky_metrics_free(SKY_METRICS *metrics) {
+  if (metrics == NULL)
+    return;
+
+  if (metrics->running)
+    metrics_stop(metrics);
+
+  if (metrics->fd >= 0)
+    close(metrics->fd);
+
+  if (metrics->path) {
+    unlink(metrics->path);
+    free(metrics->path);
+  }
+
+  pthread_mutex_destroy(&metrics->lock);
+  free(metrics);
+}
+
+/* Reads a counter a worker is updating */
+static uint64_t load_counter(const uint64_t *counter) {
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void write_header(FILE *out, const char *name, const char *type,
+                         const char *help) {
+  fprintf(out, "# HELP %s %s\n", name, help);
+  fprintf(out, "# TYPE %s %s\n", name, type);
+}
+
+/* Adds up the counts of the given workers. Unopened workers of a
+   pool are NULL */
+static void add_workers(SKY_WORKER **workers, uint32_t nworkers,
+                        SKY_METRICS_TOTALS *totals, uint32_t *phases,
+                        uint32_t *aborted, uint32_t *in_flight) {
+  for (uint32_t i = 0; i < nworkers; i++) {
+    SKY_WORKER *worker = workers[i];
+    uint16_t phase;
+
+    if (worker == NULL)
+      continue;
+
+    sky_histogram_merge(&totals->latency[SKY_PHASE_INSERT],
+                        &worker->insert_latency);
+    sky_histogram_merge(&totals->latency[SKY_PHASE_WRITE],
+                        &worker->write_latency);
+    sky_histogram_merge(&totals->latency[SKY_PHASE_READ],
+                        &worker->read_latency);
+    sky_histogram_merge(&totals->latency[SKY_PHASE_REPLAY],
+                        &worker->replay_latency);
+
+    totals->errors += load_counter(&worker->failed_queries);
+    totals->retries += load_counter(&worker->retries);
+    totals->reconnects += load_counter(&worker->reconnects);
+    totals->rows += load_counter(&worker->rows_inserted);
+    totals->runs += load_counter(&worker->file_runs);
+
+    if (phases == NULL)
+      continue;
+
+    phase = __atomic_load_n(&worker->phase, __ATOMIC_RELAXED);
+    phases[(phase < SKY_NPHASES) ? phase : SKY_NPHASES]++;
+    *aborted += __atomic_load_n(&worker->aborted, __ATOMIC_RELAXED);
+    *in_flight += __atomic_load_n(&worker->in_flight, __ATOMIC_RELAXED);
+  }
+}
+
+bool write_metrics(SKY_METRICS *metrics, FILE *out) {
+  assert(metrics && out);
+
+  SKY_SHARE *share = metrics->share;
+  SKY_METRICS_TOTALS *totals = &metrics->scrape;
+  uint64_t counts[SKY_NPHASES][METRICS_NBOUNDS];
+  uint64_t queries[SKY_NPHASES];
+  uint32_t phases[SKY_NPHASES + 1] = {0};
+  uint32_t aborted = 0, in_flight = 0;
+  uint64_t now = current_usec();
+
+  /* a pool is only published or withdrawn under the lock */
+  pthread_mutex_lock(&metrics->lock);
+  memcpy(totals, &metrics->retired, sizeof(*totals));
+  add_workers(metrics->workers, share->concurrency, totals, phases,
+              &aborted, &in_flight);
+  if (metrics->pool) {
+    add_workers(metrics->pool, metrics->pool_size, totals, phases,
+                &aborted, &in_flight);
+  }
+  pthread_mutex_unlock(&metrics->lock);
+
+  /* the buckets were read one at a time, so their total stands in
+     for the count to keep the histogram consistent */
+  for (int p = 0; p < SKY_NPHASES; p++) {
+    queries[p] = sky_histogram_cumulative(&totals->latency[p],
+                                          latency_bounds, METRICS_NBOUNDS,
+                                          counts[p]);
+  }
+
+  /* the throughput gauge moves at most once per window however often
+     the endpoint is scraped */
+  if (metrics->rate_time == 0)
+    metrics->rate_time = share->start_time;
+
+  if (now - metrics->rate_time >= METRICS_RATE_WINDOW) {
+    for (int p = 0; p < SKY_NPHASES; p++) {
+      metrics->qps[p] = (double)(queries[p] - metrics->rate_queries[p]) *
+                        1000000 / (now - metrics->rate_time);
+      metrics->rate_queries[p] = queries[p];
+    }
+    metrics->rate_time = now;
+  }
+
+  write_header(out, "skyload_elapsed_seconds", "gauge",
+               "Seconds since the load started.");
+  fprintf(out, "skyload_elapsed_seconds %.3lf\n",
+          (double)(now - share->start_time) / 1000000);
+
+  write_header(out, "skyload_workers", "gauge",
+               "Workers by the phase they are in.");
+  for (int p = 0; p < SKY_NPHASES; p++)
+    fprintf(out, "skyload_workers{phase=\"%s\"} %u\n", phase_name(p),
+            phases[p]);
+  fprintf(out, "skyload_workers{phase=\"done\"} %u\n", phases[SKY_NPHASES]);
+
+  write_header(out, "skyload_workers_aborted", "gauge",
+               "Workers that gave up on an error.");
+  fprintf(out, "skyload_workers_aborted %u\n", aborted);
+
+  write_header(out, "skyload_queries_total", "counter",
+               "Statements completed by phase.");
+  for (int p = 0; p < SKY_NPHASES; p++)
+    fprintf(out, "skyload_queries_total{phase=\"%s\"} %llu\n",
+            phase_name(p), (unsigned long long)queries[p]);
+
+  write_header(out, "skyload_queries_per_second", "gauge",
+               "Statements completed per second by phase.");
+  for (int p = 0; p < SKY_NPHASES; p++)
+    fprintf(out, "skyload_queries_per_second{phase=\"%s\"} %.1lf\n",
+            phase_name(p), metrics->qps[p]);
+
+  write_header(out, "skyload_query_duration_seconds", "histogram",
+               "Latency of the completed statements by phase.");
+  for (int p = 0; p < SKY_NPHASES; p++) {
+    for (uint32_t b = 0; b < METRICS_NBOUNDS; b++) {
+      fprintf(out, "skyload_query_duration_seconds_bucket"
+              "{phase=\"%s\",le=\"%g\"} %llu\n", phase_name(p),
+              (double)latency_bounds[b] / 1000000,
+              (unsigned long long)counts[p][b]);
+    }
+    fprintf(out, "skyload_query_duration_seconds_bucket"
+            "{phase=\"%s\",le=\"+Inf\"} %llu\n", phase_name(p),
+            (unsigned long long)queries[p]);
+    fprintf(out, "skyload_query_duration_seconds_sum{phase=\"%s\"} %.6lf\n",
+            phase_name(p), (double)totals->latency[p].sum / 1000000);
+    fprintf(out, "skyload_query_duration_seconds_count{phase=\"%s\"} %llu\n",
+            phase_name(p), (unsigned long long)queries[p]);
+  }
+
+  write_header(out, "skyload_in_flight_queries", "gauge",
+               "Statements sent and awaiting their result.");
+  fprintf(out, "skyload_in_flight_queries %u\n", in_flight);
+
+  write_header(out, "skyload_errors_total", "counter",
+               "Statements given up on.");
+  fprintf(out, "skyload_errors_total %llu\n", (unsigned long long)totals->errors);
+
+  write_header(out, "skyload_retries_total", "counter",
+               "Statements attempted again.");
+  fprintf(out, "skyload_retries_total %llu\n", (unsigned long long)totals->retries);
+
+  write_header(out, "skyload_reconnects_total", "counter",
+               "Connections re-established.");
+  fprintf(out, "skyload_reconnects_total %llu\n",
+          (unsigned long long)totals->reconnects);
+
+  write_header(out, "skyload_rows_inserted_total", "counter",
+               "Rows generated and inserted.");
+  fprintf(out, "skyload_rows_inserted_total %llu\n",
+          (unsigned long long)totals->rows);
+
+  write_header(out, "skyload_read_file_runs_total", "counter",
+               "Completed runs of the read file, summed over the workers.");
+  fprintf(out, "skyload_read_file_runs_total %llu\n",
+          (unsigned long long)totals->runs);
+
+  return (ferror(out) == 0);
+}
+
+void metrics_publish(SKY_METRICS *metrics, SKY_WORKER **pool,
+                     uint32_t size) {
+  assert(metrics);
+
+  pthread_mutex_lock(&metrics->lock);
+
+  if (metrics->pool) {
+    add_workers(metrics->pool, metrics->pool_size, &metrics->retired,
+                NULL, NULL, NULL);
+
+    for (uint32_t i = 0; i < metrics->pool_size; i++) {
+      SKY_WORKER *worker = metrics->pool[i];
+
+      if (worker == NULL)
+        continue;
+
+      sky_histogram_reset(&worker->insert_latency);
+      sky_histogram_reset(&worker->write_latency);
+      sky_histogram_reset(&worker->read_latency);
+      sky_histogram_reset(&worker->replay_latency);
+      worker->failed_queries = 0;
+      worker->retries = 0;
+      worker->reconnects = 0;
+      worker->rows_inserted = 0;
+      worker->file_runs = 0;
+    }
+  }
+
+  metrics->pool = pool;
+  metrics->pool_size = (pool) ? size : 0;
+  pthread_mutex_unlock(&metrics->lock);
+}
+
+/* Sends the whole buffer unless the scraper goes away */
+static bool send_all(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+
+    data += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+static void send_response(int fd, int code, const char *reason,
+                          const char *body, size_t length) {
+  char header[SKY_STRSIZ];
+  int size;
+
+  size = snprintf(header, sizeof(header),
+                  "HTTP/1.1 %d %s\r\n"
+                  "Content-Type: %s\r\n"
+                  "Content-Length: %zu\r\n"
+                  "Connection: close\r\n\r\n",
+                  code, reason, METRICS_CONTENT_TYPE, length);
+
+  if (send_all(fd, header, size) && length > 0)
+    send_all(fd, body, length);
+}
+
+/* Answers a single request. Only the request line is looked at, the
+   headers are read past */
+static void serve_request(SKY_METRICS *metrics, int fd) {
+  struct timeval timeout = {METRICS_TIMEOUT, 0};
+  char request[METRICS_REQUEST_SIZE];
+  char method[16], target[256];
+  size_t length = 0;
+  char *body = NULL;
+  size_t size = 0;
+  bool written;
+  FILE *out;
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  while (length < sizeof(request) - 1) {
+    ssize_t received = recv(fd, request + length,
+                            sizeof(request) - 1 - length, 0);
+
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      break;
+
+    length += received;
+    request[length] = '\0';
+
+    if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+      break;
+  }
+  request[length] = '\0';
+
+  if (sscanf(request, "%15s %255s", method, target) != 2) {
+    send_response(fd, 400, "Bad Request", NULL, 0);
+    return;
+  }
+
+  if (strcmp(method, "GET") != 0) {
+    send_response(fd, 405, "Method Not Allowed", NULL, 0);
+    return;
+  }
+
+  target[strcspn(target, "?")] = '\0';
+
+  if (strcmp(target, "/metrics") != 0 && strcmp(target, "/") != 0) {
+    send_response(fd, 404, "Not Found", NULL, 0);
+    return;
+  }
+
+  if ((out = open_memstream(&body, &size)) == NULL) {
+    send_response(fd, 500, "Internal Server Error", NULL, 0);
+    return;
+  }
+
+  written = write_metrics(metrics, out);
+
+  if (fclose(out) == 0 && written) {
+    send_response(fd, 200, "OK", body, size);
+  } else {
+    send_response(fd, 500, "Internal Server Error", NULL, 0);
+  }
+
+  metrics->scrapes++;
+  free(body);
+}
+
+static void *metrics_workload(void *arg) {
+  SKY_METRICS *metrics = (SKY_METRICS *)arg;
+  struct pollfd listener = {metrics->fd, POLLIN, 0};
+
+  for (;;) {
+    bool stop;
+    int fd;
+
+    pthread_mutex_lock(&metrics->lock);
+    stop = metrics->stop;
+    pthread_mutex_unlock(&metrics->lock);
+
+    if (stop)
+      break;
+
+    /* wakes up now and then to see if it's been stopped */
+    if (poll(&listener, 1, METRICS_POLL_MSEC) <= 0)
+      continue;
+
+    if ((fd = accept(metrics->fd, NULL, NULL)) < 0)
+      continue;
+
+    serve_request(metrics, fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+bool metrics_start(SKY_METRICS *metrics) {
+  assert(metrics);
+
+  if (pthread_create(&metrics->thread_id, NULL, metrics_workload,
+                     (void *)metrics)) {
+    report_error("failed to create metrics exporter thread");
+    return false;
+  }
+
+  metrics->running = true;
+  return true;
+}
+
+void metrics_stop(SKY_METRICS *metrics) {
+  assert(metrics);
+
+  if (!metrics->running)
+    return;
+
+  pthread_mutex_lock(&metrics->lock);
+  metrics->stop = true;
+  pthread_mutex_unlock(&metrics->lock);
+
+  pthread_join(metrics->thread_id, NULL);
+  metrics->running = false;
+}
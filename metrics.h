@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_METRICS_H__
+#define __SKYLOAD_METRICS_H__
+
+#include "skyload.h"
+
+#define METRICS_POLL_MSEC    100  /* how often the exporter looks for a stop */
+#define METRICS_TIMEOUT      1    /* secs a scraper has to send its request */
+#define METRICS_REQUEST_SIZE 4096
+#define METRICS_RATE_WINDOW  1000000 /* usec the throughput gauge spans */
+#define METRICS_BACKLOG      16
+
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4"
+
+/* Counts of the workers no longer followed */
+typedef struct _sky_metrics_totals {
+  SKY_HISTOGRAM latency[SKY_NPHASES];
+  uint64_t errors;
+  uint64_t retries;
+  uint64_t reconnects;
+  uint64_t rows;
+  uint64_t runs;
+} SKY_METRICS_TOTALS;
+
+/* Serves the client side counters in the Prometheus text format from
+   a thread of its own, over HTTP on a local TCP port or a Unix domain
+   socket. The counters are read without locks while the workers go on
+   updating them. They are only ever added to, so a scrape is at worst
+   behind by the statements finishing while it's taken. The workers
+   of a sweep, search or scenario are followed once published. */
+typedef struct _sky_metrics {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_WORKER **pool;        /* published workers of a later run, if any */
+  uint32_t pool_size;
+  SKY_METRICS_TOTALS retired; /* left behind by the pools withdrawn */
+  int fd;                   /* listening socket */
+  char *path;               /* Unix domain socket to remove, if any */
+  pthread_t thread_id;
+  pthread_mutex_t lock;
+  bool running;
+  bool stop;
+  uint64_t scrapes;         /* requests answered */
+  SKY_METRICS_TOTALS scrape; /* added up at every scrape */
+  uint64_t rate_time;       /* usec timestamp of the throughput gauge */
+  uint64_t rate_queries[SKY_NPHASES]; /* statements as of 'rate_time' */
+  double qps[SKY_NPHASES];
+} SKY_METRICS;
+
+/* allocator and deallocator of the exporter. the allocator starts
+   listening on share->metrics_addr, which is either [host:]port or,
+   if it contains a '/', the path of a Unix domain socket */
+SKY_METRICS *sky_metrics_new(SKY_SHARE *share, SKY_WORKER **workers);
+void sky_metrics_free(SKY_METRICS *metrics);
+
+/* writes the current value of every metric to the given stream.
+   returns false if the stream could not be written */
+bool write_metrics(SKY_METRICS *metrics, FILE *out);
+
+/* hands the workers of a sweep, search or scenario to the exporter
+   in place of those published before. the counts of the previous pool
+   are kept and then cleared from its workers, so a pool can be
+   published again between runs. NULL withdraws the current pool */
+void metrics_publish(SKY_METRICS *metrics, SKY_WORKER **pool,
+                     uint32_t size);
+
+/* starts and stops the exporter thread */
+bool metrics_start(SKY_METRICS *metrics);
+void metrics_stop(SKY_METRICS *metrics);
+
+#endif
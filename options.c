@@ -6,7 +6,11 @@
  * BSD license. See the COPYING file for full text.
  */
 
+#include <ctype.h>
+#include <errno.h>
 #include "skyload.h"
+#include "generator.h"
+#include "payload.h"
 
 typedef enum {
   OPT_HELP = 'h',
@@ -15,6 +19,7 @@ typedef enum {
   OPT_CREATE_QUERY,
   OPT_INSERT_TMPL,
   OPT_NUM_ROWS,
+  OPT_TXN_SIZE,
   OPT_CONCURRENCY,
   OPT_NUM_SELECT,
   OPT_KEEP_DB,
@@ -22,6 +27,46 @@ typedef enum {
   OPT_LOAD_FILE,
   OPT_READ_FILE,
   OPT_NUM_RUNS,
+  OPT_REPLAY_FILE,
+  OPT_SPEED,
+  OPT_SWEEP,
+  OPT_SWEEP_TIME,
+  OPT_WARMUP,
+  OPT_REPLICA,
+  OPT_ROUTE,
+  OPT_MAX_RETRIES,
+  OPT_RETRY_BACKOFF,
+  OPT_REPORT_INTERVAL,
+  OPT_JSON,
+  OPT_COMPARE,
+  OPT_TOLERANCE,
+  OPT_NOISE_FLOOR,
+  OPT_NOISE_Z,
+  OPT_STATUS,
+  OPT_STATUS_VARS,
+  OPT_ENGINE_STATUS,
+  OPT_PIPELINE,
+  OPT_THINK_TIME,
+  OPT_PACE,
+  OPT_READ_ORDER,
+  OPT_RUN_WARMUP,
+  OPT_SOAK,
+  OPT_SOAK_FILE,
+  OPT_SOAK_ROTATE,
+  OPT_METRICS,
+  OPT_SCENARIO,
+  OPT_PAYLOAD_SIZE,
+  OPT_PAYLOAD_FILE,
+  OPT_KEY_ORDER,
+  OPT_UPDATE_TMPL,
+  OPT_DELETE_TMPL,
+  OPT_WRITES,
+  OPT_KEY_DIST,
+  OPT_SLOWEST,
+  OPT_TRACE,
+  OPT_TRACE_SAMPLE,
+  OPT_SEARCH,
+  OPT_SLO,
   OPT_MYSQL_PROT
 } sky_options;
 
@@ -32,19 +77,86 @@ static struct option longopts[] = {
   {"db", required_argument, NULL, OPT_USE_DB},
   {"port", required_argument, NULL, OPT_PORT},
   {"server", required_argument, NULL, OPT_SERVER},
+  {"replica", required_argument, NULL, OPT_REPLICA},
+  {"route", required_argument, NULL, OPT_ROUTE},
   {"load-file", required_argument, NULL, OPT_LOAD_FILE},
   {"read-file", required_argument, NULL, OPT_READ_FILE},
   {"runs", required_argument, NULL, OPT_NUM_RUNS},
+  {"replay-file", required_argument, NULL, OPT_REPLAY_FILE},
+  {"speed", required_argument, NULL, OPT_SPEED},
+  {"sweep", required_argument, NULL, OPT_SWEEP},
+  {"sweep-time", required_argument, NULL, OPT_SWEEP_TIME},
+  {"warmup", required_argument, NULL, OPT_WARMUP},
+  {"max-retries", required_argument, NULL, OPT_MAX_RETRIES},
+  {"retry-backoff", required_argument, NULL, OPT_RETRY_BACKOFF},
+  {"report-interval", required_argument, NULL, OPT_REPORT_INTERVAL},
+  {"json", required_argument, NULL, OPT_JSON},
+  {"compare", required_argument, NULL, OPT_COMPARE},
+  {"tolerance", required_argument, NULL, OPT_TOLERANCE},
+  {"noise-floor", required_argument, NULL, OPT_NOISE_FLOOR},
+  {"noise-z", required_argument, NULL, OPT_NOISE_Z},
+  {"status", no_argument, NULL, OPT_STATUS},
+  {"status-vars", required_argument, NULL, OPT_STATUS_VARS},
+  {"engine-status", no_argument, NULL, OPT_ENGINE_STATUS},
+  {"pipeline", required_argument, NULL, OPT_PIPELINE},
+  {"think-time", required_argument, NULL, OPT_THINK_TIME},
+  {"pace", required_argument, NULL, OPT_PACE},
+  {"read-order", required_argument, NULL, OPT_READ_ORDER},
+  {"run-warmup", required_argument, NULL, OPT_RUN_WARMUP},
+  {"soak", no_argument, NULL, OPT_SOAK},
+  {"soak-file", required_argument, NULL, OPT_SOAK_FILE},
+  {"soak-rotate", required_argument, NULL, OPT_SOAK_ROTATE},
+  {"metrics", required_argument, NULL, OPT_METRICS},
+  {"scenario", required_argument, NULL, OPT_SCENARIO},
+  {"payload-size", required_argument, NULL, OPT_PAYLOAD_SIZE},
+  {"payload-file", required_argument, NULL, OPT_PAYLOAD_FILE},
+  {"key-order", required_argument, NULL, OPT_KEY_ORDER},
+  {"update", required_argument, NULL, OPT_UPDATE_TMPL},
+  {"delete", required_argument, NULL, OPT_DELETE_TMPL},
+  {"writes", required_argument, NULL, OPT_WRITES},
+  {"key-dist", required_argument, NULL, OPT_KEY_DIST},
+  {"slowest", required_argument, NULL, OPT_SLOWEST},
+  {"trace", required_argument, NULL, OPT_TRACE},
+  {"trace-sample", required_argument, NULL, OPT_TRACE_SAMPLE},
+  {"search", required_argument, NULL, OPT_SEARCH},
+  {"slo", required_argument, NULL, OPT_SLO},
   {"table", required_argument, NULL, OPT_CREATE_QUERY},
   {"insert", required_argument, NULL, OPT_INSERT_TMPL},
   {"rows", required_argument, NULL, OPT_NUM_ROWS},
+  {"txn-size", required_argument, NULL, OPT_TXN_SIZE},
   {"concurrency", required_argument, NULL, OPT_CONCURRENCY},
   {0, 0, 0, 0}
 };
 
+/* Checks that every %refN placeholder of the given template refers
+   to one of the first 'limit' tables, which are populated before it */
+static bool check_table_references(SKY_SHARE *share, const char *tmpl,
+                                   int limit) {
+  const char *pos = tmpl;
+
+  while ((pos = strstr(pos, "%ref")) != NULL) {
+    int parent = atoi(pos + 4) - 1;
+
+    if (parent < 0 || parent >= limit) {
+      report_error("%ref must refer to a table specified earlier");
+      return false;
+    }
+
+    if (!share->tables[parent].insert_tmpl ||
+        !strstr(share->tables[parent].insert_tmpl, "%seq")) {
+      report_error("%ref must refer to a table with a %seq column");
+      return false;
+    }
+    pos++;
+  }
+  return true;
+}
+
 bool check_options(SKY_SHARE *share) {
   assert(share);
   bool rv = true;
+  bool insert_tmpl = has_insert_template(share);
+  bool payloads = false;
 
   if (share->server == NULL) {
     report_error("hostname is missing");
@@ -54,14 +166,14 @@ bool check_options(SKY_SHARE *share) {
   /* skyload does not allow any write operations on the user
      supplied database. this policy is placed to avoid undesired
      updates on the database */
-  if (share->database_name && (share->load_file_path || share->insert_tmpl)) {
+  if (share->database_name && (share->load_file_path || insert_tmpl)) {
     report_error("write operations on existing database is not allowed");
     return false;
   }
 
   /* skyload requires either a INSERT template or load file unless
      the user had specified a existing database (for read-only test) */
-  if (!share->database_name && !share->load_file_path && !share->insert_tmpl) {
+  if (!share->database_name && !share->load_file_path && !insert_tmpl) {
     report_error("No INSERT template or load file");
     return false;
   }
@@ -69,54 +181,519 @@ bool check_options(SKY_SHARE *share) {
   /* skyload does not allow both INSERT template and load-file to
      be provided at the same time. return immediately since this
      is a critical rule */
-  if (share->insert_tmpl && share->load_file_path) {
+  if (insert_tmpl && share->load_file_path) {
     report_error("INSERT template and load file cannot be supplied together");
     return false;
   }
 
   /* TODO: Check if there's a CREATE statement in the load file */
-  if (!share->database_name) {
-    if (!share->create_query && !share->load_file_path) {
+  if (!share->database_name && !share->load_file_path) {
+    if (share->ntables == 0) {
       report_error("table creation statement or load-file is missing");
       return false;
     }
+
+    for (int i = 0; i < share->ntables; i++) {
+      if (!share->tables[i].create_query) {
+        report_error("table creation statement or load-file is missing");
+        return false;
+      }
+    }
   }
 
   /* User had specified skyload to auto-generate data. In this
-     case, skyload only supports one table */
-  if (share->insert_tmpl) {
-    if (string_occurrence(share->create_query, "create table") > 1) {
+     case, each --table option may only create one table */
+  for (int i = 0; i < share->ntables && insert_tmpl; i++) {
+    SKY_TABLE *table = &share->tables[i];
+
+    if (!table->insert_tmpl)
+      continue;
+
+    if (string_occurrence(table->create_query, "create table") > 1) {
       report_error("only one table can be created");
       rv = false;
     }
 
     /* Check INSERT template validity */
-    if (share->columns > SKY_MAX_COLS) {
+    if (table->columns > SKY_MAX_COLS) {
       report_error("too many columns");
       rv = false;
-    } else if (share->columns <= 0) {
+    } else if (table->columns <= 0) {
       report_error("column placeholder is missing from the INSERT template");
       rv = false;
     }
 
-    if (share->nwrite < 1) {
+    if (table->nwrite < 1) {
       report_error("--rows must be set to greater than 0");
       rv = false;
     }
-  } 
+
+    if (!check_table_references(share, table->insert_tmpl, i))
+      rv = false;
+
+    /* room for the largest payloads is made in the generated query */
+    table->payload_size = string_occurrence(table->insert_tmpl,
+                                            PLACEHOLDER_PAYLOAD) *
+                          share->payload_max;
+    payloads = payloads || table->payload_size > 0;
+  }
+
+  /* User had specified UPDATEs and DELETEs of the populated rows */
+  if (has_write_template(share)) {
+    if (share->writes < 1) {
+      report_error("--writes must be set to greater than 0");
+      rv = false;
+    }
+
+    for (int i = 0; i < share->ntables; i++) {
+      SKY_TABLE *table = &share->tables[i];
+
+      if ((table->write_tmpl[SKY_WRITE_UPDATE] ||
+           table->write_tmpl[SKY_WRITE_DELETE]) &&
+          (!table->insert_tmpl || table->nwrite < 1)) {
+        report_error("UPDATE and DELETE templates need the rows of an "
+                     "INSERT template");
+        rv = false;
+      }
+
+      for (int j = 0; j < SKY_NWRITES; j++) {
+        if (table->write_tmpl[j] &&
+            !check_table_references(share, table->write_tmpl[j],
+                                    share->ntables))
+          rv = false;
+      }
+    }
+  } else if (share->writes > 0) {
+    report_error("--writes requires --update or --delete");
+    rv = false;
+  }
+
+  if (share->zipf_theta <= 0 || share->zipf_theta >= 1) {
+    report_error("the zipfian skew must be between 0 and 1");
+    rv = false;
+  }
+
+  /* User had specified the size of the %payload values */
+  if (share->payload_min < 1 || share->payload_min > share->payload_max ||
+      share->payload_max > PAYLOAD_MAX_SIZE) {
+    report_error("invalid --payload-size");
+    rv = false;
+  }
+
+  if (share->payload_path && !payloads) {
+    report_error("--payload-file requires a %payload placeholder");
+    rv = false;
+  }
+
   /* User had specified to provide their own read test */
   if (share->read_file_path) {
     if (share->runs < 1) {
       report_error("--runs must be set to greater than 0");
       rv = false;
     }
+  } else if (share->run_warmup > 0) {
+    report_error("--run-warmup requires --read-file");
+    rv = false;
+  }
+
+  /* User had specified to replay a captured query log */
+  if (share->replay_file_path) {
+    if (share->speed <= 0) {
+      report_error("--speed must be set to greater than 0");
+      rv = false;
+    }
+  }
+
+  /* User had specified a concurrency sweep of the read load */
+  if (share->sweep_levels) {
+    if (!share->read_file_path) {
+      report_error("--sweep requires --read-file");
+      rv = false;
+    }
+
+    if (share->sweep_time < 1) {
+      report_error("--sweep-time must be set to greater than 0");
+      rv = false;
+    }
+  }
+
+  /* User had specified to search for the throughput within --slo */
+  if (share->search != SKY_SEARCH_NONE) {
+    if (!share->read_file_path) {
+      report_error("--search requires --read-file");
+      rv = false;
+    }
+
+    if (share->slo_latency == 0) {
+      report_error("--search requires --slo");
+      rv = false;
+    }
+
+    if (share->sweep_levels) {
+      report_error("--search cannot be used with --sweep");
+      rv = false;
+    }
+
+    if (share->sweep_time < 1) {
+      report_error("--sweep-time must be set to greater than 0");
+      rv = false;
+    }
+  }
+
+  /* User had specified a scenario to run after the population */
+  if (share->scenario_path) {
+    if (share->search != SKY_SEARCH_NONE) {
+      report_error("--scenario cannot be used with --search");
+      rv = false;
+    }
+
+    if (share->sweep_levels) {
+      report_error("--scenario cannot be used with --sweep");
+      rv = false;
+    }
+
+    if (share->soak) {
+      report_error("--scenario cannot be used with --soak");
+      rv = false;
+    }
+  }
+
+  if (share->report_interval < 1) {
+    report_error("--report-interval must be set to greater than 0");
+    rv = false;
+  }
+
+  /* User had specified to run until stopped */
+  if (share->soak) {
+    if (!share->read_file_path && !insert_tmpl) {
+      report_error("--soak requires --read-file or an INSERT template");
+      rv = false;
+    }
+
+    if (share->sweep_levels) {
+      report_error("--soak cannot be used with --sweep");
+      rv = false;
+    }
+
+    if (share->search != SKY_SEARCH_NONE) {
+      report_error("--soak cannot be used with --search");
+      rv = false;
+    }
+
+    if (share->soak_rotate < 1) {
+      report_error("--soak-rotate must be set to greater than 0");
+      rv = false;
+    }
+  } else if (share->soak_path) {
+    report_error("--soak-file requires --soak");
+    rv = false;
+  }
+
+  /* User had specified to compare the results against a baseline */
+  if (share->compare_path) {
+    if (share->tolerance < 0) {
+      report_error("--tolerance must not be negative");
+      rv = false;
+    }
+
+    if (share->noise_z < 0) {
+      report_error("--noise-z must not be negative");
+      rv = false;
+    }
+  }
+
+  /* rows routed by key may land on different primaries, which a
+     single transaction cannot span */
+  if (share->route == SKY_ROUTE_KEY) {
+    if (!insert_tmpl) {
+      report_error("--route=key requires an INSERT template");
+      rv = false;
+    }
+
+    if (share->txn_size > 0) {
+      report_error("--route=key cannot be used with --txn-size");
+      rv = false;
+    }
+  }
+
+  /* think time is drawn from the range of a uniform model */
+  if (share->think_model == SKY_THINK_UNIFORM &&
+      share->think_max < share->think_min) {
+    report_error("--think-time range must not be reversed");
+    rv = false;
+  }
+
+  if (share->slowest > SKY_MAX_SLOWEST) {
+    report_error("--slowest is too large");
+    rv = false;
+  }
+
+  if (share->trace_sample < 1) {
+    report_error("--trace-sample must be set to greater than 0");
+    rv = false;
+  }
+
+  /* a pipelined batch is a single multi-statement packet */
+  if (share->pipeline_depth != 1) {
+    if (share->pipeline_depth < 1) {
+      report_error("--pipeline must be set to greater than 0");
+      rv = false;
+    } else if (share->pipeline_depth > SKY_MAX_PIPELINE) {
+      report_error("--pipeline is too deep");
+      rv = false;
+    }
+
+    if (share->protocol != DRIZZLE_CON_MYSQL) {
+      report_error("--pipeline requires --mysql");
+      rv = false;
+    }
+
+    if (share->txn_size > 0) {
+      report_error("--pipeline cannot be used with --txn-size");
+      rv = false;
+    }
+
+    if (share->route == SKY_ROUTE_KEY) {
+      report_error("--pipeline cannot be used with --route=key");
+      rv = false;
+    }
+
+    if (share->think_model != SKY_THINK_NONE || share->pace > 0) {
+      report_error("--pipeline cannot be used with --think-time or --pace");
+      rv = false;
+    }
   }
 
   return rv;
 }
 
+/* Parses the latency target of the --slo search, given as MS or
+   pPERCENTILE:MS, e.g. 'p99.9:10' */
+static bool parse_slo(SKY_SHARE *share, const char *arg) {
+  const char *colon = strchr(arg, ':');
+  double latency;
+  char *end;
+
+  if (colon != NULL) {
+    double percentile;
+
+    if (*arg == 'p')
+      arg++;
+
+    percentile = strtod(arg, &end);
+
+    if (end != colon || percentile <= 0 || percentile >= 100) {
+      report_error("the --slo percentile must be between 0 and 100");
+      return false;
+    }
+    share->slo_percentile = percentile;
+    arg = colon + 1;
+  }
+
+  latency = strtod(arg, &end);
+
+  if (end == arg || *end != '\0' || latency <= 0) {
+    report_error("--slo must be given as [pPERCENTILE:]MS");
+    return false;
+  }
+
+  share->slo_latency = (uint64_t)(latency * 1000);
+  return true;
+}
+
+/* Parses a comma separated list of concurrency levels */
+static bool parse_sweep_levels(SKY_SHARE *share, const char *list) {
+  const char *pos = list;
+  uint32_t count = 1;
+
+  for (; *pos != '\0'; pos++) {
+    if (*pos == ',')
+      count++;
+  }
+
+  if ((share->sweep_levels = malloc(sizeof(uint32_t) * count)) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+
+  pos = list;
+  for (uint32_t i = 0; i < count; i++) {
+    int level = atoi(pos);
+
+    if (level <= 0) {
+      report_error("concurrency levels must be greater than 0");
+      return false;
+    }
+
+    share->sweep_levels[i] = level;
+    if ((pos = strchr(pos, ',')) != NULL)
+      pos++;
+  }
+
+  share->nsweep = count;
+  return true;
+}
+
+/* Parses a number of bytes with an optional K or M suffix */
+static uint64_t parse_bytes(const char *spec, char **end) {
+  uint64_t bytes = strtoull(spec, end, 10);
+
+  if (**end == 'k' || **end == 'K') {
+    bytes *= 1024;
+    (*end)++;
+  } else if (**end == 'm' || **end == 'M') {
+    bytes *= 1024 * 1024;
+    (*end)++;
+  }
+  return bytes;
+}
+
+/* Parses --payload-size, given as SIZE or MIN-MAX */
+static bool parse_payload_size(SKY_SHARE *share, const char *spec) {
+  char *end;
+
+  share->payload_min = parse_bytes(spec, &end);
+  share->payload_max = share->payload_min;
+
+  if (end != spec && *end == '-')
+    share->payload_max = parse_bytes(end + 1, &end);
+
+  if (end == spec || *end != '\0') {
+    report_error("invalid --payload-size");
+    return false;
+  }
+  return true;
+}
+
+/* Parses --key-dist, given as uniform or zipfian[:THETA] */
+static bool parse_key_dist(SKY_SHARE *share, const char *spec) {
+  char *end;
+
+  if (strcasecmp(spec, "uniform") == 0) {
+    share->key_dist = SKY_DIST_UNIFORM;
+    return true;
+  }
+
+  if (strncasecmp(spec, "zipfian", 7) != 0 ||
+      (spec[7] != '\0' && spec[7] != ':')) {
+    report_error("unknown --key-dist distribution");
+    return false;
+  }
+
+  share->key_dist = SKY_DIST_ZIPFIAN;
+
+  if (spec[7] == ':') {
+    share->zipf_theta = strtod(spec + 8, &end);
+
+    if (end == spec + 8 || *end != '\0') {
+      report_error("invalid zipfian skew");
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Parses the think time model, e.g. 'fixed:500', 'uniform:100-900'
+   or 'exp:500'. The times are given in msecs */
+/* Reads msecs into usecs. strtoull() would take a sign and wrap a
+   negative number around, so only digits may start it */
+static bool parse_msecs(const char *text, char **end, uint64_t *usecs) {
+  unsigned long long msecs;
+
+  *end = (char *)text;
+
+  if (!isdigit((unsigned char)*text))
+    return false;
+
+  errno = 0;
+  msecs = strtoull(text, end, 10);
+
+  if (errno == ERANGE || msecs > UINT64_MAX / 1000)
+    return false;
+
+  *usecs = msecs * 1000;
+  return true;
+}
+
+static bool parse_think_time(SKY_SHARE *share, const char *spec) {
+  const char *times = strchr(spec, ':');
+  bool valid;
+  char *end;
+
+  if (times == NULL) {
+    report_error("--think-time must be given as model:msecs");
+    return false;
+  }
+
+  valid = parse_msecs(times + 1, &end, &share->think_min);
+  share->think_max = share->think_min;
+
+  if (strncasecmp(spec, "fixed:", 6) == 0) {
+    share->think_model = SKY_THINK_FIXED;
+  } else if (strncasecmp(spec, "exp:", 4) == 0) {
+    share->think_model = SKY_THINK_EXPONENTIAL;
+  } else if (strncasecmp(spec, "uniform:", 8) == 0) {
+    share->think_model = SKY_THINK_UNIFORM;
+    if (valid && *end == '-')
+      valid = parse_msecs(end + 1, &end, &share->think_max);
+  } else {
+    report_error("unknown think time model");
+    return false;
+  }
+
+  if (!valid || *end != '\0') {
+    report_error("invalid think time");
+    return false;
+  }
+  return true;
+}
+
+/* Returns the table that a --table, --insert or --rows option applies
+   to. The options fill the most recent table and a new table is
+   started once the given option has already been set for it */
+static SKY_TABLE *option_table(SKY_SHARE *share, int option) {
+  SKY_TABLE *table;
+  bool taken;
+
+  if (share->ntables == 0)
+    share->ntables = 1;
+
+  table = &share->tables[share->ntables - 1];
+
+  switch (option) {
+  case OPT_CREATE_QUERY:
+    taken = (table->create_query != NULL);
+    break;
+  case OPT_INSERT_TMPL:
+    taken = (table->insert_tmpl != NULL);
+    break;
+  case OPT_UPDATE_TMPL:
+    taken = (table->write_tmpl[SKY_WRITE_UPDATE] != NULL);
+    break;
+  case OPT_DELETE_TMPL:
+    taken = (table->write_tmpl[SKY_WRITE_DELETE] != NULL);
+    break;
+  default:
+    taken = (table->nwrite > 0);
+    break;
+  }
+
+  if (!taken)
+    return table;
+
+  if (share->ntables == SKY_MAX_TABLES) {
+    report_error("too many tables");
+    return NULL;
+  }
+  return &share->tables[share->ntables++];
+}
+
 bool handle_options(SKY_SHARE *share, int argc, char **argv) {
   assert(share);
+  SKY_TABLE *table;
+  sky_write kind;
+  bool interval_given = false;
+  long long count;
   int ch, temp;
 
   while ((ch = getopt_long(argc, argv, "hs:p:", longopts, NULL)) != -1) {
@@ -130,20 +707,59 @@ bool handle_options(SKY_SHARE *share, int argc, char **argv) {
         return false;
       }
       break;
+    case OPT_REPLICA:
+      if ((share->replica_list = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_ROUTE:
+      if (strcmp(optarg, "key") == 0) {
+        share->route = SKY_ROUTE_KEY;
+      } else if (strcmp(optarg, "worker") == 0) {
+        share->route = SKY_ROUTE_WORKER;
+      } else {
+        report_error("unknown routing policy");
+        return false;
+      }
+      break;
     case OPT_CREATE_QUERY:
-      if ((share->create_query = strdup(optarg)) == NULL) {
+      if ((table = option_table(share, ch)) == NULL)
+        return false;
+      if ((table->create_query = strdup(optarg)) == NULL) {
         report_error("out of memory");
         return false;
       }
-      sky_tolower(share->create_query);
+      sky_tolower(table->create_query);
       break;
     case OPT_INSERT_TMPL:
-      if ((share->insert_tmpl = strdup(optarg)) == NULL) {
+      if ((table = option_table(share, ch)) == NULL)
+        return false;
+      if ((table->insert_tmpl = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      sky_tolower(table->insert_tmpl);
+      table->columns = string_occurrence(table->insert_tmpl, "%");
+      break;
+    case OPT_UPDATE_TMPL:
+    case OPT_DELETE_TMPL:
+      if ((table = option_table(share, ch)) == NULL)
+        return false;
+      kind = (ch == OPT_UPDATE_TMPL) ? SKY_WRITE_UPDATE : SKY_WRITE_DELETE;
+      if ((table->write_tmpl[kind] = strdup(optarg)) == NULL) {
         report_error("out of memory");
         return false;
       }
-      sky_tolower(share->insert_tmpl);
-      share->columns = string_occurrence(share->insert_tmpl, "%");
+      sky_tolower(table->write_tmpl[kind]);
+      break;
+    case OPT_WRITES:
+      count = atoll(optarg);
+      share->writes = (count <= 0) ? 0 : count;
+      break;
+    case OPT_KEY_DIST:
+      if (!parse_key_dist(share, optarg))
+        return false;
       break;
     case OPT_LOAD_FILE:
       if ((share->load_file_path = strdup(optarg)) == NULL) {
@@ -157,6 +773,185 @@ bool handle_options(SKY_SHARE *share, int argc, char **argv) {
         return false;
       }
       break;
+    case OPT_REPLAY_FILE:
+      if ((share->replay_file_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_SPEED:
+      share->speed = atof(optarg);
+      break;
+    case OPT_SWEEP:
+      if (!parse_sweep_levels(share, optarg))
+        return false;
+      break;
+    case OPT_SEARCH:
+      if (strcmp(optarg, "rate") == 0) {
+        share->search = SKY_SEARCH_RATE;
+      } else if (strcmp(optarg, "concurrency") == 0) {
+        share->search = SKY_SEARCH_CONCURRENCY;
+      } else {
+        report_error("--search must be 'rate' or 'concurrency'");
+        return false;
+      }
+      break;
+    case OPT_SLO:
+      if (!parse_slo(share, optarg))
+        return false;
+      break;
+    case OPT_SWEEP_TIME:
+      temp = atoi(optarg);
+      share->sweep_time = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_WARMUP:
+      temp = atoi(optarg);
+      share->warmup_time = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_MAX_RETRIES:
+      temp = atoi(optarg);
+      share->max_retries = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_RETRY_BACKOFF:
+      temp = atoi(optarg);
+      share->retry_backoff = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_REPORT_INTERVAL:
+      temp = atoi(optarg);
+      share->report_interval = (temp <= 0) ? 0 : temp;
+      interval_given = true;
+      break;
+    case OPT_JSON:
+      if ((share->json_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_TRACE:
+      if ((share->trace_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_TRACE_SAMPLE:
+      temp = atoi(optarg);
+      share->trace_sample = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_COMPARE:
+      if ((share->compare_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_TOLERANCE:
+      share->tolerance = atof(optarg);
+      break;
+    case OPT_NOISE_FLOOR:
+      temp = atoi(optarg);
+      share->noise_floor = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_NOISE_Z:
+      share->noise_z = atof(optarg);
+      break;
+    case OPT_STATUS:
+      share->status = true;
+      break;
+    case OPT_STATUS_VARS:
+      if ((share->status_vars = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      share->status = true;
+      break;
+    case OPT_ENGINE_STATUS:
+      share->engine_status = true;
+      share->status = true;
+      break;
+    case OPT_PIPELINE:
+      temp = atoi(optarg);
+      share->pipeline_depth = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_THINK_TIME:
+      if (!parse_think_time(share, optarg))
+        return false;
+      break;
+    case OPT_PACE:
+      temp = atoi(optarg);
+      share->pace = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_READ_ORDER:
+      if (strcasecmp(optarg, "sequential") == 0) {
+        share->read_order = SKY_ORDER_SEQUENTIAL;
+      } else if (strcasecmp(optarg, "offset") == 0) {
+        share->read_order = SKY_ORDER_OFFSET;
+      } else if (strcasecmp(optarg, "random") == 0) {
+        share->read_order = SKY_ORDER_RANDOM;
+      } else if (strcasecmp(optarg, "weighted") == 0) {
+        share->read_order = SKY_ORDER_WEIGHTED;
+      } else if (strcasecmp(optarg, "shuffle") == 0) {
+        share->read_order = SKY_ORDER_SHUFFLE;
+      } else {
+        report_error("unknown --read-order policy");
+        return false;
+      }
+      break;
+    case OPT_SLOWEST:
+      temp = atoi(optarg);
+      share->slowest = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_RUN_WARMUP:
+      temp = atoi(optarg);
+      share->run_warmup = (temp <= 0) ? 0 : temp;
+      break;
+    case OPT_SOAK:
+      share->soak = true;
+      break;
+    case OPT_SOAK_FILE:
+      if ((share->soak_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_SOAK_ROTATE:
+      temp = atoi(optarg);
+      share->soak_rotate = (temp <= 0) ? 0 : (uint64_t)temp * 1024 * 1024;
+      break;
+    case OPT_SCENARIO:
+      if ((share->scenario_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_KEY_ORDER:
+      if (strcasecmp(optarg, "interleaved") == 0) {
+        share->key_order = SKY_KEYS_INTERLEAVED;
+      } else if (strcasecmp(optarg, "partitioned") == 0) {
+        share->key_order = SKY_KEYS_PARTITIONED;
+      } else if (strcasecmp(optarg, "descending") == 0) {
+        share->key_order = SKY_KEYS_DESCENDING;
+      } else if (strcasecmp(optarg, "random") == 0) {
+        share->key_order = SKY_KEYS_RANDOM;
+      } else {
+        report_error("unknown --key-order layout");
+        return false;
+      }
+      break;
+    case OPT_PAYLOAD_SIZE:
+      if (!parse_payload_size(share, optarg))
+        return false;
+      break;
+    case OPT_PAYLOAD_FILE:
+      if ((share->payload_path = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
+    case OPT_METRICS:
+      if ((share->metrics_addr = strdup(optarg)) == NULL) {
+        report_error("out of memory");
+        return false;
+      }
+      break;
     case OPT_USE_DB:
       if ((share->database_name = strdup(optarg)) == NULL) {
         report_error("out of memory");
@@ -164,13 +959,21 @@ bool handle_options(SKY_SHARE *share, int argc, char **argv) {
       }
       break;
     case OPT_NUM_RUNS:
-      share->runs = (uint32_t)atoi(optarg);
+      count = atoll(optarg);
+      share->runs = (count <= 0) ? 0 : count;
       break;
     case OPT_PORT:
       share->port = (in_port_t)atoi(optarg);
       break;
     case OPT_NUM_ROWS:
-      share->nwrite = (uint32_t)atoi(optarg);
+      if ((table = option_table(share, ch)) == NULL)
+        return false;
+      count = atoll(optarg);
+      table->nwrite = (count <= 0) ? 0 : count;
+      break;
+    case OPT_TXN_SIZE:
+      temp = atoi(optarg);
+      share->txn_size = (temp <= 0) ? 0 : temp;
       break;
     case OPT_CONCURRENCY:
       temp = atoi(optarg);
@@ -187,5 +990,10 @@ bool handle_options(SKY_SHARE *share, int argc, char **argv) {
       break;
     }
   }
+
+  /* a soak test samples once a minute unless told otherwise */
+  if (share->soak && !interval_given)
+    share->report_interval = SKY_SOAK_INTERVAL;
+
   return true;
 }
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "payload.h"
+
+bool payload_is_literal(const char *data, size_t size) {
+  assert(data);
+
+  for (size_t i = 0; i < size; i++) {
+    if (data[i] == '"' || data[i] == '\\' || data[i] == '\0')
+      return false;
+  }
+  return true;
+}
+
+void fill_payload(char *buffer, size_t size) {
+  assert(buffer);
+
+  size_t symbols = sizeof(PAYLOAD_ALPHABET) - 1;
+
+  for (size_t i = 0; i < size; i++)
+    buffer[i] = PAYLOAD_ALPHABET[random() % symbols];
+}
+
+/* Maps the payload file. Its pages are shared with the page cache, so
+   the payloads cost no memory of their own however large the file */
+static bool map_payload_file(SKY_PAYLOAD *payload, const char *path) {
+  struct stat st;
+  void *data;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) == -1) {
+    fprintf(stderr, "failed to open (%s)\n", path);
+    return false;
+  }
+
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    report_error("the payload file is empty");
+    close(fd);
+    return false;
+  }
+
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "failed to map (%s)\n", path);
+    return false;
+  }
+
+  payload->data = data;
+  payload->size = st.st_size;
+  payload->mapped = true;
+
+  /* the slices are taken from anywhere in the file */
+  madvise(payload->data, payload->size, MADV_RANDOM);
+  return true;
+}
+
+SKY_PAYLOAD *sky_payload_new(SKY_SHARE *share) {
+  assert(share);
+
+  SKY_PAYLOAD *payload;
+
+  if ((payload = calloc(1, sizeof(SKY_PAYLOAD))) == NULL) {
+    report_error("out of memory");
+    return NULL;
+  }
+
+  if (share->payload_path) {
+    if (!map_payload_file(payload, share->payload_path)) {
+      free(payload);
+      return NULL;
+    }
+
+    /* the file is checked once rather than escaping every payload */
+    if (!payload_is_literal(payload->data, payload->size)) {
+      report_error("the payload file contains quotes, backslashes "
+                   "or null bytes");
+      sky_payload_free(payload);
+      return NULL;
+    }
+
+    if (payload->size < share->payload_max) {
+      report_error("the payload file is smaller than --payload-size");
+      sky_payload_free(payload);
+      return NULL;
+    }
+    return payload;
+  }
+
+  /* twice the largest payload leaves room for slices to differ */
+  payload->size = PAYLOAD_POOL_SIZE;
+  if (payload->size < share->payload_max * 2)
+    payload->size = share->payload_max * 2;
+
+  if ((payload->data = malloc(payload->size)) == NULL) {
+    report_error("out of memory");
+    free(payload);
+    return NULL;
+  }
+
+  fill_payload(payload->data, payload->size);
+  return payload;
+}
+
+void sky_payload_free(SKY_PAYLOAD *payload) {
+  if (payload == NULL)
+    return;
+
+  if (payload->mapped)
+    munmap(payload->data, payload->size);
+  else
+    free(payload->data);
+
+  free(payload);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_PAYLOAD_H__
+#define __SKYLOAD_PAYLOAD_H__
+
+#include "skyload.h"
+
+#define PAYLOAD_POOL_SIZE (4 * 1024 * 1024) /* bytes generated, at least */
+#define PAYLOAD_MAX_SIZE  (64 * 1024 * 1024) /* largest --payload-size */
+
+#define PAYLOAD_ALPHABET \
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+
+/* The bytes that the %payload values of the generated rows are cut
+   out of. It's either a file mapped into memory or a pool generated
+   at startup, and it's shared read-only by every worker. A payload is
+   sent straight from here rather than being copied into the query. */
+typedef struct _sky_payload {
+  char *data;
+  size_t size;
+  bool mapped;            /* whether 'data' has to be unmapped */
+} SKY_PAYLOAD;
+
+/* allocator and deallocator of the payload source. the allocator maps
+   share->payload_path if it's given and generates a pool otherwise */
+SKY_PAYLOAD *sky_payload_new(SKY_SHARE *share);
+void sky_payload_free(SKY_PAYLOAD *payload);
+
+/* returns true if the bytes can be put between double quotes in a
+   statement as they are, that is, without a quote, a backslash or a
+   null byte that would need to be escaped */
+bool payload_is_literal(const char *data, size_t size);
+
+/* fills the buffer with random characters of PAYLOAD_ALPHABET */
+void fill_payload(char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <ctype.h>
+#include "pipeline.h"
+#include "slowest.h"
+#include "trace.h"
+
+SKY_PIPELINE *sky_pipeline_new(uint32_t depth) {
+  SKY_PIPELINE *pipeline;
+
+  if (depth == 0)
+    return NULL;
+
+  if ((pipeline = calloc(1, sizeof(*pipeline))) == NULL)
+    return NULL;
+
+  pipeline->entries = calloc(depth, sizeof(SKY_PIPELINE_ENTRY));
+  pipeline->buffer = malloc(PIPELINE_INITIAL_SIZE);
+
+  if (pipeline->entries == NULL || pipeline->buffer == NULL) {
+    sky_pipeline_free(pipeline);
+    return NULL;
+  }
+
+  pipeline->capacity = PIPELINE_INITIAL_SIZE;
+  pipeline->depth = depth;
+  return pipeline;
+}
+
+void sky_pipeline_free(SKY_PIPELINE *pipeline) {
+  if (pipeline == NULL)
+    return;
+
+  free(pipeline->entries);
+  free(pipeline->buffer);
+  free(pipeline);
+}
+
+bool pipeline_add(SKY_PIPELINE *pipeline, const char *query, size_t length,
+                  const void *tag) {
+  assert(pipeline && query);
+
+  SKY_PIPELINE_ENTRY *entry;
+  size_t needed;
+
+  if (pipeline->count == pipeline->depth)
+    return false;
+
+  /* an empty statement between two separators is an error */
+  while (length > 0 && (query[length - 1] == ';' ||
+                        isspace((unsigned char)query[length - 1])))
+    length--;
+
+  /* room for the separator and the terminating null */
+  needed = pipeline->length + length + 2;
+
+  if (needed > pipeline->capacity) {
+    size_t capacity = pipeline->capacity;
+    char *buffer;
+
+    while (capacity < needed)
+      capacity *= 2;
+
+    if ((buffer = realloc(pipeline->buffer, capacity)) == NULL)
+      return false;
+
+    pipeline->buffer = buffer;
+    pipeline->capacity = capacity;
+  }
+
+  if (pipeline->count > 0)
+    pipeline->buffer[pipeline->length++] = ';';
+
+  entry = &pipeline->entries[pipeline->count++];
+  entry->offset = pipeline->length;
+  entry->tag = tag;
+  entry->latency = 0;
+  entry->done = false;
+
+  memcpy(pipeline->buffer + pipeline->length, query, length);
+  pipeline->length += length;
+  pipeline->buffer[pipeline->length] = '\0';
+  return true;
+}
+
+bool pipeline_full(const SKY_PIPELINE *pipeline) {
+  return (pipeline->count == pipeline->depth);
+}
+
+size_t pipeline_statement_length(const SKY_PIPELINE *pipeline,
+                                 uint32_t index) {
+  assert(pipeline && index < pipeline->count);
+
+  /* a statement ends at the separator of the next one */
+  size_t end = (index + 1 < pipeline->count) ?
+               pipeline->entries[index + 1].offset - 1 : pipeline->length;
+
+  return end - pipeline->entries[index].offset;
+}
+
+void pipeline_reset(SKY_PIPELINE *pipeline) {
+  pipeline->length = 0;
+  pipeline->count = 0;
+  pipeline->completed = 0;
+}
+
+/* Records the result of the next statement in the batch */
+static void pipeline_done(SKY_WORKER *worker, drizzle_con_st *conn,
+                          uint16_t target, SKY_PIPELINE *pipeline,
+                          uint32_t index, uint64_t start_time,
+                          uint64_t latency) {
+  SKY_PIPELINE_ENTRY *entry = &pipeline->entries[index];
+  struct iovec text = {pipeline->buffer + entry->offset,
+                       pipeline_statement_length(pipeline, index)};
+
+  entry->latency = latency;
+  entry->done = true;
+  worker->in_flight--;
+  worker->target_queries[target]++;
+  worker->target_time[target] += latency;
+  record_interval(worker, 1, 0, 0);
+  record_latency(worker, latency);
+  record_slow_query(worker, conn, &text, 1, latency);
+  record_span(worker, start_time, latency, false);
+}
+
+sky_error_class pipeline_flush(SKY_WORKER *worker, drizzle_con_st *conn,
+                               uint16_t target, SKY_PIPELINE *pipeline,
+                               int options, uint64_t *elapsed) {
+  assert(worker && conn && pipeline);
+
+  SKY_SHARE *share = worker->share;
+  sky_error_class error = SKY_ERROR_NONE;
+  uint32_t next = 0;    /* first statement without an outcome */
+  uint32_t attempt = 0; /* attempts of the statement at 'next' */
+
+  while (next < pipeline->count) {
+    size_t offset = pipeline->entries[next].offset;
+    uint64_t start_time = current_usec();
+    drizzle_result_st result;
+    drizzle_return_t ret;
+    uint16_t code;
+
+    /* the statements are sent at once and their results are read
+       back in the order they were queued */
+    worker->in_flight = pipeline->count - next;
+    drizzle_query(conn, &result, pipeline->buffer + offset,
+                  pipeline->length - offset, &ret);
+
+    for (;;) {
+      bool has_result = (ret == DRIZZLE_RETURN_OK ||
+                         ret == DRIZZLE_RETURN_ERROR_CODE);
+
+      /* the next result can't be read before this one is consumed */
+      if (ret == DRIZZLE_RETURN_OK)
+        ret = read_result(worker, &result);
+
+      code = (ret == DRIZZLE_RETURN_ERROR_CODE) ? drizzle_con_error_code(conn) : 0;
+
+      if (has_result)
+        drizzle_result_free(&result);
+
+      if (ret != DRIZZLE_RETURN_OK)
+        break;
+
+      uint64_t end_time = current_usec();
+
+      pipeline_done(worker, conn, target, pipeline, next++, start_time,
+                    end_time - start_time);
+      pipeline->completed++;
+      attempt = 0;
+
+      if (next == pipeline->count) {
+        if (elapsed)
+          *elapsed += end_time - start_time;
+        return error;
+      }
+
+      if (!(drizzle_con_status(conn) & DRIZZLE_CON_STATUS_MORE_RESULTS_EXISTS)) {
+        fprintf(stderr, "thread[%d] error: the server did not run every "
+                "pipelined statement\n", worker->unique_id);
+        worker->in_flight = 0;
+        worker->failed_queries += pipeline->count - next;
+        record_interval(worker, 0, pipeline->count - next, 0);
+        return SKY_ERROR_FATAL;
+      }
+
+      drizzle_result_read(conn, &result, &ret);
+    }
+
+    if (elapsed)
+      *elapsed += current_usec() - start_time;
+
+    worker->in_flight = 0;
+    error = classify_error(ret, code);
+
+    if (error == SKY_ERROR_FATAL) {
+      fprintf(stderr, "thread[%d] error: %s\n",
+              worker->unique_id, drizzle_con_error(conn));
+      worker->failed_queries++;
+      record_interval(worker, 0, 1, 0);
+      return error;
+    }
+
+    /* the rest of the batch is sent again on a working connection */
+    if (error == SKY_ERROR_CONNECTION)
+      reconnect(worker, conn);
+
+    if ((options & SKY_EXEC_RETRY) && attempt < share->max_retries) {
+      worker->retries++;
+      record_interval(worker, 0, 0, 1);
+      sleep_usec(retry_backoff(share->retry_backoff, attempt++));
+      continue;
+    }
+
+    /* give up on the failed statement and go on with the next */
+    worker->failed_queries++;
+    record_interval(worker, 0, 1, 0);
+    next++;
+    attempt = 0;
+  }
+  return error;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_PIPELINE_H__
+#define __SKYLOAD_PIPELINE_H__
+
+#include "retry.h"
+
+#define PIPELINE_INITIAL_SIZE 4096 /* bytes of the initial packet buffer */
+
+/* A statement queued in the pipeline */
+typedef struct {
+  size_t offset;      /* where the statement starts in the buffer */
+  const void *tag;    /* caller's reference to the statement */
+  uint64_t latency;   /* usec between sending and receiving its result */
+  bool done;          /* whether the server ran it successfully */
+} SKY_PIPELINE_ENTRY;
+
+/* Statements sent to the server in a single multi-statement packet.
+   The server runs them in order and sends their results back one
+   after another, so that a batch costs a single round trip. Each
+   result is matched back to the time the batch was sent. */
+typedef struct _sky_pipeline {
+  char *buffer;       /* the statements separated by ';' */
+  size_t length;
+  size_t capacity;
+  uint32_t depth;     /* statements per batch */
+  uint32_t count;     /* statements queued */
+  uint32_t completed; /* statements the server ran successfully */
+  SKY_PIPELINE_ENTRY *entries;
+} SKY_PIPELINE;
+
+/* allocator and deallocator of a pipeline of the given depth */
+SKY_PIPELINE *sky_pipeline_new(uint32_t depth);
+void sky_pipeline_free(SKY_PIPELINE *pipeline);
+
+/* queues a statement. the trailing ';' and whitespace of the
+   statement are dropped. returns false if out of memory */
+bool pipeline_add(SKY_PIPELINE *pipeline, const char *query, size_t length,
+                  const void *tag);
+
+/* whether the pipeline holds a full batch */
+bool pipeline_full(const SKY_PIPELINE *pipeline);
+
+/* returns the length of the given queued statement */
+size_t pipeline_statement_length(const SKY_PIPELINE *pipeline,
+                                 uint32_t index);
+
+/* empties the pipeline for the next batch */
+void pipeline_reset(SKY_PIPELINE *pipeline);
+
+/* sends the queued statements in a single packet and reads their
+   results in order. result sets are always read in full. a statement
+   that fails stops the server from running the rest of the batch,
+   so the remaining statements are sent again, after retrying the
+   failed one with SKY_EXEC_RETRY. the time between sending and
+   receiving the last result of every round trip is added to
+   'elapsed' if it's given. returns the class of the last error */
+sky_error_class pipeline_flush(SKY_WORKER *worker, drizzle_con_st *conn,
+                               uint16_t target, SKY_PIPELINE *pipeline,
+                               int options, uint64_t *elapsed);
+
+#endif
@@ -0,0 +1,614 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "replay.h"
+#include "generator.h"
+#include "retry.h"
+#include "slowest.h"
+#include "trace.h"
+
+#define REPLAY_MAX_COMMAND 32
+
+SKY_REPLAY *sky_replay_new(void) {
+  SKY_REPLAY *replay = malloc(sizeof(*replay));
+
+  if (replay == NULL)
+    return NULL;
+
+  replay->entries = NULL;
+  replay->session_list = NULL;
+  replay->size = 0;
+  replay->capacity = 0;
+  replay->sessions = 0;
+  replay->duration = 0;
+  replay->start_time = 0;
+  return replay;
+}
+
+void sky_replay_free(SKY_REPLAY *replay) {
+  if (replay == NULL) return;
+
+  for (size_t i = 0; i < replay->size; i++)
+    free(replay->entries[i].query);
+
+  free(replay->entries);
+  free(replay->session_list);
+  free(replay);
+}
+
+static bool is_digit(char c) {
+  return (c >= '0' && c <= '9');
+}
+
+/* Parses the timestamp that prefixes a general log record. Two
+   formats are understood, the classic 'YYMMDD HH:MM:SS' format and
+   the ISO 8601 format used since MySQL 5.7 which also carries the
+   fractional part. On success, the timestamp is stored in 'usec'
+   and 'end' points to the first character after the timestamp. */
+static bool parse_log_timestamp(const char *line, uint64_t *usec,
+                                const char **end) {
+  struct tm tm;
+  int year, mon, day, hour, min, sec, n = 0;
+  uint64_t frac = 0;
+
+  memset(&tm, 0, sizeof(tm));
+
+  if (sscanf(line, "%4d-%2d-%2dT%2d:%2d:%2d%n",
+             &year, &mon, &day, &hour, &min, &sec, &n) == 6 && n > 0) {
+    const char *pos = line + n;
+
+    if (*pos == '.') {
+      int digits = 0;
+      for (pos++; is_digit(*pos); pos++) {
+        if (digits++ < 6)
+          frac = frac * 10 + (*pos - '0');
+      }
+      for (; digits < 6; digits++)
+        frac *= 10;
+    }
+
+    /* skip the timezone designator, e.g. 'Z' or '+09:00' */
+    while (*pos != '\0' && *pos != ' ' && *pos != '\t')
+      pos++;
+
+    *end = pos;
+  } else {
+    for (int i = 0; i < 6; i++) {
+      if (!is_digit(line[i]))
+        return false;
+    }
+
+    if (sscanf(line, "%2d%2d%2d %d:%2d:%2d%n",
+               &year, &mon, &day, &hour, &min, &sec, &n) != 6 || n == 0)
+      return false;
+
+    year += 2000;
+    *end = line + n;
+  }
+
+  tm.tm_year = year - 1900;
+  tm.tm_mon = mon - 1;
+  tm.tm_mday = day;
+  tm.tm_hour = hour;
+  tm.tm_min = min;
+  tm.tm_sec = sec;
+
+  *usec = (uint64_t)timegm(&tm) * 1000000 + frac;
+  return true;
+}
+
+bool parse_general_log_line(const char *line, uint64_t *last_time,
+                            uint32_t *session_id, char *command,
+                            size_t command_len, const char **argument) {
+  assert(line && last_time && session_id && command && argument);
+
+  const char *pos = line;
+  uint64_t timestamp;
+  size_t length = 0;
+
+  if (parse_log_timestamp(line, &timestamp, &pos)) {
+    *last_time = timestamp;
+  } else if (*line != ' ' && *line != '\t') {
+    /* records without a timestamp are always indented. anything
+       else is a continuation of a multi-line statement */
+    return false;
+  }
+
+  while (*pos == ' ' || *pos == '\t')
+    pos++;
+
+  if (!is_digit(*pos))
+    return false;
+
+  *session_id = (uint32_t)strtoul(pos, (char **)&pos, 10);
+
+  if (*pos != ' ')
+    return false;
+
+  while (*pos == ' ')
+    pos++;
+
+  /* the command is one or two words (e.g. 'Query', 'Init DB')
+     followed by a tab and the argument */
+  while (pos[length] != '\t') {
+    char c = pos[length];
+
+    if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == ' '))
+      return false;
+
+    if (++length >= command_len || length >= REPLAY_MAX_COMMAND)
+      return false;
+  }
+
+  if (length == 0)
+    return false;
+
+  memcpy(command, pos, length);
+  command[length] = '\0';
+  *argument = pos + length + 1;
+  return true;
+}
+
+/* The server prints a banner each time the log is (re)opened */
+static bool is_log_banner(const char *line) {
+  return (strstr(line, ", Version: ") != NULL ||
+          strncmp(line, "Tcp port:", 9) == 0 ||
+          strncmp(line, "Time ", 5) == 0);
+}
+
+static SKY_REPLAY_ENTRY *replay_push(SKY_REPLAY *replay, uint64_t timestamp,
+                                     uint32_t session_id, const char *prefix,
+                                     const char *query) {
+  SKY_REPLAY_ENTRY *entry;
+  size_t prefix_len = strlen(prefix);
+  size_t query_len = strlen(query);
+
+  if (replay->size == replay->capacity) {
+    size_t capacity = (replay->capacity) ? replay->capacity * 2 :
+                      REPLAY_INITIAL_CAPACITY;
+    SKY_REPLAY_ENTRY *temp = realloc(replay->entries,
+                                     sizeof(*temp) * capacity);
+    if (temp == NULL)
+      return NULL;
+
+    replay->entries = temp;
+    replay->capacity = capacity;
+  }
+
+  entry = &replay->entries[replay->size];
+  entry->offset = timestamp;
+  entry->session_id = session_id;
+  entry->next = REPLAY_END_OF_SESSION;
+  entry->length = prefix_len + query_len;
+
+  if ((entry->query = malloc(entry->length + 1)) == NULL)
+    return NULL;
+
+  memcpy(entry->query, prefix, prefix_len);
+  memcpy(entry->query + prefix_len, query, query_len + 1);
+  replay->size++;
+  return entry;
+}
+
+static bool replay_append(SKY_REPLAY_ENTRY *entry, const char *line) {
+  size_t line_len = strlen(line);
+  char *temp = realloc(entry->query, entry->length + line_len + 2);
+
+  if (temp == NULL)
+    return false;
+
+  temp[entry->length] = '\n';
+  memcpy(temp + entry->length + 1, line, line_len + 1);
+  entry->query = temp;
+  entry->length += line_len + 1;
+  return true;
+}
+
+static SKY_REPLAY_ENTRY *sort_base;
+
+/* orders entry indexes by session id, then by position in the log */
+static int compare_entry_session(const void *a, const void *b) {
+  size_t x = *(const size_t *)a;
+  size_t y = *(const size_t *)b;
+  uint32_t sx = sort_base[x].session_id;
+  uint32_t sy = sort_base[y].session_id;
+
+  if (sx != sy)
+    return (sx > sy) - (sx < sy);
+  return (x > y) - (x < y);
+}
+
+static int compare_session_first(const void *a, const void *b) {
+  size_t x = ((const SKY_REPLAY_SESSION *)a)->first;
+  size_t y = ((const SKY_REPLAY_SESSION *)b)->first;
+  return (x > y) - (x < y);
+}
+
+/* Chain the entries of each session together and build the list
+   of sessions ordered by their first appearance in the log */
+static bool build_sessions(SKY_REPLAY *replay) {
+  size_t *order;
+  uint32_t count = 0;
+
+  if (replay->size == 0)
+    return true;
+
+  if ((order = malloc(sizeof(*order) * replay->size)) == NULL)
+    return false;
+
+  for (size_t i = 0; i < replay->size; i++)
+    order[i] = i;
+
+  sort_base = replay->entries;
+  qsort(order, replay->size, sizeof(*order), compare_entry_session);
+
+  for (size_t i = 0; i < replay->size; i++) {
+    if (i == 0 || replay->entries[order[i]].session_id !=
+                  replay->entries[order[i-1]].session_id)
+      count++;
+  }
+
+  replay->session_list = malloc(sizeof(SKY_REPLAY_SESSION) * count);
+
+  if (replay->session_list == NULL) {
+    free(order);
+    return false;
+  }
+
+  SKY_REPLAY_SESSION *session = NULL;
+
+  for (size_t i = 0; i < replay->size; i++) {
+    SKY_REPLAY_ENTRY *entry = &replay->entries[order[i]];
+
+    if (session == NULL || entry->session_id != session->session_id) {
+      session = (session) ? session + 1 : replay->session_list;
+      session->session_id = entry->session_id;
+      session->first = order[i];
+      session->count = 0;
+    } else {
+      replay->entries[order[i-1]].next = order[i];
+    }
+    session->count++;
+  }
+
+  qsort(replay->session_list, count, sizeof(SKY_REPLAY_SESSION),
+        compare_session_first);
+
+  replay->sessions = count;
+  free(order);
+  return true;
+}
+
+SKY_REPLAY *load_general_log(const char *path) {
+  assert(path);
+
+  SKY_REPLAY *replay;
+  SKY_REPLAY_ENTRY *current = NULL;
+  FILE *log_file;
+  char *line = NULL;
+  size_t line_cap = 0;
+  ssize_t line_len;
+  uint64_t last_time = 0;
+  bool rv = true;
+
+  if (!(log_file = fopen(path, "r"))) {
+    report_error("failed to open the specified query log");
+    return NULL;
+  }
+
+  if ((replay = sky_replay_new()) == NULL) {
+    fclose(log_file);
+    return NULL;
+  }
+
+  while ((line_len = getline(&line, &line_cap, log_file)) != -1 &&
+         replay->size != MAX_LOADABLE_QUERIES) {
+    char command[REPLAY_MAX_COMMAND];
+    const char *argument;
+    uint32_t session_id;
+
+    while (line_len > 0 && (line[line_len-1] == '\n' ||
+                            line[line_len-1] == '\r'))
+      line[--line_len] = '\0';
+
+    if (is_log_banner(line)) {
+      current = NULL;
+      continue;
+    }
+
+    if (!parse_general_log_line(line, &last_time, &session_id, command,
+                                sizeof(command), &argument)) {
+      /* continuation of a multi-line statement */
+      if (current && !(rv = replay_append(current, line)))
+        break;
+      continue;
+    }
+
+    current = NULL;
+
+    if (*argument == '\0')
+      continue;
+
+    if (strcmp(command, "Query") == 0 || strcmp(command, "Execute") == 0) {
+      current = replay_push(replay, last_time, session_id, "", argument);
+    } else if (strcmp(command, "Init DB") == 0) {
+      current = replay_push(replay, last_time, session_id, "USE ", argument);
+    } else {
+      continue;
+    }
+
+    if (current == NULL) {
+      rv = false;
+      break;
+    }
+  }
+
+  free(line);
+  fclose(log_file);
+
+  if (!rv) {
+    report_error("out of memory");
+    sky_replay_free(replay);
+    return NULL;
+  }
+
+  /* convert the absolute timestamps to offsets from the first entry */
+  if (replay->size > 0) {
+    uint64_t first = replay->entries[0].offset;
+
+    for (size_t i = 0; i < replay->size; i++) {
+      SKY_REPLAY_ENTRY *entry = &replay->entries[i];
+      entry->offset = (entry->offset > first) ? entry->offset - first : 0;
+    }
+    replay->duration = replay->entries[replay->size-1].offset;
+  }
+
+  if (!build_sessions(replay)) {
+    report_error("out of memory");
+    sky_replay_free(replay);
+    return NULL;
+  }
+  return replay;
+}
+
+/* Replay state of a session owned by a worker */
+typedef struct {
+  drizzle_con_st connection;
+  drizzle_result_st result;
+  drizzle_query_st query;
+  size_t next;         /* next entry to be sent */
+  uint64_t due;        /* when the next entry should be sent */
+  uint64_t sent_time;  /* when the in-flight entry was sent */
+} SKY_REPLAY_SLOT;
+
+/* Binary min-heap of idle sessions ordered by their due time */
+typedef struct {
+  SKY_REPLAY_SLOT **slots;
+  size_t size;
+} SKY_REPLAY_HEAP;
+
+static void heap_push(SKY_REPLAY_HEAP *heap, SKY_REPLAY_SLOT *slot) {
+  size_t i = heap->size++;
+
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (heap->slots[parent]->due <= slot->due)
+      break;
+    heap->slots[i] = heap->slots[parent];
+    i = parent;
+  }
+  heap->slots[i] = slot;
+}
+
+static SKY_REPLAY_SLOT *heap_pop(SKY_REPLAY_HEAP *heap) {
+  SKY_REPLAY_SLOT *top = heap->slots[0];
+  SKY_REPLAY_SLOT *last = heap->slots[--heap->size];
+  size_t i = 0;
+
+  for (;;) {
+    size_t child = i * 2 + 1;
+    if (child >= heap->size)
+      break;
+    if (child + 1 < heap->size &&
+        heap->slots[child+1]->due < heap->slots[child]->due)
+      child++;
+    if (last->due <= heap->slots[child]->due)
+      break;
+    heap->slots[i] = heap->slots[child];
+    i = child;
+  }
+
+  if (heap->size > 0)
+    heap->slots[i] = last;
+  return top;
+}
+
+static uint64_t entry_due(SKY_REPLAY *replay, size_t index, double speed) {
+  return replay->start_time +
+         (uint64_t)(replay->entries[index].offset / speed);
+}
+
+bool replay_benchmark(SKY_WORKER *context) {
+  assert(context && context->share->replay);
+
+  SKY_SHARE *share = context->share;
+  SKY_REPLAY *replay = share->replay;
+  SKY_REPLAY_SLOT *slots;
+  SKY_REPLAY_HEAP heap;
+  drizzle_st drizzle;
+  drizzle_return_t ret;
+  uint32_t nslots = 0;
+  uint32_t inflight = 0;
+  bool rv = true;
+
+  char *db = (share->database_name) ? share->database_name : SKY_DB_NAME;
+
+  /* sessions are dealt to the workers in order of appearance */
+  for (uint32_t i = context->unique_id - 1; i < replay->sessions;
+       i += share->concurrency)
+    nslots++;
+
+  if (nslots == 0) {
+    context->replay_end_time = current_usec();
+    return true;
+  }
+
+  slots = calloc(nslots, sizeof(*slots));
+  heap.slots = malloc(sizeof(*heap.slots) * nslots);
+  heap.size = 0;
+
+  if (slots == NULL || heap.slots == NULL) {
+    report_error("out of memory");
+    free(slots);
+    free(heap.slots);
+    context->aborted = true;
+    return false;
+  }
+
+  /* the connections of this worker are driven by a dedicated
+     handle so that polling only involves the replay sessions */
+  drizzle_create(&drizzle);
+
+  /* the first worker to get here marks the beginning of the replay.
+     the schedule of every entry is relative to this point */
+  __sync_bool_compare_and_swap(&replay->start_time, 0, current_usec());
+
+  for (uint32_t i = 0; i < nslots; i++) {
+    SKY_REPLAY_SESSION *session =
+      &replay->session_list[context->unique_id - 1 + i * share->concurrency];
+
+    if (!sky_connect_target(share, &share->targets[context->target_index],
+                            &drizzle, &slots[i].connection)) {
+      report_error("failed to initialize connection");
+      nslots = i;
+      rv = false;
+      break;
+    }
+
+    /* the connection is established lazily by the first query */
+    drizzle_con_set_db(&slots[i].connection, db);
+    slots[i].next = session->first;
+    slots[i].due = entry_due(replay, session->first, share->speed);
+    heap_push(&heap, &slots[i]);
+  }
+
+  while (rv && ((heap.size > 0 && !stop_requested()) || inflight > 0)) {
+    uint64_t now = current_usec();
+
+    /* dispatch every session whose next statement is due. once a stop
+       is requested, only the statements in flight are waited for */
+    while (heap.size > 0 && heap.slots[0]->due <= now &&
+           !stop_requested()) {
+      SKY_REPLAY_SLOT *slot = heap_pop(&heap);
+      SKY_REPLAY_ENTRY *entry = &replay->entries[slot->next];
+      uint64_t lag = now - slot->due;
+
+      context->replay_lag_total += lag;
+      if (lag > context->replay_lag_max)
+        context->replay_lag_max = lag;
+      if (lag > REPLAY_LATE_THRESHOLD)
+        context->replay_late++;
+
+      slot->sent_time = now;
+      drizzle_query_add(&drizzle, &slot->query, &slot->connection,
+                        &slot->result, entry->query, entry->length,
+                        DRIZZLE_QUERY_NONE, slot);
+      context->in_flight = ++inflight;
+    }
+
+    if (inflight == 0) {
+      if (heap.slots[0]->due > now)
+        sleep_usec(heap.slots[0]->due - now);
+      continue;
+    }
+
+    /* wait for a statement to complete, but no longer than the
+       time until the next statement is due. the wait is rounded up
+       to a whole msec, as a timeout of 0 would only spin */
+    if (heap.size > 0 && !stop_requested())
+      drizzle_set_timeout(&drizzle,
+                          (int)((heap.slots[0]->due - now + 999) / 1000));
+    else
+      drizzle_set_timeout(&drizzle, -1);
+
+    drizzle_query_st *query = drizzle_query_run(&drizzle, &ret);
+
+    if (query == NULL) {
+      if (ret == DRIZZLE_RETURN_OK || ret == DRIZZLE_RETURN_TIMEOUT)
+        continue;
+
+      fprintf(stderr, "thread[%d] error: %s\n",
+              context->unique_id, drizzle_error(&drizzle));
+      rv = false;
+      break;
+    }
+
+    SKY_REPLAY_SLOT *slot = drizzle_query_context(query);
+    uint16_t code = (ret == DRIZZLE_RETURN_ERROR_CODE) ?
+                    drizzle_con_error_code(&slot->connection) : 0;
+
+    /* only a connection that can't go on ends the replay */
+    if (ret != DRIZZLE_RETURN_OK &&
+        (ret != DRIZZLE_RETURN_ERROR_CODE ||
+         classify_error(ret, code) == SKY_ERROR_CONNECTION)) {
+      fprintf(stderr, "thread[%d] error: %s\n",
+              context->unique_id, drizzle_con_error(&slot->connection));
+      rv = false;
+      break;
+    }
+
+    drizzle_result_free(&slot->result);
+    drizzle_query_free(query);
+    context->in_flight = --inflight;
+
+    uint64_t elapsed = current_usec() - slot->sent_time;
+    SKY_REPLAY_ENTRY *entry = &replay->entries[slot->next];
+    struct iovec text = {entry->query, entry->length};
+
+    if (ret == DRIZZLE_RETURN_OK) {
+      context->replay_time += elapsed;
+      sky_histogram_add(&context->replay_latency, elapsed);
+      record_interval(context, 1, 0, 0);
+      record_latency(context, elapsed);
+      record_slow_query(context, &slot->connection, &text, 1, elapsed);
+      record_span(context, slot->sent_time, elapsed, false);
+      context->replay_queries++;
+      context->target_queries[context->target_index]++;
+      context->target_time[context->target_index] += elapsed;
+    } else {
+      /* captures hold statements that failed on the server they were
+         taken from too. they're counted and the session goes on */
+      context->failed_queries++;
+      record_interval(context, 0, 1, 0);
+    }
+
+    /* queue the next statement of the session or hang up */
+    slot->next = replay->entries[slot->next].next;
+
+    if (slot->next != REPLAY_END_OF_SESSION) {
+      slot->due = entry_due(replay, slot->next, share->speed);
+      heap_push(&heap, slot);
+    } else {
+      drizzle_con_close(&slot->connection);
+    }
+  }
+
+  if (!rv)
+    context->aborted = true;
+
+  context->in_flight = 0;
+
+  for (uint32_t i = 0; i < nslots; i++)
+    sky_close_connection(&slots[i].connection);
+
+  drizzle_free(&drizzle);
+  free(heap.slots);
+  free(slots);
+  context->replay_end_time = current_usec();
+  return rv;
+}
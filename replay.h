@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_REPLAY_H__
+#define __SKYLOAD_REPLAY_H__
+
+#include "skyload.h"
+
+#define REPLAY_INITIAL_CAPACITY 1024
+#define REPLAY_LATE_THRESHOLD   1000 /* usec behind schedule */
+#define REPLAY_END_OF_SESSION   ((size_t)-1)
+
+/* A single statement captured in the query log */
+typedef struct {
+  uint64_t offset;     /* usec since the first captured statement */
+  uint32_t session_id; /* connection id recorded by the server */
+  size_t next;         /* index of the next entry in the same session */
+  char *query;
+  size_t length;
+} SKY_REPLAY_ENTRY;
+
+/* A client session captured in the query log. Each session is
+   replayed in order on a connection of its own. */
+typedef struct {
+  uint32_t session_id;
+  size_t first;        /* index of the first entry of the session */
+  size_t count;        /* number of entries in the session */
+} SKY_REPLAY_SESSION;
+
+/* In-memory representation of a query log. The entries are kept
+   in an array in log order and chained per session. Sessions are
+   ordered by their first appearance and handed to the workers in
+   a round-robin fashion. Everything except 'start_time' is
+   read-only once the log has been parsed. */
+typedef struct _sky_replay {
+  SKY_REPLAY_ENTRY *entries;
+  SKY_REPLAY_SESSION *session_list;
+  size_t size;
+  size_t capacity;
+  uint32_t sessions;            /* number of distinct session ids */
+  uint64_t duration;            /* usec between first and last entry */
+  volatile uint64_t start_time; /* usec timestamp of the replay start */
+} SKY_REPLAY;
+
+/* allocator and deallocator of the replay object */
+SKY_REPLAY *sky_replay_new(void);
+void sky_replay_free(SKY_REPLAY *replay);
+
+/* parses a single line of a MySQL general query log. 'last_time' is
+   updated whenever the line carries a timestamp. returns true and
+   fills the output arguments if the line starts a new log record */
+bool parse_general_log_line(const char *line, uint64_t *last_time,
+                            uint32_t *session_id, char *command,
+                            size_t command_len, const char **argument);
+
+/* reads the MySQL general query log at the given path and converts
+   the Query/Execute/Init DB records into a SKY_REPLAY object */
+SKY_REPLAY *load_general_log(const char *path);
+
+/* replays the sessions assigned to the given worker. every session
+   gets a dedicated connection and the worker multiplexes them with
+   libdrizzle's concurrent query API, keeping the original
+   inter-arrival times scaled by the user specified speed */
+bool replay_benchmark(SKY_WORKER *context);
+
+#endif
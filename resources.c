@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#define _GNU_SOURCE /* RUSAGE_THREAD */
+#include <sys/resource.h>
+#include "resources.h"
+
+static uint64_t timeval_usec(struct timeval tv) {
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+bool sample_rusage(SKY_RUSAGE *usage, bool thread) {
+  assert(usage);
+
+  struct rusage ru;
+  int who = RUSAGE_SELF;
+
+#ifdef RUSAGE_THREAD
+  if (thread)
+    who = RUSAGE_THREAD;
+#else
+  /* without per thread figures only the client as a whole is known */
+  if (thread)
+    return false;
+#endif
+
+  if (getrusage(who, &ru) != 0)
+    return false;
+
+  usage->wall = current_usec();
+  usage->cpu = timeval_usec(ru.ru_utime) + timeval_usec(ru.ru_stime);
+  usage->voluntary = ru.ru_nvcsw;
+  usage->involuntary = ru.ru_nivcsw;
+  return true;
+}
+
+SKY_RUSAGE rusage_diff(const SKY_RUSAGE *from, const SKY_RUSAGE *to) {
+  SKY_RUSAGE diff;
+
+  diff.wall = (to->wall > from->wall) ? to->wall - from->wall : 0;
+  diff.cpu = (to->cpu > from->cpu) ? to->cpu - from->cpu : 0;
+  diff.voluntary = (to->voluntary > from->voluntary) ?
+                   to->voluntary - from->voluntary : 0;
+  diff.involuntary = (to->involuntary > from->involuntary) ?
+                     to->involuntary - from->involuntary : 0;
+  return diff;
+}
+
+double rusage_busy(const SKY_RUSAGE *usage, uint32_t ncpus) {
+  if (usage->wall == 0 || ncpus == 0)
+    return 0;
+  return (double)usage->cpu / usage->wall / ncpus;
+}
+
+void worker_rusage_begin(SKY_WORKER *worker) {
+  if (!sample_rusage(&worker->rusage_start, true))
+    worker->rusage_start.wall = 0;
+}
+
+void worker_rusage_end(SKY_WORKER *worker) {
+  SKY_RUSAGE now, used;
+
+  if (worker->rusage_start.wall == 0 || !sample_rusage(&now, true))
+    return;
+
+  used = rusage_diff(&worker->rusage_start, &now);
+  worker->rusage.wall += used.wall;
+  worker->rusage.cpu += used.cpu;
+  worker->rusage.voluntary += used.voluntary;
+  worker->rusage.involuntary += used.involuntary;
+  worker->rusage_start.wall = 0;
+}
+
+uint32_t online_cpus(void) {
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return (ncpus < 1) ? 1 : (uint32_t)ncpus;
+}
+
+void warn_client_bound(double client_busy, double worker_busy,
+                       const char *label) {
+  char where[64] = "";
+
+  if (label)
+    snprintf(where, sizeof(where), " at %s", label);
+
+  /* a worker that hardly waits on the server is the one setting the
+     pace, as is a client that runs out of CPUs */
+  if (client_busy >= CLIENT_BUSY_THRESHOLD) {
+    fprintf(stderr, "warning: skyload kept %.0lf%% of the CPUs busy%s, the "
+            "throughput is likely bound by the client rather than the "
+            "server\n", client_busy * 100, where);
+  } else if (worker_busy >= CLIENT_BUSY_THRESHOLD) {
+    fprintf(stderr, "warning: the workers were on the CPU %.0lf%% of their "
+            "time%s, the throughput is likely bound by the client rather "
+            "than the server\n", worker_busy * 100, where);
+  }
+}
+
+void print_client_result(SKY_WORKER **workers) {
+  SKY_SHARE *share = workers[0]->share;
+  SKY_RUSAGE total, client, now;
+  uint64_t queries = 0;
+  uint32_t ncpus = online_cpus();
+  double worker_busy, client_busy = 0;
+  struct rusage ru;
+
+  memset(&total, 0, sizeof(total));
+
+  for (int i = 0; i < share->concurrency; i++) {
+    total.wall += workers[i]->rusage.wall;
+    total.cpu += workers[i]->rusage.cpu;
+    total.voluntary += workers[i]->rusage.voluntary;
+    total.involuntary += workers[i]->rusage.involuntary;
+
+    for (int j = 0; j < share->ntargets; j++)
+      queries += workers[i]->target_queries[j];
+  }
+
+  /* nothing to tell without the figures of the threads */
+  if (total.wall == 0)
+    return;
+
+  worker_busy = rusage_busy(&total, 1);
+
+  if (share->client_start.wall > 0 && sample_rusage(&now, false)) {
+    client = rusage_diff(&share->client_start, &now);
+    client_busy = rusage_busy(&client, ncpus);
+  }
+
+  printf("\n");
+  printf("[ CLIENT RESOURCE USAGE ]\n");
+  printf("  Worker CPU Time        : %.3lf secs\n",
+         (double)total.cpu / 1000000);
+  printf("  CPU per Statement      : %.1lf usec\n",
+         (queries) ? (double)total.cpu / queries : 0);
+  printf("  Worker CPU Busy        : %.1lf%% of their time\n",
+         worker_busy * 100);
+  if (client_busy > 0)
+    printf("  Client CPU Utilization : %.1lf%% of %u CPUs\n",
+           client_busy * 100, ncpus);
+  printf("  Context Switches       : %llu voluntary, %llu involuntary\n",
+         (unsigned long long)total.voluntary,
+         (unsigned long long)total.involuntary);
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    printf("  Client Peak Memory     : %.1lf MB\n",
+           (double)ru.ru_maxrss / 1024);
+
+  warn_client_bound(client_busy, worker_busy, NULL);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_RESOURCES_H__
+#define __SKYLOAD_RESOURCES_H__
+
+#include "skyload.h"
+
+/* A worker that spends this share of its time on the CPU, or a client
+   that keeps this share of the CPUs busy, is too busy to tell how
+   fast the server is */
+#define CLIENT_BUSY_THRESHOLD 0.8
+
+/* samples the resources used so far by the calling thread, or by
+   the whole client if 'thread' is false. returns false if they could
+   not be sampled */
+bool sample_rusage(SKY_RUSAGE *usage, bool thread);
+
+/* returns the resources used between two samples */
+SKY_RUSAGE rusage_diff(const SKY_RUSAGE *from, const SKY_RUSAGE *to);
+
+/* returns the share of its wall-clock time that the usage spent on
+   the CPU, spread over 'ncpus' CPUs */
+double rusage_busy(const SKY_RUSAGE *usage, uint32_t ncpus);
+
+/* called by a worker thread when it starts and when it's done with
+   the load, to account for the resources it used in between */
+void worker_rusage_begin(SKY_WORKER *worker);
+void worker_rusage_end(SKY_WORKER *worker);
+
+/* returns the number of CPUs online, at least 1 */
+uint32_t online_cpus(void);
+
+/* warns if the client rather than the server was likely the
+   bottleneck. 'label' names the sweep level or search step that the
+   figures are of, NULL for the main load */
+void warn_client_bound(double client_busy, double worker_busy,
+                       const char *label);
+
+/* prints the CPU time the client spent per statement and how busy
+   it was, with a warning if it was likely the bottleneck */
+void print_client_result(SKY_WORKER **workers);
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "retry.h"
+#include "slowest.h"
+#include "trace.h"
+
+sky_error_class classify_error(drizzle_return_t ret, uint16_t code) {
+  switch (ret) {
+  case DRIZZLE_RETURN_OK:
+    return SKY_ERROR_NONE;
+  case DRIZZLE_RETURN_LOST_CONNECTION:
+  case DRIZZLE_RETURN_COULD_NOT_CONNECT:
+  case DRIZZLE_RETURN_TIMEOUT:
+    /* the state of the connection is unknown after a timeout */
+    return SKY_ERROR_CONNECTION;
+  case DRIZZLE_RETURN_ERROR_CODE:
+    break;
+  default:
+    return SKY_ERROR_FATAL;
+  }
+
+  switch (code) {
+  case ER_LOCK_WAIT_TIMEOUT:
+  case ER_LOCK_DEADLOCK:
+  case ER_QUERY_INTERRUPTED:
+  case ER_TOO_MANY_CONCURRENT_TRXS:
+    return SKY_ERROR_RETRY;
+  case ER_CON_COUNT_ERROR:
+  case ER_SERVER_SHUTDOWN:
+  case CR_SERVER_GONE_ERROR:
+  case CR_SERVER_LOST:
+    return SKY_ERROR_CONNECTION;
+  default:
+    return SKY_ERROR_FATAL;
+  }
+}
+
+uint64_t retry_backoff(uint32_t base, uint32_t attempt) {
+  uint64_t delay = (uint64_t)base * 1000;
+
+  while (attempt-- > 0 && delay < RETRY_MAX_BACKOFF)
+    delay *= 2;
+
+  if (delay > RETRY_MAX_BACKOFF)
+    delay = RETRY_MAX_BACKOFF;
+
+  return delay - (delay / 2) * (random() % 1001) / 1000;
+}
+
+void record_interval(SKY_WORKER *worker, uint64_t queries,
+                     uint64_t errors, uint64_t retries) {
+  SKY_SHARE *share = worker->share;
+  SKY_INTERVAL *interval;
+  uint64_t now = current_usec();
+
+  /* nothing to attribute the counts to before the load started */
+  if (share->start_time == 0 || now < share->start_time)
+    return;
+
+  uint32_t index = (now - share->start_time) /
+                   ((uint64_t)share->report_interval * 1000000);
+
+  /* a soak test runs until stopped and its intervals go to the soak
+     file, so only the totals are kept here */
+  if (share->soak)
+    index = 0;
+
+  if ((interval = sky_timeline_at(&worker->timeline, index)) == NULL)
+    return;
+
+  interval->queries += queries;
+  interval->errors += errors;
+  interval->retries += retries;
+}
+
+void record_latency(SKY_WORKER *worker, uint64_t usec) {
+  if (worker->soak_latency == NULL)
+    return;
+
+  pthread_mutex_lock(&worker->soak_lock);
+  sky_histogram_add(worker->soak_latency, usec);
+  pthread_mutex_unlock(&worker->soak_lock);
+}
+
+/* Accounts for a statement right away */
+static void account_statement(SKY_WORKER *worker, uint16_t target,
+                              uint64_t latency) {
+  worker->target_queries[target]++;
+  worker->target_time[target] += latency;
+  record_latency(worker, latency);
+}
+
+bool record_statement(SKY_WORKER *worker, drizzle_con_st *conn,
+                      uint16_t target, const struct iovec *pieces,
+                      int npieces, uint64_t latency) {
+  SKY_TXN_STATEMENT *statement;
+
+  if (!worker->txn_open) {
+    account_statement(worker, target, latency);
+    record_interval(worker, 1, 0, 0);
+    record_slow_query(worker, conn, pieces, npieces, latency);
+    return true;
+  }
+
+  if (worker->txn_count == worker->txn_capacity) {
+    uint32_t capacity = (worker->txn_capacity) ?
+                        worker->txn_capacity * 2 : TXN_INITIAL_CAPACITY;
+    SKY_TXN_STATEMENT *log = realloc(worker->txn_log,
+                                     sizeof(*log) * capacity);
+
+    if (log == NULL)
+      return false;
+
+    worker->txn_log = log;
+    worker->txn_capacity = capacity;
+  }
+
+  statement = &worker->txn_log[worker->txn_count++];
+  statement->latency = latency;
+  statement->bytes = 0;
+  statement->rows = worker->affected_rows;
+  statement->tag = 0;
+  statement->target = target;
+
+  for (int i = 0; i < npieces; i++)
+    statement->bytes += pieces[i].iov_len;
+
+  /* only the text of a statement that may be kept is copied */
+  statement->slow = is_slow_query(worker, latency);
+
+  if (statement->slow)
+    make_slow_query(worker, conn, pieces, npieces, latency,
+                    &statement->query);
+  return true;
+}
+
+void txn_begin(SKY_WORKER *worker) {
+  worker->txn_open = true;
+  worker->txn_count = 0;
+}
+
+void txn_commit(SKY_WORKER *worker) {
+  if (!worker->txn_open)
+    return;
+
+  for (uint32_t i = 0; i < worker->txn_count; i++) {
+    SKY_TXN_STATEMENT *statement = &worker->txn_log[i];
+
+    account_statement(worker, statement->target, statement->latency);
+
+    if (statement->slow)
+      keep_slow_query(worker, &statement->query);
+  }
+
+  record_interval(worker, worker->txn_count, 0, 0);
+  worker->txn_open = false;
+}
+
+void txn_discard(SKY_WORKER *worker) {
+  worker->txn_open = false;
+  worker->txn_count = 0;
+}
+
+void txn_tag(SKY_WORKER *worker, uint32_t tag) {
+  if (worker->txn_open && worker->txn_count > 0)
+    worker->txn_log[worker->txn_count - 1].tag = tag;
+}
+
+bool reconnect(SKY_WORKER *worker, drizzle_con_st *conn) {
+  drizzle_con_close(conn);
+
+  if (drizzle_con_connect(conn) != DRIZZLE_RETURN_OK)
+    return false;
+
+  if (!switch_database(worker->share, conn)) {
+    drizzle_con_close(conn);
+    return false;
+  }
+
+  if (worker->share->pipeline_depth > 1 && !enable_multi_statements(conn)) {
+    drizzle_con_close(conn);
+    return false;
+  }
+
+  worker->reconnects++;
+  return true;
+}
+
+drizzle_return_t read_result(SKY_WORKER *worker, drizzle_result_st *result) {
+  assert(worker && result);
+
+  SKY_ARENA *arena = &worker->arena;
+  SKY_ARENA_MARK mark;
+  drizzle_return_t ret;
+
+  if (drizzle_result_column_count(result) == 0)
+    return DRIZZLE_RETURN_OK;
+
+  if ((ret = drizzle_column_skip(result)) != DRIZZLE_RETURN_OK)
+    return ret;
+
+  mark = arena_mark(arena);
+
+  while (drizzle_row_read(result, &ret) != 0 && ret == DRIZZLE_RETURN_OK) {
+    char *value = NULL;
+
+    /* a row only lives until the next one is read */
+    arena_rewind(arena, mark);
+
+    for (;;) {
+      size_t offset, size, total;
+      drizzle_field_t field = drizzle_field_read(result, &offset, &size,
+                                                 &total, &ret);
+
+      if (ret == DRIZZLE_RETURN_ROW_END)
+        break;
+
+      if (ret != DRIZZLE_RETURN_OK)
+        return ret;
+
+      /* large fields come in pieces, the first of them tells the
+         size of the whole field */
+      if (offset == 0) {
+        value = NULL;
+        if (field != NULL && (value = arena_alloc(arena, total)) == NULL)
+          return DRIZZLE_RETURN_MEMORY;
+      }
+
+      if (field != NULL && value != NULL)
+        memcpy(value + offset, field, size);
+    }
+  }
+
+  arena_rewind(arena, mark);
+  return ret;
+}
+
+/* Sends a statement. One made of several pieces is sent incrementally
+   as the total length goes ahead of the statement in the packet */
+static void send_pieces(drizzle_con_st *conn, drizzle_result_st *result,
+                        const struct iovec *pieces, int npieces,
+                        drizzle_return_t *ret) {
+  size_t total = 0;
+
+  if (npieces == 1) {
+    drizzle_query(conn, result, pieces[0].iov_base, pieces[0].iov_len, ret);
+    return;
+  }
+
+  for (int i = 0; i < npieces; i++)
+    total += pieces[i].iov_len;
+
+  *ret = DRIZZLE_RETURN_OK;
+
+  for (int i = 0; i < npieces && *ret == DRIZZLE_RETURN_OK; i++) {
+    if (pieces[i].iov_len > 0)
+      drizzle_query_inc(conn, result, pieces[i].iov_base,
+                        pieces[i].iov_len, total, ret);
+  }
+}
+
+sky_error_class execute_query(SKY_WORKER *worker, drizzle_con_st *conn,
+                              uint16_t target, const char *query,
+                              size_t length, int options,
+                              uint64_t *elapsed) {
+  assert(query);
+
+  struct iovec piece = {(void *)query, length};
+
+  return execute_pieces(worker, conn, target, &piece, 1, options, elapsed);
+}
+
+sky_error_class execute_pieces(SKY_WORKER *worker, drizzle_con_st *conn,
+                               uint16_t target, const struct iovec *pieces,
+                               int npieces, int options, uint64_t *elapsed) {
+  assert(worker && conn && pieces && npieces > 0);
+
+  SKY_SHARE *share = worker->share;
+  bool measured = !(options & SKY_EXEC_UNMEASURED);
+  sky_error_class error;
+  drizzle_result_st result;
+  drizzle_return_t ret;
+  uint16_t code;
+
+  for (uint32_t attempt = 0; ; attempt++) {
+    uint64_t start_time = current_usec();
+    bool has_result;
+
+    worker->in_flight = 1;
+    send_pieces(conn, &result, pieces, npieces, &ret);
+    has_result = (ret == DRIZZLE_RETURN_OK || ret == DRIZZLE_RETURN_ERROR_CODE);
+
+    if (ret == DRIZZLE_RETURN_OK && (options & SKY_EXEC_BUFFER))
+      ret = read_result(worker, &result);
+
+    code = (ret == DRIZZLE_RETURN_ERROR_CODE) ? drizzle_con_error_code(conn) : 0;
+
+    if (ret == DRIZZLE_RETURN_OK)
+      worker->affected_rows = drizzle_result_affected_rows(&result);
+
+    if (has_result)
+      drizzle_result_free(&result);
+
+    worker->in_flight = 0;
+
+    if (ret == DRIZZLE_RETURN_OK) {
+      uint64_t end_time = current_usec();
+
+      if (elapsed)
+        *elapsed += end_time - start_time;
+
+      if (!measured)
+        return SKY_ERROR_NONE;
+
+      record_span(worker, start_time, end_time - start_time,
+                  (options & SKY_EXEC_CONTROL) != 0);
+
+      if (!(options & SKY_EXEC_CONTROL) &&
+          !record_statement(worker, conn, target, pieces, npieces,
+                            end_time - start_time)) {
+        fprintf(stderr, "thread[%d] error: out of memory\n",
+                worker->unique_id);
+        return SKY_ERROR_FATAL;
+      }
+      return SKY_ERROR_NONE;
+    }
+
+    error = classify_error(ret, code);
+
+    if (error == SKY_ERROR_FATAL) {
+      fprintf(stderr, "thread[%d] error: %s\n",
+              worker->unique_id, drizzle_con_error(conn));
+      break;
+    }
+
+    /* the following statements need a working connection even if
+       this one is not retried */
+    if (error == SKY_ERROR_CONNECTION)
+      reconnect(worker, conn);
+
+    if (!(options & SKY_EXEC_RETRY) || attempt >= share->max_retries)
+      break;
+
+    if (measured) {
+      worker->retries++;
+      record_interval(worker, 0, 0, 1);
+    }
+    sleep_usec(retry_backoff(share->retry_backoff, attempt));
+  }
+
+  if (measured) {
+    worker->failed_queries++;
+    record_interval(worker, 0, 1, 0);
+  }
+  return error;
+}
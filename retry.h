@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_RETRY_H__
+#define __SKYLOAD_RETRY_H__
+
+#include <sys/uio.h>
+#include "skyload.h"
+#include "slowest.h"
+
+#define RETRY_MAX_BACKOFF 1000000 /* usec */
+
+/* Server error codes that are worth another attempt */
+#define ER_CON_COUNT_ERROR          1040
+#define ER_SERVER_SHUTDOWN          1053
+#define ER_LOCK_WAIT_TIMEOUT        1205
+#define ER_LOCK_DEADLOCK            1213
+#define ER_QUERY_INTERRUPTED        1317
+#define ER_TOO_MANY_CONCURRENT_TRXS 1637
+#define CR_SERVER_GONE_ERROR        2006
+#define CR_SERVER_LOST              2013
+
+/* options of execute_query() */
+#define SKY_EXEC_NONE    0
+#define SKY_EXEC_BUFFER  (1 << 0) /* read the whole result set */
+#define SKY_EXEC_RETRY   (1 << 1) /* retry the statement on its own */
+#define SKY_EXEC_CONTROL (1 << 2) /* transaction control, not a workload
+                                     statement */
+#define SKY_EXEC_UNMEASURED (1 << 3) /* a warmup statement, left out of
+                                        every figure */
+
+#define TXN_INITIAL_CAPACITY 16
+
+/* A statement of the transaction in progress. Its figures are held
+   back until the transaction commits, so that a transaction that is
+   rolled back and run again isn't counted twice */
+typedef struct _sky_txn_statement {
+  uint64_t latency;     /* usec */
+  uint64_t bytes;       /* length of the statement */
+  uint64_t rows;        /* rows it changed */
+  uint32_t tag;         /* set by the caller, e.g. the kind of write */
+  uint16_t target;
+  bool slow;            /* whether 'query' was among the slowest */
+  SKY_SLOW_QUERY query;
+} SKY_TXN_STATEMENT;
+
+/* How a failed statement is dealt with */
+typedef enum {
+  SKY_ERROR_NONE,       /* the statement succeeded */
+  SKY_ERROR_RETRY,      /* transient, e.g. a deadlock. try again */
+  SKY_ERROR_CONNECTION, /* the connection is gone. reconnect first */
+  SKY_ERROR_FATAL       /* anything else. the worker gives up */
+} sky_error_class;
+
+/* classifies the outcome of a statement from the libdrizzle return
+   code and, if the server sent one, the error code */
+sky_error_class classify_error(drizzle_return_t ret, uint16_t code);
+
+/* returns the number of usecs to wait before the given retry. the
+   delay doubles with every attempt, starting at 'base' msecs and
+   capped at RETRY_MAX_BACKOFF, and is randomized by up to a half so
+   that workers which failed together don't retry in lockstep */
+uint64_t retry_backoff(uint32_t base, uint32_t attempt);
+
+/* adds to the counters of the interval the current time falls in */
+void record_interval(SKY_WORKER *worker, uint64_t queries,
+                     uint64_t errors, uint64_t retries);
+
+/* adds a latency to the soak interval of the worker, if any. the
+   soak sampler takes the interval away under the same lock */
+void record_latency(SKY_WORKER *worker, uint64_t usec);
+
+/* closes and re-establishes a connection of the worker on the test
+   database */
+bool reconnect(SKY_WORKER *worker, drizzle_con_st *conn);
+
+/* reads the rows of a result one at a time into the arena of the
+   worker instead of buffering the whole result set on the heap */
+drizzle_return_t read_result(SKY_WORKER *worker, drizzle_result_st *result);
+
+/* runs a statement on one of the connections of the worker. with
+   SKY_EXEC_RETRY, transient errors are retried with a backoff up to
+   --max-retries times. a lost connection is re-established either
+   way. the time of the successful attempt is added to 'elapsed' if
+   it's given and the rows it changed are left in the affected_rows of
+   the worker. returns the class of the last error, if any */
+sky_error_class execute_query(SKY_WORKER *worker, drizzle_con_st *conn,
+                              uint16_t target, const char *query,
+                              size_t length, int options,
+                              uint64_t *elapsed);
+
+/* accounts for a workload statement that succeeded. while a
+   transaction is open its figures are only logged, to be accounted
+   by txn_commit(). returns false if out of memory */
+bool record_statement(SKY_WORKER *worker, drizzle_con_st *conn,
+                      uint16_t target, const struct iovec *pieces,
+                      int npieces, uint64_t latency);
+
+/* opens a transaction of the worker, whose statements are accounted
+   once txn_commit() is called or forgotten by txn_discard(). the
+   log of the statements stays readable until the next txn_begin() */
+void txn_begin(SKY_WORKER *worker);
+void txn_commit(SKY_WORKER *worker);
+void txn_discard(SKY_WORKER *worker);
+
+/* sets the tag of the last statement logged in the open transaction */
+void txn_tag(SKY_WORKER *worker, uint32_t tag);
+
+/* same as execute_query() for a statement that lies in pieces apart
+   from each other, e.g. a generated row and its payloads. the pieces
+   are handed to libdrizzle one after another instead of being joined */
+sky_error_class execute_pieces(SKY_WORKER *worker, drizzle_con_st *conn,
+                               uint16_t target, const struct iovec *pieces,
+                               int npieces, int options, uint64_t *elapsed);
+
+#endif
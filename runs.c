@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <math.h>
+#include "runs.h"
+
+bool record_run(SKY_WORKER *worker, uint64_t elapsed, uint64_t queries,
+                uint64_t latency) {
+  assert(worker);
+
+  SKY_RUN *run;
+
+  if (worker->run_log_size == RUNS_MAX_RECORDED)
+    return true;
+
+  if (worker->run_log_size == worker->run_log_capacity) {
+    uint32_t capacity = (worker->run_log_capacity) ?
+                        worker->run_log_capacity * 2 : RUNS_INITIAL_CAPACITY;
+    SKY_RUN *log = realloc(worker->run_log, sizeof(*log) * capacity);
+
+    if (log == NULL)
+      return false;
+
+    worker->run_log = log;
+    worker->run_log_capacity = capacity;
+  }
+
+  run = &worker->run_log[worker->run_log_size++];
+  run->elapsed = elapsed;
+  run->queries = queries;
+  run->latency = latency;
+  return true;
+}
+
+double t_quantile_95(uint32_t df) {
+  static const double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  uint32_t size = sizeof(table) / sizeof(table[0]);
+
+  if (df == 0)
+    return 0;
+  if (df <= size)
+    return table[df - 1];
+
+  /* within 0.001 of the exact value past the table */
+  return 1.96 + 2.5 / df;
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* median of the sorted values */
+static double median(const double *sorted, uint32_t n) {
+  if (n % 2)
+    return sorted[n / 2];
+  return (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+bool summarize_runs(const double *values, uint32_t n,
+                    SKY_RUN_SUMMARY *summary, bool *outliers) {
+  assert(values && summary);
+
+  double *sorted, mad, sum = 0, sumsq = 0;
+
+  memset(summary, 0, sizeof(*summary));
+
+  if (n == 0)
+    return true;
+
+  if ((sorted = malloc(sizeof(double) * n)) == NULL)
+    return false;
+
+  memcpy(sorted, values, sizeof(double) * n);
+  qsort(sorted, n, sizeof(double), compare_double);
+  summary->median = median(sorted, n);
+
+  /* the median absolute deviation isn't thrown off by the outliers
+     it's meant to find */
+  for (uint32_t i = 0; i < n; i++)
+    sorted[i] = fabs(values[i] - summary->median);
+
+  qsort(sorted, n, sizeof(double), compare_double);
+  mad = median(sorted, n);
+  free(sorted);
+
+  for (uint32_t i = 0; i < n; i++) {
+    bool outlier = (mad > 0 &&
+                    0.6745 * fabs(values[i] - summary->median) / mad >
+                    RUNS_OUTLIER_Z);
+
+    if (outliers)
+      outliers[i] = outlier;
+
+    if (outlier) {
+      summary->outliers++;
+      continue;
+    }
+
+    summary->n++;
+    sum += values[i];
+    sumsq += values[i] * values[i];
+  }
+
+  summary->mean = sum / summary->n;
+
+  if (summary->n > 1) {
+    double variance = (sumsq - sum * sum / summary->n) / (summary->n - 1);
+
+    summary->stddev = (variance > 0) ? sqrt(variance) : 0;
+    summary->ci = t_quantile_95(summary->n - 1) * summary->stddev /
+                  sqrt(summary->n);
+  }
+  return true;
+}
+
+SKY_RUN_RESULT *collect_runs(SKY_WORKER **workers, uint32_t *nruns) {
+  assert(workers && nruns);
+
+  SKY_SHARE *share = workers[0]->share;
+  SKY_RUN_RESULT *runs;
+  uint32_t n = UINT32_MAX;
+
+  /* only the runs every worker got through are comparable */
+  for (int i = 0; i < share->concurrency; i++) {
+    if (!workers[i]->aborted && workers[i]->run_log_size < n)
+      n = workers[i]->run_log_size;
+  }
+
+  *nruns = 0;
+
+  if (n == 0 || n == UINT32_MAX)
+    return NULL;
+
+  if ((runs = calloc(n, sizeof(*runs))) == NULL)
+    return NULL;
+
+  for (uint32_t r = 0; r < n; r++) {
+    uint64_t latency = 0;
+
+    for (int i = 0; i < share->concurrency; i++) {
+      SKY_RUN *run = &workers[i]->run_log[r];
+
+      if (workers[i]->aborted)
+        continue;
+
+      /* the workers aren't in lockstep, so their rates are added up
+         rather than dividing by a common window */
+      runs[r].queries += run->queries;
+      if (run->elapsed > 0)
+        runs[r].qps += (double)run->queries * 1000000 / run->elapsed;
+      latency += run->latency;
+    }
+
+    runs[r].mean = (runs[r].queries) ? (double)latency / runs[r].queries : 0;
+  }
+
+  *nruns = n;
+  return runs;
+}
+
+bool summarize_throughput(SKY_WORKER **workers, SKY_RUN_SUMMARY *summary) {
+  SKY_RUN_RESULT *runs;
+  double *values;
+  uint32_t nruns;
+  bool rv;
+
+  if ((runs = collect_runs(workers, &nruns)) == NULL)
+    return false;
+
+  if (nruns < 2 || (values = malloc(sizeof(double) * nruns)) == NULL) {
+    free(runs);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < nruns; i++)
+    values[i] = runs[i].qps;
+
+  rv = summarize_runs(values, nruns, summary, NULL);
+
+  free(values);
+  free(runs);
+  return (rv && summary->n > 1);
+}
+
+/* Summarizes one metric of the runs and flags their outliers */
+static bool summarize_metric(SKY_RUN_RESULT *runs, uint32_t nruns,
+                             bool latency, SKY_RUN_SUMMARY *summary) {
+  double *values = calloc(nruns, sizeof(double));
+  bool *outliers = malloc(sizeof(bool) * nruns);
+  bool rv;
+
+  if (values == NULL || outliers == NULL) {
+    free(outliers);
+    free(values);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < nruns; i++)
+    values[i] = (latency) ? runs[i].mean : runs[i].qps;
+
+  rv = summarize_runs(values, nruns, summary, outliers);
+
+  for (uint32_t i = 0; rv && i < nruns; i++)
+    runs[i].outlier = runs[i].outlier || outliers[i];
+
+  free(outliers);
+  free(values);
+  return rv;
+}
+
+void print_run_result(SKY_WORKER **workers) {
+  SKY_SHARE *share = workers[0]->share;
+  SKY_RUN_SUMMARY qps, mean;
+  SKY_RUN_RESULT *runs;
+  uint32_t nruns;
+
+  if ((runs = collect_runs(workers, &nruns)) == NULL || nruns < 2) {
+    free(runs);
+    return;
+  }
+
+  /* a run stands out by its latency as much as by its throughput */
+  if (!summarize_metric(runs, nruns, false, &qps) ||
+      !summarize_metric(runs, nruns, true, &mean)) {
+    report_error("out of memory");
+    free(runs);
+    return;
+  }
+
+  printf("\n");
+  printf("[ RUN TO RUN VARIATION ]\n");
+  printf("  Runs Measured          : %u", nruns);
+  if (share->run_warmup > 0)
+    printf(" (after %u secs of warmup each)", share->run_warmup);
+  printf("\n");
+  printf("  Throughput             : %.1lf q/s +/- %.1lf (95%% CI), "
+         "stddev %.1lf (%.1lf%%)\n", qps.mean, qps.ci, qps.stddev,
+         (qps.mean > 0) ? 100.0 * qps.stddev / qps.mean : 0);
+  printf("  Mean Latency           : %.3lf ms +/- %.3lf (95%% CI), "
+         "stddev %.3lf (%.1lf%%)\n", mean.mean / 1000, mean.ci / 1000,
+         mean.stddev / 1000,
+         (mean.mean > 0) ? 100.0 * mean.stddev / mean.mean : 0);
+  printf("  Outlier Runs           : %u by throughput, %u by latency "
+         "(left out above)\n", qps.outliers, mean.outliers);
+  printf("  %-6s %12s %14s %12s\n", "Run", "Queries", "Rate (q/s)",
+         "Mean (ms)");
+
+  for (uint32_t i = 0; i < nruns; i++) {
+    printf("  %-6u %12llu %14.1lf %12.3lf%s\n", i + 1,
+           (unsigned long long)runs[i].queries, runs[i].qps,
+           runs[i].mean / 1000, (runs[i].outlier) ? "  outlier" : "");
+  }
+
+  free(runs);
+}
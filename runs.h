@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_RUNS_H__
+#define __SKYLOAD_RUNS_H__
+
+#include "skyload.h"
+
+#define RUNS_INITIAL_CAPACITY 16
+#define RUNS_MAX_RECORDED     100000 /* runs a worker keeps track of */
+#define RUNS_OUTLIER_Z        3.5    /* modified z-score of an outlier */
+
+/* A single run of the read file by one worker */
+typedef struct _sky_run {
+  uint64_t elapsed;    /* usec of wall-clock time */
+  uint64_t queries;    /* statements measured */
+  uint64_t latency;    /* usec spent in the measured statements */
+} SKY_RUN;
+
+/* The same run of every worker put together */
+typedef struct {
+  uint64_t queries;
+  double qps;          /* sum of the rates of the workers */
+  double mean;         /* usec */
+  bool outlier;
+} SKY_RUN_RESULT;
+
+/* Location and spread of a metric over the runs. Outliers are left
+   out of everything but 'median' and 'outliers' */
+typedef struct {
+  uint32_t n;          /* runs summarized, outliers excluded */
+  double mean;
+  double stddev;
+  double ci;           /* half width of the 95% confidence interval */
+  double median;
+  uint32_t outliers;
+} SKY_RUN_SUMMARY;
+
+/* appends a run to the log of the worker. runs past
+   RUNS_MAX_RECORDED are not kept. returns false if out of memory */
+bool record_run(SKY_WORKER *worker, uint64_t elapsed, uint64_t queries,
+                uint64_t latency);
+
+/* returns the two-sided 95% quantile of Student's t distribution
+   with the given degrees of freedom */
+double t_quantile_95(uint32_t df);
+
+/* marks the values whose modified z-score, i.e. the distance from
+   the median in units of the median absolute deviation, exceeds
+   RUNS_OUTLIER_Z and summarizes the rest. 'outliers' may be NULL */
+bool summarize_runs(const double *values, uint32_t n,
+                    SKY_RUN_SUMMARY *summary, bool *outliers);
+
+/* puts the runs that every worker completed together. the caller
+   frees the returned array. returns NULL if there are none or if out
+   of memory */
+SKY_RUN_RESULT *collect_runs(SKY_WORKER **workers, uint32_t *nruns);
+
+/* summarizes the throughput of the runs for --json. returns false
+   if fewer than two runs were completed */
+bool summarize_throughput(SKY_WORKER **workers, SKY_RUN_SUMMARY *summary);
+
+/* prints the figures of every run and their spread */
+void print_run_result(SKY_WORKER **workers);
+
+#endif
@@ -0,0 +1,658 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <ctype.h>
+#include "scenario.h"
+#include "generator.h"
+#include "retry.h"
+#include "status.h"
+#include "metrics.h"
+
+const char *operation_name(sky_op op) {
+  static const char *names[] = {"read", "insert"};
+  return (op < SKY_NOPS) ? names[op] : "unknown";
+}
+
+/* Strips the whitespace around a string in place */
+static char *trim(char *string) {
+  char *end;
+
+  while (isspace((unsigned char)*string))
+    string++;
+
+  end = string + strlen(string);
+  while (end > string && isspace((unsigned char)end[-1]))
+    end--;
+
+  *end = '\0';
+  return string;
+}
+
+/* Parses a non-negative number that takes up the whole string */
+static bool parse_number(const char *value, double *number) {
+  char *end;
+
+  *number = strtod(value, &end);
+  return (end != value && *end == '\0' && *number >= 0);
+}
+
+/* Parses a comma separated list of operations, each optionally
+   followed by ':' and its weight, e.g. "read:80,insert:20" */
+static bool parse_mix(char *value, uint32_t *mix) {
+  char *item, *saveptr = NULL;
+
+  memset(mix, 0, sizeof(uint32_t) * SKY_NOPS);
+
+  for (item = strtok_r(value, ",", &saveptr); item != NULL;
+       item = strtok_r(NULL, ",", &saveptr)) {
+    char *weight = strchr(item, ':');
+    double number = 1;
+    int op;
+
+    if (weight) {
+      *weight++ = '\0';
+      if (!parse_number(trim(weight), &number) || number != (uint32_t)number)
+        return false;
+    }
+
+    item = trim(item);
+
+    for (op = 0; op < SKY_NOPS; op++) {
+      if (strcasecmp(item, operation_name(op)) == 0)
+        break;
+    }
+
+    if (op == SKY_NOPS)
+      return false;
+
+    mix[op] += (uint32_t)number;
+  }
+  return true;
+}
+
+/* Starts a phase with the settings of the command line */
+static SKY_SCENARIO_PHASE *add_phase(SKY_SCENARIO *scenario,
+                                     SKY_SHARE *share, const char *name) {
+  SKY_SCENARIO_PHASE *phase;
+
+  if (scenario->nphases == SCENARIO_MAX_PHASES)
+    return NULL;
+
+  phase = &scenario->phases[scenario->nphases++];
+  memset(phase, 0, sizeof(*phase));
+  snprintf(phase->name, sizeof(phase->name), "%s", name);
+  phase->concurrency = share->concurrency;
+  phase->rate_end = -1;
+  phase->measure = true;
+
+  if (share->read_queries && share->read_queries->size > 0)
+    phase->mix[SKY_OP_READ] = 1;
+  else
+    phase->mix[SKY_OP_INSERT] = 1;
+
+  for (int i = share->ntables - 1; i >= 0; i--) {
+    if (share->tables[i].insert_tmpl)
+      phase->table = i;
+  }
+  return phase;
+}
+
+/* Applies a setting to the phase. returns an error message or NULL */
+static const char *set_phase_value(SKY_SHARE *share,
+                                   SKY_SCENARIO_PHASE *phase,
+                                   const char *key, char *value) {
+  double number;
+
+  if (strcasecmp(key, "mix") == 0) {
+    if (!parse_mix(value, phase->mix))
+      return "invalid operation mix";
+    return NULL;
+  }
+
+  if (strcasecmp(key, "measure") == 0) {
+    if (strcasecmp(value, "yes") == 0 || strcasecmp(value, "true") == 0 ||
+        strcmp(value, "1") == 0) {
+      phase->measure = true;
+    } else if (strcasecmp(value, "no") == 0 ||
+               strcasecmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+      phase->measure = false;
+    } else {
+      return "measure must be yes or no";
+    }
+    return NULL;
+  }
+
+  if (!parse_number(value, &number))
+    return "value must be a non-negative number";
+
+  if (strcasecmp(key, "duration") == 0) {
+    phase->duration = (uint32_t)number;
+  } else if (strcasecmp(key, "ops") == 0) {
+    phase->ops = (uint64_t)number;
+  } else if (strcasecmp(key, "concurrency") == 0) {
+    phase->concurrency = (uint32_t)number;
+  } else if (strcasecmp(key, "rate") == 0) {
+    phase->rate = number;
+  } else if (strcasecmp(key, "rate_end") == 0) {
+    phase->rate_end = number;
+  } else if (strcasecmp(key, "table") == 0) {
+    if (number < 1 || number > share->ntables)
+      return "no such table";
+    phase->table = (uint16_t)number - 1;
+  } else {
+    return "unknown setting";
+  }
+  return NULL;
+}
+
+/* Checks that a phase can run with what the command line provided.
+   returns an error message or NULL */
+static const char *check_phase(SKY_SHARE *share, SKY_SCENARIO *scenario,
+                               SKY_SCENARIO_PHASE *phase) {
+  if (phase->rate_end < 0)
+    phase->rate_end = phase->rate;
+
+  for (uint32_t i = 0; &scenario->phases[i] != phase; i++) {
+    if (strcmp(scenario->phases[i].name, phase->name) == 0)
+      return "phase name used twice";
+  }
+
+  if (phase->duration == 0 && phase->ops == 0)
+    return "phase needs a duration or a number of ops";
+
+  if (phase->concurrency < 1)
+    return "concurrency must be greater than 0";
+
+  if (phase->rate_end != phase->rate &&
+      (phase->duration == 0 || phase->rate == 0 || phase->rate_end == 0))
+    return "rate_end needs a duration and a rate, both greater than 0";
+
+  if (phase->mix[SKY_OP_READ] + phase->mix[SKY_OP_INSERT] == 0)
+    return "operation mix is empty";
+
+  if (phase->mix[SKY_OP_READ] > 0 &&
+      (!share->read_queries || share->read_queries->size == 0))
+    return "read operations need --read-file";
+
+  if (phase->mix[SKY_OP_INSERT] > 0 &&
+      (share->ntables == 0 || !share->tables[phase->table].insert_tmpl))
+    return "insert operations need a table with an INSERT template";
+
+  return NULL;
+}
+
+SKY_SCENARIO *load_scenario(SKY_SHARE *share, const char *path) {
+  assert(share && path);
+
+  SKY_SCENARIO *scenario;
+  SKY_SCENARIO_PHASE *phase = NULL;
+  char line[SKY_STRSIZ];
+  const char *error = NULL;
+  uint32_t number = 0;
+  FILE *file;
+
+  if ((file = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "failed to open (%s)\n", path);
+    return NULL;
+  }
+
+  if ((scenario = calloc(1, sizeof(*scenario))) == NULL) {
+    report_error("out of memory");
+    fclose(file);
+    return NULL;
+  }
+
+  while (error == NULL && fgets(line, sizeof(line), file) != NULL) {
+    char *text = trim(line);
+    char *value;
+
+    number++;
+
+    if (*text == '\0' || *text == '#' || *text == ';')
+      continue;
+
+    /* a new phase ends the previous one */
+    if (*text == '[') {
+      size_t length = strlen(text);
+
+      if (phase && (error = check_phase(share, scenario, phase)) != NULL)
+        break;
+
+      if (text[length - 1] != ']') {
+        error = "phase name must be enclosed in []";
+      } else {
+        text[length - 1] = '\0';
+        text = trim(text + 1);
+
+        if (*text == '\0' || strlen(text) >= SCENARIO_NAME_SIZE)
+          error = "phase name must be 1 to 31 characters long";
+        else if ((phase = add_phase(scenario, share, text)) == NULL)
+          error = "too many phases";
+      }
+      continue;
+    }
+
+    if ((value = strchr(text, '=')) == NULL) {
+      error = "expected 'key = value'";
+    } else if (phase == NULL) {
+      error = "setting outside of a phase";
+    } else {
+      *value++ = '\0';
+      error = set_phase_value(share, phase, trim(text), trim(value));
+    }
+  }
+
+  if (error == NULL && phase == NULL)
+    error = "no phases";
+  else if (error == NULL)
+    error = check_phase(share, scenario, phase);
+
+  fclose(file);
+
+  if (error) {
+    fprintf(stderr, "%s:%u: %s\n", path, number, error);
+    free(scenario);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < scenario->nphases; i++) {
+    if (scenario->phases[i].concurrency > scenario->max_concurrency)
+      scenario->max_concurrency = scenario->phases[i].concurrency;
+  }
+
+  /* the rows inserted by the phases follow the populated ones */
+  for (int i = 0; i < share->ntables; i++) {
+    if (share->tables[i].insert_tmpl && share->tables[i].nwrite > 0)
+      scenario->next_key[i] = next_free_key(share, &share->tables[i]);
+  }
+  return scenario;
+}
+
+void sky_scenario_free(SKY_SCENARIO *scenario) {
+  free(scenario);
+}
+
+double phase_rate(const SKY_SCENARIO_PHASE *phase, uint64_t elapsed) {
+  uint64_t duration = (uint64_t)phase->duration * 1000000;
+
+  if (duration == 0)
+    return phase->rate;
+  if (elapsed >= duration)
+    return phase->rate_end;
+
+  return phase->rate + (phase->rate_end - phase->rate) * elapsed / duration;
+}
+
+sky_op pick_operation(const SKY_SCENARIO_PHASE *phase, uint64_t draw) {
+  uint64_t total = 0;
+
+  for (int op = 0; op < SKY_NOPS; op++)
+    total += phase->mix[op];
+
+  draw %= total;
+
+  for (int op = 0; op < SKY_NOPS; op++) {
+    if (draw < phase->mix[op])
+      return op;
+    draw -= phase->mix[op];
+  }
+  return SKY_OP_READ;
+}
+
+/* Runs a single operation and records its latency */
+static sky_error_class run_operation(SKY_WORKER *context, sky_op op,
+                                     size_t *next_read) {
+  SKY_SHARE *share = context->share;
+  sky_error_class error;
+  uint64_t elapsed = 0;
+
+  if (op == SKY_OP_READ) {
+    SKY_LIST *queries = share->read_queries;
+    SKY_LIST_NODE *current = queries->nodes[context->read_order[*next_read]];
+
+    error = execute_query(context, context->read_connection,
+                          context->read_target_index, current->data,
+                          current->length,
+                          SKY_EXEC_BUFFER | SKY_EXEC_RETRY, &elapsed);
+
+    if (error == SKY_ERROR_NONE)
+      sky_histogram_add(&context->read_latency, elapsed);
+
+    /* the file is run over and over in the order of --read-order */
+    if (++(*next_read) == queries->size) {
+      *next_read = 0;
+      if (!plan_read_order(context)) {
+        fprintf(stderr, "thread[%d] error: out of memory\n",
+                context->unique_id);
+        return SKY_ERROR_FATAL;
+      }
+    }
+  } else {
+    size_t query_size = insert_query_size(context->table);
+    uint16_t target = context->target_index;
+    drizzle_con_st *conn = &context->connection;
+    size_t length;
+    char *query;
+
+    arena_reset(&context->arena);
+
+    if ((query = arena_alloc(&context->arena, query_size)) == NULL) {
+      fprintf(stderr, "thread[%d] error: out of memory\n",
+              context->unique_id);
+      return SKY_ERROR_FATAL;
+    }
+
+    if ((length = next_insert_query(context, query, query_size)) == 0) {
+      fprintf(stderr, "thread[%d] invalid INSERT template\n",
+              context->unique_id);
+      return SKY_ERROR_FATAL;
+    }
+
+    /* rows are sent to the primary owning their key if requested */
+    if (context->shard_connections) {
+      target = route_key(share, context->row_key);
+      conn = &context->shard_connections[target];
+    }
+
+    error = execute_query(context, conn, target, query, length,
+                          SKY_EXEC_RETRY, &elapsed);
+
+    if (error == SKY_ERROR_NONE) {
+      sky_histogram_add(&context->insert_latency, elapsed);
+      context->rows_inserted++;
+    }
+  }
+  return error;
+}
+
+/* Runs the operations of a phase until its time is up or the worker
+   has run its share of the ops. With a rate, the operations are
+   started on a schedule that doesn't catch up on a backlog in bursts
+   when the server falls behind. */
+static void *scenario_workload(void *arg) {
+  assert(arg);
+
+  SKY_WORKER *context = (SKY_WORKER *)arg;
+  SKY_SCENARIO_PHASE *phase = context->scenario_phase;
+  uint64_t begin = current_usec();
+  uint64_t due = begin;
+  size_t next_read = 0;
+
+  if (phase->mix[SKY_OP_READ] > 0 && !plan_read_order(context)) {
+    fprintf(stderr, "thread[%d] error: out of memory\n", context->unique_id);
+    context->aborted = true;
+    return NULL;
+  }
+
+  for (uint64_t n = 0; n < context->scenario_ops; n++) {
+    uint64_t now = current_usec();
+    uint64_t draw = ((uint64_t)random() << 31) | (uint64_t)random();
+
+    if (now >= context->measure_end || stop_requested())
+      break;
+
+    if (phase->rate > 0) {
+      double rate = phase_rate(phase, now - begin) / phase->concurrency;
+
+      if (due >= context->measure_end)
+        break;
+      if (due > now)
+        sleep_usec(due - now);
+
+      due += (uint64_t)(1000000 / rate);
+      if (due < current_usec())
+        due = current_usec();
+    }
+
+    if (run_operation(context, pick_operation(phase, draw),
+                      &next_read) == SKY_ERROR_FATAL) {
+      context->aborted = true;
+      return NULL;
+    }
+  }
+  return NULL;
+}
+
+/* Hands the %seq values of the table out from where the previous
+   phase on it left off, each worker taking every n-th of them */
+static void seed_keys(SKY_SCENARIO *scenario, SKY_WORKER **workers,
+                      uint32_t nworkers, uint16_t table) {
+  for (uint32_t i = 0; i < nworkers; i++) {
+    workers[i]->seq_stride = nworkers;
+    for (int j = 0; j < SKY_MAX_COLS; j++)
+      workers[i]->current_seq_id[j] = scenario->next_key[table] + i -
+                                      nworkers;
+  }
+}
+
+/* Remembers the first %seq value that wasn't handed out yet */
+static void save_keys(SKY_SCENARIO *scenario, SKY_WORKER **workers,
+                      uint32_t nworkers, uint16_t table) {
+  for (uint32_t i = 0; i < nworkers; i++) {
+    for (int j = 0; j < SKY_MAX_COLS; j++) {
+      if (workers[i]->current_seq_id[j] + nworkers > scenario->next_key[table])
+        scenario->next_key[table] = workers[i]->current_seq_id[j] + nworkers;
+    }
+  }
+}
+
+/* Runs a phase with the first 'concurrency' workers of the pool */
+static bool run_scenario_phase(SKY_SHARE *share, SKY_WORKER **workers,
+                               SKY_SCENARIO_PHASE *phase) {
+  SKY_SCENARIO *scenario = share->scenario;
+  uint32_t concurrency = phase->concurrency;
+  uint64_t begin = current_usec();
+  uint64_t failed_before = 0, failed_after = 0;
+  SKY_HISTOGRAM *merged;
+  bool rv = true;
+
+  if ((merged = malloc(sizeof(*merged))) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+  sky_histogram_reset(merged);
+
+  if (phase->mix[SKY_OP_INSERT] > 0)
+    seed_keys(scenario, workers, concurrency, phase->table);
+
+  if (share->status_sampler)
+    status_mark(share->status_sampler, "");
+
+  for (uint32_t i = 0; i < concurrency; i++) {
+    SKY_WORKER *worker = workers[i];
+
+    sky_histogram_reset(&worker->read_latency);
+    sky_histogram_reset(&worker->insert_latency);
+    failed_before += worker->failed_queries;
+
+    worker->scenario_phase = phase;
+    worker->phase = (phase->mix[SKY_OP_READ] > 0) ? SKY_PHASE_READ :
+                    SKY_PHASE_INSERT;
+    worker->table = &share->tables[phase->table];
+    worker->measure_end = (phase->duration > 0) ?
+                          begin + (uint64_t)phase->duration * 1000000 :
+                          UINT64_MAX;
+    worker->scenario_ops = UINT64_MAX;
+
+    /* the ops are split as evenly as the workers allow */
+    if (phase->ops > 0)
+      worker->scenario_ops = phase->ops / concurrency +
+                             (i < phase->ops % concurrency);
+
+    if (pthread_create(&worker->thread_id, NULL, scenario_workload,
+                       (void *)worker)) {
+      report_error("failed to create worker thread");
+      concurrency = i;
+      rv = false;
+      break;
+    }
+  }
+
+  for (uint32_t i = 0; i < concurrency; i++) {
+    pthread_join(workers[i]->thread_id, NULL);
+    workers[i]->phase = SKY_NPHASES;
+
+    if (workers[i]->aborted)
+      rv = false;
+
+    phase->count[SKY_OP_READ] += workers[i]->read_latency.count;
+    phase->count[SKY_OP_INSERT] += workers[i]->insert_latency.count;
+    failed_after += workers[i]->failed_queries;
+    sky_histogram_merge(merged, &workers[i]->read_latency);
+    sky_histogram_merge(merged, &workers[i]->insert_latency);
+  }
+
+  if (phase->mix[SKY_OP_INSERT] > 0)
+    save_keys(scenario, workers, concurrency, phase->table);
+
+  if (share->status_sampler && rv) {
+    char label[STATUS_LABEL_SIZE];
+
+    snprintf(label, sizeof(label), "%s%s", SCENARIO_LABEL, phase->name);
+    status_mark(share->status_sampler, label);
+  }
+
+  phase->elapsed = current_usec() - begin;
+  phase->errors = failed_after - failed_before;
+  phase->qps = (phase->elapsed) ?
+               (double)merged->count * 1000000 / phase->elapsed : 0;
+  phase->mean = sky_histogram_mean(merged);
+  phase->p50 = sky_histogram_percentile(merged, 50.0);
+  phase->p95 = sky_histogram_percentile(merged, 95.0);
+  phase->p99 = sky_histogram_percentile(merged, 99.0);
+  phase->completed = (rv && !stop_requested());
+
+  free(merged);
+  return rv;
+}
+
+static void print_scenario_result(SKY_SHARE *share, SKY_SCENARIO *scenario) {
+  uint64_t elapsed = 0, count = 0, errors = 0;
+
+  printf("\n");
+  printf("[ SCENARIO RESULT ]\n");
+  printf("  Scenario File          : %s\n", share->scenario_path);
+  printf("\n");
+  printf("  %-16s %8s %5s %10s %10s %10s %7s %11s %9s %9s\n", "Phase",
+         "Secs", "Conc", "Target/s", "Reads", "Inserts", "Errors",
+         "Queries/s", "Avg (ms)", "p99 (ms)");
+
+  for (uint32_t i = 0; i < scenario->nphases; i++) {
+    SKY_SCENARIO_PHASE *phase = &scenario->phases[i];
+    char target[32];
+
+    if (phase->elapsed == 0)
+      break;
+
+    if (phase->rate == 0)
+      snprintf(target, sizeof(target), "-");
+    else if (phase->rate_end != phase->rate)
+      snprintf(target, sizeof(target), "%.0lf>%.0lf", phase->rate,
+               phase->rate_end);
+    else
+      snprintf(target, sizeof(target), "%.0lf", phase->rate);
+
+    printf("  %-16s %8.1lf %5u %10s %10llu %10llu %7llu %11.1lf %9.3lf "
+           "%9.3lf%s\n", phase->name, (double)phase->elapsed / 1000000,
+           phase->concurrency, target,
+           (unsigned long long)phase->count[SKY_OP_READ],
+           (unsigned long long)phase->count[SKY_OP_INSERT],
+           (unsigned long long)phase->errors, phase->qps, phase->mean / 1000,
+           (double)phase->p99 / 1000,
+           (!phase->measure) ? "  warmup" :
+           (!phase->completed) ? "  incomplete" : "");
+
+    if (phase->measure) {
+      elapsed += phase->elapsed;
+      count += phase->count[SKY_OP_READ] + phase->count[SKY_OP_INSERT];
+      errors += phase->errors;
+    }
+  }
+
+  printf("\n");
+  printf("  Measured Phases        : %.3lf secs, %llu operations, "
+         "%llu errors\n", (double)elapsed / 1000000,
+         (unsigned long long)count, (unsigned long long)errors);
+  printf("  Measured Throughput    : %.1lf operations/sec\n",
+         (elapsed) ? (double)count * 1000000 / elapsed : 0);
+}
+
+bool run_scenario(SKY_SHARE *share) {
+  assert(share && share->scenario);
+
+  SKY_SCENARIO *scenario = share->scenario;
+  uint32_t nworkers = scenario->max_concurrency;
+  SKY_WORKER **workers;
+  bool rv = true;
+
+  if ((workers = calloc(nworkers, sizeof(*workers))) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+
+  /* open all connections up front so they are reused by every phase */
+  for (uint32_t i = 0; i < nworkers; i++) {
+    if ((workers[i] = sky_worker_new()) == NULL) {
+      report_error("out of memory");
+      rv = false;
+      break;
+    }
+
+    workers[i]->share = share;
+    workers[i]->unique_id = i + 1;
+    workers[i]->phase = SKY_NPHASES;
+    assign_targets(workers[i]);
+    drizzle_create(&workers[i]->database_handle);
+
+    if (!sky_worker_connect(workers[i])) {
+      drizzle_free(&workers[i]->database_handle);
+      sky_worker_free(workers[i]);
+      workers[i] = NULL;
+      rv = false;
+      break;
+    }
+  }
+
+  for (uint32_t i = 0; i < scenario->nphases && rv; i++) {
+    SKY_SCENARIO_PHASE *phase = &scenario->phases[i];
+
+    if (stop_requested())
+      break;
+
+    fprintf(stdout, "Scenario Phase: %s (%u connections)\n", phase->name,
+            phase->concurrency);
+
+    /* the exporter keeps the counts of the previous phase before they
+       are cleared for this one */
+    if (share->metrics)
+      metrics_publish(share->metrics, workers, nworkers);
+
+    if (!run_scenario_phase(share, workers, phase)) {
+      report_error("failed to run scenario phase");
+      rv = false;
+    }
+  }
+
+  /* phases that ran are reported even if a later one failed */
+  if (scenario->nphases > 0 && scenario->phases[0].elapsed > 0)
+    print_scenario_result(share, scenario);
+
+  if (share->metrics)
+    metrics_publish(share->metrics, NULL, 0);
+
+  for (uint32_t i = 0; i < nworkers; i++) {
+    if (workers[i] == NULL)
+      continue;
+    sky_worker_disconnect(workers[i]);
+    drizzle_free(&workers[i]->database_handle);
+    sky_worker_free(workers[i]);
+  }
+
+  free(workers);
+  return rv;
+}
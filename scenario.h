@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_SCENARIO_H__
+#define __SKYLOAD_SCENARIO_H__
+
+#include "skyload.h"
+
+#define SCENARIO_MAX_PHASES 64
+#define SCENARIO_NAME_SIZE  32
+#define SCENARIO_LABEL      "scenario-" /* prefix of the phase labels */
+
+/* Operations a scenario phase mixes */
+typedef enum {
+  SKY_OP_READ,            /* the next statement of the read file */
+  SKY_OP_INSERT,          /* a row generated from an INSERT template */
+  SKY_NOPS
+} sky_op;
+
+/* A phase of a scenario followed by its result once it has run */
+typedef struct _sky_scenario_phase {
+  char name[SCENARIO_NAME_SIZE];
+  uint32_t duration;      /* secs, 0 if only bounded by 'ops' */
+  uint64_t ops;           /* operations to run, 0 if only bounded in time */
+  uint32_t concurrency;
+  double rate;            /* operations/sec of all workers, 0 for no limit */
+  double rate_end;        /* rate reached by the end of the phase */
+  uint32_t mix[SKY_NOPS]; /* relative weight of every operation */
+  uint16_t table;         /* index of the table the INSERTs go to */
+  bool measure;           /* false for a warmup */
+  bool completed;
+  uint64_t elapsed;       /* usec */
+  uint64_t count[SKY_NOPS];
+  uint64_t errors;
+  double qps;
+  double mean;            /* usec */
+  uint64_t p50;
+  uint64_t p95;
+  uint64_t p99;
+} SKY_SCENARIO_PHASE;
+
+/* A scenario file broken down into its phases. The phases run one
+   after another on a pool of workers sized for the busiest of them,
+   whose connections are opened once and kept across the phases. */
+typedef struct _sky_scenario {
+  SKY_SCENARIO_PHASE phases[SCENARIO_MAX_PHASES];
+  uint32_t nphases;
+  uint32_t max_concurrency;
+  uint64_t next_key[SKY_MAX_TABLES]; /* first %seq value not handed out */
+} SKY_SCENARIO;
+
+/* reads a scenario file. every phase starts with a [name] line and
+   is followed by 'key = value' settings. see usage() for the keys.
+   the phases are checked against the read file and the tables of
+   the share. returns NULL on error */
+SKY_SCENARIO *load_scenario(SKY_SHARE *share, const char *path);
+void sky_scenario_free(SKY_SCENARIO *scenario);
+
+/* returns the name of an operation as used in scenario files */
+const char *operation_name(sky_op op);
+
+/* returns the target rate of the phase 'elapsed' usecs into it,
+   ramping linearly from 'rate' to 'rate_end' */
+double phase_rate(const SKY_SCENARIO_PHASE *phase, uint64_t elapsed);
+
+/* returns the operation that the given draw of a uniformly
+   distributed random number falls on, weighted by the mix */
+sky_op pick_operation(const SKY_SCENARIO_PHASE *phase, uint64_t draw);
+
+/* runs the phases of share->scenario in order and prints the result
+   of each of them. stops early if a phase fails or is interrupted */
+bool run_scenario(SKY_SHARE *share);
+
+#endif
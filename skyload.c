@@ -8,10 +8,24 @@
 
 #include "skyload.h"
 #include "generator.h"
+#include "replay.h"
+#include "sweep.h"
+#include "retry.h"
+#include "compare.h"
+#include "status.h"
+#include "pipeline.h"
+#include "think.h"
+#include "soak.h"
+#include "metrics.h"
+#include "scenario.h"
+#include "payload.h"
+#include "runs.h"
+#include "slowest.h"
+#include "trace.h"
+#include "resources.h"
 
-static bool create_skyload_database(SKY_SHARE *share) {
-  assert(share);
-
+/* Creates the test database and its tables on a single primary */
+static bool create_database_on(SKY_SHARE *share, SKY_TARGET *target) {
   drizzle_st drizzle;
   drizzle_con_st connection;
   drizzle_return_t ret;
@@ -19,20 +33,12 @@ static bool create_skyload_database(SKY_SHARE *share) {
 
   drizzle_create(&drizzle);
   
-  if (!sky_create_connection(share, &drizzle, &connection)) {
+  if (!sky_connect_target(share, target, &drizzle, &connection)) {
     report_error("failed to initialize connection");
     drizzle_free(&drizzle);
     return false;
   }
 
-  /* Attempt to drop the database just in case the database
-     still exists from the previous run. */
-  if (!drop_database(share)) {
-    report_error("failed to drop database");
-    drizzle_free(&drizzle);
-    return false;
-  }
-
   /* Now we actually create the database */
   drizzle_query_str(&connection, &result, SKY_DB_CREATE, &ret);
 
@@ -51,63 +57,294 @@ static bool create_skyload_database(SKY_SHARE *share) {
     return false;
   }
 
-  /* Create the test table */
-  if (share->create_query)
-    drizzle_query_str(&connection, &result, share->create_query, &ret);
+  /* Create the test tables in the order they were specified */
+  for (int i = 0; i < share->ntables; i++) {
+    if (!share->tables[i].create_query)
+      continue;
 
-  if (ret != DRIZZLE_RETURN_OK) {
-    report_error(drizzle_con_error(&connection));
-    drizzle_free(&drizzle);
-    return false;
+    drizzle_query_str(&connection, &result, share->tables[i].create_query,
+                      &ret);
+
+    if (ret != DRIZZLE_RETURN_OK) {
+      report_error(drizzle_con_error(&connection));
+      drizzle_free(&drizzle);
+      return false;
+    }
+    drizzle_result_free(&result);
   }
-  drizzle_result_free(&result);
 
   sky_close_connection(&connection);
   drizzle_free(&drizzle);
   return true;
 }
 
+static bool create_skyload_database(SKY_SHARE *share) {
+  assert(share);
+
+  /* Attempt to drop the database just in case the database
+     still exists from the previous run. */
+  if (!drop_database(share)) {
+    report_error("failed to drop database");
+    return false;
+  }
+
+  /* Every primary holds its own copy of the schema. Replicas are
+     expected to receive it through replication */
+  for (uint16_t i = 0; i < share->nprimaries; i++) {
+    if (!create_database_on(share, &share->targets[i]))
+      return false;
+  }
+  return true;
+}
+
+/* Runs a transaction control statement such as BEGIN or COMMIT and
+   adds the time it took to 'elapsed' if it's given */
+static sky_error_class run_txn_statement(SKY_WORKER *context,
+                                         drizzle_con_st *conn,
+                                         const char *query,
+                                         uint64_t *elapsed) {
+  return execute_query(context, conn, 0, query, strlen(query),
+                       SKY_EXEC_CONTROL, elapsed);
+}
+
+/* Rolls back a transaction that one of its statements failed in.
+   Returns true if the transaction should be run again from its first
+   statement, false once it has been attempted --max-retries times */
+static bool rollback_txn(SKY_WORKER *context, drizzle_con_st *conn,
+                         uint32_t *attempts) {
+  SKY_SHARE *share = context->share;
+
+  /* nothing the transaction ran counts, whether it's run again or not */
+  txn_discard(context);
+
+  /* the server may have rolled back already, e.g. on a deadlock */
+  run_txn_statement(context, conn, SKY_TXN_ROLLBACK, NULL);
+
+  if (*attempts >= share->max_retries) {
+    *attempts = 0;
+    return false;
+  }
+
+  context->retries++;
+  record_interval(context, 0, 0, 1);
+  sleep_usec(retry_backoff(share->retry_backoff, (*attempts)++));
+  return true;
+}
+
+/* Adds a row that made it into the table to the INSERT figures */
+static void account_insert(SKY_WORKER *context, uint64_t elapsed,
+                           uint64_t bytes) {
+  context->total_insert_time += elapsed;
+  sky_histogram_add(&context->insert_latency, elapsed);
+  context->rows_inserted++;
+  context->insert_bytes += bytes;
+}
+
+/* Adds an UPDATE or DELETE that took effect to the write figures */
+static void account_write(SKY_WORKER *context, sky_write kind,
+                          uint64_t elapsed, uint64_t rows) {
+  sky_histogram_add(&context->write_latency, elapsed);
+  sky_histogram_add(&context->write_kind_latency[kind], elapsed);
+  context->write_rows[kind] += rows;
+}
+
+/* Adds a statement of the read file to the read figures */
+static void account_read(SKY_WORKER *context, uint32_t fingerprint,
+                         uint64_t elapsed) {
+  context->file_benchmark_time += elapsed;
+  sky_histogram_add(&context->read_latency, elapsed);
+
+  if (context->query_latency)
+    sky_histogram_add(&context->query_latency[fingerprint], elapsed);
+}
+
+/* Whether the given statement read from a file ends a transaction */
+static bool is_commit_statement(const char *query) {
+  while (*query == ' ' || *query == '\t')
+    query++;
+  return (strncasecmp(query, "commit", 6) == 0);
+}
+
+/* Queues a generated INSERT with --pipeline. The batch is sent once
+   it's full or the last row of the table has been queued */
+static sky_error_class pipeline_insert(SKY_WORKER *context,
+                                       const char *query, size_t length,
+                                       bool last) {
+  SKY_PIPELINE *pipeline = context->pipeline;
+  sky_error_class error;
+  uint64_t elapsed = 0;
+
+  if (!pipeline_add(pipeline, query, length, NULL)) {
+    fprintf(stderr, "thread[%d] error: out of memory\n", context->unique_id);
+    return SKY_ERROR_FATAL;
+  }
+
+  if (!pipeline_full(pipeline) && !last)
+    return SKY_ERROR_NONE;
+
+  /* the round trips are accounted rather than the latency of every
+     statement, which overlaps with the others in the batch */
+  error = pipeline_flush(context, &context->connection,
+                         context->target_index, pipeline, SKY_EXEC_RETRY,
+                         &elapsed);
+  context->total_insert_time += elapsed;
+
+  for (uint32_t i = 0; i < pipeline->count; i++) {
+    if (pipeline->entries[i].done) {
+      sky_histogram_add(&context->insert_latency,
+                        pipeline->entries[i].latency);
+      context->rows_inserted++;
+      context->insert_bytes += pipeline_statement_length(pipeline, i);
+    }
+  }
+
+  pipeline_reset(pipeline);
+  return error;
+}
+
 static bool insert_benchmark(SKY_WORKER *context) {
   assert(context);
 
-  struct timeval start_time;
-  struct timeval end_time;
-  char query_buf[SKY_STRSIZ];
-  drizzle_result_st result;
-  drizzle_return_t ret;
+  char *query_buf;
+  uint64_t seq_snapshot[SKY_MAX_COLS];
+  uint32_t txn_attempts = 0;
+  sky_error_class error;
+  SKY_PIECES pieces;
 
-  uint32_t nwrite = rows_to_write(context);
-  if (context->unique_id == 1)
-    fprintf(stdout, "Skyload Worker[0] INSERT Progress:\n");
+  uint64_t nwrite = rows_to_write(context);
+  uint32_t txn_size = context->share->txn_size;
+  size_t query_size = insert_query_size(context->table);
+  uint64_t begin_time = current_usec();
+  uint64_t insert_time = context->total_insert_time;
+  int table_index = context->table - context->share->tables;
 
-  for (int i = 0; i < nwrite; i++) {
-    size_t qlen = next_insert_query(context, query_buf, SKY_STRSIZ);
+  /* large payloads are sent from the payload source as they are,
+     which a batch of statements can't do */
+  bool in_pieces = (context->table->payload_size > 0 && !context->pipeline);
 
-    if (qlen <= 0) {
-      fprintf(stderr, "thread[%d] invalid INSERT template\n",
-              context->unique_id);
-      sky_close_connection(&context->connection);      
-      context->aborted = true;
-      return NULL;
+  /* statements in a transaction are retried with the transaction */
+  int options = (txn_size > 0) ? SKY_EXEC_NONE : SKY_EXEC_RETRY;
+
+  context->op_start = begin_time;
+
+  /* every table hands out its %seq values from the beginning */
+  for (int j = 0; j < SKY_MAX_COLS; j++)
+    context->current_seq_id[j] = context->unique_id;
+
+  if (context->unique_id == 1) {
+    if (context->share->ntables > 1)
+      fprintf(stdout, "Skyload Worker[0] INSERT Progress (table %d):\n",
+              table_index + 1);
+    else
+      fprintf(stdout, "Skyload Worker[0] INSERT Progress:\n");
+  }
+
+  for (uint64_t i = 0; i < nwrite; i++) {
+    bool txn_end = (txn_size > 0 &&
+                    ((i + 1) % txn_size == 0 || i == nwrite - 1));
+    error = SKY_ERROR_NONE;
+
+    /* a stop only takes effect between transactions and batches */
+    if ((txn_size == 0 || (i % txn_size) == 0) &&
+        (!context->pipeline || context->pipeline->count == 0) &&
+        stop_requested())
+      break;
+
+    /* group every 'txn_size' INSERTs into a single transaction. the
+       keys are remembered so that a rerun generates the same rows */
+    if (txn_size > 0 && (i % txn_size) == 0) {
+      memcpy(seq_snapshot, context->current_seq_id, sizeof(seq_snapshot));
+      txn_begin(context);
+      error = run_txn_statement(context, &context->connection,
+                                SKY_TXN_BEGIN, NULL);
     }
 
-    /* Attempt to insert the generated INSERT query */
-    gettimeofday(&start_time, NULL);
-    drizzle_query_str(&context->connection, &result, query_buf, &ret);
+    if (error == SKY_ERROR_NONE) {
+      /* the query lives in the arena until the next one is made */
+      arena_reset(&context->arena);
 
-    if (ret != DRIZZLE_RETURN_OK) {
-      fprintf(stderr, "thread[%d] error: %s\n",
-              context->unique_id, drizzle_con_error(&context->connection));
+      if ((query_buf = arena_alloc(&context->arena, query_size)) == NULL) {
+        fprintf(stderr, "thread[%d] error: out of memory\n",
+                context->unique_id);
+        sky_worker_disconnect(context);
+        context->aborted = true;
+        return false;
+      }
+
+      size_t qlen = (in_pieces) ?
+                    next_insert_pieces(context, query_buf, query_size,
+                                       &pieces) :
+                    next_insert_query(context, query_buf, query_size);
+
+      if (qlen <= 0) {
+        fprintf(stderr, "thread[%d] invalid INSERT template\n",
+                context->unique_id);
+        sky_worker_disconnect(context);
+        context->aborted = true;
+        return NULL;
+      }
+
+      if (context->pipeline) {
+        error = pipeline_insert(context, query_buf, qlen, i == nwrite - 1);
+      } else {
+        /* rows are sent to the primary owning their key if requested */
+        uint16_t target = context->target_index;
+        drizzle_con_st *conn = &context->connection;
+
+        if (context->shard_connections) {
+          target = route_key(context->share, context->row_key);
+          conn = &context->shard_connections[target];
+        }
+
+        /* Attempt to insert the generated INSERT query. The time it
+           took is accumulated for later aggregation by the main thread */
+        uint64_t elapsed = 0;
+
+        if (in_pieces)
+          error = execute_pieces(context, conn, target, pieces.piece,
+                                 pieces.count, options, &elapsed);
+        else
+          error = execute_query(context, conn, target, query_buf, qlen,
+                                options, &elapsed);
+
+        /* the rows of a transaction count once it has committed */
+        if (error == SKY_ERROR_NONE && txn_size == 0)
+          account_insert(context, elapsed, qlen);
+      }
+    }
+
+    /* COMMIT latency is accounted separately from the INSERTs */
+    if (error == SKY_ERROR_NONE && txn_end) {
+      error = run_txn_statement(context, &context->connection,
+                                SKY_TXN_COMMIT, &context->insert_commit_time);
+      if (error == SKY_ERROR_NONE) {
+        for (uint32_t j = 0; j < context->txn_count; j++)
+          account_insert(context, context->txn_log[j].latency,
+                         context->txn_log[j].bytes);
+        txn_commit(context);
+        context->insert_commits++;
+        txn_attempts = 0;
+      }
+    }
+
+    if (error == SKY_ERROR_FATAL) {
       context->aborted = true;
-      sky_close_connection(&context->connection);
-      return NULL;
+      sky_worker_disconnect(context);
+      return false;
     }
-    drizzle_result_free(&result);
 
-    /* accumulate the time it took to execute this query for later
-       aggregation by the main thread */
-    gettimeofday(&end_time, NULL);
-    context->total_insert_time += timediff(end_time, start_time);
+    /* a failed transaction is run again from its first row. once it
+       has failed too often, its remaining rows are skipped */
+    if (error != SKY_ERROR_NONE && txn_size > 0) {
+      if (rollback_txn(context, &context->connection, &txn_attempts)) {
+        memcpy(context->current_seq_id, seq_snapshot, sizeof(seq_snapshot));
+        i -= i % txn_size + 1;
+        continue;
+      }
+
+      while (!((i + 1) % txn_size == 0 || i == nwrite - 1))
+        i++;
+    }
 
     /* Print the progress of the first worker thread so we can give
        some feedback to the user. Progress feedback for all worker
@@ -122,107 +359,574 @@ static bool insert_benchmark(SKY_WORKER *context) {
         }
       }
       if (((i + 1) % 1000) == 0 || i == nwrite-1)
-        fprintf(stdout, " (%d)\n", i + 1);
+        fprintf(stdout, " (%llu)\n", (unsigned long long)(i + 1));
     }
+
+    /* the user thinks before the next row or transaction */
+    if (context->share->timer_wheel && (txn_size == 0 || txn_end) &&
+        i < nwrite - 1)
+      session_pause(context);
   }
+  context->insert_elapsed += current_usec() - begin_time;
+  context->table_insert_time[table_index] +=
+    context->total_insert_time - insert_time;
   return true;
 }
 
-static bool sql_file_benchmark(SKY_WORKER *context) {
-  assert(context && context->share->read_queries);
+/* Picks the table and the kind of the next UPDATE or DELETE among
+   the templates given, each as likely as the others */
+static SKY_TABLE *pick_write(SKY_SHARE *share, sky_write *kind) {
+  int ntemplates = 0, pick;
 
-  SKY_LIST_NODE *current = context->share->read_queries->head;
-  struct timeval start_time;
-  struct timeval end_time;
-  drizzle_result_st result;
-  drizzle_return_t ret;
+  for (int i = 0; i < share->ntables; i++) {
+    for (int j = 0; j < SKY_NWRITES; j++)
+      ntemplates += (share->tables[i].write_tmpl[j] != NULL);
+  }
 
-  for (int i = 0; i < context->share->read_queries->size; i++) {
-    gettimeofday(&start_time, NULL);
-    drizzle_query_str(&context->connection, &result, current->data, &ret);
+  pick = random() % ntemplates;
 
-    if (ret != DRIZZLE_RETURN_OK) {
-      fprintf(stderr, "thread[%d] error: %s\n",
-              context->unique_id, drizzle_con_error(&context->connection));
+  for (int i = 0; i < share->ntables; i++) {
+    for (int j = 0; j < SKY_NWRITES; j++) {
+      if (share->tables[i].write_tmpl[j] == NULL || pick-- > 0)
+        continue;
+      *kind = j;
+      return &share->tables[i];
+    }
+  }
+  return NULL;
+}
+
+/* Runs this worker's share of the --writes UPDATEs and DELETEs over
+   the rows populated before */
+static bool write_benchmark(SKY_WORKER *context) {
+  assert(context);
+
+  SKY_SHARE *share = context->share;
+  uint32_t txn_attempts = 0;
+  sky_error_class error;
+
+  uint64_t nwrite = share->writes / share->concurrency;
+  uint32_t txn_size = share->txn_size;
+  uint64_t begin_time = current_usec();
+
+  /* statements in a transaction are retried with the transaction */
+  int options = (txn_size > 0) ? SKY_EXEC_NONE : SKY_EXEC_RETRY;
+
+  if (context->unique_id == share->concurrency)
+    nwrite += share->writes % share->concurrency;
+
+  context->op_start = begin_time;
+
+  for (uint64_t i = 0; i < nwrite; i++) {
+    bool txn_end = (txn_size > 0 &&
+                    ((i + 1) % txn_size == 0 || i == nwrite - 1));
+    sky_write kind = SKY_WRITE_UPDATE;
+    SKY_TABLE *table = pick_write(share, &kind);
+    size_t query_size = write_query_size(table, kind);
+    char *query_buf;
+    error = SKY_ERROR_NONE;
+
+    /* a stop only takes effect between transactions */
+    if ((txn_size == 0 || (i % txn_size) == 0) && stop_requested())
+      break;
+
+    /* a rerun of a failed transaction draws new keys */
+    if (txn_size > 0 && (i % txn_size) == 0) {
+      txn_begin(context);
+      error = run_txn_statement(context, &context->connection,
+                                SKY_TXN_BEGIN, NULL);
+    }
+
+    if (error == SKY_ERROR_NONE) {
+      arena_reset(&context->arena);
+
+      if ((query_buf = arena_alloc(&context->arena, query_size)) == NULL) {
+        fprintf(stderr, "thread[%d] error: out of memory\n",
+                context->unique_id);
+        sky_worker_disconnect(context);
+        context->aborted = true;
+        return false;
+      }
+
+      size_t qlen = next_write_query(context, table, kind, query_buf,
+                                     query_size);
+
+      if (qlen == 0) {
+        fprintf(stderr, "thread[%d] invalid %s template\n",
+                context->unique_id,
+                (kind == SKY_WRITE_UPDATE) ? "UPDATE" : "DELETE");
+        sky_worker_disconnect(context);
+        context->aborted = true;
+        return false;
+      }
+
+      /* a row is changed on the primary it was inserted into */
+      uint16_t target = context->target_index;
+      drizzle_con_st *conn = &context->connection;
+
+      if (context->shard_connections) {
+        target = route_key(share, context->row_key);
+        conn = &context->shard_connections[target];
+      }
+
+      uint64_t elapsed = 0;
+      error = execute_query(context, conn, target, query_buf, qlen,
+                            options, &elapsed);
+
+      /* the writes of a transaction count once it has committed */
+      if (error == SKY_ERROR_NONE && txn_size == 0)
+        account_write(context, kind, elapsed, context->affected_rows);
+      else if (error == SKY_ERROR_NONE)
+        txn_tag(context, kind);
+    }
+
+    if (error == SKY_ERROR_NONE && txn_end) {
+      error = run_txn_statement(context, &context->connection,
+                                SKY_TXN_COMMIT, NULL);
+      if (error == SKY_ERROR_NONE) {
+        for (uint32_t j = 0; j < context->txn_count; j++)
+          account_write(context, context->txn_log[j].tag,
+                        context->txn_log[j].latency,
+                        context->txn_log[j].rows);
+        txn_commit(context);
+        txn_attempts = 0;
+      }
+    }
+
+    if (error == SKY_ERROR_FATAL) {
       context->aborted = true;
-      sky_close_connection(&context->connection);
+      sky_worker_disconnect(context);
       return false;
     }
 
-    ret = drizzle_result_buffer(&result);
+    if (error != SKY_ERROR_NONE && txn_size > 0) {
+      if (rollback_txn(context, &context->connection, &txn_attempts)) {
+        i -= i % txn_size + 1;
+        continue;
+      }
 
-    if (ret != DRIZZLE_RETURN_OK) {
-      fprintf(stderr, "thread[%d] error: %s\n",
-              context->unique_id, drizzle_con_error(&context->connection));
+      while (!((i + 1) % txn_size == 0 || i == nwrite - 1))
+        i++;
+    }
+
+    /* the user thinks before the next statement or transaction */
+    if (share->timer_wheel && (txn_size == 0 || txn_end) && i < nwrite - 1)
+      session_pause(context);
+  }
+  context->write_elapsed += current_usec() - begin_time;
+  return true;
+}
+
+/* Accounts for a run of the read file. A run cut short by a stop
+   doesn't count and a soak test doesn't keep track of its runs */
+static bool end_file_run(SKY_WORKER *context, uint64_t begin_time,
+                         uint64_t queries, uint64_t latency, bool stopped) {
+  uint64_t elapsed = current_usec() - begin_time;
+
+  context->file_elapsed += elapsed;
+
+  if (stopped)
+    return true;
+
+  context->file_runs++;
+
+  if (!context->share->soak &&
+      !record_run(context, elapsed, context->read_latency.count - queries,
+                  context->read_latency.sum - latency)) {
+    fprintf(stderr, "thread[%d] error: out of memory\n", context->unique_id);
+    context->aborted = true;
+    sky_worker_disconnect(context);
+    return false;
+  }
+  return true;
+}
+
+/* Runs the read file with --pipeline. Transactions can't be combined
+   with it, so every statement stands on its own */
+static bool pipeline_sql_file(SKY_WORKER *context) {
+  SKY_PIPELINE *pipeline = context->pipeline;
+  SKY_LIST *queries = context->share->read_queries;
+  uint64_t begin_time = current_usec();
+  uint64_t queries_before = context->read_latency.count;
+  uint64_t latency_before = context->read_latency.sum;
+  bool stopped = false;
+
+  for (size_t i = 0; i < queries->size; i++) {
+    SKY_LIST_NODE *current = queries->nodes[context->read_order[i]];
+
+    /* a stop only takes effect between batches */
+    if (pipeline->count == 0 && stop_requested()) {
+      stopped = true;
+      break;
+    }
+
+    if (!pipeline_add(pipeline, current->data, current->length, current)) {
+      fprintf(stderr, "thread[%d] error: out of memory\n",
+              context->unique_id);
       context->aborted = true;
-      sky_close_connection(&context->connection);
+      sky_worker_disconnect(context);
       return false;
     }
 
-    drizzle_result_free(&result);
-    gettimeofday(&end_time, NULL);
-    context->file_benchmark_time += timediff(end_time, start_time);
+    if (!pipeline_full(pipeline) && i < queries->size - 1)
+      continue;
+
+    uint64_t elapsed = 0;
+    sky_error_class error = pipeline_flush(context, context->read_connection,
+                                           context->read_target_index,
+                                           pipeline, SKY_EXEC_RETRY,
+                                           &elapsed);
+    context->file_benchmark_time += elapsed;
+
+    for (uint32_t i = 0; i < pipeline->count; i++) {
+      SKY_PIPELINE_ENTRY *entry = &pipeline->entries[i];
+      const SKY_LIST_NODE *node = entry->tag;
+
+      if (!entry->done)
+        continue;
+
+      if (is_commit_statement(node->data)) {
+        context->file_commit_time += entry->latency;
+        context->file_commits++;
+      } else {
+        sky_histogram_add(&context->read_latency, entry->latency);
+      }
+
+      if (context->query_latency)
+        sky_histogram_add(&context->query_latency[node->fingerprint],
+                          entry->latency);
+    }
+    pipeline_reset(pipeline);
+
+    if (error == SKY_ERROR_FATAL) {
+      context->aborted = true;
+      sky_worker_disconnect(context);
+      return false;
+    }
+  }
+  return end_file_run(context, begin_time, queries_before, latency_before,
+                      stopped);
+}
+
+/* Runs the read file unmeasured for --run-warmup seconds */
+static bool warmup_read_load(SKY_WORKER *context) {
+  SKY_LIST *queries = context->share->read_queries;
+  uint64_t end_time = current_usec() +
+                      (uint64_t)context->share->run_warmup * 1000000;
+  size_t i = 0;
+
+  while (current_usec() < end_time && !stop_requested()) {
+    if (i == 0 && !plan_read_order(context)) {
+      fprintf(stderr, "thread[%d] error: out of memory\n",
+              context->unique_id);
+      context->aborted = true;
+      sky_worker_disconnect(context);
+      return false;
+    }
 
-    current = current->next;
+    SKY_LIST_NODE *current = queries->nodes[context->read_order[i]];
+    sky_error_class error = execute_query(context, context->read_connection,
+                                          context->read_target_index,
+                                          current->data, current->length,
+                                          SKY_EXEC_BUFFER | SKY_EXEC_RETRY |
+                                          SKY_EXEC_UNMEASURED, NULL);
+
+    if (error == SKY_ERROR_FATAL) {
+      context->aborted = true;
+      sky_worker_disconnect(context);
+      return false;
+    }
+
+    i = (i + 1) % queries->size;
   }
   return true;
 }
 
+static bool sql_file_benchmark(SKY_WORKER *context) {
+  assert(context && context->share->read_queries);
+
+  /* the statements of this run in the order of --read-order */
+  if (!plan_read_order(context)) {
+    fprintf(stderr, "thread[%d] error: out of memory\n", context->unique_id);
+    context->aborted = true;
+    sky_worker_disconnect(context);
+    return false;
+  }
+
+  if (context->pipeline)
+    return pipeline_sql_file(context);
+
+  SKY_LIST *queries = context->share->read_queries;
+  SKY_LIST_NODE *current;
+  drizzle_con_st *conn = context->read_connection;
+  uint16_t target = context->read_target_index;
+  uint32_t txn_attempts = 0;
+  sky_error_class error;
+
+  size_t nqueries = context->share->read_queries->size;
+  uint32_t txn_size = context->share->txn_size;
+  uint64_t begin_time = current_usec();
+  uint64_t queries_before = context->read_latency.count;
+  uint64_t latency_before = context->read_latency.sum;
+  bool stopped = false;
+
+  context->op_start = begin_time;
+
+  /* statements in a transaction are retried with the transaction */
+  int options = SKY_EXEC_BUFFER;
+  if (txn_size == 0)
+    options |= SKY_EXEC_RETRY;
+
+  for (int i = 0; i < nqueries; i++) {
+    bool txn_end = (txn_size > 0 &&
+                    ((i + 1) % txn_size == 0 || i == nqueries - 1));
+    error = SKY_ERROR_NONE;
+    current = queries->nodes[context->read_order[i]];
+
+    /* a stop only takes effect between transactions */
+    if ((txn_size == 0 || (i % txn_size) == 0) && stop_requested()) {
+      stopped = true;
+      break;
+    }
+
+    /* group every 'txn_size' statements into a single transaction */
+    if (txn_size > 0 && (i % txn_size) == 0) {
+      txn_begin(context);
+      error = run_txn_statement(context, conn, SKY_TXN_BEGIN, NULL);
+    }
+
+    /* explicit transactions in the file end with their own COMMIT */
+    bool commit = (txn_size == 0 && is_commit_statement(current->data));
+
+    if (error == SKY_ERROR_NONE) {
+      uint64_t elapsed = 0;
+      error = execute_query(context, conn, target, current->data,
+                            current->length, options, &elapsed);
+
+      /* the statements of a transaction count once it has committed */
+      if (error == SKY_ERROR_NONE && txn_size > 0) {
+        txn_tag(context, current->fingerprint);
+      } else if (error == SKY_ERROR_NONE && commit) {
+        context->file_commit_time += elapsed;
+        context->file_commits++;
+
+        if (context->query_latency)
+          sky_histogram_add(&context->query_latency[current->fingerprint],
+                            elapsed);
+      } else if (error == SKY_ERROR_NONE) {
+        account_read(context, current->fingerprint, elapsed);
+      }
+    }
+
+    if (error == SKY_ERROR_NONE && txn_end) {
+      error = run_txn_statement(context, conn, SKY_TXN_COMMIT,
+                                &context->file_commit_time);
+      if (error == SKY_ERROR_NONE) {
+        for (uint32_t j = 0; j < context->txn_count; j++)
+          account_read(context, context->txn_log[j].tag,
+                       context->txn_log[j].latency);
+        txn_commit(context);
+        context->file_commits++;
+        txn_attempts = 0;
+      }
+    }
+
+    if (error == SKY_ERROR_FATAL) {
+      context->aborted = true;
+      sky_worker_disconnect(context);
+      return false;
+    }
+
+    /* a failed transaction is run again from its first statement.
+       once it has failed too often, its remaining statements are
+       skipped */
+    if (error != SKY_ERROR_NONE && txn_size > 0) {
+      if (rollback_txn(context, conn, &txn_attempts)) {
+        i -= i % txn_size + 1;
+        continue;
+      }
+
+      while (!((i + 1) % txn_size == 0 || i == nqueries - 1))
+        i++;
+    }
+
+    /* the user thinks before the next statement or transaction */
+    if (context->share->timer_wheel && (txn_size == 0 || txn_end) &&
+        i < nqueries - 1)
+      session_pause(context);
+  }
+  return end_file_run(context, begin_time, queries_before, latency_before,
+                      stopped);
+}
+
+/* Terminates a worker that failed before populating the tables. The
+   barriers between the tables must still be passed or the other
+   workers would wait for this worker forever */
+static void abandon_workload(SKY_WORKER *context) {
+  context->aborted = true;
+  worker_rusage_end(context);
+  status_end_phase(context, SKY_NPHASES - 1);
+
+  if (has_insert_template(context->share) && context->share->ntables > 1) {
+    for (int i = 0; i < context->share->ntables; i++)
+      pthread_barrier_wait(&context->share->table_barrier);
+  }
+  pthread_exit(NULL);
+}
+
+/* Terminates a worker that can't go on. The phases it didn't get to
+   still count as finished for the server status sampler */
+static void finish_workload(SKY_WORKER *context) {
+  status_end_phase(context, SKY_NPHASES - 1);
+  worker_rusage_end(context);
+  sky_pipeline_free(context->pipeline);
+  context->pipeline = NULL;
+  pthread_exit(NULL);
+}
+
 void *workload(void *arg) {
   assert(arg);
 
   SKY_WORKER *context = (SKY_WORKER *)arg;
 
-  /* Initialize worker specific connection */
-  if (!sky_create_connection(context->share, &context->database_handle,
-                             &context->connection)) {
-    report_error("failed to initialize connection");
-    context->aborted = true;
+  /* The CPU time of the thread is accounted from here on */
+  worker_rusage_begin(context);
+
+  /* Initialize worker specific connections on the test database */
+  if (!sky_worker_connect(context)) {
     drizzle_free(&context->database_handle);
-    pthread_exit(NULL);
+    abandon_workload(context);
   }
 
-  /* Switch to the test database */
-  if (!switch_database(context->share, &context->connection)) {
-    report_error(drizzle_con_error(&context->connection));
-    context->aborted = true;
-    drizzle_free(&context->database_handle);
-    pthread_exit(NULL);
+  /* Statements are batched into a round trip each with --pipeline */
+  if (context->share->pipeline_depth > 1) {
+    context->pipeline = sky_pipeline_new(context->share->pipeline_depth);
+
+    if (context->pipeline == NULL) {
+      fprintf(stderr, "thread[%d] error: out of memory\n",
+              context->unique_id);
+      sky_worker_disconnect(context);
+      abandon_workload(context);
+    }
   }
 
-  /* Perform insertion benchmark if speficified */
-  if (context->share->insert_tmpl && context->share->nwrite > 0) {
-    if (!insert_benchmark(context))
-      pthread_exit(NULL);
+  /* Perform insertion benchmark if speficified. The tables are
+     populated one after another, each one by all workers in parallel.
+     Workers wait for each other between tables so that the rows
+     referenced with %ref exist by the time they are referenced */
+  if (has_insert_template(context->share)) {
+    for (int i = 0; i < context->share->ntables; i++) {
+      context->table = &context->share->tables[i];
+
+      if (!context->aborted && context->table->insert_tmpl &&
+          context->table->nwrite > 0 && !stop_requested())
+        insert_benchmark(context);
+
+      if (context->share->ntables > 1)
+        pthread_barrier_wait(&context->share->table_barrier);
+    }
+
+    if (context->aborted)
+      finish_workload(context);
+
     if (context->unique_id == 1) {
       fprintf(stdout, "\n");
       fprintf(stdout, "Populating DB with auto generated data: Done\n");
     }
   }
+  status_end_phase(context, SKY_PHASE_INSERT);
+
+  /* Update and delete the rows populated above */
+  if (phase_enabled(context->share, SKY_PHASE_WRITE) && !stop_requested()) {
+    if (context->unique_id == 1)
+      fprintf(stdout, "Running UPDATE and DELETE Load: ");
+
+    if (!write_benchmark(context))
+      finish_workload(context);
 
-  /* Run benchmark based on the supplied SQL file */
-  if (context->share->read_queries && context->share->read_queries->size > 0) {
+    if (context->unique_id == 1)
+      fprintf(stdout, "Done\n");
+  }
+  status_end_phase(context, SKY_PHASE_WRITE);
+
+  /* Run benchmark based on the supplied SQL file. It's run by the
+     concurrency sweep, the search or the scenario instead when one
+     has been specified */
+  if (phase_enabled(context->share, SKY_PHASE_READ)) {
     if (context->unique_id == 1) {
       fprintf(stdout, "Emulating Read Load: ");
     }
 
-    for (int i = 0; i < context->share->runs; i++) {
+    /* a soak test goes on until it's stopped */
+    for (uint64_t i = 0; context->share->soak || i < context->share->runs;
+         i++) {
+      if (stop_requested())
+        break;
+      if (context->share->run_warmup > 0 && !warmup_read_load(context))
+        finish_workload(context);
       if (!sql_file_benchmark(context))
-        pthread_exit(NULL);
+        finish_workload(context);
     }
 
     if (context->unique_id == 1)
       fprintf(stdout, "Done\n");
   }
+  status_end_phase(context, SKY_PHASE_READ);
+
+  /* Replay the captured query log with its original timing */
+  if (context->share->replay && context->share->replay->size > 0) {
+    if (context->unique_id == 1)
+      fprintf(stdout, "Replaying Query Log: ");
+
+    if (!replay_benchmark(context))
+      finish_workload(context);
+
+    if (context->unique_id == 1)
+      fprintf(stdout, "Done\n");
+  }
+  status_end_phase(context, SKY_PHASE_REPLAY);
+  worker_rusage_end(context);
 
-  sky_close_connection(&context->connection);
+  sky_pipeline_free(context->pipeline);
+  context->pipeline = NULL;
+  sky_worker_disconnect(context);
   return NULL;
 }
 
+/* Writes the results for --json and compares them for --compare. A
+   regression is reported through 'exit_code' */
+static bool report_results(SKY_SHARE *share, SKY_WORKER **workers,
+                           int *exit_code) {
+  SKY_RESULT *result, *baseline;
+  bool rv = true;
+
+  if ((result = collect_results(workers)) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+
+  if (share->json_path && !write_result_file(share->json_path, result))
+    rv = false;
+
+  if (rv && share->compare_path) {
+    if ((baseline = load_result_file(share->compare_path)) == NULL) {
+      rv = false;
+    } else {
+      if (compare_results(share, baseline, result) > 0)
+        *exit_code = SKY_EXIT_REGRESSION;
+      sky_result_free(baseline);
+    }
+  }
+
+  sky_result_free(result);
+  return rv;
+}
+
 int main(int argc, char **argv) {
   SKY_SHARE *share;
   SKY_WORKER **workers;
   pthread_attr_t joinable;
+  int exit_code = EXIT_SUCCESS;
 
   if (argc == 1)
     usage();
@@ -253,12 +957,57 @@ int main(int argc, char **argv) {
       share->port = DRIZZLE_DEFAULT_PORT;
   }
 
+  /* Break the server lists down into individual targets */
+  if (!resolve_targets(share)) {
+    sky_share_free(share);
+    return EXIT_FAILURE;
+  }
+
   /* If provided, load the external SQL file to memory */
   if (!preload_sql_file(share)) {
     sky_share_free(share);
     return EXIT_FAILURE;
   }
 
+  /* Read queries are measured per fingerprint for --compare */
+  if (share->read_queries && (share->json_path || share->compare_path)) {
+    if (!build_fingerprints(share)) {
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* The phases of a scenario are checked before anything is loaded */
+  if (share->scenario_path) {
+    if ((share->scenario = load_scenario(share, share->scenario_path)) == NULL) {
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* The payloads of the generated rows are cut out of a single source */
+  for (int i = 0; i < share->ntables && share->payload == NULL; i++) {
+    if (share->tables[i].payload_size == 0)
+      continue;
+
+    if ((share->payload = sky_payload_new(share)) == NULL) {
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* Zipfian keys are drawn with constants computed once per table */
+  if (has_write_template(share))
+    prepare_key_dist(share);
+
+  /* If provided, parse the query log to be replayed */
+  if (share->replay_file_path) {
+    if ((share->replay = load_general_log(share->replay_file_path)) == NULL) {
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
   /* Create worker object(s) */
   if ((workers = create_workers(share)) == NULL) {
     report_error("out of memory");
@@ -281,6 +1030,67 @@ int main(int argc, char **argv) {
     }
   }
 
+  /* Workers synchronize between the tables they populate */
+  if (share->ntables > 1)
+    pthread_barrier_init(&share->table_barrier, NULL, share->concurrency);
+
+  /* SIGINT and SIGTERM end the load with a report from here on */
+  if (!install_stop_handler()) {
+    report_error("failed to install the signal handlers");
+    sky_share_free(share);
+    return EXIT_FAILURE;
+  }
+
+  /* Error rates are reported in intervals from this point on */
+  share->start_time = current_usec();
+  sample_rusage(&share->client_start, false);
+
+  /* Sample the server status on the side while the load runs */
+  if (share->status) {
+    if ((share->status_sampler = sky_status_new(share)) == NULL ||
+        !status_start(share->status_sampler)) {
+      sky_status_free(share->status_sampler);
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* A single timer wakes up the sessions between their operations */
+  if (share->think_model != SKY_THINK_NONE || share->pace > 0) {
+    if ((share->timer_wheel = sky_timer_wheel_new()) == NULL ||
+        !timer_wheel_start(share->timer_wheel)) {
+      sky_timer_wheel_free(share->timer_wheel);
+      sky_status_free(share->status_sampler);
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* A soak test is sampled on the side until it's stopped */
+  if (share->soak) {
+    if ((share->soak_sampler = sky_soak_new(share, workers)) == NULL ||
+        !soak_start(share->soak_sampler)) {
+      sky_soak_free(share->soak_sampler);
+      sky_timer_wheel_free(share->timer_wheel);
+      sky_status_free(share->status_sampler);
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* Live counters can be scraped while the workers run */
+  if (share->metrics_addr) {
+    if ((share->metrics = sky_metrics_new(share, workers)) == NULL ||
+        !metrics_start(share->metrics)) {
+      sky_metrics_free(share->metrics);
+      sky_soak_free(share->soak_sampler);
+      sky_timer_wheel_free(share->timer_wheel);
+      sky_status_free(share->status_sampler);
+      sky_share_free(share);
+      return EXIT_FAILURE;
+    }
+  }
+
   pthread_attr_init(&joinable);
   pthread_attr_setdetachstate(&joinable, PTHREAD_CREATE_JOINABLE);
 
@@ -303,9 +1113,77 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (share->ntables > 1)
+    pthread_barrier_destroy(&share->table_barrier);
+
+  if (share->soak_sampler)
+    soak_stop(share->soak_sampler);
+
   /* Aggregate and print the benchmark result held by all workers */ 
   aggregate_worker_result(workers);
 
+  /* Tell whether the client kept up with the server */
+  print_client_result(workers);
+
+  /* Show how much the runs of the read file differed */
+  if (share->read_queries && !share->sweep_levels && !share->scenario_path &&
+      share->search == SKY_SEARCH_NONE && !share->soak)
+    print_run_result(workers);
+
+  /* Show which statements were the slowest and when they ran */
+  if (share->slowest > 0)
+    print_slowest_result(workers);
+
+  if (share->soak_sampler) {
+    print_soak_result(share->soak_sampler);
+    if (share->soak_sampler->failed)
+      exit_code = EXIT_FAILURE;
+  }
+
+  if (share->timer_wheel) {
+    timer_wheel_stop(share->timer_wheel);
+    print_session_result(workers);
+  }
+
+  /* Step through the concurrency levels on the loaded database */
+  if (share->sweep_levels && share->read_queries) {
+    if (!run_concurrency_sweep(share))
+      exit_code = EXIT_FAILURE;
+  }
+
+  /* Search for the highest throughput that meets the latency target */
+  if (share->search != SKY_SEARCH_NONE && share->read_queries &&
+      !stop_requested()) {
+    if (!run_slo_search(share))
+      exit_code = EXIT_FAILURE;
+  }
+
+  /* Run the phases of the scenario on the populated database */
+  if (share->scenario && !stop_requested()) {
+    if (!run_scenario(share))
+      exit_code = EXIT_FAILURE;
+  }
+
+  /* Keep serving the metrics until the later runs are done */
+  if (share->metrics)
+    metrics_stop(share->metrics);
+
+  /* Put the server side counters next to the client side figures */
+  if (share->status_sampler) {
+    status_stop(share->status_sampler);
+    print_status_result(share->status_sampler, workers);
+  }
+
+  /* Lay the statements out on a timeline for chrome://tracing */
+  if (share->trace_path && !write_trace(share->trace_path, workers))
+    exit_code = EXIT_FAILURE;
+
+  /* Save the results and check them against the baseline */
+  if (share->json_path || share->compare_path) {
+    if (!report_results(share, workers, &exit_code))
+      exit_code = EXIT_FAILURE;
+  }
+
   /* skyload is done, drop the database unless we're specified not
      to or if we're using an existing database */
   if (!share->keep_db && !share->database_name) {
@@ -317,8 +1195,22 @@ int main(int argc, char **argv) {
     sky_list_free(share->read_queries);
   if (share->load_queries != NULL)
     sky_list_free(share->load_queries);
+  if (share->replay != NULL)
+    sky_replay_free(share->replay);
+  if (share->status_sampler != NULL)
+    sky_status_free(share->status_sampler);
+  if (share->timer_wheel != NULL)
+    sky_timer_wheel_free(share->timer_wheel);
+  if (share->soak_sampler != NULL)
+    sky_soak_free(share->soak_sampler);
+  if (share->metrics != NULL)
+    sky_metrics_free(share->metrics);
+  if (share->scenario != NULL)
+    sky_scenario_free(share->scenario);
+  if (share->payload != NULL)
+    sky_payload_free(share->payload);
 
   destroy_workers(workers);
   sky_share_free(share);
-  return EXIT_SUCCESS;
+  return exit_code;
 }
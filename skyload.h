@@ -14,15 +14,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
 #include <getopt.h>
 #include <assert.h>
 #include <sys/time.h> 
+#include <signal.h>
 
 #include <libdrizzle/drizzle_client.h>
 
+#include "stats.h"
+
 #define DRIZZLE_DEFAULT_PORT 4427
 #define MYSQL_DEFAULT_PORT 3306
 
@@ -30,17 +34,53 @@
 #define SKY_DB_CREATE "CREATE DATABASE skyload"
 #define SKY_DB_DROP   "DROP DATABASE IF EXISTS skyload"
 
+#define SKY_TXN_BEGIN  "BEGIN"
+#define SKY_TXN_COMMIT "COMMIT"
+#define SKY_TXN_ROLLBACK "ROLLBACK"
+
 #define SKY_PLACEHOLDER_SYM '%'
 
 #define SKY_STRSIZ    1024
 #define SKY_MAX_COLS  128
+#define SKY_MAX_TABLES 16
+#define SKY_MAX_TARGETS 32
 #define SKY_RAND_SEED 149
+
+#define SKY_SWEEP_TIME   10 /* secs measured at each sweep level */
+#define SKY_SWEEP_WARMUP 2  /* secs of warmup at each sweep level */
+#define SKY_SLO_PERCENTILE 99.0 /* of --slo when only a latency is given */
+
+#define SKY_MAX_RETRIES     3  /* attempts to repeat a failed statement */
+#define SKY_RETRY_BACKOFF   10 /* msecs to wait before the first retry */
+#define SKY_REPORT_INTERVAL 1  /* secs per error rate interval */
+
+#define SKY_TOLERANCE   5.0 /* percent of change tolerated by --compare */
+#define SKY_NOISE_FLOOR 100 /* usecs of latency change considered noise */
+#define SKY_NOISE_Z     3.0 /* z-score a mean latency change must exceed */
+
+#define SKY_ARENA_SIZE   65536 /* bytes of an arena chunk */
+#define SKY_ARENA_ALIGN  8
+
+#define SKY_SOAK_INTERVAL 60 /* secs per interval with --soak */
+#define SKY_SOAK_ROTATE   64 /* MB written to a soak file before rotating */
+#define SKY_SOAK_KEEP     8  /* rotated soak files kept around */
+
+#define SKY_PAYLOAD_SIZE 8192 /* bytes of a %payload value */
+#define SKY_ZIPF_THETA   0.99 /* skew of --key-dist=zipfian */
+
+#define SKY_METRICS_HOST "127.0.0.1" /* --metrics address without a host */
+
+#define SKY_MAX_PIPELINE 1024 /* statements in flight per connection */
+#define SKY_MAX_SLOWEST  10000 /* statements --slowest reports at most */
+#define SKY_MULTI_STATEMENTS_ON 0 /* MYSQL_OPTION_MULTI_STATEMENTS_ON */
  
 /* Structure to represent a node for a singly linked query list */
 typedef struct _sky_node {
   struct _sky_node *next;
   char *data;
   size_t length;
+  uint32_t fingerprint;   /* index of the normalized form of the query */
+  uint32_t weight;        /* relative frequency with --read-order=weighted */
 } SKY_LIST_NODE;
 
 /* Structure to represent a singly linked list used to represent
@@ -50,41 +90,325 @@ typedef struct {
   SKY_LIST_NODE *head;
   SKY_LIST_NODE *tail;
   size_t size;
+  SKY_LIST_NODE **nodes;  /* the nodes in order, once indexed */
+  uint64_t *cumulative;   /* running total of the weights, once indexed */
 } SKY_LIST;
 
+/* A chunk of memory handed out by an arena */
+typedef struct _sky_arena_chunk {
+  struct _sky_arena_chunk *next;
+  size_t size;
+  size_t used;
+  char data[];
+} SKY_ARENA_CHUNK;
+
+/* Bump allocator for the short lived buffers of a worker such as
+   the generated queries and the rows of a result. Everything is
+   released at once by resetting the arena, which keeps its chunks
+   for reuse, so that the heap is left alone once the chunks cover
+   the largest query and row of the workload. Not thread-safe. */
+typedef struct {
+  SKY_ARENA_CHUNK *head;
+  SKY_ARENA_CHUNK *current; /* chunk allocations are made from */
+  uint64_t chunks;          /* chunks taken from the heap */
+} SKY_ARENA;
+
+/* Position in an arena to rewind to */
+typedef struct {
+  SKY_ARENA_CHUNK *chunk;
+  size_t used;
+} SKY_ARENA_MARK;
+
+/* Resources used by a thread or the whole client up to some point */
+typedef struct {
+  uint64_t wall;          /* usec timestamp */
+  uint64_t cpu;           /* usec of user and system time */
+  uint64_t voluntary;     /* context switches while waiting, e.g. on I/O */
+  uint64_t involuntary;   /* context switches by preemption */
+} SKY_RUSAGE;
+
+/* Statements the write phase generates from the templates of a table */
+typedef enum {
+  SKY_WRITE_UPDATE,
+  SKY_WRITE_DELETE,
+  SKY_NWRITES
+} sky_write;
+
+/* A table to create and populate with auto generated data. The
+   tables are populated in the order they were specified so that
+   a table can reference the keys generated for an earlier one */
+typedef struct {
+  char *create_query;     /* CREATE TABLE query */
+  char *insert_tmpl;      /* INSERT query template */
+  uint16_t columns;       /* Number of placeholders in the template */
+  size_t payload_size;    /* Bytes of %payload values a row has at most */
+  char *write_tmpl[SKY_NWRITES]; /* UPDATE and DELETE query templates */
+  double zeta;            /* of the rows, for zipfian key draws */
+  uint64_t nwrite;        /* Number of rows to INSERT */
+} SKY_TABLE;
+
+/* A server to send load to. The primaries come first in the target
+   list and the replicas, which only receive the read load, follow */
+typedef struct {
+  char *host;
+  in_port_t port;
+  bool replica;
+} SKY_TARGET;
+
+/* How generated rows are spread over the primaries */
+typedef enum {
+  SKY_ROUTE_WORKER,       /* each worker sticks to one primary */
+  SKY_ROUTE_KEY           /* each row goes to the primary its key hashes to */
+} sky_route;
+
+/* Order in which a worker runs the statements of the read file */
+typedef enum {
+  SKY_ORDER_SEQUENTIAL,   /* every worker from the first to the last */
+  SKY_ORDER_OFFSET,       /* round-robin, each worker from its own offset */
+  SKY_ORDER_RANDOM,       /* uniformly random picks */
+  SKY_ORDER_WEIGHTED,     /* random picks by the weight of the statements */
+  SKY_ORDER_SHUFFLE       /* a new permutation every run */
+} sky_read_order;
+
+/* Layout of the %seq keys of a table over the workers inserting it */
+typedef enum {
+  SKY_KEYS_INTERLEAVED,   /* every worker takes every c-th key in turn */
+  SKY_KEYS_PARTITIONED,   /* every worker a contiguous range of its own */
+  SKY_KEYS_DESCENDING,    /* interleaved, from the highest key down */
+  SKY_KEYS_RANDOM         /* a pseudo-random permutation of the keys */
+} sky_key_order;
+
+/* Distribution the write templates draw the keys of existing rows from */
+typedef enum {
+  SKY_DIST_UNIFORM,       /* every row as likely */
+  SKY_DIST_ZIPFIAN        /* the first rows inserted are the hottest */
+} sky_key_dist;
+
+/* What the search for the highest throughput within --slo adjusts */
+typedef enum {
+  SKY_SEARCH_NONE,
+  SKY_SEARCH_RATE,        /* the rate offered by --concurrency workers */
+  SKY_SEARCH_CONCURRENCY  /* the number of unpaced workers */
+} sky_search;
+
+/* Distribution of the think time between two operations */
+typedef enum {
+  SKY_THINK_NONE,
+  SKY_THINK_FIXED,
+  SKY_THINK_UNIFORM,
+  SKY_THINK_EXPONENTIAL
+} sky_think_model;
+
+/* Stages every worker goes through, in this order */
+typedef enum {
+  SKY_PHASE_INSERT,       /* populating the tables from the templates */
+  SKY_PHASE_WRITE,        /* updating and deleting the populated rows */
+  SKY_PHASE_READ,         /* running the read file */
+  SKY_PHASE_REPLAY,       /* replaying the query log */
+  SKY_NPHASES
+} sky_phase;
+
+/* Server status sampler, defined in status.h */
+struct _sky_status;
+
+/* Timer wheel pacing the sessions, defined in think.h */
+struct _sky_timer_wheel;
+
+/* Statements batched into a single packet, defined in pipeline.h */
+struct _sky_pipeline;
+
+/* Parsed query log for replay, defined in replay.h */
+struct _sky_replay;
+
+/* Result of a concurrency sweep level, defined in sweep.h */
+struct _sky_sweep_level;
+
+/* Interval sampler of a soak test, defined in soak.h */
+struct _sky_soak;
+
+/* A run of the read file by a worker, defined in runs.h */
+struct _sky_run;
+
+/* Live metrics endpoint, defined in metrics.h */
+struct _sky_metrics;
+
+/* Phases of a scenario file, defined in scenario.h */
+struct _sky_scenario;
+struct _sky_scenario_phase;
+
+/* Source of the %payload values, defined in payload.h */
+struct _sky_payload;
+
 /* Object shared among all worker threads. Only add items that
    will not be updated at runtime to this struct  */
 typedef struct {
   SKY_LIST *load_queries; /* Singly linked list for external load queries */
   SKY_LIST *read_queries; /* Singly linked list for external read queries */
+  struct _sky_replay *replay; /* Query log to replay */
   in_port_t port;         /* DBMS port to talk to */
-  char *server;           /* DBMS Hostname */
+  char *server;           /* DBMS Hostname (the first primary) */
+  char *server_list;      /* Comma separated list of primaries */
+  char *replica_list;     /* Comma separated list of read replicas */
+  SKY_TARGET targets[SKY_MAX_TARGETS]; /* Primaries followed by replicas */
+  uint16_t ntargets;      /* Number of targets */
+  uint16_t nprimaries;    /* Number of primaries among the targets */
+  uint16_t route;         /* How rows are routed to the primaries */
   char *database_name;    /* User specified database to run tests on */
-  char *create_query;     /* CREATE TABLE query */
-  char *insert_tmpl;      /* INSERT query template */
+  SKY_TABLE tables[SKY_MAX_TABLES]; /* Tables to create and populate */
   char *load_file_path;   /* Path to the provided Load-SQL file */
   char *read_file_path;   /* Path to the provided Read-SQL file */
+  char *replay_file_path; /* Path to the provided query log */
   bool keep_db;           /* Whether to drop the test database or not */
   uint16_t protocol;      /* Database protocol */
-  uint16_t columns;       /* Number of columns in the table */
-  uint32_t nwrite;        /* Number of rows to INSERT */
-  uint32_t runs;          /* Number of times to run the test */
+  uint16_t ntables;       /* Number of tables specified */
+  uint64_t runs;          /* Number of times to run the test */
+  uint32_t run_warmup;    /* Seconds to warm up before every run */
   uint32_t concurrency;   /* Number of concurrent connections */
+  uint32_t txn_size;      /* Number of operations per transaction */
   double file_load_time;  /* Time taken to process a load file */
+  double speed;           /* Replay speed multiplier */
+  uint32_t *sweep_levels; /* Concurrency levels to sweep through */
+  uint32_t nsweep;        /* Number of concurrency levels */
+  uint32_t sweep_time;    /* Seconds to measure at each level */
+  uint32_t warmup_time;   /* Seconds to warm up at each level */
+  uint32_t max_retries;   /* Attempts to repeat a failed statement */
+  uint32_t retry_backoff; /* Initial msecs to wait before a retry */
+  uint32_t report_interval; /* Seconds per error rate interval */
+  uint64_t start_time;    /* usec timestamp of the start of the load */
+  SKY_RUSAGE client_start; /* Resources the client used before the load */
+  struct _sky_sweep_level *sweep_results; /* Measured sweep levels */
+  uint16_t search;        /* What the --slo search adjusts, if anything */
+  double slo_percentile;  /* Percentile the latency target applies to */
+  uint64_t slo_latency;   /* usec the percentile must stay within */
+  struct _sky_sweep_level *search_results; /* Steps the search took */
+  uint32_t nsearch;       /* Number of steps taken */
+  int32_t search_point;   /* Step the search ended up at, -1 if none */
+  char **fingerprints;    /* Normalized forms of the read queries */
+  uint32_t nfingerprints; /* Number of distinct normalized queries */
+  char *json_path;        /* Path to write the results to */
+  char *compare_path;     /* Path to the baseline results */
+  double tolerance;       /* Percent of change tolerated by --compare */
+  uint32_t noise_floor;   /* usecs of latency change considered noise */
+  double noise_z;         /* z-score a mean latency change must exceed */
+  bool status;            /* Whether to sample the server status */
+  bool engine_status;     /* Whether to sample the engine status too */
+  char *status_vars;      /* Comma separated status variables to sample */
+  struct _sky_status *status_sampler; /* Samples the server status */
+  uint32_t phase_finished[SKY_NPHASES]; /* Workers done with a phase */
+  uint32_t pipeline_depth; /* Statements sent per round trip */
+  uint16_t think_model;   /* Distribution of the think time */
+  uint64_t think_min;     /* usecs of think time, the mean if exponential */
+  uint64_t think_max;     /* upper bound of a uniform think time */
+  uint32_t pace;          /* Operations per minute per session */
+  uint16_t read_order;    /* Order of the read file statements */
+  uint16_t key_order;     /* Layout of the generated %seq keys */
+  uint64_t writes;        /* Number of UPDATEs and DELETEs to run */
+  uint16_t key_dist;      /* Distribution of the keys they draw */
+  double zipf_theta;      /* Skew of a zipfian key distribution */
+  uint32_t slowest;       /* Number of slowest statements to report */
+  char *trace_path;       /* Path to write the timeline of statements to */
+  uint32_t trace_sample;  /* 1 in how many statements are traced */
+  struct _sky_timer_wheel *timer_wheel; /* Wakes up the thinking workers */
+  bool soak;              /* Whether to run until stopped by a signal */
+  char *soak_path;        /* Path to write the soak intervals to */
+  uint64_t soak_rotate;   /* Bytes written to a soak file before rotating */
+  struct _sky_soak *soak_sampler; /* Samples the intervals of a soak test */
+  char *metrics_addr;     /* [host:]port or socket path to serve metrics on */
+  struct _sky_metrics *metrics; /* Serves the live metrics */
+  char *scenario_path;    /* Path to the scenario file */
+  struct _sky_scenario *scenario; /* Phases to run after the population */
+  char *payload_path;     /* Path to the file the payloads are taken from */
+  uint64_t payload_min;   /* Bytes of the smallest %payload value */
+  uint64_t payload_max;   /* Bytes of the largest %payload value */
+  struct _sky_payload *payload; /* Bytes the payloads are cut out of */
+  pthread_barrier_t table_barrier; /* Separates the population of tables */
 } SKY_SHARE;
  
 /* Structure to represent a worker. Number of workers created
    is relative to the specified concurrency level. */
 typedef struct {
   SKY_SHARE *share;
+  SKY_TABLE *table;       /* table currently being populated */
   pthread_t thread_id;
   drizzle_st database_handle;
-  drizzle_con_st connection;
+  drizzle_con_st connection;          /* connection to the primary */
+  drizzle_con_st *read_connection;    /* connection for the read load */
+  drizzle_con_st *replica_connection; /* connection to a read replica */
+  drizzle_con_st *shard_connections;  /* a connection per primary */
+  uint16_t target_index;              /* primary this worker talks to */
+  uint16_t read_target_index;         /* target serving the read load */
+  uint64_t target_queries[SKY_MAX_TARGETS]; /* queries sent to a target */
+  uint64_t target_time[SKY_MAX_TARGETS];    /* time spent on a target */
+  uint64_t row_key;                   /* key of the last row written */
   bool aborted;
   uint32_t unique_id;
-  uint32_t current_seq_id[SKY_MAX_COLS];
+  uint64_t current_seq_id[SKY_MAX_COLS];
+  uint32_t seq_stride;    /* step between %seq values, the concurrency if 0 */
   uint64_t total_insert_time;
+  uint64_t table_insert_time[SKY_MAX_TABLES];
   uint64_t file_benchmark_time;
+  uint64_t insert_commit_time; /* time spent in COMMIT while inserting */
+  uint64_t insert_commits;     /* transactions committed while inserting */
+  uint64_t insert_elapsed;     /* wall-clock time of the INSERT phase */
+  uint64_t file_commit_time;   /* time spent in COMMIT during read load */
+  uint64_t file_commits;       /* transactions committed during read load */
+  uint64_t file_elapsed;       /* wall-clock time of the read load */
+  uint64_t replay_time;      /* time spent executing replayed queries */
+  uint64_t replay_queries;   /* number of replayed queries */
+  uint64_t replay_lag_total; /* accumulated lag behind the schedule */
+  uint64_t replay_lag_max;   /* worst lag behind the schedule */
+  uint64_t replay_late;      /* queries dispatched later than allowed */
+  uint64_t replay_end_time;  /* when this worker finished replaying */
+  uint64_t measure_start;    /* beginning of a timed measurement */
+  uint64_t measure_end;      /* end of a timed measurement */
+  uint64_t sweep_queries;    /* queries measured at the current level */
+  double sweep_interval;     /* usec between paced statements, 0 if not */
+  double sweep_next;         /* usec timestamp the next one is due at */
+  SKY_HISTOGRAM latency;     /* latency of the current measurement */
+  uint64_t failed_queries;   /* statements given up on */
+  uint64_t retries;          /* statements attempted again */
+  uint64_t reconnects;       /* connections re-established */
+  SKY_TIMELINE timeline;     /* outcome of statements per interval */
+  SKY_HISTOGRAM insert_latency; /* latency of the generated INSERTs */
+  SKY_HISTOGRAM read_latency;   /* latency of the read file queries */
+  SKY_HISTOGRAM replay_latency; /* latency of the replayed queries */
+  SKY_HISTOGRAM *query_latency; /* latency per read query fingerprint */
+  uint16_t phase;            /* first phase this worker hasn't finished */
+  struct _sky_pipeline *pipeline; /* statements batched with --pipeline */
+  uint64_t op_start;         /* when the current operation started */
+  uint64_t think_wait;       /* time spent between operations */
+  uint64_t session_ops;      /* operations followed by a pause */
+  uint32_t *read_order;      /* indexes of the read statements to run */
+  SKY_ARENA arena;           /* per query buffers */
+  uint64_t rows_inserted;    /* rows generated and inserted */
+  uint64_t insert_bytes;     /* bytes of the rows inserted */
+  uint64_t affected_rows;    /* rows changed by the last statement */
+  uint64_t write_elapsed;    /* wall-clock time of the write phase */
+  SKY_HISTOGRAM write_latency; /* latency of the UPDATEs and DELETEs */
+  SKY_HISTOGRAM write_kind_latency[SKY_NWRITES]; /* the same by kind */
+  uint64_t write_rows[SKY_NWRITES]; /* rows they affected by kind */
+  uint64_t file_runs;        /* completed runs of the read file */
+  struct _sky_run *run_log;  /* figures of every completed run */
+  uint32_t run_log_size;
+  uint32_t run_log_capacity;
+  SKY_HISTOGRAM *soak_latency; /* latency of the current soak interval */
+  struct _sky_slow_query *slowest; /* min-heap of the slowest statements */
+  uint32_t slowest_size;
+  struct _sky_span *spans;   /* traced statements, in the order they ran */
+  uint32_t spans_size;
+  uint32_t spans_capacity;
+  uint64_t trace_seen;       /* statements the trace sampled from */
+  uint64_t spans_dropped;    /* traced statements that weren't kept */
+  pthread_mutex_t soak_lock;   /* shared with the soak sampler */
+  uint32_t in_flight;          /* statements awaiting their result */
+  struct _sky_scenario_phase *scenario_phase; /* phase being run */
+  uint64_t scenario_ops;       /* operations left to this worker */
+  SKY_RUSAGE rusage;           /* resources the thread used in the load */
+  SKY_RUSAGE rusage_start;     /* as of when the thread started */
+  struct _sky_txn_statement *txn_log; /* statements of the open transaction */
+  uint32_t txn_count;
+  uint32_t txn_capacity;
+  bool txn_open;               /* whether the statements are held back */
 } SKY_WORKER;
 
 /* allocator and deallocator. don't add anything more than
@@ -111,9 +435,29 @@ char *sky_tolower(char *string);
 bool sky_create_connection(SKY_SHARE *share, drizzle_st *handle,
                            drizzle_con_st *conn);
 
+/* initialize a connection to the given target */
+bool sky_connect_target(SKY_SHARE *share, SKY_TARGET *target,
+                        drizzle_st *handle, drizzle_con_st *conn);
+
 /* closes then frees a connection */
 void sky_close_connection(drizzle_con_st *conn);
 
+/* builds the target list out of the --server and --replica lists */
+bool resolve_targets(SKY_SHARE *share);
+
+/* picks the primary and the read target of a worker */
+void assign_targets(SKY_WORKER *worker);
+
+/* opens every connection a worker needs and switches them to the
+   test database */
+bool sky_worker_connect(SKY_WORKER *worker);
+
+/* closes every connection opened by sky_worker_connect() */
+void sky_worker_disconnect(SKY_WORKER *worker);
+
+/* returns the index of the primary that the given key routes to */
+uint16_t route_key(SKY_SHARE *share, uint64_t key);
+
 /* create an array of workers*/
 SKY_WORKER **create_workers(SKY_SHARE *share);
 
@@ -135,16 +479,63 @@ bool sky_list_push(SKY_LIST *list, const char *value, const size_t length);
 /* free a linked list node */
 void sky_node_free(SKY_LIST_NODE *node);
 
+/* builds the array of the nodes and their running weight total so
+   that the list can be accessed by index */
+bool sky_list_index(SKY_LIST *list);
+
+/* arena allocator. allocations are aligned to SKY_ARENA_ALIGN and
+   are valid until the arena is reset or rewound past them. returns
+   NULL if out of memory */
+void sky_arena_init(SKY_ARENA *arena);
+void sky_arena_free(SKY_ARENA *arena);
+void *arena_alloc(SKY_ARENA *arena, size_t size);
+void arena_reset(SKY_ARENA *arena);
+SKY_ARENA_MARK arena_mark(SKY_ARENA *arena);
+void arena_rewind(SKY_ARENA *arena, SKY_ARENA_MARK mark);
+
 /* calculates time difference in microseconds */
 uint64_t timediff(struct timeval from, struct timeval to);
 
+/* returns the current time in microseconds */
+uint64_t current_usec(void);
+
+/* suspends the calling thread for the given microseconds */
+void sleep_usec(uint64_t usec);
+
 /* caluclates the number of insertions that a given worker
-   thread must perform */
-uint32_t rows_to_write(SKY_WORKER *worker);
+   thread must perform on the table it's currently populating */
+uint64_t rows_to_write(SKY_WORKER *worker);
+
+/* makes SIGINT and SIGTERM ask the workers to stop at the end of
+   their current statement or transaction. a second signal kills the
+   process as usual */
+bool install_stop_handler(void);
+
+/* whether a stop has been requested with a signal */
+bool stop_requested(void);
+
+/* whether any of the tables has an INSERT template */
+bool has_insert_template(SKY_SHARE *share);
+
+/* whether any of the tables has an UPDATE or DELETE template */
+bool has_write_template(SKY_SHARE *share);
+
+/* name of a --read-order policy, as used in the reports */
+const char *read_order_name(sky_read_order order);
+
+/* name of a phase, as used in the reports */
+const char *phase_name(sky_phase phase);
+
+/* whether the given phase is part of this run */
+bool phase_enabled(SKY_SHARE *share, sky_phase phase);
 
 /* switch to the specified (or default) database */
 bool switch_database(SKY_SHARE *share, drizzle_con_st *conn);
 
+/* lets the server run several statements sent in a single packet.
+   only supported by the MySQL protocol */
+bool enable_multi_statements(drizzle_con_st *conn);
+
 /* drop a database */
 bool drop_database(SKY_SHARE *share);
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "slowest.h"
+
+static void swap_entries(SKY_SLOW_QUERY *a, SKY_SLOW_QUERY *b) {
+  SKY_SLOW_QUERY tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+/* Moves the entry at 'index' down until the heap is in order again */
+static void sift_down(SKY_SLOW_QUERY *heap, uint32_t size, uint32_t index) {
+  for (;;) {
+    uint32_t smallest = index;
+    uint32_t left = 2 * index + 1, right = left + 1;
+
+    if (left < size && heap[left].latency < heap[smallest].latency)
+      smallest = left;
+    if (right < size && heap[right].latency < heap[smallest].latency)
+      smallest = right;
+    if (smallest == index)
+      return;
+
+    swap_entries(&heap[index], &heap[smallest]);
+    index = smallest;
+  }
+}
+
+/* Moves the entry at 'index' up until the heap is in order again */
+static void sift_up(SKY_SLOW_QUERY *heap, uint32_t index) {
+  while (index > 0) {
+    uint32_t parent = (index - 1) / 2;
+
+    if (heap[parent].latency <= heap[index].latency)
+      return;
+
+    swap_entries(&heap[index], &heap[parent]);
+    index = parent;
+  }
+}
+
+/* Copies the beginning of the statement on a single line */
+static void copy_text(SKY_SLOW_QUERY *entry, const struct iovec *pieces,
+                      int npieces) {
+  size_t used = 0;
+
+  entry->length = 0;
+
+  for (int i = 0; i < npieces; i++) {
+    const char *data = pieces[i].iov_base;
+
+    entry->length += pieces[i].iov_len;
+
+    for (size_t j = 0; j < pieces[i].iov_len &&
+         used < SLOWEST_TEXT_SIZE - 1; j++) {
+      char c = data[j];
+      entry->text[used++] = (c == '\n' || c == '\r' || c == '\t') ? ' ' : c;
+    }
+  }
+  entry->text[used] = '\0';
+}
+
+bool is_slow_query(SKY_WORKER *worker, uint64_t latency) {
+  if (worker->slowest == NULL)
+    return false;
+
+  /* the root is the fastest of the slowest statements so far */
+  return (worker->slowest_size < worker->share->slowest ||
+          latency > worker->slowest[0].latency);
+}
+
+void make_slow_query(SKY_WORKER *worker, drizzle_con_st *conn,
+                     const struct iovec *pieces, int npieces,
+                     uint64_t latency, SKY_SLOW_QUERY *entry) {
+  SKY_SHARE *share = worker->share;
+  uint64_t now = current_usec();
+
+  entry->latency = latency;
+  entry->time = (share->start_time > 0 && now > share->start_time) ?
+                now - share->start_time : 0;
+  entry->connection = (conn) ? drizzle_con_thread_id(conn) : 0;
+  entry->worker = worker->unique_id;
+  copy_text(entry, pieces, npieces);
+}
+
+/* Returns the entry of the heap that a slow statement takes */
+static SKY_SLOW_QUERY *heap_slot(SKY_WORKER *worker) {
+  return (worker->slowest_size < worker->share->slowest) ?
+         &worker->slowest[worker->slowest_size] : &worker->slowest[0];
+}
+
+/* Puts the heap back in order once its slot has been filled in */
+static void heap_settle(SKY_WORKER *worker) {
+  if (worker->slowest_size < worker->share->slowest)
+    sift_up(worker->slowest, worker->slowest_size++);
+  else
+    sift_down(worker->slowest, worker->slowest_size, 0);
+}
+
+void record_slow_query(SKY_WORKER *worker, drizzle_con_st *conn,
+                       const struct iovec *pieces, int npieces,
+                       uint64_t latency) {
+  if (!is_slow_query(worker, latency))
+    return;
+
+  make_slow_query(worker, conn, pieces, npieces, latency, heap_slot(worker));
+  heap_settle(worker);
+}
+
+void keep_slow_query(SKY_WORKER *worker, const SKY_SLOW_QUERY *entry) {
+  if (!is_slow_query(worker, entry->latency))
+    return;
+
+  *heap_slot(worker) = *entry;
+  heap_settle(worker);
+}
+
+static int compare_latency(const void *a, const void *b) {
+  const SKY_SLOW_QUERY *x = a, *y = b;
+  return (x->latency < y->latency) - (x->latency > y->latency);
+}
+
+SKY_SLOW_QUERY *merge_slowest(SKY_WORKER **workers, uint32_t *count) {
+  assert(workers && count);
+
+  SKY_SHARE *share = workers[0]->share;
+  SKY_SLOW_QUERY *merged;
+  uint32_t total = 0;
+
+  *count = 0;
+
+  for (int i = 0; i < share->concurrency; i++)
+    total += workers[i]->slowest_size;
+
+  if (total == 0 || (merged = malloc(sizeof(*merged) * total)) == NULL)
+    return NULL;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    memcpy(&merged[*count], workers[i]->slowest,
+           sizeof(*merged) * workers[i]->slowest_size);
+    *count += workers[i]->slowest_size;
+  }
+
+  /* only the slowest of all the workers are kept */
+  qsort(merged, total, sizeof(*merged), compare_latency);
+
+  if (*count > share->slowest)
+    *count = share->slowest;
+  return merged;
+}
+
+void print_slowest_result(SKY_WORKER **workers) {
+  SKY_SLOW_QUERY *slowest;
+  uint32_t count;
+
+  if ((slowest = merge_slowest(workers, &count)) == NULL)
+    return;
+
+  printf("\n");
+  printf("[ SLOWEST STATEMENTS ]\n");
+  printf("  %-5s %12s %10s %7s %10s  %s\n", "Rank", "Latency (ms)",
+         "At (secs)", "Worker", "Conn", "Statement");
+
+  for (uint32_t i = 0; i < count; i++) {
+    printf("  %-5u %12.3lf %10.3lf %7u %10u  %s", i + 1,
+           (double)slowest[i].latency / 1000,
+           (double)slowest[i].time / 1000000, slowest[i].worker,
+           slowest[i].connection, slowest[i].text);
+
+    if (slowest[i].length >= SLOWEST_TEXT_SIZE)
+      printf("... (%zu bytes)", slowest[i].length);
+    printf("\n");
+  }
+
+  free(slowest);
+}
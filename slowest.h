@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_SLOWEST_H__
+#define __SKYLOAD_SLOWEST_H__
+
+#include <sys/uio.h>
+#include "skyload.h"
+
+#define SLOWEST_TEXT_SIZE 256 /* bytes of a statement kept, with a null */
+
+/* One of the slowest statements a worker ran */
+typedef struct _sky_slow_query {
+  uint64_t latency;    /* usec */
+  uint64_t time;       /* usec since the load started */
+  uint32_t connection; /* thread id of the connection on the server */
+  uint32_t worker;
+  size_t length;       /* of the whole statement, which may be cut */
+  char text[SLOWEST_TEXT_SIZE];
+} SKY_SLOW_QUERY;
+
+/* records a statement among the slowest ones of the worker if it's
+   slower than the fastest of them. they're kept in a min-heap of
+   share->slowest entries, so a statement that doesn't make it costs
+   a single comparison */
+void record_slow_query(SKY_WORKER *worker, drizzle_con_st *conn,
+                       const struct iovec *pieces, int npieces,
+                       uint64_t latency);
+
+/* same as record_slow_query() in steps, for a statement of a
+   transaction that only counts once the transaction commits.
+   is_slow_query() tells whether a statement is slow enough to be
+   kept so far, make_slow_query() fills in an entry out of it and
+   keep_slow_query() records the entry if it's still slow enough */
+bool is_slow_query(SKY_WORKER *worker, uint64_t latency);
+void make_slow_query(SKY_WORKER *worker, drizzle_con_st *conn,
+                     const struct iovec *pieces, int npieces,
+                     uint64_t latency, SKY_SLOW_QUERY *entry);
+void keep_slow_query(SKY_WORKER *worker, const SKY_SLOW_QUERY *entry);
+
+/* puts the slowest statements of every worker together, slowest
+   first. the caller frees the returned array. returns NULL if there
+   are none or if out of memory */
+SKY_SLOW_QUERY *merge_slowest(SKY_WORKER **workers, uint32_t *count);
+
+/* prints the slowest statements of the load */
+void print_slowest_result(SKY_WORKER **workers);
+
+#endif
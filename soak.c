@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "soak.h"
+
+/* Opens a new soak file, which starts with the column names */
+static bool open_soak_file(SKY_SOAK *soak) {
+  const char *path = soak->share->soak_path;
+
+  if ((soak->file = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "failed to open (%s) for writing\n", path);
+    return false;
+  }
+
+  if (fputs(SOAK_HEADER, soak->file) == EOF) {
+    fprintf(stderr, "failed to write (%s)\n", path);
+    return false;
+  }
+
+  soak->file_size = strlen(SOAK_HEADER);
+  return true;
+}
+
+SKY_SOAK *sky_soak_new(SKY_SHARE *share, SKY_WORKER **workers) {
+  assert(share && workers);
+
+  SKY_SOAK *soak;
+
+  if ((soak = calloc(1, sizeof(*soak))) == NULL)
+    return NULL;
+
+  soak->share = share;
+  soak->workers = workers;
+  sky_histogram_reset(&soak->interval);
+  sky_histogram_reset(&soak->total);
+  pthread_mutex_init(&soak->lock, NULL);
+  pthread_cond_init(&soak->wakeup, NULL);
+
+  for (uint32_t i = 0; i < share->concurrency; i++) {
+    SKY_HISTOGRAM *hist = malloc(sizeof(*hist));
+
+    if (hist == NULL) {
+      sky_soak_free(soak);
+      return NULL;
+    }
+
+    sky_histogram_reset(hist);
+    workers[i]->soak_latency = hist;
+  }
+
+  if (share->soak_path && !open_soak_file(soak)) {
+    sky_soak_free(soak);
+    return NULL;
+  }
+  return soak;
+}
+
+void sky_soak_free(SKY_SOAK *soak) {
+  if (soak == NULL)
+    return;
+
+  if (soak->running)
+    soak_stop(soak);
+
+  /* the workers stop recording with their histograms gone */
+  for (uint32_t i = 0; i < soak->share->concurrency; i++) {
+    free(soak->workers[i]->soak_latency);
+    soak->workers[i]->soak_latency = NULL;
+  }
+
+  if (soak->file)
+    fclose(soak->file);
+
+  pthread_mutex_destroy(&soak->lock);
+  pthread_cond_destroy(&soak->wakeup);
+  free(soak);
+}
+
+void trend_add(SKY_TREND *trend, double x, double y) {
+  trend->n++;
+  trend->sx += x;
+  trend->sy += y;
+  trend->sxx += x * x;
+  trend->sxy += x * y;
+}
+
+double trend_slope(const SKY_TREND *trend) {
+  double denominator = trend->n * trend->sxx - trend->sx * trend->sx;
+
+  if (trend->n < 2 || denominator <= 0)
+    return 0;
+
+  return (trend->n * trend->sxy - trend->sx * trend->sy) / denominator;
+}
+
+uint64_t current_rss(void) {
+  unsigned long long size, resident;
+  FILE *statm;
+  long page_size = sysconf(_SC_PAGESIZE);
+
+  if ((statm = fopen("/proc/self/statm", "r")) == NULL)
+    return 0;
+
+  if (fscanf(statm, "%llu %llu", &size, &resident) != 2 || page_size <= 0)
+    resident = 0;
+
+  fclose(statm);
+  return (uint64_t)resident * page_size;
+}
+
+bool soak_rotate(SKY_SOAK *soak) {
+  assert(soak);
+
+  const char *path = soak->share->soak_path;
+  char from[SKY_STRSIZ], to[SKY_STRSIZ];
+
+  if (soak->file) {
+    fclose(soak->file);
+    soak->file = NULL;
+  }
+
+  /* the oldest file is overwritten by the one after it */
+  for (uint32_t i = SKY_SOAK_KEEP - 1; i > 0; i--) {
+    snprintf(from, sizeof(from), "%s.%u", path, i);
+    snprintf(to, sizeof(to), "%s.%u", path, i + 1);
+    rename(from, to);
+  }
+
+  snprintf(to, sizeof(to), "%s.1", path);
+
+  if (rename(path, to) != 0) {
+    fprintf(stderr, "failed to rotate (%s)\n", path);
+    return false;
+  }
+
+  soak->rotations++;
+  return open_soak_file(soak);
+}
+
+/* Appends an interval to the soak file, rotating it first if the
+   line would take it past --soak-rotate */
+static bool write_interval(SKY_SOAK *soak, const SKY_SOAK_SAMPLE *iv) {
+  char line[SKY_STRSIZ];
+  int length;
+
+  length = snprintf(line, sizeof(line),
+                    "%.3lf,%llu,%.3lf,%llu,%llu,%llu,%llu,%llu,%llu,"
+                    "%llu,%.3lf\n",
+                    (double)iv->elapsed / 1000000,
+                    (unsigned long long)iv->queries, iv->qps,
+                    (unsigned long long)iv->errors,
+                    (unsigned long long)iv->retries,
+                    (unsigned long long)iv->p50,
+                    (unsigned long long)iv->p95,
+                    (unsigned long long)iv->p99,
+                    (unsigned long long)iv->max,
+                    (unsigned long long)(iv->rss / 1024), iv->drift);
+
+  if (soak->file_size > strlen(SOAK_HEADER) &&
+      soak->file_size + length > soak->share->soak_rotate) {
+    if (!soak_rotate(soak))
+      return false;
+  }
+
+  if (fputs(line, soak->file) == EOF || fflush(soak->file) == EOF) {
+    fprintf(stderr, "failed to write (%s)\n", soak->share->soak_path);
+    return false;
+  }
+
+  soak->file_size += length;
+  return true;
+}
+
+bool soak_sample(SKY_SOAK *soak, SKY_SOAK_SAMPLE *iv) {
+  assert(soak && iv);
+
+  SKY_SHARE *share = soak->share;
+  uint64_t now = current_usec();
+  uint64_t errors = 0, retries = 0;
+  uint64_t duration = now - soak->last_time;
+  double hours = (double)(now - share->start_time) / 3600000000.0;
+
+  sky_histogram_reset(&soak->interval);
+
+  /* the workers go on recording into a cleared histogram */
+  for (uint32_t i = 0; i < share->concurrency; i++) {
+    SKY_WORKER *worker = soak->workers[i];
+
+    pthread_mutex_lock(&worker->soak_lock);
+    sky_histogram_merge(&soak->interval, worker->soak_latency);
+    sky_histogram_reset(worker->soak_latency);
+    pthread_mutex_unlock(&worker->soak_lock);
+
+    errors += worker->failed_queries;
+    retries += worker->retries;
+  }
+
+  sky_histogram_merge(&soak->total, &soak->interval);
+
+  memset(iv, 0, sizeof(*iv));
+  iv->elapsed = now - share->start_time;
+  iv->queries = soak->interval.count;
+  iv->errors = errors - soak->errors;
+  iv->retries = retries - soak->retries;
+  iv->qps = (duration) ? (double)iv->queries * 1000000 / duration : 0;
+  iv->p50 = sky_histogram_percentile(&soak->interval, 50.0);
+  iv->p95 = sky_histogram_percentile(&soak->interval, 95.0);
+  iv->p99 = sky_histogram_percentile(&soak->interval, 99.0);
+  iv->max = soak->interval.max;
+  iv->rss = current_rss();
+
+  soak->last_time = now;
+  soak->errors = errors;
+  soak->retries = retries;
+  soak->queries += iv->queries;
+
+  /* an interval cut short by the end of the run is too noisy to
+     count towards the trends */
+  if (duration * 2 >= (uint64_t)share->report_interval * 1000000) {
+    soak->intervals++;
+
+    if (soak->intervals <= SOAK_BASELINE) {
+      soak->baseline += (iv->qps - soak->baseline) / soak->intervals;
+    } else if (soak->baseline > 0) {
+      iv->drift = 100.0 * (iv->qps - soak->baseline) / soak->baseline;
+    }
+
+    if (soak->intervals == 1 || iv->qps < soak->min_qps)
+      soak->min_qps = iv->qps;
+    if (iv->qps > soak->max_qps)
+      soak->max_qps = iv->qps;
+
+    trend_add(&soak->qps_trend, hours, iv->qps);
+    if (iv->rss > 0)
+      trend_add(&soak->rss_trend, hours, (double)iv->rss / 1048576);
+
+    soak->last_drift = iv->drift;
+  }
+
+  if (iv->rss > 0) {
+    if (soak->rss_start == 0)
+      soak->rss_start = iv->rss;
+    if (iv->rss > soak->rss_peak)
+      soak->rss_peak = iv->rss;
+    soak->rss_end = iv->rss;
+  }
+
+  if (soak->file && !soak->failed && !write_interval(soak, iv))
+    soak->failed = true;
+
+  return !soak->failed;
+}
+
+static void *soak_workload(void *arg) {
+  SKY_SOAK *soak = (SKY_SOAK *)arg;
+  uint64_t interval = (uint64_t)soak->share->report_interval * 1000000;
+  uint64_t next = soak->share->start_time + interval;
+  SKY_SOAK_SAMPLE iv;
+
+  pthread_mutex_lock(&soak->lock);
+
+  for (;;) {
+    while (!soak->stop && current_usec() < next) {
+      struct timespec deadline;
+
+      deadline.tv_sec = next / 1000000;
+      deadline.tv_nsec = (next % 1000000) * 1000;
+      pthread_cond_timedwait(&soak->wakeup, &soak->lock, &deadline);
+    }
+
+    if (soak->stop)
+      break;
+
+    pthread_mutex_unlock(&soak->lock);
+    soak_sample(soak, &iv);
+    pthread_mutex_lock(&soak->lock);
+
+    /* skip the intervals missed while sampling was held up */
+    while (next <= current_usec())
+      next += interval;
+  }
+
+  pthread_mutex_unlock(&soak->lock);
+
+  /* the rest of the last interval */
+  soak_sample(soak, &iv);
+  return NULL;
+}
+
+bool soak_start(SKY_SOAK *soak) {
+  assert(soak);
+
+  soak->last_time = soak->share->start_time;
+  soak->rss_start = current_rss();
+  soak->rss_peak = soak->rss_start;
+
+  if (pthread_create(&soak->thread_id, NULL, soak_workload, (void *)soak)) {
+    report_error("failed to create soak sampler thread");
+    return false;
+  }
+
+  soak->running = true;
+  return true;
+}
+
+void soak_stop(SKY_SOAK *soak) {
+  assert(soak);
+
+  if (!soak->running)
+    return;
+
+  pthread_mutex_lock(&soak->lock);
+  soak->stop = true;
+  pthread_cond_signal(&soak->wakeup);
+  pthread_mutex_unlock(&soak->lock);
+
+  pthread_join(soak->thread_id, NULL);
+  soak->running = false;
+}
+
+void print_soak_result(SKY_SOAK *soak) {
+  assert(soak);
+
+  SKY_SHARE *share = soak->share;
+  double hours = (double)(soak->last_time - share->start_time) /
+                 3600000000.0;
+  double qps_slope = trend_slope(&soak->qps_trend);
+
+  printf("\n");
+  printf("[ SOAK TEST RESULT ]\n");
+  printf("  Duration               : %.3lf hours\n", hours);
+  printf("  Intervals Sampled      : %llu (%u secs each)\n",
+         (unsigned long long)soak->intervals, share->report_interval);
+  printf("  Statements Sampled     : %llu\n",
+         (unsigned long long)soak->queries);
+  printf("  Throughput Baseline    : %.1lf q/s (first %d intervals)\n",
+         soak->baseline, SOAK_BASELINE);
+  printf("  Throughput Range       : %.1lf - %.1lf q/s\n",
+         soak->min_qps, soak->max_qps);
+  printf("  Throughput Drift       : %+.2lf%% (last interval)\n",
+         soak->last_drift);
+  printf("  Throughput Trend       : %+.3lf%% per hour\n",
+         (soak->baseline > 0) ? 100.0 * qps_slope / soak->baseline : 0);
+  printf("  Latency p50/p99/max    : %.3lf / %.3lf / %.3lf ms\n",
+         (double)sky_histogram_percentile(&soak->total, 50.0) / 1000,
+         (double)sky_histogram_percentile(&soak->total, 99.0) / 1000,
+         (double)soak->total.max / 1000);
+
+  if (soak->rss_end > 0) {
+    printf("  Client RSS             : %.1lf MB at start, %.1lf MB peak, "
+           "%.1lf MB at end\n", (double)soak->rss_start / 1048576,
+           (double)soak->rss_peak / 1048576,
+           (double)soak->rss_end / 1048576);
+    printf("  Client RSS Trend       : %+.3lf MB per hour\n",
+           trend_slope(&soak->rss_trend));
+  }
+
+  if (share->soak_path) {
+    printf("  Soak File              : %s (%u rotations)%s\n",
+           share->soak_path, soak->rotations,
+           (soak->failed) ? " incomplete" : "");
+  }
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_SOAK_H__
+#define __SKYLOAD_SOAK_H__
+
+#include "skyload.h"
+
+#define SOAK_BASELINE 5 /* intervals averaged into the throughput baseline */
+#define SOAK_HEADER   "elapsed_secs,queries,qps,errors,retries,p50_us," \
+                      "p95_us,p99_us,max_us,rss_kb,drift_pct\n"
+
+/* Least squares fit of a series, kept as running sums so that it
+   takes the same memory however long the run goes on */
+typedef struct {
+  double n;
+  double sx;
+  double sy;
+  double sxx;
+  double sxy;
+} SKY_TREND;
+
+/* Figures of a single soak interval */
+typedef struct {
+  uint64_t elapsed;    /* usec since the start of the load */
+  uint64_t queries;
+  uint64_t errors;
+  uint64_t retries;
+  double qps;
+  uint64_t p50;
+  uint64_t p95;
+  uint64_t p99;
+  uint64_t max;
+  uint64_t rss;        /* bytes resident, 0 if unknown */
+  double drift;        /* percent of throughput change from the baseline */
+} SKY_SOAK_SAMPLE;
+
+/* Samples a soak test every --report-interval from a thread of its
+   own. The workers record their latencies into a histogram each,
+   which the sampler merges and clears under the lock of the worker.
+   Nothing grows with the length of the run: the intervals go to the
+   soak file, rotated by size, and only their trend is kept. The
+   timeline of a worker holds its totals alone and the server status
+   keeps its latest samples. */
+typedef struct _sky_soak {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  pthread_t thread_id;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  bool running;
+  bool stop;
+  SKY_HISTOGRAM interval;   /* latency of the interval being sampled */
+  SKY_HISTOGRAM total;      /* latency of the whole run */
+  uint64_t last_time;       /* usec timestamp of the last sample */
+  uint64_t errors;          /* failed statements as of the last sample */
+  uint64_t retries;         /* retried attempts as of the last sample */
+  uint64_t intervals;       /* intervals sampled */
+  uint64_t queries;         /* statements sampled */
+  double baseline;          /* throughput of the first intervals */
+  double min_qps;
+  double max_qps;
+  double last_drift;
+  SKY_TREND qps_trend;      /* throughput over hours */
+  SKY_TREND rss_trend;      /* resident MB over hours */
+  uint64_t rss_start;
+  uint64_t rss_peak;
+  uint64_t rss_end;
+  FILE *file;               /* current soak file, if any */
+  uint64_t file_size;       /* bytes written to the current soak file */
+  uint32_t rotations;
+  bool failed;              /* the soak file could not be written */
+} SKY_SOAK;
+
+/* allocator and deallocator of the sampler. also gives every worker
+   a histogram for its soak intervals and opens the soak file */
+SKY_SOAK *sky_soak_new(SKY_SHARE *share, SKY_WORKER **workers);
+void sky_soak_free(SKY_SOAK *soak);
+
+/* adds a point to the trend and returns its slope. the slope is 0
+   until two distinct points have been added */
+void trend_add(SKY_TREND *trend, double x, double y);
+double trend_slope(const SKY_TREND *trend);
+
+/* returns the resident set size of the process in bytes, or 0 if the
+   platform doesn't tell */
+uint64_t current_rss(void);
+
+/* takes the latencies and errors recorded since the last sample,
+   folds them into the totals and the trends and writes them to the
+   soak file. returns false if the soak file could not be written */
+bool soak_sample(SKY_SOAK *soak, SKY_SOAK_SAMPLE *interval);
+
+/* moves the soak file to <path>.1, shifting the older ones up to
+   <path>.SKY_SOAK_KEEP, and starts a new one */
+bool soak_rotate(SKY_SOAK *soak);
+
+/* starts and stops the sampler thread. stopping samples the interval
+   that was cut short */
+bool soak_start(SKY_SOAK *soak);
+void soak_stop(SKY_SOAK *soak);
+
+/* prints the throughput drift and memory growth of the soak test */
+void print_soak_result(SKY_SOAK *soak);
+
+#endif
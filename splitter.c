@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "splitter.h"
+#include "generator.h"
+
+const char *split_scan(const char *pos, const char *end, const char *set,
+                       size_t nset) {
+  assert(pos && end && set && nset > 0 && nset <= SPLIT_MAX_SET);
+
+#if defined(__AVX2__)
+  __m256i needles[SPLIT_MAX_SET];
+
+  for (size_t i = 0; i < nset; i++)
+    needles[i] = _mm256_set1_epi8(set[i]);
+
+  /* compare 32 bytes against every byte of the set at once */
+  while (end - pos >= 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)pos);
+    __m256i hits = _mm256_cmpeq_epi8(block, needles[0]);
+    uint32_t mask;
+
+    for (size_t i = 1; i < nset; i++)
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[i]));
+
+    if ((mask = (uint32_t)_mm256_movemask_epi8(hits)) != 0)
+      return pos + __builtin_ctz(mask);
+    pos += 32;
+  }
+#elif defined(__SSE2__)
+  __m128i needles[SPLIT_MAX_SET];
+
+  for (size_t i = 0; i < nset; i++)
+    needles[i] = _mm_set1_epi8(set[i]);
+
+  /* compare 16 bytes against every byte of the set at once */
+  while (end - pos >= 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)pos);
+    __m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+    uint32_t mask;
+
+    for (size_t i = 1; i < nset; i++)
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+
+    if ((mask = (uint32_t)_mm_movemask_epi8(hits)) != 0)
+      return pos + __builtin_ctz(mask);
+    pos += 16;
+  }
+#endif
+
+  /* whatever is left of the vectors, or everything without them */
+  for (; pos < end; pos++) {
+    if (memchr(set, *pos, nset) != NULL)
+      return pos;
+  }
+  return end;
+}
+
+void splitter_init(SKY_SPLITTER *splitter, const char *data, size_t size) {
+  assert(splitter && data);
+
+  splitter->pos = data;
+  splitter->end = data + size;
+  strcpy(splitter->delimiter, SPLIT_DELIMITER);
+  splitter->delimiter_len = strlen(SPLIT_DELIMITER);
+  splitter->error = false;
+}
+
+/* Whether a comment starts at the given byte. A '--' only starts one
+   if it's followed by whitespace, as in MySQL */
+static bool starts_comment(const char *pos, const char *end) {
+  if (*pos == '#')
+    return true;
+
+  if (end - pos < 2)
+    return false;
+
+  if (pos[0] == '/' && pos[1] == '*')
+    return true;
+
+  return (pos[0] == '-' && pos[1] == '-' &&
+          (end - pos == 2 || isspace((unsigned char)pos[2]) ||
+           iscntrl((unsigned char)pos[2])));
+}
+
+/* Returns the byte following the comment that starts at 'pos' */
+static const char *skip_comment(const char *pos, const char *end) {
+  const char *newline;
+
+  if (*pos != '/') {
+    newline = memchr(pos, '\n', end - pos);
+    return (newline) ? newline + 1 : end;
+  }
+
+  for (pos += 2; (pos = split_scan(pos, end, "*", 1)) < end; pos++) {
+    if (end - pos >= 2 && pos[1] == '/')
+      return pos + 2;
+  }
+  return end;
+}
+
+/* Returns the byte following the quoted string or identifier that
+   starts at 'pos'. A quote doubled up closes the string and opens it
+   again right away, so it needs no special care */
+static const char *skip_quoted(const char *pos, const char *end) {
+  char set[2] = {*pos, '\\'};
+
+  /* identifiers have no escapes */
+  size_t nset = (*pos == '`') ? 1 : 2;
+
+  for (pos++; (pos = split_scan(pos, end, set, nset)) < end; pos += 2) {
+    if (*pos != '\\')
+      return pos + 1;
+    if (end - pos < 2)
+      break;
+  }
+  return end;
+}
+
+static bool at_delimiter(SKY_SPLITTER *splitter, const char *pos) {
+  return ((size_t)(splitter->end - pos) >= splitter->delimiter_len &&
+          memcmp(pos, splitter->delimiter, splitter->delimiter_len) == 0);
+}
+
+/* Returns where the delimiter ending the statement that starts at
+   'pos' is, or the end of the script if there's none */
+static const char *find_delimiter(SKY_SPLITTER *splitter, const char *pos) {
+  const char *end = splitter->end;
+  char set[] = {splitter->delimiter[0], '\'', '"', '`', '-', '#', '/'};
+
+  while ((pos = split_scan(pos, end, set, sizeof(set))) < end) {
+    /* the delimiter may well start with one of the other bytes */
+    if (at_delimiter(splitter, pos))
+      return pos;
+
+    if (*pos == '\'' || *pos == '"' || *pos == '`')
+      pos = skip_quoted(pos, end);
+    else if (starts_comment(pos, end))
+      pos = skip_comment(pos, end);
+    else
+      pos++;
+  }
+  return end;
+}
+
+/* Takes the new delimiter out of a DELIMITER line at 'pos' and moves
+   past the line. Returns false if there's no such line */
+static bool delimiter_command(SKY_SPLITTER *splitter, const char *pos) {
+  const char *end = splitter->end;
+  const char *delimiter, *newline;
+  size_t length;
+
+  if (end - pos <= DELIMITER_COMMAND_LEN ||
+      strncasecmp(pos, DELIMITER_COMMAND, DELIMITER_COMMAND_LEN) != 0 ||
+      (pos[DELIMITER_COMMAND_LEN] != ' ' &&
+       pos[DELIMITER_COMMAND_LEN] != '\t'))
+    return false;
+
+  pos += DELIMITER_COMMAND_LEN;
+
+  while (pos < end && (*pos == ' ' || *pos == '\t'))
+    pos++;
+
+  for (delimiter = pos; pos < end && !isspace((unsigned char)*pos); pos++)
+    ;
+
+  length = pos - delimiter;
+
+  if (length == 0 || length > SPLIT_MAX_DELIMITER) {
+    splitter->error = true;
+    return true;
+  }
+
+  memcpy(splitter->delimiter, delimiter, length);
+  splitter->delimiter[length] = '\0';
+  splitter->delimiter_len = length;
+
+  newline = memchr(pos, '\n', end - pos);
+  splitter->pos = (newline) ? newline + 1 : end;
+  return true;
+}
+
+const char *next_statement(SKY_SPLITTER *splitter, size_t *length) {
+  assert(splitter && length);
+
+  const char *pos = splitter->pos;
+  const char *end = splitter->end;
+  const char *start, *stop;
+
+  while (!splitter->error) {
+    /* whitespace and comments ahead of a statement are dropped, but
+       not the conditional comments of mysqldump. those start with a
+       '!' and are run by MySQL */
+    while (pos < end) {
+      if (isspace((unsigned char)*pos))
+        pos++;
+      else if (starts_comment(pos, end) &&
+               !(end - pos > 2 && pos[0] == '/' && pos[2] == '!'))
+        pos = skip_comment(pos, end);
+      else
+        break;
+    }
+
+    if (pos == end)
+      break;
+
+    if (delimiter_command(splitter, pos)) {
+      pos = splitter->pos;
+      continue;
+    }
+
+    /* nothing but a delimiter makes no statement */
+    if (at_delimiter(splitter, pos)) {
+      pos += splitter->delimiter_len;
+      continue;
+    }
+
+    start = pos;
+    stop = find_delimiter(splitter, pos);
+    splitter->pos = (stop == end) ? end : stop + splitter->delimiter_len;
+
+    while (stop > start && isspace((unsigned char)stop[-1]))
+      stop--;
+
+    *length = stop - start;
+    return start;
+  }
+
+  splitter->pos = end;
+  return NULL;
+}
+
+SKY_LIST *split_file_to_list(const char *path) {
+  assert(path);
+
+  SKY_SPLITTER splitter;
+  SKY_LIST *list;
+  bool rv = true;
+  struct stat st;
+  const char *statement;
+  size_t length;
+  char *data;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) == -1) {
+    report_error("failed to open the specified SQL file");
+    return NULL;
+  }
+
+  if (fstat(fd, &st) == -1 || (list = sky_list_new()) == NULL) {
+    report_error("failed to read the specified SQL file");
+    close(fd);
+    return NULL;
+  }
+
+  /* an empty file can't be mapped and has nothing to split anyway */
+  if (st.st_size == 0) {
+    close(fd);
+    return list;
+  }
+
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "failed to map (%s)\n", path);
+    sky_list_free(list);
+    return NULL;
+  }
+
+  /* the file is read once from the beginning to the end */
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  splitter_init(&splitter, data, st.st_size);
+
+  while (rv && list->size < MAX_LOADABLE_QUERIES &&
+         (statement = next_statement(&splitter, &length)) != NULL) {
+    if (!sky_list_push(list, statement, length)) {
+      report_error("out of memory");
+      rv = false;
+    }
+  }
+
+  if (splitter.error) {
+    report_error("invalid DELIMITER in the specified SQL file");
+    rv = false;
+  }
+
+  munmap(data, st.st_size);
+
+  if (!rv) {
+    sky_list_free(list);
+    return NULL;
+  }
+  return list;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_SPLITTER_H__
+#define __SKYLOAD_SPLITTER_H__
+
+#include "skyload.h"
+
+#define SPLIT_DELIMITER     ";"
+#define SPLIT_MAX_DELIMITER 16
+#define SPLIT_MAX_SET       8  /* bytes split_scan() looks for at once */
+
+#define DELIMITER_COMMAND     "delimiter"
+#define DELIMITER_COMMAND_LEN 9
+
+/* Breaks a SQL script such as a mysqldump file down into statements
+   the way the mysql client does. A delimiter only ends a statement
+   outside of quotes, identifiers and comments, and DELIMITER lines
+   change the delimiter for the statements that follow. Comments in
+   front of a statement are dropped, as are statements made of
+   nothing but comments. The bulk of a dump is in long runs of quoted
+   values, which are skipped over a vector register at a time. */
+typedef struct {
+  const char *pos;        /* first byte not split yet */
+  const char *end;
+  char delimiter[SPLIT_MAX_DELIMITER + 1];
+  size_t delimiter_len;
+  bool error;             /* a DELIMITER line without a valid delimiter */
+} SKY_SPLITTER;
+
+/* starts splitting the given script with ';' as the delimiter */
+void splitter_init(SKY_SPLITTER *splitter, const char *data, size_t size);
+
+/* returns the next statement without its delimiter and the whitespace
+   around it, and sets its length. the statement points into the
+   script. returns NULL once the script is exhausted or on error */
+const char *next_statement(SKY_SPLITTER *splitter, size_t *length);
+
+/* returns the first byte between 'pos' and 'end' that is one of the
+   'nset' bytes of the set, or 'end' if there's none. at most
+   SPLIT_MAX_SET bytes are looked for */
+const char *split_scan(const char *pos, const char *end, const char *set,
+                       size_t nset);
+
+/* maps the given file and lists its statements. returns NULL on error */
+SKY_LIST *split_file_to_list(const char *path);
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stats.h"
+
+static int msb(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1)
+    bit++;
+  return bit;
+}
+
+static uint32_t bucket_index(uint64_t usec) {
+  int bit;
+
+  if (usec < SKY_HIST_LINEAR)
+    return (uint32_t)usec;
+
+  if ((bit = msb(usec)) >= SKY_HIST_MAX_BITS)
+    return SKY_HIST_BUCKETS - 1;
+
+  return SKY_HIST_LINEAR + (bit - 6) * SKY_HIST_SUB +
+         (uint32_t)((usec >> (bit - SKY_HIST_SUB_BITS)) & (SKY_HIST_SUB - 1));
+}
+
+/* the largest value that falls into the given bucket */
+static uint64_t bucket_value(uint32_t index) {
+  uint32_t bit, sub;
+
+  if (index < SKY_HIST_LINEAR)
+    return index;
+
+  bit = (index - SKY_HIST_LINEAR) / SKY_HIST_SUB + 6;
+  sub = (index - SKY_HIST_LINEAR) % SKY_HIST_SUB;
+
+  return (((uint64_t)SKY_HIST_SUB + sub + 1) << (bit - SKY_HIST_SUB_BITS)) - 1;
+}
+
+void sky_histogram_reset(SKY_HISTOGRAM *hist) {
+  memset(hist, 0, sizeof(*hist));
+}
+
+void sky_histogram_add(SKY_HISTOGRAM *hist, uint64_t usec) {
+  if (hist->count == 0 || usec < hist->min)
+    hist->min = usec;
+  if (usec > hist->max)
+    hist->max = usec;
+
+  hist->count++;
+  hist->sum += usec;
+  hist->sumsq += (double)usec * usec;
+  hist->buckets[bucket_index(usec)]++;
+}
+
+void sky_histogram_merge(SKY_HISTOGRAM *dst, const SKY_HISTOGRAM *src) {
+  if (src->count == 0)
+    return;
+
+  if (dst->count == 0 || src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+
+  dst->count += src->count;
+  dst->sum += src->sum;
+  dst->sumsq += src->sumsq;
+
+  for (uint32_t i = 0; i < SKY_HIST_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+}
+
+uint64_t sky_histogram_percentile(const SKY_HISTOGRAM *hist,
+                                  double percentile) {
+  uint64_t rank, seen = 0;
+
+  if (hist->count == 0)
+    return 0;
+
+  rank = (uint64_t)(hist->count * percentile / 100.0 + 0.5);
+  if (rank < 1)
+    rank = 1;
+
+  for (uint32_t i = 0; i < SKY_HIST_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if (seen >= rank) {
+      uint64_t value = bucket_value(i);
+      return (value > hist->max) ? hist->max : value;
+    }
+  }
+  return hist->max;
+}
+
+uint64_t sky_histogram_cumulative(const SKY_HISTOGRAM *hist,
+                                  const uint64_t *bounds, uint32_t nbounds,
+                                  uint64_t *counts) {
+  uint64_t seen = 0;
+  uint32_t bound = 0;
+
+  for (uint32_t i = 0; i < SKY_HIST_BUCKETS; i++) {
+    uint64_t value = bucket_value(i);
+
+    for (; bound < nbounds && bounds[bound] < value; bound++)
+      counts[bound] = seen;
+
+    seen += hist->buckets[i];
+  }
+
+  for (; bound < nbounds; bound++)
+    counts[bound] = seen;
+
+  return seen;
+}
+
+double sky_histogram_mean(const SKY_HISTOGRAM *hist) {
+  return (hist->count) ? (double)hist->sum / hist->count : 0;
+}
+
+double sky_histogram_stddev(const SKY_HISTOGRAM *hist) {
+  double mean, variance;
+
+  if (hist->count < 2)
+    return 0;
+
+  mean = sky_histogram_mean(hist);
+  variance = (hist->sumsq - mean * mean * hist->count) / (hist->count - 1);
+  return (variance > 0) ? sqrt(variance) : 0;
+}
+
+SKY_INTERVAL *sky_timeline_at(SKY_TIMELINE *timeline, uint32_t index) {
+  if (index >= timeline->capacity) {
+    uint32_t capacity = (timeline->capacity) ? timeline->capacity : 64;
+    SKY_INTERVAL *intervals;
+
+    while (capacity <= index)
+      capacity *= 2;
+
+    intervals = realloc(timeline->intervals, capacity * sizeof(*intervals));
+
+    if (intervals == NULL)
+      return NULL;
+
+    memset(intervals + timeline->capacity, 0,
+           (capacity - timeline->capacity) * sizeof(*intervals));
+    timeline->intervals = intervals;
+    timeline->capacity = capacity;
+  }
+
+  if (index >= timeline->size)
+    timeline->size = index + 1;
+
+  return &timeline->intervals[index];
+}
+
+bool sky_timeline_merge(SKY_TIMELINE *dst, const SKY_TIMELINE *src) {
+  for (uint32_t i = src->size; i > 0; i--) {
+    SKY_INTERVAL *interval = sky_timeline_at(dst, i - 1);
+
+    if (interval == NULL)
+      return false;
+
+    interval->queries += src->intervals[i - 1].queries;
+    interval->errors += src->intervals[i - 1].errors;
+    interval->retries += src->intervals[i - 1].retries;
+  }
+  return true;
+}
+
+void sky_timeline_free(SKY_TIMELINE *timeline) {
+  free(timeline->intervals);
+  timeline->intervals = NULL;
+  timeline->size = 0;
+  timeline->capacity = 0;
+}
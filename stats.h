@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_STATS_H__
+#define __SKYLOAD_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Latencies below SKY_HIST_LINEAR usec get a bucket each. Above that,
+   every power of two is split into SKY_HIST_SUB buckets which keeps
+   the relative error of a recorded value within ~3%. */
+#define SKY_HIST_LINEAR    64
+#define SKY_HIST_SUB_BITS  5
+#define SKY_HIST_SUB       (1 << SKY_HIST_SUB_BITS)
+#define SKY_HIST_MAX_BITS  40
+#define SKY_HIST_BUCKETS   (SKY_HIST_LINEAR + \
+                            (SKY_HIST_MAX_BITS - 6) * SKY_HIST_SUB)
+
+/* Fixed size latency histogram. Each worker owns its histograms
+   so recording a value does not need any synchronization. */
+typedef struct {
+  uint64_t count;
+  uint64_t sum;
+  double sumsq;     /* sum of squares, for the standard deviation */
+  uint64_t min;
+  uint64_t max;
+  uint64_t buckets[SKY_HIST_BUCKETS];
+} SKY_HISTOGRAM;
+
+/* Outcome of the statements issued during one reporting interval */
+typedef struct {
+  uint64_t queries;  /* statements that succeeded */
+  uint64_t errors;   /* statements given up on */
+  uint64_t retries;  /* attempts that were repeated */
+} SKY_INTERVAL;
+
+/* Per-interval counters of a worker, grown on demand as the run
+   goes on. Like the histograms, every worker owns its timeline. */
+typedef struct {
+  SKY_INTERVAL *intervals;
+  uint32_t size;
+  uint32_t capacity;
+} SKY_TIMELINE;
+
+/* clears all recorded values */
+void sky_histogram_reset(SKY_HISTOGRAM *hist);
+
+/* records a latency in microseconds */
+void sky_histogram_add(SKY_HISTOGRAM *hist, uint64_t usec);
+
+/* adds the values recorded in 'src' to 'dst' */
+void sky_histogram_merge(SKY_HISTOGRAM *dst, const SKY_HISTOGRAM *src);
+
+/* returns the latency in microseconds at the given percentile
+   (e.g. 99.0). returns 0 if nothing has been recorded */
+uint64_t sky_histogram_percentile(const SKY_HISTOGRAM *hist,
+                                  double percentile);
+
+/* counts the values up to each of the given ascending bounds in
+   usec. a bucket counts towards a bound if its largest value is
+   within it, so a bound is as coarse as the bucket it falls in.
+   returns the number of values in the buckets */
+uint64_t sky_histogram_cumulative(const SKY_HISTOGRAM *hist,
+                                  const uint64_t *bounds, uint32_t nbounds,
+                                  uint64_t *counts);
+
+/* returns the average latency in microseconds */
+double sky_histogram_mean(const SKY_HISTOGRAM *hist);
+
+/* returns the standard deviation of the latency in microseconds */
+double sky_histogram_stddev(const SKY_HISTOGRAM *hist);
+
+/* returns the interval at the given index, growing the timeline if
+   necessary. returns NULL if out of memory */
+SKY_INTERVAL *sky_timeline_at(SKY_TIMELINE *timeline, uint32_t index);
+
+/* adds the intervals recorded in 'src' to 'dst' */
+bool sky_timeline_merge(SKY_TIMELINE *dst, const SKY_TIMELINE *src);
+
+/* releases the intervals of the timeline */
+void sky_timeline_free(SKY_TIMELINE *timeline);
+
+#endif
@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "status.h"
+#include "sweep.h"
+#include "scenario.h"
+
+SKY_STATUS *sky_status_new(SKY_SHARE *share) {
+  assert(share);
+
+  const char *list = (share->status_vars) ? share->status_vars :
+                                            STATUS_DEFAULT_VARS;
+  const char *pos = list;
+  SKY_STATUS *status;
+
+  if ((status = calloc(1, sizeof(*status))) == NULL)
+    return NULL;
+
+  status->share = share;
+
+  while (*pos != '\0') {
+    size_t length = strcspn(pos, ",");
+
+    if (length > 0) {
+      if (status->nvars == STATUS_MAX_VARS) {
+        report_error("too many status variables");
+        sky_status_free(status);
+        return NULL;
+      }
+
+      if ((status->names[status->nvars++] = strndup(pos, length)) == NULL) {
+        sky_status_free(status);
+        return NULL;
+      }
+    }
+
+    pos += length;
+    if (*pos == ',')
+      pos++;
+  }
+
+  /* the engine status figures are sampled like any other variable */
+  if (share->engine_status) {
+    if (status->nvars + 2 > STATUS_MAX_VARS) {
+      report_error("too many status variables");
+      sky_status_free(status);
+      return NULL;
+    }
+
+    status->names[status->nvars++] = strdup(ENGINE_HISTORY_LENGTH);
+    status->names[status->nvars++] = strdup(ENGINE_LOG_SEQUENCE);
+
+    if (status->names[status->nvars - 2] == NULL ||
+        status->names[status->nvars - 1] == NULL) {
+      sky_status_free(status);
+      return NULL;
+    }
+  }
+
+  pthread_mutex_init(&status->lock, NULL);
+  pthread_cond_init(&status->wakeup, NULL);
+  return status;
+}
+
+void sky_status_free(SKY_STATUS *status) {
+  if (status == NULL)
+    return;
+
+  if (status->running)
+    status_stop(status);
+
+  for (uint32_t i = 0; i < status->nvars; i++)
+    free(status->names[i]);
+
+  pthread_mutex_destroy(&status->lock);
+  pthread_cond_destroy(&status->wakeup);
+  free(status->samples);
+  free(status);
+}
+
+SKY_STATUS_SAMPLE *status_append(SKY_STATUS *status, bool boundary,
+                                 const char *label) {
+  SKY_STATUS_SAMPLE *sample;
+
+  /* the counters only go up, so the interval of a dropped sample is
+     covered by the one after it */
+  if (status->share->soak && status->nsamples >= STATUS_SOAK_SAMPLES) {
+    for (uint32_t i = 1; i < status->nsamples; i++) {
+      if (status->samples[i].boundary)
+        continue;
+
+      memmove(&status->samples[i], &status->samples[i + 1],
+              (status->nsamples - i - 1) * sizeof(*sample));
+      status->nsamples--;
+      break;
+    }
+  }
+
+  if (status->nsamples == status->capacity) {
+    uint32_t capacity = (status->capacity) ? status->capacity * 2 :
+                                             STATUS_INITIAL_CAPACITY;
+
+    sample = realloc(status->samples, capacity * sizeof(*sample));
+
+    if (sample == NULL)
+      return NULL;
+
+    status->samples = sample;
+    status->capacity = capacity;
+  }
+
+  sample = &status->samples[status->nsamples++];
+  memset(sample, 0, sizeof(*sample));
+  sample->time = current_usec();
+  sample->boundary = boundary;
+  snprintf(sample->label, STATUS_LABEL_SIZE, "%s", (label) ? label : "");
+  return sample;
+}
+
+void status_set_value(SKY_STATUS *status, SKY_STATUS_SAMPLE *sample,
+                      const char *name, const char *value) {
+  char *end;
+
+  for (uint32_t i = 0; i < status->nvars; i++) {
+    if (strcasecmp(status->names[i], name) != 0)
+      continue;
+
+    /* only counters are of interest, e.g. skip ON/OFF values */
+    uint64_t number = strtoull(value, &end, 10);
+
+    if (end != value) {
+      sample->values[i] = number;
+      status->found[i] = true;
+    }
+    return;
+  }
+}
+
+void parse_engine_status(SKY_STATUS *status, SKY_STATUS_SAMPLE *sample,
+                         const char *text) {
+  static const char *figures[][2] = {
+    {"History list length", ENGINE_HISTORY_LENGTH},
+    {"Log sequence number", ENGINE_LOG_SEQUENCE}
+  };
+
+  for (int i = 0; i < 2; i++) {
+    const char *pos = strstr(text, figures[i][0]);
+
+    if (pos == NULL)
+      continue;
+
+    pos += strlen(figures[i][0]);
+    while (*pos == ' ' || *pos == '\t')
+      pos++;
+
+    status_set_value(status, sample, figures[i][1], pos);
+  }
+}
+
+/* Runs a statement on the sampler connection. The result is left
+   buffered for the caller to read and free */
+static bool status_query(SKY_STATUS *status, const char *query,
+                         drizzle_result_st *result) {
+  drizzle_return_t ret;
+
+  drizzle_query_str(&status->connection, result, query, &ret);
+
+  if (ret == DRIZZLE_RETURN_OK) {
+    if ((ret = drizzle_result_buffer(result)) == DRIZZLE_RETURN_OK)
+      return true;
+    drizzle_result_free(result);
+  } else if (ret == DRIZZLE_RETURN_ERROR_CODE) {
+    drizzle_result_free(result);
+  }
+
+  /* complain once, the report will show the gaps anyway */
+  if (!status->failed) {
+    fprintf(stderr, "status sampler error: %s\n",
+            drizzle_con_error(&status->connection));
+    status->failed = true;
+  }
+  return false;
+}
+
+/* Takes a snapshot of the sampled variables */
+static bool take_sample(SKY_STATUS *status, bool boundary,
+                        const char *label) {
+  SKY_STATUS_SAMPLE *sample;
+  drizzle_result_st result;
+  drizzle_row_t row;
+
+  if ((sample = status_append(status, boundary, label)) == NULL)
+    return false;
+
+  if (!status_query(status, STATUS_QUERY, &result)) {
+    status->nsamples--;
+    return false;
+  }
+
+  while ((row = drizzle_row_next(&result)) != NULL) {
+    if (row[0] && row[1])
+      status_set_value(status, sample, row[0], row[1]);
+  }
+  drizzle_result_free(&result);
+
+  /* the engine status comes as a single row of Type, Name, Status */
+  if (status->share->engine_status) {
+    if (!status_query(status, ENGINE_STATUS_QUERY, &result))
+      return true;
+
+    row = drizzle_row_next(&result);
+
+    if (row && drizzle_result_column_count(&result) >= 3 && row[2])
+      parse_engine_status(status, sample, row[2]);
+
+    drizzle_result_free(&result);
+  }
+  return true;
+}
+
+static void *status_workload(void *arg) {
+  SKY_STATUS *status = (SKY_STATUS *)arg;
+  uint64_t interval = (uint64_t)status->share->report_interval * 1000000;
+  uint64_t next = status->share->start_time + interval;
+  char label[STATUS_LABEL_SIZE];
+
+  take_sample(status, true, NULL);
+
+  pthread_mutex_lock(&status->lock);
+
+  for (;;) {
+    /* sleep until the next interval unless a boundary is marked */
+    while (status->npending == 0 && !status->stop && current_usec() < next) {
+      struct timespec deadline;
+
+      deadline.tv_sec = next / 1000000;
+      deadline.tv_nsec = (next % 1000000) * 1000;
+      pthread_cond_timedwait(&status->wakeup, &status->lock, &deadline);
+    }
+
+    if (status->npending > 0) {
+      memcpy(label, status->pending[0], STATUS_LABEL_SIZE);
+      memmove(status->pending[0], status->pending[1],
+              --status->npending * STATUS_LABEL_SIZE);
+
+      pthread_mutex_unlock(&status->lock);
+      take_sample(status, true, label);
+      pthread_mutex_lock(&status->lock);
+      continue;
+    }
+
+    if (status->stop)
+      break;
+
+    pthread_mutex_unlock(&status->lock);
+    take_sample(status, false, NULL);
+    pthread_mutex_lock(&status->lock);
+
+    /* skip the intervals missed while the server was slow to answer */
+    while (next <= current_usec())
+      next += interval;
+  }
+
+  pthread_mutex_unlock(&status->lock);
+
+  take_sample(status, true, NULL);
+  return NULL;
+}
+
+bool status_start(SKY_STATUS *status) {
+  assert(status);
+
+  SKY_SHARE *share = status->share;
+
+  drizzle_create(&status->handle);
+
+  if (!sky_connect_target(share, &share->targets[0], &status->handle,
+                          &status->connection)) {
+    report_error("failed to initialize status connection");
+    drizzle_free(&status->handle);
+    return false;
+  }
+
+  if (pthread_create(&status->thread_id, NULL, status_workload,
+                     (void *)status)) {
+    report_error("failed to create status sampler thread");
+    sky_close_connection(&status->connection);
+    drizzle_free(&status->handle);
+    return false;
+  }
+
+  status->running = true;
+  return true;
+}
+
+void status_mark(SKY_STATUS *status, const char *label) {
+  if (status == NULL)
+    return;
+
+  pthread_mutex_lock(&status->lock);
+
+  if (status->npending < STATUS_MAX_PENDING) {
+    snprintf(status->pending[status->npending++], STATUS_LABEL_SIZE, "%s",
+             label);
+    pthread_cond_signal(&status->wakeup);
+  }
+
+  pthread_mutex_unlock(&status->lock);
+}
+
+void status_stop(SKY_STATUS *status) {
+  assert(status);
+
+  if (!status->running)
+    return;
+
+  pthread_mutex_lock(&status->lock);
+  status->stop = true;
+  pthread_cond_signal(&status->wakeup);
+  pthread_mutex_unlock(&status->lock);
+
+  pthread_join(status->thread_id, NULL);
+  status->running = false;
+
+  sky_close_connection(&status->connection);
+  drizzle_free(&status->handle);
+}
+
+void status_end_phase(SKY_WORKER *worker, sky_phase phase) {
+  assert(worker);
+
+  SKY_SHARE *share = worker->share;
+
+  /* phases are finished in order, skipped ones included */
+  for (; worker->phase <= phase; worker->phase++) {
+    sky_phase current = worker->phase;
+    uint32_t finished = __sync_add_and_fetch(&share->phase_finished[current],
+                                             1);
+
+    if (finished == share->concurrency && phase_enabled(share, current))
+      status_mark(share->status_sampler, phase_name(current));
+  }
+}
+
+/* Number of client statements issued during the named phase */
+static uint64_t phase_statements(SKY_SHARE *share, SKY_WORKER **workers,
+                                 const char *label) {
+  uint64_t count = 0;
+  uint32_t concurrency, step;
+
+  if (sscanf(label, "sweep-%u", &concurrency) == 1) {
+    for (uint32_t i = 0; share->sweep_results && i < share->nsweep; i++) {
+      if (share->sweep_results[i].concurrency == concurrency)
+        return share->sweep_results[i].queries;
+    }
+    return 0;
+  }
+
+  if (sscanf(label, "search-%u", &step) == 1) {
+    if (share->search_results && step >= 1 && step <= share->nsearch)
+      return share->search_results[step - 1].queries;
+    return 0;
+  }
+
+  if (strncmp(label, SCENARIO_LABEL, strlen(SCENARIO_LABEL)) == 0) {
+    const char *name = label + strlen(SCENARIO_LABEL);
+
+    for (uint32_t i = 0; share->scenario && i < share->scenario->nphases;
+         i++) {
+      SKY_SCENARIO_PHASE *phase = &share->scenario->phases[i];
+
+      if (strcmp(phase->name, name) == 0)
+        return phase->count[SKY_OP_READ] + phase->count[SKY_OP_INSERT];
+    }
+    return 0;
+  }
+
+  for (int i = 0; i < share->concurrency; i++) {
+    if (strcmp(label, phase_name(SKY_PHASE_INSERT)) == 0)
+      count += workers[i]->insert_latency.count;
+    else if (strcmp(label, phase_name(SKY_PHASE_WRITE)) == 0)
+      count += workers[i]->write_latency.count;
+    else if (strcmp(label, phase_name(SKY_PHASE_READ)) == 0)
+      count += workers[i]->read_latency.count;
+    else if (strcmp(label, phase_name(SKY_PHASE_REPLAY)) == 0)
+      count += workers[i]->replay_latency.count;
+  }
+  return count;
+}
+
+/* Growth of a variable between two samples. a counter that went
+   backwards, e.g. after a FLUSH STATUS, did not grow */
+static uint64_t status_delta(const SKY_STATUS_SAMPLE *from,
+                             const SKY_STATUS_SAMPLE *to, uint32_t var) {
+  if (to->values[var] < from->values[var])
+    return 0;
+  return to->values[var] - from->values[var];
+}
+
+static void print_phase_delta(SKY_STATUS *status, SKY_WORKER **workers,
+                              const SKY_STATUS_SAMPLE *from,
+                              const SKY_STATUS_SAMPLE *to) {
+  uint64_t statements = phase_statements(status->share, workers, to->label);
+  double secs = (double)(to->time - from->time) / 1000000;
+  char title[SKY_STRSIZ];
+
+  snprintf(title, sizeof(title), "Phase %s", to->label);
+
+  printf("\n");
+  printf("  %-23s: %.3lf secs, %llu statements\n", title, secs,
+         (unsigned long long)statements);
+  printf("    %-34s %14s %14s %12s\n", "Variable", "Delta", "Per Sec",
+         "Per Stmt");
+
+  for (uint32_t i = 0; i < status->nvars; i++) {
+    uint64_t delta = status_delta(from, to, i);
+
+    if (!status->found[i])
+      continue;
+
+    printf("    %-34s %14llu %14.1lf %12.3lf\n", status->names[i],
+           (unsigned long long)delta, (secs > 0) ? delta / secs : 0,
+           (statements) ? (double)delta / statements : 0);
+  }
+}
+
+void print_status_result(SKY_STATUS *status, SKY_WORKER **workers) {
+  assert(status && workers);
+
+  SKY_SHARE *share = status->share;
+  SKY_TIMELINE timeline = {NULL, 0, 0};
+  double interval = share->report_interval;
+  uint32_t start = 0;
+
+  if (status->nsamples < 2) {
+    report_error("not enough server status samples to report");
+    return;
+  }
+
+  printf("\n");
+  printf("[ SERVER STATUS BY PHASE ]\n");
+  printf("  Server                 : %s:%u\n", share->targets[0].host,
+         share->targets[0].port);
+
+  /* a labelled boundary ends the phase that began at the previous one */
+  for (uint32_t i = 1; i < status->nsamples; i++) {
+    if (!status->samples[i].boundary)
+      continue;
+
+    if (status->samples[i].label[0] != '\0')
+      print_phase_delta(status, workers, &status->samples[start],
+                        &status->samples[i]);
+    start = i;
+  }
+
+  /* the client side goodput of the same intervals */
+  for (int i = 0; i < share->concurrency; i++)
+    sky_timeline_merge(&timeline, &workers[i]->timeline);
+
+  printf("\n");
+  printf("[ SERVER STATUS PER INTERVAL ]\n");
+  printf("  %-9s %11s  %s\n", "Time (s)", "Client q/s",
+         "Server deltas per second");
+
+  for (uint32_t i = 1; i < status->nsamples; i++) {
+    const SKY_STATUS_SAMPLE *from = &status->samples[i - 1];
+    const SKY_STATUS_SAMPLE *to = &status->samples[i];
+    double secs = (double)(to->time - from->time) / 1000000;
+    double offset = (double)(to->time - share->start_time) / 1000000;
+    int64_t index = (int64_t)(offset / interval + 0.5) - 1;
+    double client = 0;
+    bool first = true;
+
+    if (to->boundary || secs <= 0)
+      continue;
+
+    if (index >= 0 && index < timeline.size)
+      client = timeline.intervals[index].queries / interval;
+
+    /* the client side figures of a soak test are in the soak file */
+    if (share->soak)
+      printf("  %-9.1lf %11s  ", offset, "-");
+    else
+      printf("  %-9.1lf %11.1lf  ", offset, client);
+
+    for (uint32_t j = 0; j < status->nvars; j++) {
+      uint64_t delta = status_delta(from, to, j);
+
+      if (!status->found[j] || delta == 0)
+        continue;
+
+      printf("%s%s %.1lf", (first) ? "" : ", ", status->names[j],
+             delta / secs);
+      first = false;
+    }
+    printf("\n");
+  }
+
+  sky_timeline_free(&timeline);
+}
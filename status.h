@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_STATUS_H__
+#define __SKYLOAD_STATUS_H__
+
+#include "skyload.h"
+
+#define STATUS_MAX_VARS     48
+#define STATUS_MAX_PENDING  16
+#define STATUS_LABEL_SIZE   48
+#define STATUS_INITIAL_CAPACITY 64
+#define STATUS_SOAK_SAMPLES 1440 /* samples kept by a soak test */
+
+#define STATUS_QUERY        "SHOW GLOBAL STATUS"
+#define ENGINE_STATUS_QUERY "SHOW ENGINE INNODB STATUS"
+
+/* Counters sampled unless --status-vars says otherwise */
+#define STATUS_DEFAULT_VARS \
+  "Questions,Com_select,Com_insert,Com_update,Com_delete,Com_commit," \
+  "Com_rollback,Innodb_rows_read,Innodb_rows_inserted," \
+  "Innodb_rows_updated,Innodb_rows_deleted," \
+  "Innodb_buffer_pool_read_requests,Innodb_buffer_pool_reads," \
+  "Innodb_row_lock_waits,Innodb_row_lock_time,Innodb_data_fsyncs," \
+  "Innodb_os_log_written,Handler_read_rnd_next,Created_tmp_disk_tables," \
+  "Bytes_received,Bytes_sent"
+
+/* Figures picked out of the engine status text with --engine-status */
+#define ENGINE_HISTORY_LENGTH "History_list_length"
+#define ENGINE_LOG_SEQUENCE   "Log_sequence_number"
+
+/* Snapshot of the sampled variables */
+typedef struct {
+  uint64_t time;                  /* usec timestamp */
+  bool boundary;                  /* taken at a phase boundary */
+  char label[STATUS_LABEL_SIZE];  /* phase that ended here, if any */
+  uint64_t values[STATUS_MAX_VARS];
+} SKY_STATUS_SAMPLE;
+
+/* Samples the server status from a thread and connection of its own.
+   Samples are taken every --report-interval seconds and whenever a
+   phase boundary is marked. Only the sampler thread touches the
+   samples until it has been stopped. A soak test keeps the latest
+   STATUS_SOAK_SAMPLES of them, the older intervals folding into one. */
+typedef struct _sky_status {
+  SKY_SHARE *share;
+  drizzle_st handle;
+  drizzle_con_st connection;
+  pthread_t thread_id;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  bool running;
+  bool stop;
+  char pending[STATUS_MAX_PENDING][STATUS_LABEL_SIZE]; /* marked phases */
+  uint32_t npending;
+  char *names[STATUS_MAX_VARS];   /* variables to sample */
+  bool found[STATUS_MAX_VARS];    /* whether the server reported it */
+  uint32_t nvars;
+  SKY_STATUS_SAMPLE *samples;
+  uint32_t nsamples;
+  uint32_t capacity;
+  bool failed;                    /* a sample could not be taken */
+} SKY_STATUS;
+
+/* allocator and deallocator of the sampler. the variable list comes
+   from --status-vars or STATUS_DEFAULT_VARS */
+SKY_STATUS *sky_status_new(SKY_SHARE *share);
+void sky_status_free(SKY_STATUS *status);
+
+/* appends an empty sample, dropping the oldest one between phase
+   boundaries if a soak test has kept enough. returns NULL if out of
+   memory */
+SKY_STATUS_SAMPLE *status_append(SKY_STATUS *status, bool boundary,
+                                 const char *label);
+
+/* stores the value of a status variable if it's one being sampled */
+void status_set_value(SKY_STATUS *status, SKY_STATUS_SAMPLE *sample,
+                      const char *name, const char *value);
+
+/* picks the history list length and the log sequence number out of
+   the InnoDB engine status text */
+void parse_engine_status(SKY_STATUS *status, SKY_STATUS_SAMPLE *sample,
+                         const char *text);
+
+/* connects to the first primary and starts sampling */
+bool status_start(SKY_STATUS *status);
+
+/* asks for a sample at the end of the named phase. an empty label
+   marks the start of a measurement instead */
+void status_mark(SKY_STATUS *status, const char *label);
+
+/* takes a final sample and stops the sampler thread */
+void status_stop(SKY_STATUS *status);
+
+/* called by a worker once it's done with a phase. the last worker
+   to finish marks the phase boundary */
+void status_end_phase(SKY_WORKER *worker, sky_phase phase);
+
+/* prints the deltas of every phase and interval next to the client
+   side figures of the workers */
+void print_status_result(SKY_STATUS *status, SKY_WORKER **workers);
+
+#endif
@@ -0,0 +1,501 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <math.h>
+#include "sweep.h"
+#include "generator.h"
+#include "retry.h"
+#include "resources.h"
+#include "status.h"
+#include "metrics.h"
+
+/* Runs the read queries in a loop until the end of the measurement
+   window. Latencies observed before 'measure_start' are warmup and
+   are not recorded. A paced worker sends a statement every
+   'sweep_interval' usecs and its latency counts from when it was
+   due, so that a server falling behind the rate isn't hidden by the
+   statements the worker couldn't send in time. The CPU the worker
+   uses is accounted over the measurement window */
+static void *sweep_workload(void *arg) {
+  assert(arg);
+
+  SKY_WORKER *context = (SKY_WORKER *)arg;
+  SKY_LIST *queries = context->share->read_queries;
+  SKY_LIST_NODE *current;
+  drizzle_con_st *conn = context->read_connection;
+  sky_error_class error;
+  uint64_t start, now;
+  bool measuring = false;
+  size_t i = 0;
+
+  /* the file is run over and over in the order of --read-order */
+  if (!plan_read_order(context)) {
+    context->aborted = true;
+    return NULL;
+  }
+
+  while ((start = current_usec()) < context->measure_end) {
+    if (!measuring && start >= context->measure_start) {
+      worker_rusage_begin(context);
+      measuring = true;
+    }
+
+    if (context->sweep_interval > 0) {
+      if (context->sweep_next > start)
+        sleep_usec((uint64_t)context->sweep_next - start);
+
+      start = context->sweep_next;
+      context->sweep_next += context->sweep_interval;
+    }
+
+    current = queries->nodes[context->read_order[i]];
+    error = execute_query(context, conn, context->read_target_index,
+                          current->data, current->length,
+                          SKY_EXEC_BUFFER | SKY_EXEC_RETRY, NULL);
+
+    if (error == SKY_ERROR_FATAL) {
+      context->aborted = true;
+      return NULL;
+    }
+
+    now = current_usec();
+
+    /* statements that failed for good don't count as throughput, nor
+       do those a paced worker was due to send past the window */
+    if (error == SKY_ERROR_NONE && start >= context->measure_start &&
+        start < context->measure_end) {
+      sky_histogram_add(&context->latency, now - start);
+      sky_histogram_add(&context->read_latency, now - start);
+      context->sweep_queries++;
+    }
+
+    if (++i == queries->size) {
+      i = 0;
+      if (!plan_read_order(context)) {
+        context->aborted = true;
+        return NULL;
+      }
+    }
+  }
+  worker_rusage_end(context);
+  return NULL;
+}
+
+/* Runs a single level of the sweep with the first 'concurrency'
+   workers, sharing 'rate' statements/sec between them if it isn't 0.
+   Their connections stay open across levels. */
+static bool run_sweep_level(SKY_SHARE *share, SKY_WORKER **workers,
+                            uint32_t concurrency, double rate,
+                            const char *label, SKY_SWEEP_LEVEL *level) {
+  SKY_HISTOGRAM *merged;
+  SKY_RUSAGE total, client_begin, client_end, client;
+  bool sampled = false;
+  uint64_t begin = current_usec();
+  uint64_t measure_start = begin + (uint64_t)share->warmup_time * 1000000;
+  uint64_t measure_end = measure_start + (uint64_t)share->sweep_time * 1000000;
+  bool rv = true;
+
+  if ((merged = malloc(sizeof(*merged))) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+  sky_histogram_reset(merged);
+  memset(&total, 0, sizeof(total));
+  memset(&client, 0, sizeof(client));
+
+  for (uint32_t i = 0; i < concurrency; i++) {
+    sky_histogram_reset(&workers[i]->latency);
+    memset(&workers[i]->rusage, 0, sizeof(workers[i]->rusage));
+    workers[i]->rusage_start.wall = 0;
+    workers[i]->sweep_queries = 0;
+    workers[i]->measure_start = measure_start;
+    workers[i]->measure_end = measure_end;
+
+    /* the paced workers take turns rather than sending at once */
+    workers[i]->sweep_interval = (rate > 0) ? concurrency * 1e6 / rate : 0;
+    workers[i]->sweep_next = begin + workers[i]->sweep_interval * i /
+                             concurrency;
+    workers[i]->phase = SKY_PHASE_READ;
+
+    if (pthread_create(&workers[i]->thread_id, NULL, sweep_workload,
+                       (void *)workers[i])) {
+      report_error("failed to create worker thread");
+      concurrency = i;
+      rv = false;
+      break;
+    }
+  }
+
+  /* the server status and the CPU of the client are sampled over
+     the measurement only */
+  if (rv) {
+    uint64_t now = current_usec();
+
+    if (now < measure_start)
+      sleep_usec(measure_start - now);
+    if (share->status_sampler)
+      status_mark(share->status_sampler, "");
+
+    if (sample_rusage(&client_begin, false)) {
+      if ((now = current_usec()) < measure_end)
+        sleep_usec(measure_end - now);
+      sampled = sample_rusage(&client_end, false);
+    }
+  }
+
+  for (uint32_t i = 0; i < concurrency; i++) {
+    pthread_join(workers[i]->thread_id, NULL);
+    workers[i]->phase = SKY_NPHASES;
+
+    if (workers[i]->aborted)
+      rv = false;
+
+    sky_histogram_merge(merged, &workers[i]->latency);
+    total.wall += workers[i]->rusage.wall;
+    total.cpu += workers[i]->rusage.cpu;
+  }
+
+  if (sampled)
+    client = rusage_diff(&client_begin, &client_end);
+
+  if (share->status_sampler && rv)
+    status_mark(share->status_sampler, label);
+
+  level->concurrency = concurrency;
+  level->rate = rate;
+  level->queries = merged->count;
+  level->qps = (double)merged->count * 1000000 / (measure_end - measure_start);
+  level->mean = sky_histogram_mean(merged);
+  level->p99 = sky_histogram_percentile(merged, 99.0);
+  level->slo = sky_histogram_percentile(merged, share->slo_percentile);
+  level->met = (merged->count > 0 && level->slo <= share->slo_latency);
+  level->cpu = (merged->count) ? (double)total.cpu / merged->count : 0;
+  level->busy = rusage_busy(&total, 1);
+  level->load = rusage_busy(&client, online_cpus());
+
+  if (rv)
+    warn_client_bound(level->load, level->busy, label);
+
+  free(merged);
+  return rv;
+}
+
+int find_saturation_point(const SKY_SWEEP_LEVEL *levels, uint32_t nlevels) {
+  for (uint32_t i = 1; i < nlevels; i++) {
+    if (levels[i].qps < levels[i-1].qps * SWEEP_SCALING_GAIN &&
+        levels[i].p99 > levels[i-1].p99)
+      return i - 1;
+  }
+  return -1;
+}
+
+static void print_sweep_result(SKY_SHARE *share, SKY_SWEEP_LEVEL *levels,
+                               uint32_t nlevels) {
+  int knee = find_saturation_point(levels, nlevels);
+
+  printf("\n");
+  printf("[ CONCURRENCY SWEEP RESULT ]\n");
+  printf("  SQL File               : %s\n", share->read_file_path);
+  printf("  Warmup per Level       : %u secs\n", share->warmup_time);
+  printf("  Measurement per Level  : %u secs\n", share->sweep_time);
+  printf("\n");
+  printf("  Concurrency   Queries/sec    Avg (ms)    p99 (ms)   Scaling"
+         "  CPU/Query (us)  Client CPU\n");
+
+  for (uint32_t i = 0; i < nlevels; i++) {
+    /* throughput relative to linear scaling from the first level */
+    double linear = levels[0].qps * levels[i].concurrency /
+                    levels[0].concurrency;
+
+    printf("  %11u %13.1lf %11.3lf %11.3lf %8.1lf%% %15.1lf %10.1lf%%\n",
+           levels[i].concurrency, levels[i].qps, levels[i].mean / 1000,
+           (double)levels[i].p99 / 1000,
+           (linear > 0) ? levels[i].qps / linear * 100 : 0,
+           levels[i].cpu, levels[i].load * 100);
+  }
+
+  printf("\n");
+  if (knee >= 0)
+    printf("  Saturation Point       : %u connections (%.1lf queries/sec)\n",
+           levels[knee].concurrency, levels[knee].qps);
+  else
+    printf("  Saturation Point       : not reached\n");
+}
+
+/* Closes the connections of the workers opened so far and frees them */
+static void close_sweep_workers(SKY_SHARE *share, SKY_WORKER **workers,
+                                uint32_t nworkers) {
+  /* the exporter keeps the counts of the workers */
+  if (share->metrics)
+    metrics_publish(share->metrics, NULL, 0);
+
+  for (uint32_t i = 0; i < nworkers; i++) {
+    if (workers[i] == NULL)
+      continue;
+    sky_worker_disconnect(workers[i]);
+    drizzle_free(&workers[i]->database_handle);
+    sky_worker_free(workers[i]);
+  }
+  free(workers);
+}
+
+/* Opens the connections of the given number of workers up front so
+   that they are reused by every level. returns NULL on error */
+static SKY_WORKER **open_sweep_workers(SKY_SHARE *share, uint32_t nworkers) {
+  SKY_WORKER **workers = calloc(nworkers, sizeof(*workers));
+
+  if (workers == NULL) {
+    report_error("out of memory");
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < nworkers; i++) {
+    if ((workers[i] = sky_worker_new()) == NULL) {
+      report_error("out of memory");
+      close_sweep_workers(share, workers, nworkers);
+      return NULL;
+    }
+
+    workers[i]->share = share;
+    workers[i]->unique_id = i + 1;
+    workers[i]->phase = SKY_NPHASES;
+    assign_targets(workers[i]);
+    drizzle_create(&workers[i]->database_handle);
+
+    if (!sky_worker_connect(workers[i])) {
+      drizzle_free(&workers[i]->database_handle);
+      sky_worker_free(workers[i]);
+      workers[i] = NULL;
+      close_sweep_workers(share, workers, nworkers);
+      return NULL;
+    }
+  }
+
+  if (share->metrics)
+    metrics_publish(share->metrics, workers, nworkers);
+  return workers;
+}
+
+bool run_concurrency_sweep(SKY_SHARE *share) {
+  assert(share && share->sweep_levels && share->read_queries);
+
+  SKY_SWEEP_LEVEL *levels;
+  SKY_WORKER **workers;
+  uint32_t nworkers = 0;
+  bool rv = true;
+
+  for (uint32_t i = 0; i < share->nsweep; i++) {
+    if (share->sweep_levels[i] > nworkers)
+      nworkers = share->sweep_levels[i];
+  }
+
+  if ((levels = calloc(share->nsweep, sizeof(*levels))) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+
+  if ((workers = open_sweep_workers(share, nworkers)) == NULL) {
+    free(levels);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < share->nsweep && rv; i++) {
+    uint32_t concurrency = share->sweep_levels[i];
+    char label[STATUS_LABEL_SIZE];
+
+    fprintf(stdout, "Concurrency Sweep: %u connections\n", concurrency);
+    snprintf(label, sizeof(label), "sweep-%u", concurrency);
+
+    if (!run_sweep_level(share, workers, concurrency, 0, label,
+                         &levels[i])) {
+      report_error("failed to run concurrency sweep");
+      rv = false;
+    }
+  }
+
+  /* the levels are kept for --json and --compare */
+  if (rv) {
+    print_sweep_result(share, levels, share->nsweep);
+    share->sweep_results = levels;
+    levels = NULL;
+  }
+
+  close_sweep_workers(share, workers, nworkers);
+  free(levels);
+  return rv;
+}
+
+double next_search_value(SKY_SEARCH_BOUNDS *bounds, double value, bool met) {
+  assert(bounds && value > 0);
+
+  double next;
+
+  if (met && value > bounds->pass)
+    bounds->pass = value;
+  if (!met && (bounds->fail == 0 || value < bounds->fail))
+    bounds->fail = value;
+
+  /* nothing missed the target yet, so the search reaches further */
+  if (bounds->fail == 0) {
+    if (value >= bounds->ceiling)
+      return 0;
+    return (value * 2 < bounds->ceiling) ? value * 2 : bounds->ceiling;
+  }
+
+  if (bounds->integral) {
+    if (bounds->fail - bounds->pass <= 1)
+      return 0;
+    next = floor((bounds->pass + bounds->fail) / 2);
+  } else {
+    if (bounds->fail - bounds->pass <= bounds->fail * SEARCH_PRECISION)
+      return 0;
+    next = (bounds->pass + bounds->fail) / 2;
+  }
+  return next;
+}
+
+int find_operating_point(const SKY_SWEEP_LEVEL *steps, uint32_t nsteps) {
+  int best = -1;
+
+  for (uint32_t i = 0; i < nsteps; i++) {
+    if (steps[i].met && (best < 0 || steps[i].qps > steps[best].qps))
+      best = i;
+  }
+  return best;
+}
+
+static void print_search_result(SKY_SHARE *share, SKY_SWEEP_LEVEL *steps,
+                                uint32_t nsteps) {
+  int point = find_operating_point(steps, nsteps);
+  char percentile[16];
+
+  snprintf(percentile, sizeof(percentile), "p%g", share->slo_percentile);
+
+  printf("\n");
+  printf("[ SLO SEARCH RESULT ]\n");
+  printf("  SQL File               : %s\n", share->read_file_path);
+  printf("  Latency Target         : %s <= %.3lf ms\n", percentile,
+         (double)share->slo_latency / 1000);
+  if (share->search == SKY_SEARCH_RATE)
+    printf("  Adjusted               : offered rate of %u connections\n",
+           share->concurrency);
+  else
+    printf("  Adjusted               : connections, %u at most\n",
+           share->concurrency);
+  printf("  Warmup per Step        : %u secs\n", share->warmup_time);
+  printf("  Measurement per Step   : %u secs\n", share->sweep_time);
+  printf("\n");
+  printf("  Step  Connections  Offered (q/s)  Queries/sec  %6s (ms)  Target"
+         "  CPU/Query (us)  Client CPU\n", percentile);
+
+  for (uint32_t i = 0; i < nsteps; i++) {
+    char offered[32] = "unpaced";
+
+    if (steps[i].rate > 0)
+      snprintf(offered, sizeof(offered), "%.1lf", steps[i].rate);
+
+    printf("  %4u %12u %14s %12.1lf %11.3lf  %-6s %15.1lf %10.1lf%%\n",
+           i + 1, steps[i].concurrency, offered, steps[i].qps,
+           (double)steps[i].slo / 1000, (steps[i].met) ? "met" : "missed",
+           steps[i].cpu, steps[i].load * 100);
+  }
+
+  printf("\n");
+  if (point < 0) {
+    printf("  Operating Point        : not found, the target was missed "
+           "at the lightest load\n");
+    return;
+  }
+
+  printf("  Operating Point        : %.1lf queries/sec at %u connections",
+         steps[point].qps, steps[point].concurrency);
+  if (steps[point].rate > 0)
+    printf(", %.1lf offered", steps[point].rate);
+  printf(" (%s %.3lf ms)\n", percentile, (double)steps[point].slo / 1000);
+}
+
+bool run_slo_search(SKY_SHARE *share) {
+  assert(share && share->search != SKY_SEARCH_NONE && share->read_queries);
+
+  SKY_SEARCH_BOUNDS bounds;
+  SKY_SWEEP_LEVEL *steps;
+  SKY_WORKER **workers;
+  uint32_t nsteps = 0;
+  double value;
+  bool rv = true;
+
+  if ((steps = calloc(SEARCH_MAX_STEPS, sizeof(*steps))) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+
+  if ((workers = open_sweep_workers(share, share->concurrency)) == NULL) {
+    free(steps);
+    return false;
+  }
+
+  memset(&bounds, 0, sizeof(bounds));
+
+  /* the rate search starts from what the workers manage unpaced, and
+     the worker search from a single worker */
+  if (share->search == SKY_SEARCH_RATE) {
+    value = 0;
+  } else {
+    value = 1;
+    bounds.ceiling = share->concurrency;
+    bounds.integral = true;
+  }
+
+  while (nsteps < SEARCH_MAX_STEPS && !stop_requested()) {
+    SKY_SWEEP_LEVEL *step = &steps[nsteps];
+    uint32_t concurrency = (bounds.integral) ? (uint32_t)value :
+                           share->concurrency;
+    double rate = (bounds.integral) ? 0 : value;
+    char label[STATUS_LABEL_SIZE];
+
+    if (rate > 0)
+      fprintf(stdout, "SLO Search: %u connections at %.1lf queries/sec\n",
+              concurrency, rate);
+    else
+      fprintf(stdout, "SLO Search: %u connections\n", concurrency);
+
+    snprintf(label, sizeof(label), "search-%u", nsteps + 1);
+
+    if (!run_sweep_level(share, workers, concurrency, rate, label, step)) {
+      report_error("failed to run SLO search");
+      rv = false;
+      break;
+    }
+    nsteps++;
+
+    /* an unpaced run that misses the target bounds the rate */
+    if (!bounds.integral && value == 0) {
+      if (step->met || step->qps <= 0)
+        break;
+      bounds.fail = bounds.ceiling = step->qps;
+      value = step->qps / 2;
+      continue;
+    }
+
+    if ((value = next_search_value(&bounds, value, step->met)) == 0)
+      break;
+  }
+
+  /* the steps are kept for --json, --compare and the status sampler */
+  if (rv) {
+    print_search_result(share, steps, nsteps);
+    share->search_results = steps;
+    share->nsearch = nsteps;
+    share->search_point = find_operating_point(steps, nsteps);
+    steps = NULL;
+  }
+
+  close_sweep_workers(share, workers, share->concurrency);
+  free(steps);
+  return rv;
+}
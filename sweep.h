@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_SWEEP_H__
+#define __SKYLOAD_SWEEP_H__
+
+#include "skyload.h"
+
+/* A level is considered saturated when its throughput is less than
+   SWEEP_SCALING_GAIN times the throughput of the previous level
+   while the p99 latency went up */
+#define SWEEP_SCALING_GAIN 1.05
+
+#define SEARCH_MAX_STEPS 16   /* levels the --slo search runs at most */
+#define SEARCH_PRECISION 0.05 /* the rate search stops within 5% */
+
+/* Result of a single concurrency level */
+typedef struct _sky_sweep_level {
+  uint32_t concurrency;
+  uint64_t queries;
+  double qps;
+  double mean;      /* usec */
+  uint64_t p99;     /* usec */
+  double rate;      /* offered queries/sec, 0 if unpaced */
+  uint64_t slo;     /* usec at the --slo percentile */
+  bool met;         /* whether 'slo' is within the latency target */
+  double cpu;       /* usec of worker CPU per statement */
+  double busy;      /* share of their time the workers were on the CPU */
+  double load;      /* share of the CPUs the client kept busy */
+} SKY_SWEEP_LEVEL;
+
+/* What the --slo search knows so far. The throughput is assumed to
+   meet the target up to some value of the adjusted knob and to miss
+   it past that */
+typedef struct {
+  double pass;      /* highest value that met the target, 0 if none */
+  double fail;      /* lowest value that missed it, 0 if none */
+  double ceiling;   /* highest value the search may try */
+  bool integral;    /* whether the values are numbers of workers */
+} SKY_SEARCH_BOUNDS;
+
+/* returns the index of the level where throughput stopped scaling,
+   i.e. the last level that still scaled. -1 if it never stopped */
+int find_saturation_point(const SKY_SWEEP_LEVEL *levels, uint32_t nlevels);
+
+/* runs the read load at each of the user specified concurrency
+   levels against the already loaded database and prints the
+   throughput and latency of every level */
+bool run_concurrency_sweep(SKY_SHARE *share);
+
+/* narrows the bounds down with the outcome of a level run at the
+   given value and returns the value to try next. values are doubled
+   until one misses the target and bisected from then on. returns 0
+   once the bounds are as close as they need to be */
+double next_search_value(SKY_SEARCH_BOUNDS *bounds, double value, bool met);
+
+/* returns the step of the search with the highest throughput that
+   met the target, -1 if none did */
+int find_operating_point(const SKY_SWEEP_LEVEL *steps, uint32_t nsteps);
+
+/* searches for the highest throughput of the read load whose latency
+   stays within --slo, by adjusting the offered rate or the number of
+   workers, and prints the steps it took and where it ended up */
+bool run_slo_search(SKY_SHARE *share);
+
+#endif
@@ -0,0 +1,137 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../generator.h"
+
+static bool arena_alloc_test(void);
+static bool arena_reuse_test(void);
+static bool insert_query_size_test(void);
+
+int main(void) {
+  if (arena_alloc_test() == false)
+    return EXIT_FAILURE;
+  if (arena_reuse_test() == false)
+    return EXIT_FAILURE;
+  if (insert_query_size_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool arena_alloc_test(void) {
+  SKY_ARENA arena;
+  char *first, *second, *large;
+
+  sky_arena_init(&arena);
+
+  if ((first = arena_alloc(&arena, 3)) == NULL ||
+      (second = arena_alloc(&arena, 5)) == NULL)
+    return false;
+
+  /* allocations are aligned and don't overlap */
+  if ((uintptr_t)second % SKY_ARENA_ALIGN != 0 || second - first != 8)
+    return false;
+
+  /* an allocation larger than a chunk gets a chunk of its own */
+  if ((large = arena_alloc(&arena, SKY_ARENA_SIZE * 2)) == NULL)
+    return false;
+
+  memset(large, 'x', SKY_ARENA_SIZE * 2);
+
+  if (arena.chunks != 2)
+    return false;
+
+  sky_arena_free(&arena);
+  return (arena.head == NULL);
+}
+
+static bool arena_reuse_test(void) {
+  SKY_ARENA arena;
+  SKY_ARENA_MARK mark;
+  char *first, *ptr;
+
+  sky_arena_init(&arena);
+
+  /* the first round takes the chunks from the heap */
+  if ((first = arena_alloc(&arena, 100)) == NULL)
+    return false;
+
+  for (int i = 0; i < 10; i++) {
+    if (arena_alloc(&arena, SKY_ARENA_SIZE / 4) == NULL)
+      return false;
+  }
+
+  uint64_t chunks = arena.chunks;
+
+  /* later rounds don't touch the heap anymore */
+  for (int round = 0; round < 100; round++) {
+    arena_reset(&arena);
+
+    if ((ptr = arena_alloc(&arena, 100)) != first)
+      return false;
+
+    for (int i = 0; i < 10; i++) {
+      if (arena_alloc(&arena, SKY_ARENA_SIZE / 4) == NULL)
+        return false;
+    }
+  }
+
+  if (arena.chunks != chunks)
+    return false;
+
+  /* rewinding hands out the same memory again */
+  arena_reset(&arena);
+  arena_alloc(&arena, 16);
+  mark = arena_mark(&arena);
+  ptr = arena_alloc(&arena, 32);
+  arena_alloc(&arena, SKY_ARENA_SIZE);
+  arena_rewind(&arena, mark);
+
+  if (arena_alloc(&arena, 32) != ptr)
+    return false;
+
+  sky_arena_free(&arena);
+  return true;
+}
+
+static bool insert_query_size_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_TABLE *table;
+  char *buffer;
+  size_t size;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->ntables = 1;
+  table = &share->tables[0];
+  table->insert_tmpl = strdup("insert into t1 values (%seq,%rand,%seq,%rand)");
+  table->columns = 4;
+  table->nwrite = 10;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  workers[0]->table = table;
+  size = insert_query_size(table);
+
+  /* the generated query fits in the arena allocation */
+  arena_reset(&workers[0]->arena);
+
+  if ((buffer = arena_alloc(&workers[0]->arena, size)) == NULL)
+    return false;
+
+  if (next_insert_query(workers[0], buffer, size) == 0 ||
+      strlen(buffer) >= size)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
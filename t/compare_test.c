@@ -0,0 +1,287 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../compare.h"
+#include "../runs.h"
+
+static bool fingerprint_test(void);
+static bool result_file_test(void);
+static bool regression_test(void);
+static bool collect_test(void);
+
+int main(void) {
+  if (fingerprint_test() == false)
+    return EXIT_FAILURE;
+  if (result_file_test() == false)
+    return EXIT_FAILURE;
+  if (regression_test() == false)
+    return EXIT_FAILURE;
+  if (collect_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool fingerprint_is(const char *query, const char *expected) {
+  char buffer[SKY_STRSIZ];
+
+  query_fingerprint(query, buffer, SKY_STRSIZ);
+  return (strcmp(buffer, expected) == 0);
+}
+
+static bool fingerprint_test(void) {
+  if (!fingerprint_is("SELECT * FROM t1 WHERE id = 42;",
+                      "select * from t1 where id = ?"))
+    return false;
+
+  if (!fingerprint_is("select  name\n from t1\twhere name='it''s'",
+                      "select name from t1 where name=?"))
+    return false;
+
+  if (!fingerprint_is("SELECT a FROM t2 WHERE b IN (1, 2, 3) AND c = \"x\\\"y\"",
+                      "select a from t2 where b in (?) and c = ?"))
+    return false;
+
+  /* digits that are part of an identifier are kept */
+  if (!fingerprint_is("select c1 from t1 limit 10",
+                      "select c1 from t1 limit ?"))
+    return false;
+
+  if (!fingerprint_is("select 1.5e3, 0x1f", "select ?"))
+    return false;
+
+  return true;
+}
+
+static bool result_file_test(void) {
+  SKY_RESULT *result, *loaded;
+  SKY_RESULT_ENTRY *entry;
+  const SKY_RESULT_ENTRY *found;
+  char path[] = "/tmp/skyload_compare_XXXXXX";
+  int fd;
+
+  if ((fd = mkstemp(path)) < 0)
+    return false;
+  close(fd);
+
+  if ((result = sky_result_new()) == NULL)
+    return false;
+
+  if ((entry = sky_result_add(result, SKY_RESULT_PHASE, "read")) == NULL)
+    return false;
+
+  entry->count = 1000;
+  entry->qps = 2500.5;
+  entry->mean = 400.25;
+  entry->stddev = 20;
+  entry->p50 = 390;
+  entry->p95 = 450;
+  entry->p99 = 520;
+  entry->runs = 5;
+  entry->qps_stddev = 12.5;
+
+  entry = sky_result_add(result, SKY_RESULT_QUERY,
+                         "select \"a\\b\" from t where x = ?");
+  if (entry == NULL)
+    return false;
+
+  entry->count = 500;
+
+  if (!write_result_file(path, result))
+    return false;
+
+  if ((loaded = load_result_file(path)) == NULL)
+    return false;
+
+  unlink(path);
+
+  if (loaded->size != 2)
+    return false;
+
+  found = sky_result_find(loaded, SKY_RESULT_PHASE, "read");
+
+  if (found == NULL || found->count != 1000 || found->qps != 2500.5 ||
+      found->mean != 400.25 || found->p99 != 520 || found->runs != 5 ||
+      found->qps_stddev != 12.5)
+    return false;
+
+  found = sky_result_find(loaded, SKY_RESULT_QUERY,
+                          "select \"a\\b\" from t where x = ?");
+
+  if (found == NULL || found->count != 500)
+    return false;
+
+  /* the same name of another kind is a different entry */
+  if (sky_result_find(loaded, SKY_RESULT_QUERY, "read") != NULL)
+    return false;
+
+  sky_result_free(loaded);
+  sky_result_free(result);
+  return true;
+}
+
+static SKY_RESULT *single_result(double qps, double mean, double stddev,
+                                 uint64_t p99) {
+  SKY_RESULT *result;
+  SKY_RESULT_ENTRY *entry;
+
+  if ((result = sky_result_new()) == NULL)
+    return NULL;
+
+  if ((entry = sky_result_add(result, SKY_RESULT_PHASE, "read")) == NULL)
+    return NULL;
+
+  entry->count = 10000;
+  entry->qps = qps;
+  entry->mean = mean;
+  entry->stddev = stddev;
+  entry->p99 = p99;
+  return result;
+}
+
+static bool regression_test(void) {
+  SKY_SHARE *share;
+  SKY_RESULT *baseline, *current;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  baseline = single_result(1000, 1000, 100, 2000);
+
+  /* within the tolerance */
+  current = single_result(980, 1030, 100, 2050);
+  if (compare_results(share, baseline, current) != 0)
+    return false;
+  sky_result_free(current);
+
+  /* throughput and every latency figure got worse */
+  current = single_result(800, 1300, 100, 3000);
+  if (compare_results(share, baseline, current) != 3)
+    return false;
+  sky_result_free(current);
+
+  /* a 10% higher mean that is well within the sampling error and a
+     p99 that moved by less than the noise floor are noise */
+  sky_result_free(baseline);
+  baseline = single_result(1000, 100, 5000, 500);
+  current = single_result(1000, 110, 5000, 560);
+  if (compare_results(share, baseline, current) != 0)
+    return false;
+  sky_result_free(current);
+
+  /* improvements are never regressions */
+  current = single_result(2000, 50, 100, 200);
+  if (compare_results(share, baseline, current) != 0)
+    return false;
+  sky_result_free(current);
+
+  /* a 10% throughput drop within the spread of the runs is noise */
+  baseline->entries[0].runs = 5;
+  baseline->entries[0].qps_stddev = 150;
+  current = single_result(900, 100, 5000, 500);
+  current->entries[0].runs = 5;
+  current->entries[0].qps_stddev = 150;
+  if (compare_results(share, baseline, current) != 0)
+    return false;
+
+  /* but not once the runs agree with each other */
+  baseline->entries[0].qps_stddev = 10;
+  current->entries[0].qps_stddev = 10;
+  if (compare_results(share, baseline, current) != 1)
+    return false;
+  sky_result_free(current);
+
+  /* an entry missing from the current run fails */
+  if ((current = sky_result_new()) == NULL)
+    return false;
+  if (compare_results(share, baseline, current) != 1)
+    return false;
+  sky_result_free(current);
+
+  /* so does one with too few samples to judge, unless the baseline
+     had too few as well */
+  current = single_result(1000, 100, 5000, 500);
+  current->entries[0].count = COMPARE_MIN_SAMPLES - 1;
+  if (compare_results(share, baseline, current) != 1)
+    return false;
+
+  baseline->entries[0].count = COMPARE_MIN_SAMPLES - 1;
+  if (compare_results(share, baseline, current) != 0)
+    return false;
+  sky_result_free(current);
+
+  sky_result_free(baseline);
+  sky_share_free(share);
+  return true;
+}
+
+static bool collect_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_RESULT *result;
+  const SKY_RESULT_ENTRY *entry;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+
+  if ((share->read_queries = sky_list_new()) == NULL ||
+      !sky_list_push(share->read_queries, "select 1", 8))
+    return false;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* a single run of 300 statements in a second */
+  for (int i = 0; i < share->concurrency; i++) {
+    for (int j = 0; j < 150; j++)
+      sky_histogram_add(&workers[i]->read_latency, 100);
+    workers[i]->file_elapsed = 1000000;
+
+    if (!record_run(workers[i], 1000000, 150, 15000))
+      return false;
+  }
+
+  if ((result = collect_results(workers)) == NULL)
+    return false;
+
+  entry = sky_result_find(result, SKY_RESULT_PHASE, "read");
+
+  if (entry == NULL || entry->qps != 300 || entry->runs != 0)
+    return false;
+
+  sky_result_free(result);
+
+  /* two more runs, one of them slower. the throughput is worked out
+     the same way as for the single run, with the spread on top */
+  for (int i = 0; i < share->concurrency; i++) {
+    for (int j = 0; j < 300; j++)
+      sky_histogram_add(&workers[i]->read_latency, 100);
+    workers[i]->file_elapsed = 4000000;
+
+    if (!record_run(workers[i], 1000000, 150, 15000) ||
+        !record_run(workers[i], 2000000, 150, 15000))
+      return false;
+  }
+
+  if ((result = collect_results(workers)) == NULL)
+    return false;
+
+  entry = sky_result_find(result, SKY_RESULT_PHASE, "read");
+
+  if (entry == NULL || entry->qps != 225 || entry->runs != 3 ||
+      entry->qps_stddev <= 0)
+    return false;
+
+  sky_result_free(result);
+  sky_list_free(share->read_queries);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
@@ -9,11 +9,19 @@
 #include "../skyload.h"
 
 static bool connection_init_test(void);
+static bool target_list_test(void);
+static bool route_key_test(void);
 
 int main(void) {
   if (connection_init_test() == false)
     return EXIT_FAILURE;
 
+  if (target_list_test() == false)
+    return EXIT_FAILURE;
+
+  if (route_key_test() == false)
+    return EXIT_FAILURE;
+
   return EXIT_SUCCESS;
 }
 
@@ -72,3 +80,94 @@ static bool connection_init_test(void) {
   sky_share_free(share);
   return true;
 }
+
+static bool target_list_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER *worker;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->port = 3306;
+  share->concurrency = 4;
+  share->server = strdup("db1,db2:3307");
+  share->replica_list = strdup("ro1");
+
+  if (!resolve_targets(share))
+    return false;
+
+  if (share->ntargets != 3 || share->nprimaries != 2)
+    return false;
+
+  /* administrative connections go to the first primary */
+  if (strcmp(share->server, "db1") != 0 || share->port != 3306)
+    return false;
+
+  if (strcmp(share->targets[1].host, "db2") != 0 ||
+      share->targets[1].port != 3307 || share->targets[1].replica)
+    return false;
+
+  if (strcmp(share->targets[2].host, "ro1") != 0 ||
+      share->targets[2].port != 3306 || !share->targets[2].replica)
+    return false;
+
+  if ((worker = sky_worker_new()) == NULL)
+    return false;
+
+  /* the second worker writes to the second primary and reads
+     from the only replica */
+  worker->share = share;
+  worker->unique_id = 2;
+  assign_targets(worker);
+
+  if (worker->target_index != 1 || worker->read_target_index != 2)
+    return false;
+
+  sky_worker_free(worker);
+  sky_share_free(share);
+
+  /* an empty entry in the list is rejected */
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->port = 3306;
+  share->server = strdup("db1,,db2");
+
+  if (resolve_targets(share))
+    return false;
+
+  sky_share_free(share);
+  return true;
+}
+
+static bool route_key_test(void) {
+  SKY_SHARE *share;
+  uint32_t hits[4] = {0, 0, 0, 0};
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->nprimaries = 4;
+
+  /* sequential keys should be spread roughly evenly */
+  for (uint64_t key = 1; key <= 4000; key++) {
+    uint16_t target = route_key(share, key);
+
+    if (target >= 4)
+      return false;
+
+    /* the same key must always land on the same primary */
+    if (route_key(share, key) != target)
+      return false;
+
+    hits[target]++;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    if (hits[i] < 800 || hits[i] > 1200)
+      return false;
+  }
+
+  sky_share_free(share);
+  return true;
+}
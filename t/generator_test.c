@@ -6,16 +6,43 @@
  * BSD license. See the COPYING file for full text.
  */
 
+#include <math.h>
 #include "../generator.h"
 
+#define EMPTY_TEST_FILE "empty_test.sql"
+
 static bool sky_list_test(void);
 static bool file_load_test(void);
+static bool table_key_test(void);
+static bool permute_test(void);
+static bool key_order_test(void);
+static bool write_query_test(void);
+static bool route_write_test(void);
+static bool zipf_test(void);
+static bool weight_test(void);
+static bool read_order_test(void);
 
 int main(void) {
   if (sky_list_test() == false)
     return EXIT_FAILURE;
   if (file_load_test() == false)
     return EXIT_FAILURE;
+  if (table_key_test() == false)
+    return EXIT_FAILURE;
+  if (permute_test() == false)
+    return EXIT_FAILURE;
+  if (key_order_test() == false)
+    return EXIT_FAILURE;
+  if (write_query_test() == false)
+    return EXIT_FAILURE;
+  if (route_write_test() == false)
+    return EXIT_FAILURE;
+  if (zipf_test() == false)
+    return EXIT_FAILURE;
+  if (weight_test() == false)
+    return EXIT_FAILURE;
+  if (read_order_test() == false)
+    return EXIT_FAILURE;
 
   return EXIT_SUCCESS;
 }
@@ -87,6 +114,552 @@ bool file_load_test(void) {
   }
 
   sky_list_free(share->read_queries);
+  share->read_queries = NULL;
+
+  /* a file of blank lines has nothing to read */
+  FILE *file = fopen(EMPTY_TEST_FILE, "w");
+
+  if (file == NULL)
+    return false;
+
+  fputs("\n\n/* weight=5 */\n", file);
+  fclose(file);
+  free(share->read_file_path);
+  share->read_file_path = strdup(EMPTY_TEST_FILE);
+
+  if (preload_sql_file(share) || share->read_queries != NULL)
+    return false;
+
+  unlink(EMPTY_TEST_FILE);
+  sky_share_free(share);
+  return true;
+}
+
+static bool table_key_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  char buffer[SKY_STRSIZ];
+  uint32_t keys[5];
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+  share->ntables = 2;
+  share->tables[0].insert_tmpl = strdup("insert into t1 values (%seq)");
+  share->tables[0].columns = 1;
+  share->tables[0].nwrite = 5;
+  share->tables[1].insert_tmpl = strdup("insert into t2 values (%ref1)");
+  share->tables[1].columns = 1;
+  share->tables[1].nwrite = 10;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* collect the keys the workers actually generate for table 1 */
+  int n = 0;
+  for (int i = 0; i < share->concurrency; i++) {
+    workers[i]->table = &share->tables[0];
+    uint32_t rows = rows_to_write(workers[i]);
+
+    for (int j = 0; j < rows; j++) {
+      if (next_insert_query(workers[i], buffer, SKY_STRSIZ) == 0)
+        return false;
+      keys[n++] = (uint32_t)atoi(strchr(buffer, '"') + 1);
+    }
+  }
+
+  if (n != 5)
+    return false;
+
+  /* table_key() must enumerate exactly the same set of keys */
+  for (int i = 0; i < n; i++) {
+    bool found = false;
+    for (int j = 0; j < n; j++) {
+      if (table_key(share, &share->tables[0], j) == keys[i])
+        found = true;
+    }
+    if (!found)
+      return false;
+  }
+
+  /* references to table 1 only ever produce existing keys */
+  workers[0]->table = &share->tables[1];
+
+  for (int i = 0; i < 100; i++) {
+    bool found = false;
+
+    if (next_insert_query(workers[0], buffer, SKY_STRSIZ) == 0)
+      return false;
+
+    uint32_t ref = (uint32_t)atoi(strchr(buffer, '"') + 1);
+
+    for (int j = 0; j < n; j++) {
+      if (keys[j] == ref)
+        found = true;
+    }
+    if (!found)
+      return false;
+  }
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool permute_test(void) {
+  uint64_t sizes[] = {1, 2, 7, 1000, 65536, 100003};
+  uint32_t in_place = 0;
+
+  for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    uint64_t size = sizes[i];
+    char *seen = calloc(size, 1);
+
+    if (seen == NULL)
+      return false;
+
+    /* every key is hit exactly once */
+    for (uint64_t n = 0; n < size; n++) {
+      uint64_t key = permute_key(n, size, SKY_RAND_SEED);
+
+      if (key >= size || seen[key]) {
+        free(seen);
+        return false;
+      }
+      seen[key] = 1;
+
+      if (size == 100003 && key == n)
+        in_place++;
+    }
+    free(seen);
+  }
+
+  /* the keys are shuffled, and differently for another seed */
+  if (in_place > 100 ||
+      permute_key(5, 100003, 1) == permute_key(5, 100003, 2))
+    return false;
+
+  /* a key space wider than 32 bits works as well */
+  return (permute_key(123456789, UINT64_MAX, 7) !=
+          permute_key(123456790, UINT64_MAX, 7));
+}
+
+/* Generates the rows of table 1 by every worker in turn and checks
+   that the keys make up 1 .. nwrite as table_key() says */
+static bool generate_keys(SKY_SHARE *share, SKY_WORKER **workers,
+                          uint64_t *keys) {
+  SKY_TABLE *table = &share->tables[0];
+  char buffer[SKY_STRSIZ];
+  uint64_t n = 0;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    uint64_t rows;
+
+    workers[i]->table = table;
+    rows = rows_to_write(workers[i]);
+
+    for (int j = 0; j < SKY_MAX_COLS; j++)
+      workers[i]->current_seq_id[j] = workers[i]->unique_id;
+
+    for (uint64_t j = 0; j < rows; j++) {
+      if (next_insert_query(workers[i], buffer, SKY_STRSIZ) == 0)
+        return false;
+      keys[n++] = strtoull(strchr(buffer, '"') + 1, NULL, 10);
+    }
+  }
+
+  for (uint64_t i = 0; i < n; i++) {
+    bool found = false;
+
+    if (keys[i] < 1 || keys[i] > table->nwrite)
+      return false;
+
+    for (uint64_t j = 0; j < n && !found; j++)
+      found = (table_key(share, table, j) == keys[i]);
+
+    for (uint64_t j = 0; j < i; j++) {
+      if (keys[j] == keys[i])
+        return false;
+    }
+
+    if (!found)
+      return false;
+  }
+  return (n == table->nwrite);
+}
+
+static bool key_order_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  char buffer[SKY_STRSIZ];
+  uint64_t keys[11];
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 3;
+  share->ntables = 1;
+  share->tables[0].insert_tmpl = strdup("insert into t1 values (%seq)");
+  share->tables[0].columns = 1;
+  share->tables[0].nwrite = 11;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* workers 1 and 2 take 3 rows each and worker 3 the other 5 */
+  share->key_order = SKY_KEYS_PARTITIONED;
+
+  if (!generate_keys(share, workers, keys) ||
+      keys[0] != 1 || keys[2] != 3 || keys[3] != 4 || keys[6] != 7 ||
+      keys[10] != 11)
+    return false;
+
+  /* the workers take turns from the top */
+  share->key_order = SKY_KEYS_DESCENDING;
+
+  if (!generate_keys(share, workers, keys) ||
+      keys[0] != 11 || keys[1] != 8 || keys[3] != 10 || keys[6] != 9)
+    return false;
+
+  share->key_order = SKY_KEYS_RANDOM;
+
+  if (!generate_keys(share, workers, keys))
+    return false;
+
+  /* keys past the populated rows follow in sequence */
+  workers[0]->current_seq_id[0] = next_free_key(share, &share->tables[0]);
+
+  if (next_insert_query(workers[0], buffer, SKY_STRSIZ) == 0 ||
+      strtoull(strchr(buffer, '"') + 1, NULL, 10) !=
+      next_free_key(share, &share->tables[0]) + share->concurrency)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool write_query_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_TABLE *table;
+  char buffer[SKY_STRSIZ];
+  const char *tmpl = "update t1 set b = %rand where a = %key and c = '%s'";
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+  share->ntables = 1;
+  table = &share->tables[0];
+  table->insert_tmpl = strdup("insert into t1 values (%seq)");
+  table->columns = 1;
+  table->nwrite = 10;
+  table->write_tmpl[SKY_WRITE_UPDATE] = strdup(tmpl);
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  prepare_key_dist(share);
+
+  /* the values go in unquoted and an unknown placeholder is kept.
+     the interleaved keys start past the number of workers */
+  for (int i = 0; i < 1000; i++) {
+    size_t size = write_query_size(table, SKY_WRITE_UPDATE);
+    size_t length = next_write_query(workers[0], table, SKY_WRITE_UPDATE,
+                                     buffer, size);
+    unsigned long long rand, key;
+    char tail[8];
+
+    if (length == 0 || length >= size || length != strlen(buffer))
+      return false;
+
+    if (sscanf(buffer, "update t1 set b = %llu where a = %llu and c = %7s",
+               &rand, &key, tail) != 3)
+      return false;
+
+    if (rand < 1 || rand > DEFAULT_RAND_MOD || key < 3 || key > 12 ||
+        strcmp(tail, "'%s'") != 0)
+      return false;
+  }
+
+  /* a key from a partitioned layout is still one that was inserted */
+  share->key_order = SKY_KEYS_PARTITIONED;
+
+  for (int i = 0; i < 1000; i++) {
+    uint64_t key = draw_key(share, table);
+
+    if (key < 1 || key > 10)
+      return false;
+  }
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool route_write_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_TABLE *table;
+  char buffer[SKY_STRSIZ];
+  uint16_t owner[13];
+  uint32_t hits[3] = {0, 0, 0};
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+  share->nprimaries = 3;
+  share->route = SKY_ROUTE_KEY;
+  share->ntables = 1;
+  table = &share->tables[0];
+  table->insert_tmpl = strdup("insert into t1 values (%seq)");
+  table->columns = 1;
+  table->nwrite = 10;
+  table->write_tmpl[SKY_WRITE_DELETE] =
+    strdup("delete from t1 where a = %key or a = %key");
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  prepare_key_dist(share);
+  memset(owner, 0xff, sizeof(owner));
+
+  /* note the primary every row was inserted into */
+  for (int i = 0; i < share->concurrency; i++) {
+    workers[i]->table = table;
+    uint32_t rows = rows_to_write(workers[i]);
+
+    for (int j = 0; j < rows; j++) {
+      if (next_insert_query(workers[i], buffer, SKY_STRSIZ) == 0 ||
+          workers[i]->row_key >= 13)
+        return false;
+      owner[workers[i]->row_key] = route_key(share, workers[i]->row_key);
+    }
+  }
+
+  /* a write is routed by its first key to the primary holding the row */
+  for (int i = 0; i < 1000; i++) {
+    size_t size = write_query_size(table, SKY_WRITE_DELETE);
+    unsigned long long key, other;
+
+    if (next_write_query(workers[1], table, SKY_WRITE_DELETE, buffer,
+                         size) == 0)
+      return false;
+
+    if (sscanf(buffer, "delete from t1 where a = %llu or a = %llu",
+               &key, &other) != 2 || key >= 13 ||
+        workers[1]->row_key != key)
+      return false;
+
+    uint16_t target = route_key(share, workers[1]->row_key);
+
+    if (owner[key] != target)
+      return false;
+    hits[target]++;
+  }
+
+  /* the writes are spread over all of the primaries */
+  for (int i = 0; i < 3; i++) {
+    if (hits[i] == 0)
+      return false;
+  }
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool zipf_test(void) {
+  SKY_SHARE *share;
+  SKY_TABLE *table;
+  uint64_t hits[100];
+  double sum = 0;
+
+  /* the integral takes over from the exact sum seamlessly */
+  for (uint64_t i = 1; i <= 2 * ZIPF_EXACT_TERMS; i++)
+    sum += pow((double)i, -0.99);
+
+  if (fabs(zipf_zeta(2 * ZIPF_EXACT_TERMS, 0.99) - sum) > 1e-6 * sum ||
+      fabs(zipf_zeta(3, 0.5) - (1 + pow(2, -0.5) + pow(3, -0.5))) > 1e-12)
+    return false;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 1;
+  share->ntables = 1;
+  share->key_dist = SKY_DIST_ZIPFIAN;
+  share->zipf_theta = SKY_ZIPF_THETA;
+  share->key_order = SKY_KEYS_PARTITIONED; /* row n has the key n + 1 */
+  table = &share->tables[0];
+  table->nwrite = 100;
+  table->write_tmpl[SKY_WRITE_DELETE] = strdup("delete from t1");
+
+  prepare_key_dist(share);
+  memset(hits, 0, sizeof(hits));
+
+  for (int i = 0; i < 100000; i++) {
+    uint64_t key = draw_key(share, table);
+
+    if (key < 1 || key > 100)
+      return false;
+    hits[key - 1]++;
+  }
+
+  /* the first row takes about 1/zeta(100) of the draws, the tail
+     hardly any */
+  if (hits[0] < 100000 / table->zeta * 0.9 ||
+      hits[0] > 100000 / table->zeta * 1.1 ||
+      hits[0] < hits[1] || hits[1] < hits[9] || hits[9] < hits[99])
+    return false;
+
+  sky_share_free(share);
+  return true;
+}
+
+static bool weight_test(void) {
+  SKY_SHARE *share;
+  SKY_LIST *list;
+  char path[] = "/tmp/skyload_weight_XXXXXX";
+  FILE *file;
+  int fd;
+
+  if ((fd = mkstemp(path)) < 0 || (file = fdopen(fd, "w")) == NULL)
+    return false;
+
+  fputs("/* weight=5 */ SELECT 1\n", file);
+  fputs("SELECT 2\n", file);
+  fputs("  /* weight=0 */SELECT 3;\n", file);
+  fputs("/* not a weight */ SELECT 4\n", file);
+  fclose(file);
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->read_file_path = strdup(path);
+
+  if (!preload_sql_file(share))
+    return false;
+
+  unlink(path);
+  list = share->read_queries;
+
+  if (list->size != 4 || list->nodes == NULL)
+    return false;
+
+  /* the annotation is stripped, other comments are kept */
+  if (strcmp(list->nodes[0]->data, "SELECT 1") != 0 ||
+      list->nodes[0]->length != 8 ||
+      strcmp(list->nodes[2]->data, "SELECT 3;") != 0 ||
+      strcmp(list->nodes[3]->data, "/* not a weight */ SELECT 4") != 0)
+    return false;
+
+  if (list->nodes[0]->weight != 5 || list->nodes[1]->weight != 1 ||
+      list->nodes[2]->weight != 0 || list->nodes[3]->weight != 1)
+    return false;
+
+  if (list->cumulative[0] != 5 || list->cumulative[3] != 7)
+    return false;
+
+  /* draws of 0-4 fall on the first statement, 5 on the second and
+     6 on the fourth. the one of weight 0 is never picked */
+  if (weighted_pick(list, 4) != 0 || weighted_pick(list, 5) != 1 ||
+      weighted_pick(list, 6) != 3 || weighted_pick(list, 7) != 0)
+    return false;
+
+  sky_list_free(share->read_queries);
+  share->read_queries = NULL;
+  sky_share_free(share);
+  return true;
+}
+
+/* whether the order holds every statement exactly once */
+static bool is_permutation(const uint32_t *order, size_t n) {
+  bool seen[n];
+
+  memset(seen, 0, sizeof(seen));
+
+  for (size_t i = 0; i < n; i++) {
+    if (order[i] >= n || seen[order[i]])
+      return false;
+    seen[order[i]] = true;
+  }
+  return true;
+}
+
+static bool read_order_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_LIST *list;
+  char buffer[16];
+  size_t n = 10;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((list = sky_list_new()) == NULL)
+    return false;
+
+  for (size_t i = 0; i < n; i++) {
+    sprintf(buffer, "SELECT %d", (int)i);
+    if (!sky_list_push(list, buffer, strlen(buffer)))
+      return false;
+    list->tail->weight = (i == 3) ? 1 : 0;
+  }
+
+  if (!sky_list_index(list))
+    return false;
+
+  share->read_queries = list;
+  share->concurrency = 2;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  if (!plan_read_order(workers[1]) || workers[1]->read_order[0] != 0 ||
+      workers[1]->read_order[9] != 9)
+    return false;
+
+  /* the second of two workers starts half way through the file */
+  share->read_order = SKY_ORDER_OFFSET;
+
+  if (!plan_read_order(workers[1]) || workers[1]->read_order[0] != 5 ||
+      workers[1]->read_order[5] != 0 ||
+      !is_permutation(workers[1]->read_order, n))
+    return false;
+
+  share->read_order = SKY_ORDER_SHUFFLE;
+
+  if (!plan_read_order(workers[0]) ||
+      !is_permutation(workers[0]->read_order, n))
+    return false;
+
+  share->read_order = SKY_ORDER_RANDOM;
+
+  if (!plan_read_order(workers[0]))
+    return false;
+
+  for (size_t i = 0; i < n; i++) {
+    if (workers[0]->read_order[i] >= n)
+      return false;
+  }
+
+  /* only the statement with a weight is ever picked */
+  share->read_order = SKY_ORDER_WEIGHTED;
+
+  if (!plan_read_order(workers[0]))
+    return false;
+
+  for (size_t i = 0; i < n; i++) {
+    if (workers[0]->read_order[i] != 3)
+      return false;
+  }
+
+  destroy_workers(workers);
+  sky_list_free(list);
+  share->read_queries = NULL;
   sky_share_free(share);
   return true;
 }
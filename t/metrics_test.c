@@ -0,0 +1,298 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../metrics.h"
+
+#define METRICS_TEST_SOCKET "./metrics_test.sock"
+
+static bool cumulative_test(void);
+static bool exposition_test(void);
+static bool publish_test(void);
+static bool endpoint_test(void);
+
+int main(void) {
+  if (cumulative_test() == false)
+    return EXIT_FAILURE;
+  if (exposition_test() == false)
+    return EXIT_FAILURE;
+  if (publish_test() == false)
+    return EXIT_FAILURE;
+  if (endpoint_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool cumulative_test(void) {
+  const uint64_t bounds[] = {10, 100, 1000};
+  uint64_t counts[3];
+  SKY_HISTOGRAM hist;
+
+  sky_histogram_reset(&hist);
+  sky_histogram_add(&hist, 5);
+  sky_histogram_add(&hist, 10);
+  sky_histogram_add(&hist, 50);
+  sky_histogram_add(&hist, 5000);
+
+  if (sky_histogram_cumulative(&hist, bounds, 3, counts) != 4)
+    return false;
+
+  return (counts[0] == 2 && counts[1] == 3 && counts[2] == 3);
+}
+
+/* Populates a couple of workers with known figures */
+static SKY_WORKER **create_busy_workers(SKY_SHARE *share) {
+  SKY_WORKER **workers;
+
+  share->concurrency = 2;
+  share->start_time = current_usec();
+
+  if ((workers = create_workers(share)) == NULL)
+    return NULL;
+
+  sky_histogram_add(&workers[0]->read_latency, 200);
+  sky_histogram_add(&workers[0]->read_latency, 3000);
+  sky_histogram_add(&workers[1]->read_latency, 200000);
+  sky_histogram_add(&workers[1]->insert_latency, 50);
+
+  workers[0]->phase = SKY_PHASE_READ;
+  workers[1]->phase = SKY_NPHASES;
+  workers[0]->in_flight = 1;
+  workers[0]->failed_queries = 2;
+  workers[1]->retries = 5;
+  workers[1]->rows_inserted = 1000;
+  workers[1]->aborted = true;
+  return workers;
+}
+
+static bool expect(const char *text, const char *line) {
+  if (strstr(text, line))
+    return true;
+
+  fprintf(stderr, "missing: %s\n", line);
+  return false;
+}
+
+static bool exposition_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_METRICS *metrics;
+  char *text = NULL;
+  size_t size = 0;
+  FILE *out;
+  bool rv;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((workers = create_busy_workers(share)) == NULL)
+    return false;
+
+  /* no endpoint is needed to put the metrics together */
+  if ((metrics = calloc(1, sizeof(*metrics))) == NULL)
+    return false;
+
+  metrics->share = share;
+  metrics->workers = workers;
+  pthread_mutex_init(&metrics->lock, NULL);
+
+  if ((out = open_memstream(&text, &size)) == NULL)
+    return false;
+
+  rv = write_metrics(metrics, out);
+  fclose(out);
+
+  rv = rv &&
+       expect(text, "# TYPE skyload_queries_total counter\n") &&
+       expect(text, "skyload_queries_total{phase=\"read\"} 3\n") &&
+       expect(text, "skyload_queries_total{phase=\"insert\"} 1\n") &&
+       expect(text, "skyload_queries_total{phase=\"replay\"} 0\n") &&
+       expect(text, "# TYPE skyload_query_duration_seconds histogram\n") &&
+       expect(text, "_bucket{phase=\"read\",le=\"0.0001\"} 0\n") &&
+       expect(text, "_bucket{phase=\"read\",le=\"0.00025\"} 1\n") &&
+       expect(text, "_bucket{phase=\"read\",le=\"0.005\"} 2\n") &&
+       expect(text, "_bucket{phase=\"read\",le=\"0.25\"} 3\n") &&
+       expect(text, "_bucket{phase=\"read\",le=\"+Inf\"} 3\n") &&
+       expect(text, "_count{phase=\"read\"} 3\n") &&
+       expect(text, "skyload_workers{phase=\"read\"} 1\n") &&
+       expect(text, "skyload_workers{phase=\"done\"} 1\n") &&
+       expect(text, "skyload_workers_aborted 1\n") &&
+       expect(text, "skyload_in_flight_queries 1\n") &&
+       expect(text, "skyload_errors_total 2\n") &&
+       expect(text, "skyload_retries_total 5\n") &&
+       expect(text, "skyload_rows_inserted_total 1000\n");
+
+  free(text);
+  pthread_mutex_destroy(&metrics->lock);
+  free(metrics);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return rv;
+}
+
+/* Puts the metrics together and looks for the given lines in them */
+static bool expect_metrics(SKY_METRICS *metrics, const char **lines) {
+  char *text = NULL;
+  size_t size = 0;
+  FILE *out;
+  bool rv;
+
+  if ((out = open_memstream(&text, &size)) == NULL)
+    return false;
+
+  rv = write_metrics(metrics, out);
+  fclose(out);
+
+  for (; rv && *lines; lines++)
+    rv = expect(text, *lines);
+
+  free(text);
+  return rv;
+}
+
+static bool publish_test(void) {
+  const char *published[] = {
+    "skyload_queries_total{phase=\"read\"} 6\n",
+    "skyload_workers{phase=\"read\"} 2\n",
+    "skyload_workers{phase=\"done\"} 2\n",
+    "skyload_errors_total 4\n",
+    "skyload_retries_total 10\n",
+    "skyload_rows_inserted_total 2000\n",
+    NULL
+  };
+  const char *withdrawn[] = {
+    "skyload_queries_total{phase=\"read\"} 7\n",
+    "skyload_workers{phase=\"read\"} 1\n",
+    "skyload_workers{phase=\"done\"} 1\n",
+    "skyload_errors_total 4\n",
+    "skyload_retries_total 10\n",
+    "skyload_rows_inserted_total 2000\n",
+    NULL
+  };
+  SKY_SHARE *share;
+  SKY_WORKER **workers, **pool;
+  SKY_METRICS *metrics;
+  bool rv;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((workers = create_busy_workers(share)) == NULL ||
+      (pool = create_busy_workers(share)) == NULL)
+    return false;
+
+  if ((metrics = calloc(1, sizeof(*metrics))) == NULL)
+    return false;
+
+  metrics->share = share;
+  metrics->workers = workers;
+  pthread_mutex_init(&metrics->lock, NULL);
+
+  metrics_publish(metrics, pool, share->concurrency);
+  rv = expect_metrics(metrics, published);
+
+  /* publishing the pool again keeps its counts, but only once */
+  metrics_publish(metrics, pool, share->concurrency);
+  rv = rv && pool[0]->read_latency.count == 0 && pool[1]->retries == 0 &&
+       expect_metrics(metrics, published);
+
+  /* the counts stay after the pool is withdrawn */
+  sky_histogram_add(&pool[0]->read_latency, 100);
+  metrics_publish(metrics, NULL, 0);
+  rv = rv && expect_metrics(metrics, withdrawn);
+
+  pthread_mutex_destroy(&metrics->lock);
+  free(metrics);
+  destroy_workers(pool);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return rv;
+}
+
+/* Sends a request to the endpoint and returns the response */
+static char *scrape(const char *request) {
+  struct sockaddr_un addr;
+  char *response;
+  size_t length = 0;
+  ssize_t received;
+  int fd;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, METRICS_TEST_SOCKET);
+
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    return NULL;
+
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      send(fd, request, strlen(request), 0) < 0 ||
+      (response = calloc(1, 65536)) == NULL) {
+    close(fd);
+    return NULL;
+  }
+
+  while (length < 65535 &&
+         (received = recv(fd, response + length, 65535 - length, 0)) > 0)
+    length += received;
+
+  close(fd);
+  return response;
+}
+
+static bool endpoint_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_METRICS *metrics;
+  char *response;
+  bool rv;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((workers = create_busy_workers(share)) == NULL)
+    return false;
+
+  /* neither a port nor a path */
+  share->metrics_addr = strdup("localhost:http");
+  if (sky_metrics_new(share, workers) != NULL)
+    return false;
+
+  free(share->metrics_addr);
+  share->metrics_addr = strdup(METRICS_TEST_SOCKET);
+
+  if ((metrics = sky_metrics_new(share, workers)) == NULL ||
+      !metrics_start(metrics))
+    return false;
+
+  response = scrape("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  rv = (response && strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0 &&
+        strstr(response, "Content-Type: " METRICS_CONTENT_TYPE "\r\n") &&
+        strstr(response, "\r\n\r\n# HELP ") &&
+        strstr(response, "skyload_queries_total{phase=\"read\"} 3\n"));
+  free(response);
+
+  response = scrape("GET /other HTTP/1.1\r\n\r\n");
+  rv = rv && response && strncmp(response, "HTTP/1.1 404 ", 13) == 0;
+  free(response);
+
+  response = scrape("POST /metrics HTTP/1.1\r\n\r\n");
+  rv = rv && response && strncmp(response, "HTTP/1.1 405 ", 13) == 0;
+  free(response);
+
+  rv = rv && metrics->scrapes == 1;
+
+  /* the socket goes away with the exporter */
+  sky_metrics_free(metrics);
+  rv = rv && access(METRICS_TEST_SOCKET, F_OK) != 0;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return rv;
+}
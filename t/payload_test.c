@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../generator.h"
+#include "../payload.h"
+
+#define PAYLOAD_TEST_FILE "./payload_test.dat"
+
+static bool literal_test(void);
+static bool pool_test(void);
+static bool file_test(void);
+static bool pieces_test(void);
+
+int main(void) {
+  if (literal_test() == false)
+    return EXIT_FAILURE;
+  if (pool_test() == false)
+    return EXIT_FAILURE;
+  if (file_test() == false)
+    return EXIT_FAILURE;
+  if (pieces_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool literal_test(void) {
+  char buffer[256];
+
+  fill_payload(buffer, sizeof(buffer));
+
+  if (!payload_is_literal(buffer, sizeof(buffer)))
+    return false;
+
+  /* anything that would have to be escaped is refused */
+  if (payload_is_literal("ab\"cd", 5) ||
+      payload_is_literal("ab\\cd", 5) ||
+      payload_is_literal("ab\0cd", 5))
+    return false;
+
+  return payload_is_literal("it's", 4);
+}
+
+static bool pool_test(void) {
+  SKY_SHARE *share;
+  SKY_PAYLOAD *payload;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  /* the pool grows with the largest payload */
+  share->payload_max = PAYLOAD_POOL_SIZE;
+
+  if ((payload = sky_payload_new(share)) == NULL)
+    return false;
+
+  if (payload->mapped || payload->size != (size_t)PAYLOAD_POOL_SIZE * 2 ||
+      !payload_is_literal(payload->data, payload->size))
+    return false;
+
+  sky_payload_free(payload);
+  sky_share_free(share);
+  return true;
+}
+
+static bool file_test(void) {
+  SKY_SHARE *share;
+  SKY_PAYLOAD *payload;
+  FILE *file;
+  bool rv;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((file = fopen(PAYLOAD_TEST_FILE, "w")) == NULL)
+    return false;
+
+  fprintf(file, "0123456789abcdef");
+  fclose(file);
+
+  share->payload_path = strdup(PAYLOAD_TEST_FILE);
+  share->payload_max = 16;
+
+  if ((payload = sky_payload_new(share)) == NULL)
+    return false;
+
+  rv = (payload->mapped && payload->size == 16 &&
+        memcmp(payload->data, "0123456789abcdef", 16) == 0);
+  sky_payload_free(payload);
+
+  /* a payload larger than the file can't be cut out of it */
+  share->payload_max = 17;
+
+  if (rv && sky_payload_new(share) != NULL)
+    rv = false;
+
+  /* neither can a file that needs escaping be used */
+  if ((file = fopen(PAYLOAD_TEST_FILE, "w")) == NULL)
+    return false;
+
+  fprintf(file, "0123456789\"bcdef");
+  fclose(file);
+  share->payload_max = 16;
+
+  if (rv && sky_payload_new(share) != NULL)
+    rv = false;
+
+  unlink(PAYLOAD_TEST_FILE);
+  sky_share_free(share);
+  return rv;
+}
+
+static bool pieces_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_TABLE *table;
+  SKY_PIECES pieces;
+  const char *tail = "\") on duplicate key update id=id";
+  char *buffer, *joined;
+  size_t size, length, flat;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->ntables = 1;
+  share->concurrency = 1;
+  share->payload_min = 1000;
+  share->payload_max = 2000;
+  table = &share->tables[0];
+  table->insert_tmpl = strdup("insert into t1 values (%seq,%payload,"
+                              "%payload) on duplicate key update id=id");
+  table->columns = 3;
+  table->payload_size = 2 * share->payload_max;
+  table->nwrite = 10;
+
+  if ((share->payload = sky_payload_new(share)) == NULL)
+    return false;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  workers[0]->table = table;
+  size = insert_query_size(table);
+
+  if ((buffer = malloc(size)) == NULL || (joined = malloc(size)) == NULL)
+    return false;
+
+  /* the text and the payloads take turns, the payloads being
+     left in the pool */
+  if ((length = next_insert_pieces(workers[0], buffer, size,
+                                   &pieces)) == 0 || pieces.count != 5)
+    return false;
+
+  flat = 0;
+  for (int i = 0; i < pieces.count; i++) {
+    char *base = pieces.piece[i].iov_base;
+    bool in_pool = (base >= share->payload->data &&
+                    base < share->payload->data + share->payload->size);
+
+    if (in_pool != (i % 2 == 1))
+      return false;
+
+    if (in_pool && (pieces.piece[i].iov_len < 1000 ||
+                    pieces.piece[i].iov_len > 2000))
+      return false;
+
+    memcpy(joined + flat, base, pieces.piece[i].iov_len);
+    flat += pieces.piece[i].iov_len;
+  }
+  joined[flat] = '\0';
+
+  if (flat != length ||
+      strncmp(joined, "insert into t1 values (\"2\",\"", 28) != 0 ||
+      strstr(joined, "\",\"") == NULL ||
+      strcmp(joined + flat - strlen(tail), tail) != 0)
+    return false;
+
+  /* the same row copied into a single query is as long */
+  if ((length = next_insert_query(workers[0], buffer, size)) == 0 ||
+      length != strlen(buffer) || length >= size ||
+      strncmp(buffer, "insert into t1 values (\"3\",\"", 28) != 0 ||
+      strcmp(buffer + length - strlen(tail), tail) != 0)
+    return false;
+
+  free(joined);
+  free(buffer);
+  sky_payload_free(share->payload);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
@@ -0,0 +1,120 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../pipeline.h"
+
+static bool batch_test(void);
+static bool flush_failure_test(void);
+
+int main(void) {
+  if (batch_test() == false)
+    return EXIT_FAILURE;
+  if (flush_failure_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool batch_test(void) {
+  SKY_PIPELINE *pipeline;
+  char query[PIPELINE_INITIAL_SIZE];
+  int tag = 0;
+
+  if (sky_pipeline_new(0) != NULL)
+    return false;
+
+  if ((pipeline = sky_pipeline_new(3)) == NULL)
+    return false;
+
+  /* trailing separators and whitespace are dropped */
+  if (!pipeline_add(pipeline, "SELECT 1;", 9, &tag) ||
+      !pipeline_add(pipeline, "SELECT 2 ; \t", 12, NULL))
+    return false;
+
+  if (pipeline_full(pipeline) ||
+      strcmp(pipeline->buffer, "SELECT 1;SELECT 2") != 0)
+    return false;
+
+  if (pipeline->entries[0].tag != &tag || pipeline->entries[1].offset != 9)
+    return false;
+
+  /* the buffer grows past its initial size */
+  memset(query, 'x', sizeof(query));
+
+  if (!pipeline_add(pipeline, query, sizeof(query), NULL))
+    return false;
+
+  if (!pipeline_full(pipeline) ||
+      pipeline->length != 17 + 1 + sizeof(query) ||
+      strlen(pipeline->buffer) != pipeline->length)
+    return false;
+
+  /* a full pipeline takes no more */
+  if (pipeline_add(pipeline, "SELECT 3", 8, NULL))
+    return false;
+
+  pipeline_reset(pipeline);
+
+  if (pipeline->count != 0 || !pipeline_add(pipeline, "SELECT 3", 8, NULL) ||
+      strcmp(pipeline->buffer, "SELECT 3") != 0 ||
+      pipeline->entries[0].offset != 0)
+    return false;
+
+  sky_pipeline_free(pipeline);
+  return true;
+}
+
+static bool flush_failure_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER *worker;
+  SKY_PIPELINE *pipeline;
+  drizzle_con_st connection;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((worker = sky_worker_new()) == NULL)
+    return false;
+
+  if ((pipeline = sky_pipeline_new(4)) == NULL)
+    return false;
+
+  share->server = strdup("localhost");
+  share->port = 1;
+  share->max_retries = 1;
+  share->retry_backoff = 0;
+  share->start_time = current_usec();
+  worker->share = share;
+  drizzle_create(&worker->database_handle);
+
+  if (!sky_create_connection(share, &worker->database_handle, &connection))
+    return false;
+
+  for (int i = 0; i < 3; i++) {
+    if (!pipeline_add(pipeline, "SELECT 1", 8, NULL))
+      return false;
+  }
+
+  /* nothing listens on port 1. every statement is retried once and
+     given up on, and the rest of the batch is sent again each time */
+  if (pipeline_flush(worker, &connection, 0, pipeline, SKY_EXEC_RETRY,
+                     NULL) != SKY_ERROR_CONNECTION)
+    return false;
+
+  if (pipeline->completed != 0 || pipeline->entries[2].done ||
+      worker->failed_queries != 3 || worker->retries != 3 ||
+      worker->target_queries[0] != 0)
+    return false;
+
+  sky_close_connection(&connection);
+  drizzle_free(&worker->database_handle);
+  sky_pipeline_free(pipeline);
+  sky_worker_free(worker);
+  sky_share_free(share);
+  return true;
+}
@@ -0,0 +1,146 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../replay.h"
+
+static bool log_line_test(void);
+static bool classic_log_test(void);
+static bool iso_log_test(void);
+
+int main(void) {
+  if (log_line_test() == false)
+    return EXIT_FAILURE;
+  if (classic_log_test() == false)
+    return EXIT_FAILURE;
+  if (iso_log_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool log_line_test(void) {
+  char command[32];
+  const char *argument;
+  uint64_t last_time = 0;
+  uint32_t session_id;
+
+  /* record with a timestamp */
+  if (!parse_general_log_line("091019 12:00:00\t    3 Query\tSELECT 1",
+                              &last_time, &session_id, command,
+                              sizeof(command), &argument))
+    return false;
+
+  if (session_id != 3 || strcmp(command, "Query") != 0 ||
+      strcmp(argument, "SELECT 1") != 0 || last_time == 0)
+    return false;
+
+  uint64_t previous = last_time;
+
+  /* record without a timestamp keeps the previous one */
+  if (!parse_general_log_line("\t\t   12 Init DB\tskyload",
+                              &last_time, &session_id, command,
+                              sizeof(command), &argument))
+    return false;
+
+  if (session_id != 12 || strcmp(command, "Init DB") != 0 ||
+      strcmp(argument, "skyload") != 0 || last_time != previous)
+    return false;
+
+  /* continuation lines of a multi-line statement */
+  if (parse_general_log_line("  WHERE id < 4", &last_time, &session_id,
+                             command, sizeof(command), &argument))
+    return false;
+
+  if (parse_general_log_line("1, 2, 3)", &last_time, &session_id,
+                             command, sizeof(command), &argument))
+    return false;
+
+  /* fractional ISO 8601 timestamps */
+  if (!parse_general_log_line("2020-10-19T12:00:01.500000Z\t 5 Query\tx",
+                              &last_time, &session_id, command,
+                              sizeof(command), &argument))
+    return false;
+
+  previous = last_time;
+
+  if (!parse_general_log_line("2020-10-19T12:00:02.000000Z\t 5 Query\ty",
+                              &last_time, &session_id, command,
+                              sizeof(command), &argument))
+    return false;
+
+  if (last_time - previous != 500000)
+    return false;
+
+  return true;
+}
+
+static bool classic_log_test(void) {
+  SKY_REPLAY *replay;
+
+  if ((replay = load_general_log("general_01.log")) == NULL)
+    return false;
+
+  /* Init DB, two SELECTs and an INSERT. Connect and Quit
+     records are not replayed */
+  if (replay->size != 4 || replay->sessions != 2) {
+    sky_replay_free(replay);
+    return false;
+  }
+
+  if (strcmp(replay->entries[0].query, "USE skyload") != 0 ||
+      replay->entries[0].offset != 0) {
+    sky_replay_free(replay);
+    return false;
+  }
+
+  /* the multi-line statement must be reassembled */
+  SKY_REPLAY_ENTRY *entry = &replay->entries[2];
+
+  if (strcmp(entry->query, "SELECT *\n  FROM t1\n  WHERE id < 4") != 0 ||
+      strlen(entry->query) != entry->length || entry->offset != 1000000 ||
+      entry->session_id != 2) {
+    sky_replay_free(replay);
+    return false;
+  }
+
+  /* sessions are listed in order of appearance and the entries
+     of each session are chained in log order */
+  if (replay->session_list[0].session_id != 1 ||
+      replay->session_list[0].count != 3 ||
+      replay->session_list[1].session_id != 2 ||
+      replay->session_list[1].first != 2 ||
+      replay->entries[0].next != 1 || replay->entries[1].next != 3 ||
+      replay->entries[3].next != REPLAY_END_OF_SESSION) {
+    sky_replay_free(replay);
+    return false;
+  }
+
+  if (replay->duration != 3000000) {
+    sky_replay_free(replay);
+    return false;
+  }
+
+  sky_replay_free(replay);
+  return true;
+}
+
+static bool iso_log_test(void) {
+  SKY_REPLAY *replay;
+
+  if ((replay = load_general_log("general_02.log")) == NULL)
+    return false;
+
+  if (replay->size != 2 || replay->sessions != 2 ||
+      replay->duration != 500000) {
+    sky_replay_free(replay);
+    return false;
+  }
+
+  sky_replay_free(replay);
+  return true;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../resources.h"
+
+static bool busy_test(void);
+static bool sample_test(void);
+static bool worker_test(void);
+
+int main(void) {
+  if (busy_test() == false)
+    return EXIT_FAILURE;
+  if (sample_test() == false)
+    return EXIT_FAILURE;
+  if (worker_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+/* keeps the CPU busy for about the given number of usecs */
+static void burn_cpu(uint64_t usec) {
+  volatile uint64_t sink = 0;
+  uint64_t end = current_usec() + usec;
+
+  while (current_usec() < end)
+    sink++;
+}
+
+static bool busy_test(void) {
+  SKY_RUSAGE from = { 1000000, 200000, 10, 1 };
+  SKY_RUSAGE to = { 3000000, 1800000, 25, 4 };
+  SKY_RUSAGE used = rusage_diff(&from, &to);
+
+  if (used.wall != 2000000 || used.cpu != 1600000 || used.voluntary != 15 ||
+      used.involuntary != 3)
+    return false;
+
+  /* 1.6 secs of CPU in 2 secs is 80% of one CPU or 20% of four */
+  if (rusage_busy(&used, 1) < 0.799 || rusage_busy(&used, 1) > 0.801 ||
+      rusage_busy(&used, 4) < 0.199 || rusage_busy(&used, 4) > 0.201)
+    return false;
+
+  /* counters that went backwards didn't grow */
+  used = rusage_diff(&to, &from);
+
+  if (used.wall != 0 || used.cpu != 0 || rusage_busy(&used, 1) != 0)
+    return false;
+
+  /* the utilization of the client is spread over one CPU at least */
+  if (online_cpus() < 1)
+    return false;
+
+  return true;
+}
+
+static bool sample_test(void) {
+  SKY_RUSAGE before, after, used;
+
+  if (!sample_rusage(&before, false))
+    return false;
+
+  burn_cpu(50000);
+
+  if (!sample_rusage(&after, false))
+    return false;
+
+  /* a spinning thread is on the CPU most of the time */
+  used = rusage_diff(&before, &after);
+
+  if (used.wall < 50000 || used.cpu < 10000 || used.cpu > used.wall + 20000)
+    return false;
+
+  return true;
+}
+
+static bool worker_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_RUSAGE *usage;
+  uint64_t cpu;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 1;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  usage = &workers[0]->rusage;
+
+  worker_rusage_begin(workers[0]);
+  burn_cpu(30000);
+  worker_rusage_end(workers[0]);
+
+  /* without per thread figures nothing is accounted */
+  if (usage->wall == 0)
+    return (usage->cpu == 0);
+
+  if (usage->wall < 30000 || usage->cpu < 5000)
+    return false;
+
+  /* a second end without a begin doesn't count twice */
+  cpu = usage->cpu;
+  worker_rusage_end(workers[0]);
+
+  if (usage->cpu != cpu)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
@@ -0,0 +1,273 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../retry.h"
+
+static bool classify_test(void);
+static bool backoff_test(void);
+static bool timeline_test(void);
+static bool execute_retry_test(void);
+static bool txn_test(void);
+
+int main(void) {
+  if (classify_test() == false)
+    return EXIT_FAILURE;
+  if (backoff_test() == false)
+    return EXIT_FAILURE;
+  if (timeline_test() == false)
+    return EXIT_FAILURE;
+  if (execute_retry_test() == false)
+    return EXIT_FAILURE;
+  if (txn_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool classify_test(void) {
+  if (classify_error(DRIZZLE_RETURN_OK, 0) != SKY_ERROR_NONE)
+    return false;
+
+  if (classify_error(DRIZZLE_RETURN_ERROR_CODE, ER_LOCK_DEADLOCK) !=
+      SKY_ERROR_RETRY)
+    return false;
+
+  if (classify_error(DRIZZLE_RETURN_ERROR_CODE, ER_LOCK_WAIT_TIMEOUT) !=
+      SKY_ERROR_RETRY)
+    return false;
+
+  if (classify_error(DRIZZLE_RETURN_ERROR_CODE, CR_SERVER_GONE_ERROR) !=
+      SKY_ERROR_CONNECTION)
+    return false;
+
+  if (classify_error(DRIZZLE_RETURN_LOST_CONNECTION, 0) !=
+      SKY_ERROR_CONNECTION)
+    return false;
+
+  /* a syntax error is not going to go away by retrying */
+  if (classify_error(DRIZZLE_RETURN_ERROR_CODE, 1064) != SKY_ERROR_FATAL)
+    return false;
+
+  if (classify_error(DRIZZLE_RETURN_BAD_PACKET, 0) != SKY_ERROR_FATAL)
+    return false;
+
+  return true;
+}
+
+static bool backoff_test(void) {
+  for (uint32_t attempt = 0; attempt < 8; attempt++) {
+    uint64_t ceiling = 10000ULL << attempt;
+    uint64_t delay = retry_backoff(10, attempt);
+
+    if (delay < ceiling / 2 || delay > ceiling)
+      return false;
+  }
+
+  /* the delay never grows beyond the cap */
+  if (retry_backoff(10, 30) > RETRY_MAX_BACKOFF)
+    return false;
+
+  if (retry_backoff(0, 3) != 0)
+    return false;
+
+  return true;
+}
+
+static bool timeline_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER *worker;
+  SKY_TIMELINE merged = {NULL, 0, 0};
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((worker = sky_worker_new()) == NULL)
+    return false;
+
+  worker->share = share;
+
+  /* nothing is recorded before the load has started */
+  record_interval(worker, 1, 0, 0);
+
+  if (worker->timeline.size != 0)
+    return false;
+
+  /* pretend the load started 2.5 seconds ago */
+  share->start_time = current_usec() - 2500000;
+  record_interval(worker, 5, 1, 2);
+
+  if (worker->timeline.size != 3)
+    return false;
+
+  if (worker->timeline.intervals[2].queries != 5 ||
+      worker->timeline.intervals[2].errors != 1 ||
+      worker->timeline.intervals[2].retries != 2 ||
+      worker->timeline.intervals[0].queries != 0)
+    return false;
+
+  if (!sky_timeline_merge(&merged, &worker->timeline) ||
+      !sky_timeline_merge(&merged, &worker->timeline))
+    return false;
+
+  if (merged.size != 3 || merged.intervals[2].queries != 10)
+    return false;
+
+  /* a distant interval grows the timeline */
+  if (sky_timeline_at(&merged, 500) == NULL || merged.size != 501 ||
+      merged.intervals[499].errors != 0)
+    return false;
+
+  /* but a soak test only keeps the totals */
+  share->soak = true;
+  record_interval(worker, 1, 0, 0);
+
+  if (worker->timeline.size != 3 || worker->timeline.intervals[0].queries != 1)
+    return false;
+
+  sky_timeline_free(&merged);
+  sky_worker_free(worker);
+  sky_share_free(share);
+  return true;
+}
+
+static bool execute_retry_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER *worker;
+  drizzle_con_st connection;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((worker = sky_worker_new()) == NULL)
+    return false;
+
+  share->server = strdup("localhost");
+  share->port = 1;
+  share->max_retries = 2;
+  share->retry_backoff = 0;
+  share->start_time = current_usec();
+  worker->share = share;
+  drizzle_create(&worker->database_handle);
+
+  if (!sky_create_connection(share, &worker->database_handle, &connection))
+    return false;
+
+  /* nothing listens on port 1, so every attempt fails with a
+     connection error and is retried until --max-retries runs out */
+  if (execute_query(worker, &connection, 0, "SELECT 1", 8,
+                    SKY_EXEC_RETRY, NULL) != SKY_ERROR_CONNECTION)
+    return false;
+
+  if (worker->retries != 2 || worker->failed_queries != 1 ||
+      worker->target_queries[0] != 0)
+    return false;
+
+  /* without SKY_EXEC_RETRY the statement is attempted only once */
+  if (execute_query(worker, &connection, 0, "SELECT 1", 8,
+                    SKY_EXEC_NONE, NULL) != SKY_ERROR_CONNECTION)
+    return false;
+
+  if (worker->retries != 2 || worker->failed_queries != 2)
+    return false;
+
+  if (worker->timeline.size == 0 ||
+      worker->timeline.intervals[0].errors != 2 ||
+      worker->timeline.intervals[0].retries != 2)
+    return false;
+
+  /* a warmup statement is retried but left out of the figures */
+  if (execute_query(worker, &connection, 0, "SELECT 1", 8,
+                    SKY_EXEC_RETRY | SKY_EXEC_UNMEASURED,
+                    NULL) != SKY_ERROR_CONNECTION)
+    return false;
+
+  if (worker->retries != 2 || worker->failed_queries != 2 ||
+      worker->timeline.intervals[0].errors != 2 ||
+      worker->timeline.intervals[0].retries != 2)
+    return false;
+
+  sky_close_connection(&connection);
+  drizzle_free(&worker->database_handle);
+  sky_worker_free(worker);
+  sky_share_free(share);
+  return true;
+}
+
+static bool txn_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_WORKER *worker;
+  drizzle_con_st connection;
+  struct iovec piece = {"insert into t1 values (1)", 25};
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->server = strdup("localhost");
+  share->port = 1;
+  share->concurrency = 1;
+  share->slowest = 4;
+  share->max_retries = 0;
+  share->start_time = current_usec();
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  worker = workers[0];
+
+  if (!sky_create_connection(share, &worker->database_handle, &connection))
+    return false;
+
+  /* two INSERTs of a transaction whose COMMIT fails */
+  txn_begin(worker);
+
+  if (!record_statement(worker, &connection, 0, &piece, 1, 100) ||
+      !record_statement(worker, &connection, 0, &piece, 1, 200))
+    return false;
+
+  if (worker->target_queries[0] != 0 || worker->slowest_size != 0 ||
+      worker->timeline.size != 0)
+    return false;
+
+  if (execute_query(worker, &connection, 0, "COMMIT", 6, SKY_EXEC_CONTROL,
+                    NULL) == SKY_ERROR_NONE)
+    return false;
+
+  /* the transaction is rolled back and run again, and commits */
+  txn_discard(worker);
+  txn_begin(worker);
+
+  if (!record_statement(worker, &connection, 0, &piece, 1, 300) ||
+      !record_statement(worker, &connection, 0, &piece, 1, 400))
+    return false;
+
+  txn_commit(worker);
+
+  /* only the statements of the committed run count */
+  if (worker->target_queries[0] != 2 || worker->target_time[0] != 700 ||
+      worker->failed_queries != 1 || worker->slowest_size != 2 ||
+      worker->slowest[0].latency != 300 ||
+      worker->timeline.intervals[0].queries != 2)
+    return false;
+
+  /* the log stays readable for the caller's own figures */
+  if (worker->txn_count != 2 || worker->txn_log[1].latency != 400 ||
+      worker->txn_log[1].bytes != 25)
+    return false;
+
+  /* a statement outside of a transaction counts right away */
+  if (!record_statement(worker, &connection, 0, &piece, 1, 50) ||
+      worker->target_queries[0] != 3 ||
+      worker->timeline.intervals[0].queries != 3)
+    return false;
+
+  sky_close_connection(&connection);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
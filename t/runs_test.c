@@ -0,0 +1,136 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../runs.h"
+
+static bool summary_test(void);
+static bool outlier_test(void);
+static bool collect_test(void);
+
+int main(void) {
+  if (summary_test() == false)
+    return EXIT_FAILURE;
+  if (outlier_test() == false)
+    return EXIT_FAILURE;
+  if (collect_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool near(double value, double expected) {
+  return (value > expected - 0.001 && value < expected + 0.001);
+}
+
+static bool summary_test(void) {
+  double values[] = {10, 12, 14, 16, 18};
+  SKY_RUN_SUMMARY summary;
+
+  if (!near(t_quantile_95(1), 12.706) || !near(t_quantile_95(30), 2.042))
+    return false;
+
+  /* past the table the quantile closes in on the normal one */
+  if (t_quantile_95(1000) < 1.96 || t_quantile_95(1000) > 1.963)
+    return false;
+
+  if (!summarize_runs(values, 5, &summary, NULL))
+    return false;
+
+  /* stddev = sqrt(10), ci = 2.776 * sqrt(10) / sqrt(5) */
+  if (summary.n != 5 || summary.outliers != 0 || !near(summary.mean, 14) ||
+      !near(summary.median, 14) || !near(summary.stddev, 3.16228) ||
+      !near(summary.ci, 2.776 * 1.41421))
+    return false;
+
+  /* a single run has no spread */
+  if (!summarize_runs(values, 1, &summary, NULL) || summary.n != 1 ||
+      summary.stddev != 0 || summary.ci != 0)
+    return false;
+
+  return true;
+}
+
+static bool outlier_test(void) {
+  double values[] = {1000, 1010, 990, 1005, 995, 400};
+  double equal[] = {500, 500, 500};
+  bool outliers[6];
+  SKY_RUN_SUMMARY summary;
+
+  if (!summarize_runs(values, 6, &summary, outliers))
+    return false;
+
+  /* the slow run is left out of the figures */
+  if (summary.outliers != 1 || !outliers[5] || outliers[0] ||
+      summary.n != 5 || !near(summary.mean, 1000))
+    return false;
+
+  /* no deviation, no outliers */
+  if (!summarize_runs(equal, 3, &summary, outliers) ||
+      summary.outliers != 0 || summary.stddev != 0)
+    return false;
+
+  return true;
+}
+
+static bool collect_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_RUN_RESULT *runs;
+  SKY_RUN_SUMMARY summary;
+  uint32_t nruns;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* nothing to put together yet */
+  if (collect_runs(workers, &nruns) != NULL || nruns != 0)
+    return false;
+
+  /* 100 statements in a second, 500 usec each */
+  for (int i = 0; i < 3; i++) {
+    if (!record_run(workers[0], 1000000, 100, 50000))
+      return false;
+  }
+
+  /* 200 statements in half a second, 250 usec each */
+  for (int i = 0; i < 2; i++) {
+    if (!record_run(workers[1], 500000, 200, 50000))
+      return false;
+  }
+
+  /* only the runs every worker completed count */
+  if ((runs = collect_runs(workers, &nruns)) == NULL || nruns != 2)
+    return false;
+
+  if (runs[0].queries != 300 || !near(runs[0].qps, 100 + 400) ||
+      !near(runs[0].mean, 100000.0 / 300))
+    return false;
+
+  free(runs);
+
+  if (!summarize_throughput(workers, &summary) || summary.n != 2 ||
+      !near(summary.mean, 500) || summary.stddev != 0)
+    return false;
+
+  /* an aborted worker doesn't hold the others back */
+  workers[1]->aborted = true;
+
+  if ((runs = collect_runs(workers, &nruns)) == NULL || nruns != 3 ||
+      !near(runs[2].qps, 100))
+    return false;
+
+  free(runs);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
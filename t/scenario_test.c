@@ -0,0 +1,214 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../scenario.h"
+#include "../generator.h"
+
+#define SCENARIO_TEST_FILE "scenario_test.ini"
+
+static bool load_test(void);
+static bool error_test(void);
+static bool rate_test(void);
+static bool mix_test(void);
+
+int main(void) {
+  if (load_test() == false)
+    return EXIT_FAILURE;
+  if (error_test() == false)
+    return EXIT_FAILURE;
+  if (rate_test() == false)
+    return EXIT_FAILURE;
+  if (mix_test() == false)
+    return EXIT_FAILURE;
+
+  remove(SCENARIO_TEST_FILE);
+  return EXIT_SUCCESS;
+}
+
+/* A share with a read file and two populated tables */
+static SKY_SHARE *scenario_share(void) {
+  SKY_SHARE *share;
+
+  if ((share = sky_share_new()) == NULL)
+    return NULL;
+
+  share->concurrency = 4;
+  share->ntables = 2;
+  share->tables[0].create_query = strdup("CREATE TABLE a (id INT)");
+  share->tables[1].create_query = strdup("CREATE TABLE b (id INT)");
+  share->tables[1].insert_tmpl = strdup("INSERT INTO b VALUES (%seq)");
+  share->tables[1].nwrite = 100;
+
+  if ((share->read_queries = sky_list_new()) == NULL ||
+      !sky_list_push(share->read_queries, "SELECT 1", 8))
+    return NULL;
+
+  return share;
+}
+
+static SKY_SCENARIO *load_text(SKY_SHARE *share, const char *text) {
+  FILE *file;
+
+  if ((file = fopen(SCENARIO_TEST_FILE, "w")) == NULL)
+    return NULL;
+
+  fputs(text, file);
+  fclose(file);
+  return load_scenario(share, SCENARIO_TEST_FILE);
+}
+
+static bool load_test(void) {
+  SKY_SHARE *share = scenario_share();
+  SKY_SCENARIO *scenario;
+  SKY_SCENARIO_PHASE *phase;
+
+  if (share == NULL)
+    return false;
+
+  scenario = load_text(share,
+                       "# a spike in the middle of a steady load\n"
+                       "[warmup]\n"
+                       "duration = 10\n"
+                       "measure = no\n"
+                       "\n"
+                       "[ steady ]\n"
+                       "duration=60\n"
+                       "rate = 500\n"
+                       "mix = read:80, insert:20\n"
+                       "; twice the connections\n"
+                       "[spike]\n"
+                       "duration = 30\n"
+                       "concurrency = 16\n"
+                       "[ramp-down]\n"
+                       "duration = 20\n"
+                       "rate = 400\n"
+                       "rate_end = 100\n"
+                       "[load]\n"
+                       "ops = 1000\n"
+                       "mix = insert\n"
+                       "table = 2\n");
+
+  if (scenario == NULL || scenario->nphases != 5 ||
+      scenario->max_concurrency != 16)
+    return false;
+
+  /* defaults come from the command line */
+  phase = &scenario->phases[0];
+  if (strcmp(phase->name, "warmup") != 0 || phase->duration != 10 ||
+      phase->measure || phase->concurrency != 4 || phase->rate != 0 ||
+      phase->mix[SKY_OP_READ] != 1 || phase->mix[SKY_OP_INSERT] != 0 ||
+      phase->table != 1)
+    return false;
+
+  phase = &scenario->phases[1];
+  if (strcmp(phase->name, "steady") != 0 || !phase->measure ||
+      phase->rate != 500 || phase->rate_end != 500 ||
+      phase->mix[SKY_OP_READ] != 80 || phase->mix[SKY_OP_INSERT] != 20)
+    return false;
+
+  phase = &scenario->phases[3];
+  if (phase->rate != 400 || phase->rate_end != 100)
+    return false;
+
+  phase = &scenario->phases[4];
+  if (phase->ops != 1000 || phase->duration != 0 ||
+      phase->mix[SKY_OP_INSERT] != 1 || phase->mix[SKY_OP_READ] != 0)
+    return false;
+
+  /* the inserted rows follow the populated ones */
+  if (scenario->next_key[1] != table_key(share, &share->tables[1], 99) + 1)
+    return false;
+
+  sky_scenario_free(scenario);
+  sky_list_free(share->read_queries);
+  sky_share_free(share);
+  return true;
+}
+
+static bool error_test(void) {
+  static const char *invalid[] = {
+    "duration = 10\n",                            /* outside of a phase */
+    "",                                           /* no phases */
+    "[a]\nrate = 10\n",                           /* no duration or ops */
+    "[a]\nduration = 10\n[a]\nduration = 10\n",   /* name used twice */
+    "[a]\nduration = 10\nspeed = 2\n",            /* unknown setting */
+    "[a]\nduration = -1\n",                       /* negative */
+    "[a]\nduration = 10\nmix = read:80,delete\n", /* unknown operation */
+    "[a]\nduration = 10\nmix = read:0\n",         /* empty mix */
+    "[a]\nduration = 10\nmix = insert\ntable = 1\n", /* no template */
+    "[a]\nduration = 10\ntable = 3\n",            /* no such table */
+    "[a]\nops = 10\nrate = 5\nrate_end = 1\n",    /* ramp without time */
+    "[a]\nduration = 10\nrate_end = 1\n",         /* ramp without rate */
+    "[a]\nduration = 10\nconcurrency = 0\n",
+    "[a\nduration = 10\n",
+    "[]\nduration = 10\n",
+    "[a]\nduration\n",
+    NULL
+  };
+  SKY_SHARE *share = scenario_share();
+
+  if (share == NULL)
+    return false;
+
+  for (int i = 0; invalid[i] != NULL; i++) {
+    if (load_text(share, invalid[i]) != NULL) {
+      fprintf(stderr, "accepted: %s", invalid[i]);
+      return false;
+    }
+  }
+
+  if (load_scenario(share, "no_such_scenario.ini") != NULL)
+    return false;
+
+  /* reads need a read file */
+  sky_list_free(share->read_queries);
+  share->read_queries = NULL;
+
+  if (load_text(share, "[a]\nduration = 10\nmix = read\n") != NULL)
+    return false;
+
+  sky_share_free(share);
+  return true;
+}
+
+static bool rate_test(void) {
+  SKY_SCENARIO_PHASE phase;
+
+  memset(&phase, 0, sizeof(phase));
+  phase.duration = 10;
+  phase.rate = 400;
+  phase.rate_end = 100;
+
+  if (phase_rate(&phase, 0) != 400 || phase_rate(&phase, 5000000) != 250 ||
+      phase_rate(&phase, 10000000) != 100 ||
+      phase_rate(&phase, 20000000) != 100)
+    return false;
+
+  /* a phase bounded by its ops alone keeps its rate */
+  phase.duration = 0;
+  phase.rate_end = 400;
+  return (phase_rate(&phase, 5000000) == 400);
+}
+
+static bool mix_test(void) {
+  SKY_SCENARIO_PHASE phase;
+  uint64_t count[SKY_NOPS] = {0};
+
+  memset(&phase, 0, sizeof(phase));
+  phase.mix[SKY_OP_READ] = 3;
+  phase.mix[SKY_OP_INSERT] = 1;
+
+  for (uint64_t draw = 0; draw < 400; draw++)
+    count[pick_operation(&phase, draw)]++;
+
+  if (count[SKY_OP_READ] != 300 || count[SKY_OP_INSERT] != 100)
+    return false;
+
+  phase.mix[SKY_OP_READ] = 0;
+  return (pick_operation(&phase, 12345) == SKY_OP_INSERT);
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../slowest.h"
+
+static bool heap_test(void);
+static bool text_test(void);
+static bool merge_test(void);
+
+int main(void) {
+  if (heap_test() == false)
+    return EXIT_FAILURE;
+  if (text_test() == false)
+    return EXIT_FAILURE;
+  if (merge_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static void record(SKY_WORKER *worker, const char *query, uint64_t latency) {
+  struct iovec piece = {(void *)query, strlen(query)};
+  record_slow_query(worker, NULL, &piece, 1, latency);
+}
+
+static bool heap_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_SLOW_QUERY *slowest;
+  uint32_t count;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 1;
+  share->slowest = 5;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* 1000 latencies in a scrambled order, of which 996 .. 1000 are
+     the slowest */
+  for (uint64_t i = 0; i < 1000; i++)
+    record(workers[0], "select 1", (i * 379) % 1000 + 1);
+
+  if (workers[0]->slowest_size != 5 || workers[0]->slowest[0].latency != 996)
+    return false;
+
+  if ((slowest = merge_slowest(workers, &count)) == NULL || count != 5)
+    return false;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (slowest[i].latency != 1000 - i || slowest[i].worker != 1)
+      return false;
+  }
+  free(slowest);
+
+  /* nothing is kept without --slowest */
+  share->slowest = 0;
+  free(workers[0]->slowest);
+  workers[0]->slowest = NULL;
+  workers[0]->slowest_size = 0;
+  record(workers[0], "select 1", 5000);
+
+  if (merge_slowest(workers, &count) != NULL || count != 0)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool text_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_SLOW_QUERY *entry;
+  struct iovec pieces[3];
+  char payload[SLOWEST_TEXT_SIZE * 2];
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 1;
+  share->slowest = 1;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* a statement is kept on a single line */
+  record(workers[0], "select *\n  from t1\twhere a = 1", 10);
+  entry = &workers[0]->slowest[0];
+
+  if (strcmp(entry->text, "select *   from t1 where a = 1") != 0 ||
+      entry->length != 30)
+    return false;
+
+  /* the pieces of a statement are put together and cut short */
+  memset(payload, 'x', sizeof(payload));
+  pieces[0].iov_base = "insert into t1 values ('";
+  pieces[0].iov_len = 24;
+  pieces[1].iov_base = payload;
+  pieces[1].iov_len = sizeof(payload);
+  pieces[2].iov_base = "')";
+  pieces[2].iov_len = 2;
+  record_slow_query(workers[0], NULL, pieces, 3, 20);
+
+  if (entry->latency != 20 || entry->length != 24 + sizeof(payload) + 2 ||
+      strlen(entry->text) != SLOWEST_TEXT_SIZE - 1 ||
+      strncmp(entry->text, "insert into t1 values ('xxx", 27) != 0)
+    return false;
+
+  /* a faster statement doesn't take its place */
+  record(workers[0], "select 1", 15);
+
+  if (entry->latency != 20)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool merge_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_SLOW_QUERY *slowest;
+  uint32_t count;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 3;
+  share->slowest = 4;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* worker 2 ran the slowest statements and worker 3 only a few */
+  for (uint64_t i = 1; i <= 10; i++) {
+    record(workers[0], "select 1", i * 10);
+    record(workers[1], "select 2", i * 100);
+  }
+  record(workers[2], "select 3", 950);
+
+  if ((slowest = merge_slowest(workers, &count)) == NULL || count != 4)
+    return false;
+
+  if (slowest[0].latency != 1000 || slowest[0].worker != 2 ||
+      slowest[1].latency != 950 || slowest[1].worker != 3 ||
+      strcmp(slowest[1].text, "select 3") != 0 ||
+      slowest[2].latency != 900 || slowest[3].latency != 800)
+    return false;
+
+  free(slowest);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
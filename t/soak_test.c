@@ -0,0 +1,203 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../soak.h"
+
+#define SOAK_TEST_FILE "soak_test.csv"
+
+static bool trend_test(void);
+static bool sample_test(void);
+static bool rotate_test(void);
+static bool stop_test(void);
+
+int main(void) {
+  if (trend_test() == false)
+    return EXIT_FAILURE;
+  if (sample_test() == false)
+    return EXIT_FAILURE;
+  if (rotate_test() == false)
+    return EXIT_FAILURE;
+  if (stop_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool trend_test(void) {
+  SKY_TREND trend;
+
+  memset(&trend, 0, sizeof(trend));
+
+  /* a single point has no slope */
+  trend_add(&trend, 1, 10);
+  if (trend_slope(&trend) != 0)
+    return false;
+
+  /* the least squares fit of a point off the line y = 3x + 10 */
+  trend_add(&trend, 2, 16);
+  trend_add(&trend, 3, 19);
+  trend_add(&trend, 4, 22);
+
+  double slope = trend_slope(&trend);
+  if (slope < 3.899 || slope > 3.901)
+    return false;
+
+  memset(&trend, 0, sizeof(trend));
+  for (int i = 0; i < 100; i++)
+    trend_add(&trend, i, 500 - 2 * i);
+
+  slope = trend_slope(&trend);
+  return (slope > -2.0001 && slope < -1.9999);
+}
+
+static bool sample_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_SOAK *soak;
+  SKY_SOAK_SAMPLE iv;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+  share->report_interval = 1;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  if ((soak = sky_soak_new(share, workers)) == NULL)
+    return false;
+
+  if (workers[0]->soak_latency == NULL || workers[1]->soak_latency == NULL)
+    return false;
+
+  /* pretend a full interval has passed */
+  share->start_time = current_usec() - 1000000;
+  soak->last_time = share->start_time;
+
+  for (int i = 0; i < 100; i++)
+    sky_histogram_add(workers[0]->soak_latency, 1000);
+  for (int i = 0; i < 100; i++)
+    sky_histogram_add(workers[1]->soak_latency, 2000);
+  workers[1]->failed_queries = 3;
+
+  if (!soak_sample(soak, &iv))
+    return false;
+
+  if (iv.queries != 200 || iv.errors != 3 || iv.max != 2000)
+    return false;
+
+  if (iv.qps < 150 || iv.qps > 201 || iv.drift != 0)
+    return false;
+
+  /* the workers start over with an empty histogram */
+  if (workers[0]->soak_latency->count != 0 || soak->intervals != 1)
+    return false;
+
+  /* once the baseline is set, a slower interval shows as drift */
+  for (int n = 1; n < SOAK_BASELINE; n++) {
+    soak->last_time = current_usec() - 1000000;
+    for (int i = 0; i < 200; i++)
+      sky_histogram_add(workers[0]->soak_latency, 1000);
+    soak_sample(soak, &iv);
+  }
+
+  soak->last_time = current_usec() - 1000000;
+  for (int i = 0; i < 100; i++)
+    sky_histogram_add(workers[0]->soak_latency, 1000);
+  soak_sample(soak, &iv);
+
+  if (iv.errors != 0 || iv.drift > -40 || iv.drift < -60)
+    return false;
+
+  /* a short interval doesn't count towards the trends */
+  soak_sample(soak, &iv);
+  if (soak->intervals != SOAK_BASELINE + 1 || soak->queries != 1100)
+    return false;
+
+  sky_soak_free(soak);
+
+  if (workers[0]->soak_latency != NULL)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool rotate_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_SOAK *soak;
+  SKY_SOAK_SAMPLE iv;
+  char path[SKY_STRSIZ];
+  FILE *file;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->report_interval = 1;
+  share->soak_path = strdup(SOAK_TEST_FILE);
+  share->soak_rotate = 1; /* every interval goes to a file of its own */
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  if ((soak = sky_soak_new(share, workers)) == NULL)
+    return false;
+
+  share->start_time = current_usec();
+  soak->last_time = share->start_time;
+
+  for (int i = 0; i < SKY_SOAK_KEEP + 3; i++) {
+    if (!soak_sample(soak, &iv))
+      return false;
+  }
+
+  if (soak->rotations != SKY_SOAK_KEEP + 2)
+    return false;
+
+  /* only SKY_SOAK_KEEP rotated files are kept */
+  for (int i = 1; i <= SKY_SOAK_KEEP + 1; i++) {
+    snprintf(path, sizeof(path), "%s.%d", SOAK_TEST_FILE, i);
+    file = fopen(path, "r");
+
+    if ((i <= SKY_SOAK_KEEP) != (file != NULL))
+      return false;
+
+    /* every file starts with the column names */
+    if (file) {
+      char line[SKY_STRSIZ];
+
+      if (fgets(line, sizeof(line), file) == NULL ||
+          strcmp(line, SOAK_HEADER) != 0 ||
+          fgets(line, sizeof(line), file) == NULL)
+        return false;
+
+      fclose(file);
+      remove(path);
+    }
+  }
+
+  sky_soak_free(soak);
+  remove(SOAK_TEST_FILE);
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool stop_test(void) {
+  if (stop_requested())
+    return false;
+
+  if (!install_stop_handler())
+    return false;
+
+  raise(SIGTERM);
+  return stop_requested();
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../splitter.h"
+
+#define SPLITTER_TEST_FILE "./splitter_test.sql"
+
+static bool scan_test(void);
+static bool quote_test(void);
+static bool comment_test(void);
+static bool delimiter_test(void);
+static bool file_test(void);
+
+int main(void) {
+  if (scan_test() == false)
+    return EXIT_FAILURE;
+  if (quote_test() == false)
+    return EXIT_FAILURE;
+  if (comment_test() == false)
+    return EXIT_FAILURE;
+  if (delimiter_test() == false)
+    return EXIT_FAILURE;
+  if (file_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+/* Splits the script and compares the statements with the expected
+   ones, given as a NULL terminated array */
+static bool split_equals(const char *script, const char **expected) {
+  SKY_SPLITTER splitter;
+  const char *statement;
+  size_t length;
+  int i = 0;
+
+  splitter_init(&splitter, script, strlen(script));
+
+  while ((statement = next_statement(&splitter, &length)) != NULL) {
+    if (expected[i] == NULL || strlen(expected[i]) != length ||
+        strncmp(statement, expected[i], length) != 0)
+      return false;
+    i++;
+  }
+  return (expected[i] == NULL && !splitter.error);
+}
+
+static bool scan_test(void) {
+  char buffer[200];
+
+  /* the vector loop and the bytes left over agree at every offset */
+  for (int i = 0; i < 100; i++) {
+    memset(buffer, 'a', sizeof(buffer));
+    buffer[i] = ';';
+
+    for (int start = 0; start <= i; start++) {
+      if (split_scan(buffer + start, buffer + sizeof(buffer), "'\";", 3) !=
+          buffer + i)
+        return false;
+    }
+
+    /* the end of the range is respected */
+    if (split_scan(buffer, buffer + i, ";", 1) != buffer + i)
+      return false;
+  }
+
+  memset(buffer, 'a', sizeof(buffer));
+  buffer[150] = '`';
+  buffer[151] = '#';
+
+  return (split_scan(buffer, buffer + sizeof(buffer), "#`", 2) ==
+          buffer + 150);
+}
+
+static bool quote_test(void) {
+  const char *script =
+    "INSERT INTO t1 VALUES ('a;b', \"c;d\", 'it''s; fine');\n"
+    "INSERT INTO t1 VALUES ('back\\\\slash\\';', 1);\n"
+    "SELECT `odd;name` FROM t1;\n"
+    "SELECT 'unterminated;";
+  const char *expected[] = {
+    "INSERT INTO t1 VALUES ('a;b', \"c;d\", 'it''s; fine')",
+    "INSERT INTO t1 VALUES ('back\\\\slash\\';', 1)",
+    "SELECT `odd;name` FROM t1",
+    "SELECT 'unterminated;",
+    NULL
+  };
+
+  return split_equals(script, expected);
+}
+
+static bool comment_test(void) {
+  const char *script =
+    "-- MySQL dump; with a semicolon\n"
+    "# another comment;\n"
+    "/* a block; comment */\n"
+    "/*!40101 SET NAMES utf8 */;\n"
+    "SELECT 1 -- trailing; comment\n"
+    "  FROM t1;;\n"
+    "SELECT 2-1 /* inline; */ FROM t1;\n"
+    "SELECT 3--1;\n"
+    "-- Dump completed\n";
+  const char *expected[] = {
+    "/*!40101 SET NAMES utf8 */",
+    "SELECT 1 -- trailing; comment\n  FROM t1",
+    "SELECT 2-1 /* inline; */ FROM t1",
+    "SELECT 3--1",
+    NULL
+  };
+
+  return split_equals(script, expected);
+}
+
+static bool delimiter_test(void) {
+  SKY_SPLITTER splitter;
+  size_t length;
+  const char *script =
+    "DELIMITER ;;\n"
+    "CREATE TRIGGER t BEFORE INSERT ON t1 FOR EACH ROW BEGIN\n"
+    "  SET NEW.a = 1;\n"
+    "END ;;\n"
+    "delimiter //\n"
+    "SELECT 1; SELECT 2//\n"
+    "DELIMITER ;\n"
+    "SELECT 3;";
+  const char *expected[] = {
+    "CREATE TRIGGER t BEFORE INSERT ON t1 FOR EACH ROW BEGIN\n"
+    "  SET NEW.a = 1;\n"
+    "END",
+    "SELECT 1; SELECT 2",
+    "SELECT 3",
+    NULL
+  };
+
+  if (!split_equals(script, expected))
+    return false;
+
+  /* a DELIMITER line needs a delimiter */
+  splitter_init(&splitter, "SELECT 1;\nDELIMITER  \n", 21);
+
+  if (next_statement(&splitter, &length) == NULL ||
+      next_statement(&splitter, &length) != NULL)
+    return false;
+
+  return splitter.error;
+}
+
+static bool file_test(void) {
+  SKY_LIST *list;
+  FILE *file;
+  bool rv;
+
+  if ((file = fopen(SPLITTER_TEST_FILE, "w")) == NULL)
+    return false;
+
+  fprintf(file, "CREATE TABLE t1 (\n  id INT\n);\n"
+                "INSERT INTO t1 VALUES (1),(2);\n");
+  fclose(file);
+
+  if ((list = split_file_to_list(SPLITTER_TEST_FILE)) == NULL)
+    return false;
+
+  /* the statements are copied out of the file */
+  rv = (list->size == 2 &&
+        strcmp(list->head->data, "CREATE TABLE t1 (\n  id INT\n)") == 0 &&
+        strcmp(list->tail->data, "INSERT INTO t1 VALUES (1),(2)") == 0);
+  sky_list_free(list);
+
+  /* an empty file has no statements */
+  if ((file = fopen(SPLITTER_TEST_FILE, "w")) == NULL)
+    return false;
+  fclose(file);
+
+  if (rv) {
+    if ((list = split_file_to_list(SPLITTER_TEST_FILE)) == NULL)
+      return false;
+
+    rv = (list->size == 0);
+    sky_list_free(list);
+  }
+
+  unlink(SPLITTER_TEST_FILE);
+  return rv;
+}
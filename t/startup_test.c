@@ -10,6 +10,7 @@
 
 static bool allocation_test(void);
 static bool multi_allocation_test(void);
+static bool think_option_test(void);
 static bool option_check_test(void);
 
 int main(void) {
@@ -17,6 +18,8 @@ int main(void) {
     return EXIT_FAILURE;
   if (multi_allocation_test() == false)
     return EXIT_FAILURE;
+  if (think_option_test() == false)
+    return EXIT_FAILURE;
   if (option_check_test() == false)
     return EXIT_FAILURE;
 
@@ -37,18 +40,20 @@ static bool allocation_test(void) {
   /* test the deallocator. deliberatly free the allocated members
      and see if the deallocator will not double-free */
   share->server = strdup("localhost");
-  share->create_query = strdup("CREATE TABLE t1 (id int primary key);");
+  share->tables[0].create_query = strdup("CREATE TABLE t1 (id int primary key);");
+  share->ntables = 1;
   share->read_file_path = strdup("/path/to/file");
 
-  if (!share->server || !share->create_query || !share->read_file_path)
+  if (!share->server || !share->tables[0].create_query ||
+      !share->read_file_path)
     return false;
 
   free(share->server);
-  free(share->create_query);
+  free(share->tables[0].create_query);
   free(share->read_file_path);
 
   share->server = NULL; 
-  share->create_query = NULL; 
+  share->tables[0].create_query = NULL; 
   share->read_file_path = NULL;
   
   /* if this screws up, it will kill the test program */
@@ -75,6 +80,47 @@ static bool multi_allocation_test(void) {
   return true;
 }
 
+/* Parses a --think-time option on its own */
+static bool think_option(SKY_SHARE *share, const char *spec) {
+  char option[SKY_STRSIZ];
+  char *argv[] = {"skyload", option, NULL};
+
+  snprintf(option, sizeof(option), "--think-time=%s", spec);
+  optind = 1;
+  return handle_options(share, 2, argv);
+}
+
+static bool think_option_test(void) {
+  SKY_SHARE *share;
+
+  /* the rejected values complain on stderr */
+  if (freopen("/dev/null", "w", stderr) == NULL)
+    return false;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if (!think_option(share, "uniform:5-20") ||
+      share->think_model != SKY_THINK_UNIFORM ||
+      share->think_min != 5000 || share->think_max != 20000)
+    return false;
+
+  /* a negative number must not wrap around to a huge one */
+  if (think_option(share, "fixed:-5") || think_option(share, "uniform:5--20"))
+    return false;
+
+  /* nor may one overflow, in msecs or once in usecs */
+  if (think_option(share, "fixed:99999999999999999999") ||
+      think_option(share, "fixed:18446744073709552"))
+    return false;
+
+  if (think_option(share, "fixed:") || think_option(share, "fixed: 5"))
+    return false;
+
+  sky_share_free(share);
+  return true;
+}
+
 static bool option_check_test(void) {
   SKY_SHARE *share;
   FILE *redirect;
@@ -88,11 +134,14 @@ static bool option_check_test(void) {
     return false;
 
   /* specify skyload to auto-generate data */
-  share->create_query = strdup("CREATE TABLE t1 (id int primary key)");
-  share->insert_tmpl = strdup("INSERT INTO t1 VALUES (1)");
-  share->columns = string_occurrence(share->insert_tmpl, "%");
+  SKY_TABLE *table = &share->tables[0];
+  share->ntables = 1;
 
-  if (share->create_query == NULL || share->insert_tmpl == NULL)
+  table->create_query = strdup("CREATE TABLE t1 (id int primary key)");
+  table->insert_tmpl = strdup("INSERT INTO t1 VALUES (1)");
+  table->columns = string_occurrence(table->insert_tmpl, "%");
+
+  if (table->create_query == NULL || table->insert_tmpl == NULL)
     return false;
 
   /* this should fail due to lack of information */
@@ -103,7 +152,7 @@ static bool option_check_test(void) {
   if ((share->server = strdup("localhost")) == NULL)
     return false;
 
-  share->nwrite = 100;
+  table->nwrite = 100;
 
   /* this should still fail since there is no placeholder
      in the INSERT tmplate*/
@@ -111,17 +160,53 @@ static bool option_check_test(void) {
     return false;
 
   /* replace the magic number with a placeholder */
-  free(share->insert_tmpl);
-  share->insert_tmpl = strdup("INSERT INTO t1 VALUES (%seq)");
-  share->columns = string_occurrence(share->insert_tmpl, "%");
+  free(table->insert_tmpl);
+  table->insert_tmpl = strdup("INSERT INTO t1 VALUES (%seq)");
+  table->columns = string_occurrence(table->insert_tmpl, "%");
 
-  if (share->insert_tmpl == NULL)
+  if (table->insert_tmpl == NULL)
     return false;
 
   /* there should now be sufficient information */
   if (check_options(share) == false)
     return false;
 
+  /* add a child table that references the keys of the first one */
+  SKY_TABLE *child = &share->tables[1];
+  share->ntables = 2;
+
+  child->create_query = strdup("CREATE TABLE t2 (id int, t1_id int)");
+  child->insert_tmpl = strdup("INSERT INTO t2 VALUES (%seq, %ref2)");
+  child->columns = string_occurrence(child->insert_tmpl, "%");
+  child->nwrite = 100;
+
+  if (child->create_query == NULL || child->insert_tmpl == NULL)
+    return false;
+
+  /* a table can't reference itself or a later table */
+  if (check_options(share) == true)
+    return false;
+
+  free(child->insert_tmpl);
+  child->insert_tmpl = strdup("INSERT INTO t2 VALUES (%seq, %ref1)");
+
+  if (child->insert_tmpl == NULL)
+    return false;
+
+  if (check_options(share) == false)
+    return false;
+
+  /* every table needs its own creation statement */
+  free(child->create_query);
+  child->create_query = NULL;
+
+  if (check_options(share) == true)
+    return false;
+
+  free(child->insert_tmpl);
+  child->insert_tmpl = NULL;
+  share->ntables = 1;
+
   /* provide a load file as well as the insert template */
   if ((share->load_file_path = strdup("/path/to/file")) == NULL)
     return false;
@@ -131,8 +216,8 @@ static bool option_check_test(void) {
     return false;
 
   /* try retesting by gettind rid of the INSERT template */
-  free(share->insert_tmpl);
-  share->insert_tmpl = NULL;
+  free(table->insert_tmpl);
+  table->insert_tmpl = NULL;
 
   if (check_options(share) == false)
     return false;
@@ -144,6 +229,25 @@ static bool option_check_test(void) {
   if (check_options(share) == false)
     return false;
 
+  /* pipelining relies on the MySQL multi-statement support */
+  share->pipeline_depth = 8;
+
+  if (check_options(share) == true)
+    return false;
+
+  share->protocol = DRIZZLE_CON_MYSQL;
+
+  if (check_options(share) == false)
+    return false;
+
+  /* the exporter follows the workers of a scenario too */
+  if ((share->scenario_path = strdup("/path/to/scenario")) == NULL ||
+      (share->metrics_addr = strdup("9100")) == NULL)
+    return false;
+
+  if (check_options(share) == false)
+    return false;
+
   fclose(redirect);
   sky_share_free(share);
   return true;
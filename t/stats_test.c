@@ -0,0 +1,191 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../sweep.h"
+
+static bool histogram_test(void);
+static bool histogram_merge_test(void);
+static bool saturation_test(void);
+static bool search_test(void);
+static bool operating_point_test(void);
+
+int main(void) {
+  if (histogram_test() == false)
+    return EXIT_FAILURE;
+  if (histogram_merge_test() == false)
+    return EXIT_FAILURE;
+  if (saturation_test() == false)
+    return EXIT_FAILURE;
+  if (search_test() == false)
+    return EXIT_FAILURE;
+  if (operating_point_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+/* true if 'value' is within 4% of 'expected' */
+static bool roughly(uint64_t value, uint64_t expected) {
+  return (value >= expected * 0.96 && value <= expected * 1.04);
+}
+
+static bool histogram_test(void) {
+  SKY_HISTOGRAM hist;
+
+  sky_histogram_reset(&hist);
+
+  if (sky_histogram_percentile(&hist, 99.0) != 0)
+    return false;
+
+  /* 1..10000 usec, one sample each */
+  for (uint64_t i = 1; i <= 10000; i++)
+    sky_histogram_add(&hist, i);
+
+  if (hist.count != 10000 || hist.min != 1 || hist.max != 10000)
+    return false;
+
+  if (!roughly(sky_histogram_percentile(&hist, 50.0), 5000))
+    return false;
+
+  if (!roughly(sky_histogram_percentile(&hist, 99.0), 9900))
+    return false;
+
+  if (sky_histogram_percentile(&hist, 100.0) != 10000)
+    return false;
+
+  if (sky_histogram_mean(&hist) != 5000.5)
+    return false;
+
+  /* small values are recorded exactly */
+  sky_histogram_reset(&hist);
+  sky_histogram_add(&hist, 7);
+
+  if (sky_histogram_percentile(&hist, 99.0) != 7)
+    return false;
+
+  return true;
+}
+
+static bool histogram_merge_test(void) {
+  SKY_HISTOGRAM a, b;
+
+  sky_histogram_reset(&a);
+  sky_histogram_reset(&b);
+
+  for (int i = 0; i < 990; i++)
+    sky_histogram_add(&a, 100);
+  for (int i = 0; i < 10; i++)
+    sky_histogram_add(&b, 50000);
+
+  sky_histogram_merge(&a, &b);
+
+  if (a.count != 1000 || a.max != 50000 || a.min != 100)
+    return false;
+
+  if (!roughly(sky_histogram_percentile(&a, 50.0), 100))
+    return false;
+
+  if (!roughly(sky_histogram_percentile(&a, 99.5), 50000))
+    return false;
+
+  return true;
+}
+
+static bool saturation_test(void) {
+  SKY_SWEEP_LEVEL levels[5] = {
+    { 1,  0, 1000.0, 1000, 1000 },
+    { 2,  0, 1950.0, 1000, 1100 },
+    { 4,  0, 3800.0, 1000, 1300 },
+    { 8,  0, 3900.0, 2000, 2600 },
+    { 16, 0, 3700.0, 4000, 5200 }
+  };
+
+  /* throughput stops scaling after 4 connections */
+  if (find_saturation_point(levels, 5) != 2)
+    return false;
+
+  /* never saturated */
+  if (find_saturation_point(levels, 3) != -1)
+    return false;
+
+  return true;
+}
+
+static bool search_test(void) {
+  SKY_SEARCH_BOUNDS bounds = { 0, 0, 64, true };
+  double value;
+
+  /* the workers double until 16 of them miss the target */
+  if ((value = next_search_value(&bounds, 1, true)) != 2 ||
+      (value = next_search_value(&bounds, 2, true)) != 4 ||
+      (value = next_search_value(&bounds, 4, true)) != 8 ||
+      (value = next_search_value(&bounds, 8, true)) != 16)
+    return false;
+
+  /* and are bisected down to adjacent numbers from then on */
+  if ((value = next_search_value(&bounds, 16, false)) != 12 ||
+      (value = next_search_value(&bounds, 12, true)) != 14 ||
+      (value = next_search_value(&bounds, 14, false)) != 13 ||
+      next_search_value(&bounds, 13, false) != 0 ||
+      bounds.pass != 12 || bounds.fail != 13)
+    return false;
+
+  /* the search ends at the ceiling if everything met the target */
+  memset(&bounds, 0, sizeof(bounds));
+  bounds.ceiling = 3;
+  bounds.integral = true;
+
+  if (next_search_value(&bounds, 2, true) != 3 ||
+      next_search_value(&bounds, 3, true) != 0)
+    return false;
+
+  /* a single worker that misses it has nowhere to go */
+  memset(&bounds, 0, sizeof(bounds));
+  bounds.ceiling = 8;
+  bounds.integral = true;
+
+  if (next_search_value(&bounds, 1, false) != 0)
+    return false;
+
+  /* the rate is bisected until it's within SEARCH_PRECISION */
+  memset(&bounds, 0, sizeof(bounds));
+  bounds.fail = bounds.ceiling = 1000;
+  value = 500;
+
+  for (int i = 0; i < SEARCH_MAX_STEPS && value > 0; i++) {
+    double next = next_search_value(&bounds, value, value <= 730);
+
+    if (next == 0)
+      break;
+    value = next;
+  }
+
+  if (bounds.pass > 730 || bounds.fail <= 730 ||
+      bounds.fail - bounds.pass > bounds.fail * SEARCH_PRECISION)
+    return false;
+
+  return true;
+}
+
+static bool operating_point_test(void) {
+  SKY_SWEEP_LEVEL steps[4] = {
+    { 8, 40000, 4000.0, 9000, 30000, 0,      30000, false },
+    { 8, 20000, 2000.0, 2000, 6000,  2000.0, 6000,  true },
+    { 8, 30000, 3000.0, 3000, 9000,  3000.0, 9000,  true },
+    { 8, 35000, 3500.0, 6000, 20000, 3500.0, 20000, false }
+  };
+
+  /* the fastest step within the target, not the last one */
+  if (find_operating_point(steps, 4) != 2)
+    return false;
+
+  if (find_operating_point(steps, 1) != -1)
+    return false;
+
+  return true;
+}
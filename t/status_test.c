@@ -0,0 +1,170 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../status.h"
+
+static bool variable_test(void);
+static bool engine_status_test(void);
+static bool end_phase_test(void);
+
+int main(void) {
+  if (variable_test() == false)
+    return EXIT_FAILURE;
+  if (engine_status_test() == false)
+    return EXIT_FAILURE;
+  if (end_phase_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool variable_test(void) {
+  SKY_SHARE *share;
+  SKY_STATUS *status;
+  SKY_STATUS_SAMPLE *sample;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->status_vars = strdup("Questions,,Innodb_rows_read");
+
+  if ((status = sky_status_new(share)) == NULL)
+    return false;
+
+  if (status->nvars != 2 || strcmp(status->names[1], "Innodb_rows_read") != 0)
+    return false;
+
+  if ((sample = status_append(status, true, "insert")) == NULL)
+    return false;
+
+  if (!sample->boundary || strcmp(sample->label, "insert") != 0)
+    return false;
+
+  status_set_value(status, sample, "questions", "1234");
+  status_set_value(status, sample, "Innodb_rows_read", "OFF");
+  status_set_value(status, sample, "Uptime", "99");
+
+  if (sample->values[0] != 1234 || !status->found[0])
+    return false;
+
+  /* non-numeric values are not counters */
+  if (sample->values[1] != 0 || status->found[1])
+    return false;
+
+  /* samples survive the array growing */
+  for (int i = 0; i < STATUS_INITIAL_CAPACITY * 2; i++) {
+    if (status_append(status, false, NULL) == NULL)
+      return false;
+  }
+
+  if (status->nsamples != STATUS_INITIAL_CAPACITY * 2 + 1 ||
+      status->samples[0].values[0] != 1234)
+    return false;
+
+  /* a soak test drops the oldest sample between the boundaries */
+  share->soak = true;
+  status->samples[1].values[0] = 1;
+  status->samples[2].values[0] = 2;
+  status->samples[2].boundary = true;
+  status->samples[3].values[0] = 3;
+
+  for (int i = status->nsamples; i < STATUS_SOAK_SAMPLES + 2; i++) {
+    if (status_append(status, false, NULL) == NULL)
+      return false;
+  }
+
+  if (status->nsamples != STATUS_SOAK_SAMPLES ||
+      status->samples[0].values[0] != 1234 ||
+      !status->samples[1].boundary || status->samples[1].values[0] != 2 ||
+      status->samples[2].values[0] == 3)
+    return false;
+
+  sky_status_free(status);
+  sky_share_free(share);
+  return true;
+}
+
+static bool engine_status_test(void) {
+  SKY_SHARE *share;
+  SKY_STATUS *status;
+  SKY_STATUS_SAMPLE *sample;
+  const char *text =
+    "------------\nTRANSACTIONS\n------------\n"
+    "Trx id counter 5891\n"
+    "History list length 12\n"
+    "---\nLOG\n---\n"
+    "Log sequence number 123456\n"
+    "Log flushed up to   123400\n";
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  share->engine_status = true;
+
+  if ((status = sky_status_new(share)) == NULL)
+    return false;
+
+  /* the default list plus the two engine figures */
+  if (status->nvars < 3 ||
+      strcmp(status->names[status->nvars - 2], ENGINE_HISTORY_LENGTH) != 0)
+    return false;
+
+  if ((sample = status_append(status, false, NULL)) == NULL)
+    return false;
+
+  parse_engine_status(status, sample, text);
+
+  if (sample->values[status->nvars - 2] != 12 ||
+      sample->values[status->nvars - 1] != 123456)
+    return false;
+
+  sky_status_free(status);
+  sky_share_free(share);
+  return true;
+}
+
+static bool end_phase_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER *first, *second;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((first = sky_worker_new()) == NULL ||
+      (second = sky_worker_new()) == NULL)
+    return false;
+
+  share->concurrency = 2;
+  first->share = share;
+  second->share = share;
+
+  /* finishing a later phase finishes the skipped ones too */
+  status_end_phase(first, SKY_PHASE_READ);
+
+  if (first->phase != SKY_PHASE_REPLAY ||
+      share->phase_finished[SKY_PHASE_INSERT] != 1 ||
+      share->phase_finished[SKY_PHASE_READ] != 1 ||
+      share->phase_finished[SKY_PHASE_REPLAY] != 0)
+    return false;
+
+  status_end_phase(second, SKY_PHASE_INSERT);
+  status_end_phase(second, SKY_PHASE_REPLAY);
+
+  /* phases are never counted twice */
+  status_end_phase(second, SKY_PHASE_REPLAY);
+
+  if (share->phase_finished[SKY_PHASE_INSERT] != 2 ||
+      share->phase_finished[SKY_PHASE_READ] != 2 ||
+      share->phase_finished[SKY_PHASE_REPLAY] != 1)
+    return false;
+
+  sky_worker_free(first);
+  sky_worker_free(second);
+  sky_share_free(share);
+  return true;
+}
@@ -0,0 +1,163 @@
+/* 
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../think.h"
+
+static bool wheel_test(void);
+static bool think_time_test(void);
+static bool pause_test(void);
+
+int main(void) {
+  if (wheel_test() == false)
+    return EXIT_FAILURE;
+  if (think_time_test() == false)
+    return EXIT_FAILURE;
+  if (pause_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static bool wheel_test(void) {
+  SKY_TIMER_WHEEL *wheel;
+  SKY_TIMER soon, later, far, overdue;
+  uint64_t base = 1000 * WHEEL_TICK;
+
+  if ((wheel = sky_timer_wheel_new()) == NULL)
+    return false;
+
+  wheel->tick = base / WHEEL_TICK;
+
+  soon.due = base + 1500;
+  later.due = base + 10 * WHEEL_TICK;
+  far.due = base + (WHEEL_SLOTS + 2) * WHEEL_TICK; /* next revolution */
+  overdue.due = base - 5 * WHEEL_TICK;
+
+  pthread_cond_init(&soon.wakeup, NULL);
+  pthread_cond_init(&later.wakeup, NULL);
+  pthread_cond_init(&far.wakeup, NULL);
+  pthread_cond_init(&overdue.wakeup, NULL);
+
+  timer_wheel_add(wheel, &soon);
+  timer_wheel_add(wheel, &later);
+  timer_wheel_add(wheel, &far);
+  timer_wheel_add(wheel, &overdue);
+
+  if (wheel->pending != 4)
+    return false;
+
+  /* the overdue timer goes with the current tick */
+  if (timer_wheel_expire(wheel, base) != 1 || !overdue.fired)
+    return false;
+
+  /* timers never fire early */
+  if (timer_wheel_expire(wheel, base + 1999) != 0 || soon.fired)
+    return false;
+
+  if (timer_wheel_expire(wheel, base + 2000) != 1 || !soon.fired)
+    return false;
+
+  /* a revolution later only the timer due then is left */
+  if (timer_wheel_expire(wheel, base + WHEEL_SLOTS * WHEEL_TICK) != 1 ||
+      !later.fired || far.fired)
+    return false;
+
+  if (timer_wheel_expire(wheel, far.due) != 1 || !far.fired ||
+      wheel->pending != 0)
+    return false;
+
+  pthread_cond_destroy(&soon.wakeup);
+  pthread_cond_destroy(&later.wakeup);
+  pthread_cond_destroy(&far.wakeup);
+  pthread_cond_destroy(&overdue.wakeup);
+  sky_timer_wheel_free(wheel);
+  return true;
+}
+
+static bool think_time_test(void) {
+  SKY_SHARE *share;
+  double sum = 0;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if (next_think_time(share) != 0)
+    return false;
+
+  share->think_model = SKY_THINK_FIXED;
+  share->think_min = share->think_max = 5000;
+
+  if (next_think_time(share) != 5000)
+    return false;
+
+  share->think_model = SKY_THINK_UNIFORM;
+  share->think_min = 1000;
+  share->think_max = 2000;
+
+  for (int i = 0; i < 1000; i++) {
+    uint64_t think = next_think_time(share);
+
+    if (think < 1000 || think > 2000)
+      return false;
+  }
+
+  /* the mean of the exponential draws is close to the given mean */
+  share->think_model = SKY_THINK_EXPONENTIAL;
+  share->think_min = share->think_max = 10000;
+
+  for (int i = 0; i < 10000; i++)
+    sum += next_think_time(share);
+
+  if (sum / 10000 < 9000 || sum / 10000 > 11000)
+    return false;
+
+  sky_share_free(share);
+  return true;
+}
+
+static bool pause_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER *worker;
+  uint64_t begin;
+
+  if ((share = sky_share_new()) == NULL)
+    return false;
+
+  if ((worker = sky_worker_new()) == NULL)
+    return false;
+
+  if ((share->timer_wheel = sky_timer_wheel_new()) == NULL ||
+      !timer_wheel_start(share->timer_wheel))
+    return false;
+
+  worker->share = share;
+  share->think_model = SKY_THINK_FIXED;
+  share->think_min = share->think_max = 20000;
+
+  begin = current_usec();
+  session_pause(worker);
+
+  if (current_usec() - begin < 20000 || worker->session_ops != 1 ||
+      worker->think_wait < 20000)
+    return false;
+
+  /* pacing at 600 ops/min spaces the starts 100 msecs apart */
+  share->think_model = SKY_THINK_NONE;
+  share->pace = 600;
+  worker->op_start = begin = current_usec();
+  session_pause(worker);
+
+  if (current_usec() - begin < 100000 || worker->op_start - begin < 100000)
+    return false;
+
+  sky_timer_wheel_free(share->timer_wheel);
+  share->timer_wheel = NULL;
+  sky_worker_free(worker);
+  sky_share_free(share);
+  return true;
+}
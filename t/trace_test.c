@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "../trace.h"
+
+#define TRACE_TEST_FILE "trace_test.json"
+
+static bool span_test(void);
+static bool sample_test(void);
+static bool write_test(void);
+
+int main(void) {
+  if (span_test() == false)
+    return EXIT_FAILURE;
+  if (sample_test() == false)
+    return EXIT_FAILURE;
+  if (write_test() == false)
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
+
+static SKY_SHARE *trace_share(uint32_t concurrency, uint32_t sample) {
+  SKY_SHARE *share = sky_share_new();
+
+  if (share == NULL)
+    return NULL;
+
+  share->concurrency = concurrency;
+  share->trace_path = strdup(TRACE_TEST_FILE);
+  share->trace_sample = sample;
+  share->start_time = 1000000;
+  return share;
+}
+
+static bool span_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  SKY_SPAN *span;
+
+  if ((share = trace_share(1, 1)) == NULL)
+    return false;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* statements before the load started aren't on the timeline */
+  record_span(workers[0], 500000, 10, false);
+
+  workers[0]->phase = SKY_PHASE_READ;
+  record_span(workers[0], 1000250, 40, false);
+  record_span(workers[0], 1000300, 5, true);
+
+  if (workers[0]->spans_size != 2)
+    return false;
+
+  span = &workers[0]->spans[0];
+
+  if (span->start != 250 || span->duration != 40 ||
+      span->op != SKY_PHASE_READ || workers[0]->spans[1].op != TRACE_CONTROL)
+    return false;
+
+  /* nothing is traced without --trace */
+  free(share->trace_path);
+  share->trace_path = NULL;
+  record_span(workers[0], 1000400, 5, false);
+
+  if (workers[0]->spans_size != 2)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool sample_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+
+  if ((share = trace_share(1, 10)) == NULL)
+    return false;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  /* the 1st, 11th, 21st .. statements are kept */
+  for (uint64_t i = 0; i < 1000; i++)
+    record_span(workers[0], share->start_time + i, 1, false);
+
+  if (workers[0]->spans_size != 100 || workers[0]->spans[1].start != 10 ||
+      workers[0]->spans[99].start != 990)
+    return false;
+
+  /* the buffer stops growing at its bound */
+  share->trace_sample = 1;
+
+  for (uint64_t i = 0; i < TRACE_MAX_SPANS; i++)
+    record_span(workers[0], share->start_time + i, 1, false);
+
+  if (workers[0]->spans_size != TRACE_MAX_SPANS ||
+      workers[0]->spans_dropped != 100)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
+
+static bool write_test(void) {
+  SKY_SHARE *share;
+  SKY_WORKER **workers;
+  char buffer[SKY_STRSIZ];
+  size_t length;
+  FILE *file;
+
+  if ((share = trace_share(2, 1)) == NULL)
+    return false;
+
+  if ((workers = create_workers(share)) == NULL)
+    return false;
+
+  workers[0]->phase = SKY_PHASE_INSERT;
+  record_span(workers[0], 1000010, 20, false);
+  workers[1]->phase = SKY_PHASE_WRITE;
+  record_span(workers[1], 1000015, 30, true);
+
+  if (!write_trace(share->trace_path, workers))
+    return false;
+
+  if ((file = fopen(TRACE_TEST_FILE, "r")) == NULL)
+    return false;
+
+  length = fread(buffer, 1, sizeof(buffer) - 1, file);
+  buffer[length] = '\0';
+  fclose(file);
+  unlink(TRACE_TEST_FILE);
+
+  if (strstr(buffer, "\"traceEvents\": [") == NULL ||
+      strstr(buffer, "\"args\": {\"name\": \"worker 2\"}") == NULL ||
+      strstr(buffer, "{\"name\": \"insert\", \"ph\": \"X\", \"ts\": 10, "
+             "\"dur\": 20, \"pid\": 1, \"tid\": 1}") == NULL ||
+      strstr(buffer, "{\"name\": \"control\", \"ph\": \"X\", \"ts\": 15, "
+             "\"dur\": 30, \"pid\": 1, \"tid\": 2}") == NULL ||
+      strcmp(buffer + length - 4, "\n]}\n") != 0)
+    return false;
+
+  destroy_workers(workers);
+  sky_share_free(share);
+  return true;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include <math.h>
+#include "think.h"
+
+SKY_TIMER_WHEEL *sky_timer_wheel_new(void) {
+  SKY_TIMER_WHEEL *wheel;
+
+  if ((wheel = calloc(1, sizeof(*wheel))) == NULL)
+    return NULL;
+
+  pthread_mutex_init(&wheel->lock, NULL);
+  pthread_cond_init(&wheel->added, NULL);
+  return wheel;
+}
+
+void sky_timer_wheel_free(SKY_TIMER_WHEEL *wheel) {
+  if (wheel == NULL)
+    return;
+
+  if (wheel->running)
+    timer_wheel_stop(wheel);
+
+  pthread_mutex_destroy(&wheel->lock);
+  pthread_cond_destroy(&wheel->added);
+  free(wheel);
+}
+
+/* Tick that a timer expires with. Rounded up so that a timer never
+   fires before it's due */
+static uint64_t due_tick(const SKY_TIMER *timer) {
+  return (timer->due + WHEEL_TICK - 1) / WHEEL_TICK;
+}
+
+void timer_wheel_add(SKY_TIMER_WHEEL *wheel, SKY_TIMER *timer) {
+  assert(wheel && timer);
+
+  uint64_t tick = due_tick(timer);
+
+  /* an overdue timer expires with the next tick */
+  if (tick < wheel->tick)
+    tick = wheel->tick;
+
+  timer->fired = false;
+  timer->next = wheel->slots[tick % WHEEL_SLOTS];
+  wheel->slots[tick % WHEEL_SLOTS] = timer;
+  wheel->pending++;
+}
+
+uint32_t timer_wheel_expire(SKY_TIMER_WHEEL *wheel, uint64_t now) {
+  assert(wheel);
+
+  uint64_t now_tick = now / WHEEL_TICK;
+  uint32_t fired = 0;
+
+  for (; wheel->tick <= now_tick && wheel->pending > 0; wheel->tick++) {
+    SKY_TIMER **link = &wheel->slots[wheel->tick % WHEEL_SLOTS];
+
+    while (*link != NULL) {
+      SKY_TIMER *timer = *link;
+
+      /* due in a later revolution of the wheel */
+      if (due_tick(timer) > wheel->tick) {
+        link = &timer->next;
+        continue;
+      }
+
+      *link = timer->next;
+      timer->fired = true;
+      pthread_cond_signal(&timer->wakeup);
+      wheel->pending--;
+      fired++;
+    }
+  }
+
+  /* an empty wheel starts over from the present */
+  if (wheel->pending == 0 && wheel->tick <= now_tick)
+    wheel->tick = now_tick + 1;
+
+  return fired;
+}
+
+static void *wheel_workload(void *arg) {
+  SKY_TIMER_WHEEL *wheel = (SKY_TIMER_WHEEL *)arg;
+
+  pthread_mutex_lock(&wheel->lock);
+
+  while (!wheel->stop) {
+    if (wheel->pending == 0) {
+      pthread_cond_wait(&wheel->added, &wheel->lock);
+      continue;
+    }
+
+    timer_wheel_expire(wheel, current_usec());
+
+    /* sleep until the next tick unless a timer is added meanwhile */
+    if (wheel->pending > 0) {
+      uint64_t next = wheel->tick * WHEEL_TICK;
+      struct timespec deadline;
+
+      deadline.tv_sec = next / 1000000;
+      deadline.tv_nsec = (next % 1000000) * 1000;
+      pthread_cond_timedwait(&wheel->added, &wheel->lock, &deadline);
+    }
+  }
+
+  /* nobody is left waiting once the wheel stops */
+  for (int i = 0; i < WHEEL_SLOTS; i++) {
+    while (wheel->slots[i] != NULL) {
+      SKY_TIMER *timer = wheel->slots[i];
+
+      wheel->slots[i] = timer->next;
+      timer->fired = true;
+      pthread_cond_signal(&timer->wakeup);
+    }
+  }
+  wheel->pending = 0;
+  pthread_mutex_unlock(&wheel->lock);
+  return NULL;
+}
+
+bool timer_wheel_start(SKY_TIMER_WHEEL *wheel) {
+  assert(wheel);
+
+  wheel->tick = current_usec() / WHEEL_TICK;
+
+  if (pthread_create(&wheel->thread_id, NULL, wheel_workload,
+                     (void *)wheel)) {
+    report_error("failed to create timer thread");
+    return false;
+  }
+
+  wheel->running = true;
+  return true;
+}
+
+void timer_wheel_stop(SKY_TIMER_WHEEL *wheel) {
+  assert(wheel);
+
+  if (!wheel->running)
+    return;
+
+  pthread_mutex_lock(&wheel->lock);
+  wheel->stop = true;
+  pthread_cond_signal(&wheel->added);
+  pthread_mutex_unlock(&wheel->lock);
+
+  pthread_join(wheel->thread_id, NULL);
+  wheel->running = false;
+}
+
+void timer_wheel_wait(SKY_TIMER_WHEEL *wheel, uint64_t due) {
+  assert(wheel);
+
+  uint64_t now = current_usec();
+  SKY_TIMER timer;
+
+  if (due <= now)
+    return;
+
+  timer.due = due;
+  pthread_cond_init(&timer.wakeup, NULL);
+  pthread_mutex_lock(&wheel->lock);
+
+  if (!wheel->stop) {
+    /* the wheel may have stood still while it was empty */
+    if (wheel->pending == 0)
+      wheel->tick = now / WHEEL_TICK;
+
+    timer_wheel_add(wheel, &timer);
+
+    if (wheel->pending == 1)
+      pthread_cond_signal(&wheel->added);
+
+    while (!timer.fired)
+      pthread_cond_wait(&timer.wakeup, &wheel->lock);
+  }
+
+  pthread_mutex_unlock(&wheel->lock);
+  pthread_cond_destroy(&timer.wakeup);
+}
+
+const char *think_model_name(sky_think_model model) {
+  static const char *names[] = {"none", "fixed", "uniform", "exponential"};
+  return names[model];
+}
+
+uint64_t next_think_time(SKY_SHARE *share) {
+  assert(share);
+
+  double u;
+
+  switch (share->think_model) {
+  case SKY_THINK_FIXED:
+    return share->think_min;
+  case SKY_THINK_UNIFORM:
+    return share->think_min +
+           random() % (share->think_max - share->think_min + 1);
+  case SKY_THINK_EXPONENTIAL:
+    /* inverse transform of a uniform draw in [0, 1) */
+    u = (double)random() / ((double)RAND_MAX + 1);
+    return (uint64_t)(-log(1 - u) * share->think_min);
+  default:
+    return 0;
+  }
+}
+
+void session_pause(SKY_WORKER *worker) {
+  assert(worker);
+
+  SKY_SHARE *share = worker->share;
+  uint64_t now = current_usec();
+  uint64_t due = now + next_think_time(share);
+
+  /* --pace spaces out the starts of the operations */
+  if (share->pace > 0 && worker->op_start > 0) {
+    uint64_t paced = worker->op_start + 60000000 / share->pace;
+
+    if (paced > due)
+      due = paced;
+  }
+
+  if (share->timer_wheel)
+    timer_wheel_wait(share->timer_wheel, due);
+
+  worker->op_start = current_usec();
+  worker->think_wait += worker->op_start - now;
+  worker->session_ops++;
+}
+
+void print_session_result(SKY_WORKER **workers) {
+  SKY_SHARE *share = workers[0]->share;
+  uint64_t ops = 0, wait = 0, elapsed = 0;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    ops += workers[i]->session_ops;
+    wait += workers[i]->think_wait;
+    elapsed += workers[i]->insert_elapsed + workers[i]->file_elapsed;
+  }
+
+  printf("\n");
+  printf("[ SESSION MODEL RESULT ]\n");
+  printf("  %-23s: %u\n", "Sessions", share->concurrency);
+
+  switch (share->think_model) {
+  case SKY_THINK_FIXED:
+    printf("  %-23s: fixed %.1lf ms\n", "Think Time",
+           (double)share->think_min / 1000);
+    break;
+  case SKY_THINK_UNIFORM:
+    printf("  %-23s: uniform %.1lf-%.1lf ms\n", "Think Time",
+           (double)share->think_min / 1000, (double)share->think_max / 1000);
+    break;
+  case SKY_THINK_EXPONENTIAL:
+    printf("  %-23s: exponential, mean %.1lf ms\n", "Think Time",
+           (double)share->think_min / 1000);
+    break;
+  default:
+    break;
+  }
+
+  if (share->pace > 0)
+    printf("  %-23s: %u ops/min per session\n", "Target Pace", share->pace);
+
+  /* the rate of every session averaged over the sessions */
+  printf("  %-23s: %.1lf ops/min per session\n", "Achieved Pace",
+         (elapsed) ? (double)ops * 60000000 / elapsed : 0);
+  printf("  %-23s: %.3lf ms\n", "Average Pause",
+         (ops) ? (double)wait / ops / 1000 : 0);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_THINK_H__
+#define __SKYLOAD_THINK_H__
+
+#include "skyload.h"
+
+#define WHEEL_SLOTS 512  /* slots of the timer wheel */
+#define WHEEL_TICK  1000 /* usec covered by a slot */
+
+/* A worker waiting for its next operation to be due */
+typedef struct _sky_timer {
+  struct _sky_timer *next;
+  uint64_t due;          /* usec timestamp */
+  bool fired;
+  pthread_cond_t wakeup;
+} SKY_TIMER;
+
+/* Hashed timer wheel that wakes up the workers when their next
+   operation is due. A single thread advances the wheel a tick at a
+   time and only while timers are pending, so that N sessions cost
+   one timer rather than N sleeping threads racing for the clock.
+   Timers due more than a revolution ahead stay in their slot until
+   the revolution they are due in. */
+typedef struct _sky_timer_wheel {
+  SKY_TIMER *slots[WHEEL_SLOTS];
+  uint64_t tick;         /* next tick to expire */
+  uint32_t pending;      /* timers in the wheel */
+  pthread_mutex_t lock;
+  pthread_cond_t added;  /* signaled when the wheel stops being empty */
+  pthread_t thread_id;
+  bool running;
+  bool stop;
+} SKY_TIMER_WHEEL;
+
+/* allocator and deallocator of the timer wheel */
+SKY_TIMER_WHEEL *sky_timer_wheel_new(void);
+void sky_timer_wheel_free(SKY_TIMER_WHEEL *wheel);
+
+/* starts and stops the thread that advances the wheel */
+bool timer_wheel_start(SKY_TIMER_WHEEL *wheel);
+void timer_wheel_stop(SKY_TIMER_WHEEL *wheel);
+
+/* puts a timer in the slot of its due time. the caller holds the
+   lock of the wheel */
+void timer_wheel_add(SKY_TIMER_WHEEL *wheel, SKY_TIMER *timer);
+
+/* advances the wheel up to 'now' and fires the timers that are due.
+   the caller holds the lock of the wheel. returns the number of
+   timers fired */
+uint32_t timer_wheel_expire(SKY_TIMER_WHEEL *wheel, uint64_t now);
+
+/* blocks the calling thread until the given usec timestamp */
+void timer_wheel_wait(SKY_TIMER_WHEEL *wheel, uint64_t due);
+
+/* name of a think time model, as used in the reports */
+const char *think_model_name(sky_think_model model);
+
+/* draws the next think time in usecs from the model of --think-time */
+uint64_t next_think_time(SKY_SHARE *share);
+
+/* prints the think time and pacing model next to the rate of
+   operations the sessions actually achieved */
+void print_session_result(SKY_WORKER **workers);
+
+/* called by a worker between two operations of its session. waits
+   until both the think time since the end of the last operation and
+   the --pace interval since its start have passed */
+void session_pause(SKY_WORKER *worker);
+
+#endif
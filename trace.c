@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#include "trace.h"
+
+void record_span(SKY_WORKER *worker, uint64_t start_time, uint64_t latency,
+                 bool control) {
+  SKY_SHARE *share = worker->share;
+  SKY_SPAN *span;
+
+  if (share->trace_path == NULL || share->start_time == 0 ||
+      start_time < share->start_time)
+    return;
+
+  /* a fixed stride samples without drawing random numbers */
+  if (worker->trace_seen++ % share->trace_sample != 0)
+    return;
+
+  if (worker->spans_size == TRACE_MAX_SPANS) {
+    worker->spans_dropped++;
+    return;
+  }
+
+  if (worker->spans_size == worker->spans_capacity) {
+    uint32_t capacity = (worker->spans_capacity) ?
+                        worker->spans_capacity * 2 : TRACE_INITIAL_CAPACITY;
+    SKY_SPAN *spans;
+
+    if (capacity > TRACE_MAX_SPANS)
+      capacity = TRACE_MAX_SPANS;
+
+    if ((spans = realloc(worker->spans, sizeof(*spans) * capacity)) == NULL) {
+      worker->spans_dropped++;
+      return;
+    }
+
+    worker->spans = spans;
+    worker->spans_capacity = capacity;
+  }
+
+  span = &worker->spans[worker->spans_size++];
+  span->start = start_time - share->start_time;
+  span->duration = (latency > UINT32_MAX) ? UINT32_MAX : latency;
+  span->op = (control || worker->phase >= SKY_NPHASES) ? TRACE_CONTROL :
+             worker->phase;
+}
+
+static const char *span_name(uint16_t op) {
+  return (op == TRACE_CONTROL) ? "control" : phase_name(op);
+}
+
+bool write_trace(const char *path, SKY_WORKER **workers) {
+  assert(path && workers);
+
+  SKY_SHARE *share = workers[0]->share;
+  uint64_t spans = 0, dropped = 0;
+  FILE *file;
+
+  if ((file = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "failed to open (%s) for writing\n", path);
+    return false;
+  }
+
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  /* every worker is a thread of its own on the timeline */
+  for (int i = 0; i < share->concurrency; i++) {
+    SKY_WORKER *worker = workers[i];
+
+    fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+            "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"worker %d\"}}",
+            (i > 0) ? "," : "", worker->unique_id, worker->unique_id);
+
+    for (uint32_t j = 0; j < worker->spans_size; j++) {
+      const SKY_SPAN *span = &worker->spans[j];
+
+      fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %llu, "
+              "\"dur\": %u, \"pid\": 1, \"tid\": %d}", span_name(span->op),
+              (unsigned long long)span->start, span->duration,
+              worker->unique_id);
+    }
+
+    spans += worker->spans_size;
+    dropped += worker->spans_dropped;
+  }
+
+  fprintf(file, "\n]}\n");
+
+  if (fclose(file) != 0) {
+    fprintf(stderr, "failed to write (%s)\n", path);
+    return false;
+  }
+
+  if (dropped > 0) {
+    fprintf(stderr, "warning: %llu spans were left out of the trace, "
+            "raise --trace-sample to keep it within bounds\n",
+            (unsigned long long)dropped);
+  }
+
+  printf("\n");
+  printf("Trace of %llu statements written to %s\n",
+         (unsigned long long)spans, path);
+  return true;
+}
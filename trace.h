@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2009 Toru Maesaka <dev@torum.net>
+ * All Rights Reserved.
+ *
+ * Use and distribution of this program is licensed under the
+ * BSD license. See the COPYING file for full text.
+ */
+
+#ifndef __SKYLOAD_TRACE_H__
+#define __SKYLOAD_TRACE_H__
+
+#include "skyload.h"
+
+#define TRACE_INITIAL_CAPACITY 4096
+#define TRACE_MAX_SPANS        1000000 /* spans a worker keeps at most */
+#define TRACE_CONTROL          SKY_NPHASES /* op of BEGIN, COMMIT, etc */
+
+/* A statement as it shows up on the timeline */
+typedef struct _sky_span {
+  uint64_t start;      /* usec since the load started */
+  uint32_t duration;   /* usec */
+  uint16_t op;         /* phase it ran in or TRACE_CONTROL */
+} SKY_SPAN;
+
+/* appends a span to the buffer of the worker if it's one of the
+   1 in share->trace_sample statements traced. the worker is the only
+   one writing to its buffer, so no lock is taken. spans past
+   TRACE_MAX_SPANS are counted but not kept */
+void record_span(SKY_WORKER *worker, uint64_t start_time, uint64_t latency,
+                 bool control);
+
+/* writes the spans of every worker to the given path in the Chrome
+   trace event format, with a thread per worker. returns false if
+   the file could not be written */
+bool write_trace(const char *path, SKY_WORKER **workers);
+
+#endif
@@ -7,6 +7,8 @@
  */
 
 #include "skyload.h"
+#include "replay.h"
+#include "slowest.h"
 
 SKY_WORKER *sky_worker_new(void) {
   SKY_WORKER *worker = malloc(sizeof(*worker));
@@ -16,15 +18,100 @@ SKY_WORKER *sky_worker_new(void) {
   }
   worker->aborted = false;
   worker->share = NULL;
+  worker->table = NULL;
+  worker->read_connection = NULL;
+  worker->replica_connection = NULL;
+  worker->shard_connections = NULL;
+  worker->target_index = 0;
+  worker->read_target_index = 0;
+  worker->row_key = 0;
+  memset(worker->target_queries, 0, sizeof(worker->target_queries));
+  memset(worker->target_time, 0, sizeof(worker->target_time));
   worker->unique_id = 0;
   worker->total_insert_time = 0;
+  memset(worker->table_insert_time, 0, sizeof(worker->table_insert_time));
   worker->file_benchmark_time = 0;
+  worker->insert_commit_time = 0;
+  worker->insert_commits = 0;
+  worker->insert_elapsed = 0;
+  worker->file_commit_time = 0;
+  worker->file_commits = 0;
+  worker->file_elapsed = 0;
+  worker->replay_time = 0;
+  worker->replay_queries = 0;
+  worker->replay_lag_total = 0;
+  worker->replay_lag_max = 0;
+  worker->replay_late = 0;
+  worker->replay_end_time = 0;
+  worker->measure_start = 0;
+  worker->measure_end = 0;
+  worker->sweep_queries = 0;
+  worker->sweep_interval = 0;
+  worker->sweep_next = 0;
+  sky_histogram_reset(&worker->latency);
+  worker->failed_queries = 0;
+  worker->retries = 0;
+  worker->reconnects = 0;
+  memset(&worker->timeline, 0, sizeof(worker->timeline));
+  sky_histogram_reset(&worker->insert_latency);
+  sky_histogram_reset(&worker->read_latency);
+  sky_histogram_reset(&worker->replay_latency);
+  worker->query_latency = NULL;
+  worker->phase = 0;
+  worker->pipeline = NULL;
+  worker->op_start = 0;
+  worker->think_wait = 0;
+  worker->session_ops = 0;
+  worker->read_order = NULL;
+  sky_arena_init(&worker->arena);
+  worker->rows_inserted = 0;
+  worker->insert_bytes = 0;
+  worker->affected_rows = 0;
+  worker->write_elapsed = 0;
+  sky_histogram_reset(&worker->write_latency);
+  for (int i = 0; i < SKY_NWRITES; i++)
+    sky_histogram_reset(&worker->write_kind_latency[i]);
+  memset(worker->write_rows, 0, sizeof(worker->write_rows));
+  worker->file_runs = 0;
+  worker->run_log = NULL;
+  worker->run_log_size = 0;
+  worker->run_log_capacity = 0;
+  worker->soak_latency = NULL;
+  worker->slowest = NULL;
+  worker->slowest_size = 0;
+  worker->spans = NULL;
+  worker->spans_size = 0;
+  worker->spans_capacity = 0;
+  worker->trace_seen = 0;
+  worker->spans_dropped = 0;
+  pthread_mutex_init(&worker->soak_lock, NULL);
+  worker->in_flight = 0;
+  worker->seq_stride = 0;
+  worker->scenario_phase = NULL;
+  worker->scenario_ops = 0;
+  memset(&worker->rusage, 0, sizeof(worker->rusage));
+  memset(&worker->rusage_start, 0, sizeof(worker->rusage_start));
+  worker->txn_log = NULL;
+  worker->txn_count = 0;
+  worker->txn_capacity = 0;
+  worker->txn_open = false;
   return worker;
 }
 
 void sky_worker_free(SKY_WORKER *worker) {
-  if (worker != NULL)
+  if (worker != NULL) {
+    sky_timeline_free(&worker->timeline);
+    free(worker->query_latency);
+    free(worker->read_order);
+    sky_arena_free(&worker->arena);
+    free(worker->soak_latency);
+    free(worker->run_log);
+    free(worker->slowest);
+    free(worker->spans);
+    free(worker->txn_log);
+    pthread_mutex_destroy(&worker->soak_lock);
     free(worker);
+  }
 }
 
 SKY_SHARE *sky_share_new(void) {
@@ -35,20 +122,84 @@ SKY_SHARE *sky_share_new(void) {
   }
 
   share->server = NULL;
+  share->server_list = NULL;
+  share->replica_list = NULL;
+  memset(share->targets, 0, sizeof(share->targets));
+  share->ntargets = 0;
+  share->nprimaries = 0;
+  share->route = SKY_ROUTE_WORKER;
   share->database_name = NULL;
   share->load_queries = NULL;
   share->read_queries = NULL;
-  share->create_query = NULL;
-  share->insert_tmpl = NULL;
+  share->replay = NULL;
+  memset(share->tables, 0, sizeof(share->tables));
+  share->ntables = 0;
   share->load_file_path = NULL;
   share->read_file_path = NULL;
+  share->replay_file_path = NULL;
   share->keep_db = false;
   share->port = 0;
-  share->nwrite = 0;
   share->runs = 1;
+  share->run_warmup = 0;
   share->concurrency = 1;
+  share->txn_size = 0;
   share->protocol = 0;
   share->file_load_time = 0;
+  share->speed = 1.0;
+  share->sweep_levels = NULL;
+  share->nsweep = 0;
+  share->sweep_time = SKY_SWEEP_TIME;
+  share->warmup_time = SKY_SWEEP_WARMUP;
+  share->max_retries = SKY_MAX_RETRIES;
+  share->retry_backoff = SKY_RETRY_BACKOFF;
+  share->report_interval = SKY_REPORT_INTERVAL;
+  share->start_time = 0;
+  share->sweep_results = NULL;
+  share->search = SKY_SEARCH_NONE;
+  share->slo_percentile = SKY_SLO_PERCENTILE;
+  share->slo_latency = 0;
+  share->search_results = NULL;
+  share->nsearch = 0;
+  share->search_point = -1;
+  memset(&share->client_start, 0, sizeof(share->client_start));
+  share->fingerprints = NULL;
+  share->nfingerprints = 0;
+  share->json_path = NULL;
+  share->compare_path = NULL;
+  share->tolerance = SKY_TOLERANCE;
+  share->noise_floor = SKY_NOISE_FLOOR;
+  share->noise_z = SKY_NOISE_Z;
+  share->status = false;
+  share->engine_status = false;
+  share->status_vars = NULL;
+  share->status_sampler = NULL;
+  memset(share->phase_finished, 0, sizeof(share->phase_finished));
+  share->pipeline_depth = 1;
+  share->think_model = SKY_THINK_NONE;
+  share->think_min = 0;
+  share->think_max = 0;
+  share->pace = 0;
+  share->read_order = SKY_ORDER_SEQUENTIAL;
+  share->key_order = SKY_KEYS_INTERLEAVED;
+  share->writes = 0;
+  share->key_dist = SKY_DIST_UNIFORM;
+  share->zipf_theta = SKY_ZIPF_THETA;
+  share->slowest = 0;
+  share->trace_path = NULL;
+  share->trace_sample = 1;
+  share->timer_wheel = NULL;
+  share->soak = false;
+  share->soak_path = NULL;
+  share->soak_rotate = (uint64_t)SKY_SOAK_ROTATE * 1024 * 1024;
+  share->soak_sampler = NULL;
+  share->metrics_addr = NULL;
+  share->metrics = NULL;
+  share->scenario_path = NULL;
+  share->scenario = NULL;
+  share->payload_path = NULL;
+  share->payload_min = SKY_PAYLOAD_SIZE;
+  share->payload_max = SKY_PAYLOAD_SIZE;
+  share->payload = NULL;
 
   return share;
 }
@@ -59,14 +210,28 @@ void sky_share_free(SKY_SHARE *share) {
   if (share->server != NULL)
     free(share->server);
 
+  if (share->server_list != NULL)
+    free(share->server_list);
+
+  if (share->replica_list != NULL)
+    free(share->replica_list);
+
+  for (int i = 0; i < share->ntargets; i++)
+    free(share->targets[i].host);
+
   if (share->database_name != NULL)
     free(share->database_name);
 
-  if (share->create_query != NULL)
-    free(share->create_query);
+  for (int i = 0; i < share->ntables; i++) {
+    if (share->tables[i].create_query != NULL)
+      free(share->tables[i].create_query);
+
+    if (share->tables[i].insert_tmpl != NULL)
+      free(share->tables[i].insert_tmpl);
 
-  if (share->insert_tmpl != NULL)
-    free(share->insert_tmpl);
+    for (int j = 0; j < SKY_NWRITES; j++)
+      free(share->tables[i].write_tmpl[j]);
+  }
 
   if (share->load_file_path != NULL)
     free(share->load_file_path);
@@ -74,6 +239,46 @@ void sky_share_free(SKY_SHARE *share) {
   if (share->read_file_path != NULL)
     free(share->read_file_path);
 
+  if (share->replay_file_path != NULL)
+    free(share->replay_file_path);
+
+  if (share->sweep_levels != NULL)
+    free(share->sweep_levels);
+
+  if (share->sweep_results != NULL)
+    free(share->sweep_results);
+  if (share->search_results != NULL)
+    free(share->search_results);
+
+  for (uint32_t i = 0; i < share->nfingerprints; i++)
+    free(share->fingerprints[i]);
+
+  if (share->fingerprints != NULL)
+    free(share->fingerprints);
+
+  if (share->json_path != NULL)
+    free(share->json_path);
+  if (share->trace_path != NULL)
+    free(share->trace_path);
+
+  if (share->compare_path != NULL)
+    free(share->compare_path);
+
+  if (share->status_vars != NULL)
+    free(share->status_vars);
+
+  if (share->soak_path != NULL)
+    free(share->soak_path);
+
+  if (share->metrics_addr != NULL)
+    free(share->metrics_addr);
+
+  if (share->scenario_path != NULL)
+    free(share->scenario_path);
+
+  if (share->payload_path != NULL)
+    free(share->payload_path);
+
   free(share);
 }
 
@@ -86,6 +291,8 @@ SKY_LIST *sky_list_new(void) {
   list->head = NULL;
   list->tail = NULL;
   list->size = 0;
+  list->nodes = NULL;
+  list->cumulative = NULL;
   return list;
 }
 
@@ -101,6 +308,8 @@ void sky_list_free(SKY_LIST *list) {
     current = current->next;
     sky_node_free(temp);
   }
+  free(list->nodes);
+  free(list->cumulative);
   free(list);
 }
 
@@ -113,6 +322,8 @@ SKY_LIST_NODE *sky_node_new(void) {
   node->next = NULL;
   node->data = NULL;
   node->length = 0;
+  node->fingerprint = 0;
+  node->weight = 1;
   return node;
 }
 
@@ -130,13 +341,15 @@ bool sky_list_push(SKY_LIST *list, const char *value, const size_t length) {
   if ((node = sky_node_new()) == NULL)
     return false;
 
-  if ((node->data = strdup(value)) == NULL) {
+  /* the value may be part of a larger string */
+  if ((node->data = malloc(length + 1)) == NULL) {
     sky_node_free(node);
     return false;
   }
 
   node->length = length;
-  strncpy(node->data, value, length);
+  memcpy(node->data, value, length);
+  node->data[length] = '\0';
   list->size++;
 
   if (list->head == NULL) {
@@ -150,6 +363,122 @@ bool sky_list_push(SKY_LIST *list, const char *value, const size_t length) {
   return true;
 }
 
+bool sky_list_index(SKY_LIST *list) {
+  assert(list);
+
+  SKY_LIST_NODE *current = list->head;
+  uint64_t total = 0;
+
+  free(list->nodes);
+  free(list->cumulative);
+  list->nodes = NULL;
+  list->cumulative = NULL;
+
+  if (list->size == 0)
+    return true;
+
+  list->nodes = malloc(sizeof(SKY_LIST_NODE *) * list->size);
+  list->cumulative = malloc(sizeof(uint64_t) * list->size);
+
+  if (list->nodes == NULL || list->cumulative == NULL)
+    return false;
+
+  for (size_t i = 0; i < list->size; i++, current = current->next) {
+    total += current->weight;
+    list->nodes[i] = current;
+    list->cumulative[i] = total;
+  }
+  return true;
+}
+
+void sky_arena_init(SKY_ARENA *arena) {
+  assert(arena);
+  arena->head = NULL;
+  arena->current = NULL;
+  arena->chunks = 0;
+}
+
+void sky_arena_free(SKY_ARENA *arena) {
+  assert(arena);
+
+  SKY_ARENA_CHUNK *chunk = arena->head;
+
+  while (chunk != NULL) {
+    SKY_ARENA_CHUNK *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  sky_arena_init(arena);
+}
+
+void *arena_alloc(SKY_ARENA *arena, size_t size) {
+  assert(arena);
+
+  SKY_ARENA_CHUNK *chunk = arena->current;
+
+  size = (size + SKY_ARENA_ALIGN - 1) & ~(size_t)(SKY_ARENA_ALIGN - 1);
+
+  if (chunk && chunk->size - chunk->used >= size) {
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+  }
+
+  /* move on to the next chunk kept from before the last reset */
+  if (chunk && chunk->next && chunk->next->size >= size) {
+    chunk = chunk->next;
+  } else {
+    size_t chunk_size = (size > SKY_ARENA_SIZE) ? size : SKY_ARENA_SIZE;
+    SKY_ARENA_CHUNK *fresh = malloc(sizeof(*fresh) + chunk_size);
+
+    if (fresh == NULL)
+      return NULL;
+
+    fresh->size = chunk_size;
+    arena->chunks++;
+
+    /* the new chunk goes right after the current one */
+    if (chunk) {
+      fresh->next = chunk->next;
+      chunk->next = fresh;
+    } else {
+      fresh->next = arena->head;
+      arena->head = fresh;
+    }
+    chunk = fresh;
+  }
+
+  chunk->used = size;
+  arena->current = chunk;
+  return chunk->data;
+}
+
+void arena_reset(SKY_ARENA *arena) {
+  assert(arena);
+
+  arena->current = arena->head;
+  if (arena->head)
+    arena->head->used = 0;
+}
+
+SKY_ARENA_MARK arena_mark(SKY_ARENA *arena) {
+  SKY_ARENA_MARK mark;
+
+  mark.chunk = arena->current;
+  mark.used = (arena->current) ? arena->current->used : 0;
+  return mark;
+}
+
+void arena_rewind(SKY_ARENA *arena, SKY_ARENA_MARK mark) {
+  if (mark.chunk == NULL) {
+    arena_reset(arena);
+    return;
+  }
+
+  arena->current = mark.chunk;
+  mark.chunk->used = mark.used;
+}
+
 bool sky_create_connection(SKY_SHARE *share, drizzle_st *handle,
                            drizzle_con_st *conn) {
   assert(share && handle);
@@ -165,12 +494,226 @@ bool sky_create_connection(SKY_SHARE *share, drizzle_st *handle,
   return true;
 }
 
+bool sky_connect_target(SKY_SHARE *share, SKY_TARGET *target,
+                        drizzle_st *handle, drizzle_con_st *conn) {
+  assert(share && target && handle);
+
+  if (target->host == NULL || target->port == 0)
+    return false;
+
+  if (drizzle_con_create(handle, conn) == NULL)
+    return false;
+
+  drizzle_con_set_tcp(conn, target->host, target->port);
+  drizzle_con_add_options(conn, share->protocol);
+  return true;
+}
+
 void sky_close_connection(drizzle_con_st *conn) {
   assert(conn);
   drizzle_con_close(conn);
   drizzle_con_free(conn);
 }
 
+/* Appends the 'host[:port]' entries of a comma separated list */
+static bool add_targets(SKY_SHARE *share, const char *list, bool replica) {
+  const char *pos = list;
+
+  while (*pos != '\0') {
+    const char *end = strchr(pos, ',');
+    size_t length = (end) ? (size_t)(end - pos) : strlen(pos);
+    SKY_TARGET *target;
+    char *colon;
+
+    if (length == 0) {
+      report_error("empty server name in the server list");
+      return false;
+    }
+
+    if (share->ntargets == SKY_MAX_TARGETS) {
+      report_error("too many servers");
+      return false;
+    }
+
+    target = &share->targets[share->ntargets];
+
+    if ((target->host = strndup(pos, length)) == NULL) {
+      report_error("out of memory");
+      return false;
+    }
+    share->ntargets++;
+
+    target->port = share->port;
+    target->replica = replica;
+
+    if ((colon = strchr(target->host, ':')) != NULL) {
+      *colon = '\0';
+      target->port = (in_port_t)atoi(colon + 1);
+    }
+
+    if (target->port == 0) {
+      report_error("invalid port in the server list");
+      return false;
+    }
+
+    pos += length;
+    if (*pos == ',')
+      pos++;
+  }
+  return true;
+}
+
+bool resolve_targets(SKY_SHARE *share) {
+  assert(share && share->server);
+
+  /* the original option value is kept as the list of primaries */
+  share->server_list = share->server;
+  share->server = NULL;
+
+  if (!add_targets(share, share->server_list, false))
+    return false;
+
+  share->nprimaries = share->ntargets;
+
+  if (share->replica_list && !add_targets(share, share->replica_list, true))
+    return false;
+
+  if (share->nprimaries == 0) {
+    report_error("hostname is missing");
+    return false;
+  }
+
+  /* the first primary is used for administrative connections */
+  if ((share->server = strdup(share->targets[0].host)) == NULL) {
+    report_error("out of memory");
+    return false;
+  }
+  share->port = share->targets[0].port;
+  return true;
+}
+
+void assign_targets(SKY_WORKER *worker) {
+  assert(worker && worker->share);
+
+  SKY_SHARE *share = worker->share;
+  uint16_t nreplicas = share->ntargets - share->nprimaries;
+  uint32_t index = worker->unique_id - 1;
+
+  /* spread the workers over the primaries and the read load over
+     the replicas, if there are any */
+  if (share->nprimaries > 0)
+    worker->target_index = index % share->nprimaries;
+
+  if (nreplicas > 0)
+    worker->read_target_index = share->nprimaries + index % nreplicas;
+  else
+    worker->read_target_index = worker->target_index;
+}
+
+/* Connects and switches to the test database on a single target */
+static bool connect_worker_target(SKY_WORKER *worker, uint16_t index,
+                                  drizzle_con_st *conn) {
+  SKY_SHARE *share = worker->share;
+
+  if (!sky_connect_target(share, &share->targets[index],
+                          &worker->database_handle, conn)) {
+    report_error("failed to initialize connection");
+    return false;
+  }
+
+  if (!switch_database(share, conn)) {
+    report_error(drizzle_con_error(conn));
+    sky_close_connection(conn);
+    return false;
+  }
+
+  /* --pipeline sends several statements in a single packet */
+  if (share->pipeline_depth > 1 && !enable_multi_statements(conn)) {
+    report_error(drizzle_con_error(conn));
+    sky_close_connection(conn);
+    return false;
+  }
+  return true;
+}
+
+bool sky_worker_connect(SKY_WORKER *worker) {
+  assert(worker && worker->share);
+
+  SKY_SHARE *share = worker->share;
+
+  if (!connect_worker_target(worker, worker->target_index,
+                             &worker->connection))
+    return false;
+
+  worker->read_connection = &worker->connection;
+
+  /* the read load goes to a replica of its own */
+  if (worker->read_target_index != worker->target_index) {
+    worker->replica_connection = malloc(sizeof(drizzle_con_st));
+
+    if (worker->replica_connection == NULL ||
+        !connect_worker_target(worker, worker->read_target_index,
+                               worker->replica_connection)) {
+      free(worker->replica_connection);
+      worker->replica_connection = NULL;
+      sky_close_connection(&worker->connection);
+      return false;
+    }
+    worker->read_connection = worker->replica_connection;
+  }
+
+  /* rows routed by key may go to any of the primaries */
+  if (share->route == SKY_ROUTE_KEY && share->nprimaries > 1) {
+    worker->shard_connections = malloc(sizeof(drizzle_con_st) *
+                                       share->nprimaries);
+
+    if (worker->shard_connections == NULL) {
+      report_error("out of memory");
+      sky_worker_disconnect(worker);
+      return false;
+    }
+
+    for (uint16_t i = 0; i < share->nprimaries; i++) {
+      if (!connect_worker_target(worker, i, &worker->shard_connections[i])) {
+        for (uint16_t j = 0; j < i; j++)
+          sky_close_connection(&worker->shard_connections[j]);
+        free(worker->shard_connections);
+        worker->shard_connections = NULL;
+        sky_worker_disconnect(worker);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void sky_worker_disconnect(SKY_WORKER *worker) {
+  assert(worker);
+
+  sky_close_connection(&worker->connection);
+
+  if (worker->replica_connection) {
+    sky_close_connection(worker->replica_connection);
+    free(worker->replica_connection);
+    worker->replica_connection = NULL;
+  }
+
+  if (worker->shard_connections) {
+    for (uint16_t i = 0; i < worker->share->nprimaries; i++)
+      sky_close_connection(&worker->shard_connections[i]);
+    free(worker->shard_connections);
+    worker->shard_connections = NULL;
+  }
+  worker->read_connection = NULL;
+}
+
+uint16_t route_key(SKY_SHARE *share, uint64_t key) {
+  /* multiplicative hashing so that sequential keys are spread
+     evenly rather than in runs */
+  uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+  return (uint16_t)((hash >> 32) % share->nprimaries);
+}
+
 SKY_WORKER **create_workers(SKY_SHARE *share) {
   assert(share && share->concurrency > 0);
 
@@ -189,6 +732,22 @@ SKY_WORKER **create_workers(SKY_SHARE *share) {
     drizzle_create(&workers[i]->database_handle);
     workers[i]->share = share;
     workers[i]->unique_id = i + 1;
+    assign_targets(workers[i]);
+
+    /* latency is broken down per read query fingerprint */
+    if (share->nfingerprints > 0) {
+      workers[i]->query_latency = calloc(share->nfingerprints,
+                                         sizeof(SKY_HISTOGRAM));
+      if (workers[i]->query_latency == NULL)
+        return NULL;
+    }
+
+    /* the slowest statements are tracked by every worker on its own */
+    if (share->slowest > 0) {
+      workers[i]->slowest = calloc(share->slowest, sizeof(SKY_SLOW_QUERY));
+      if (workers[i]->slowest == NULL)
+        return NULL;
+    }
 
     for (int j = 0; j < SKY_MAX_COLS; j++)
       workers[i]->current_seq_id[j] = workers[i]->unique_id;
@@ -242,17 +801,111 @@ uint64_t timediff(struct timeval from, struct timeval to) {
   return s + us;
 }
 
-uint32_t rows_to_write(SKY_WORKER *worker){
-  assert(worker);
+uint64_t current_usec(void) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+void sleep_usec(uint64_t usec) {
+  struct timespec req, rem;
+
+  req.tv_sec = usec / 1000000;
+  req.tv_nsec = (usec % 1000000) * 1000;
 
-  uint32_t count = worker->share->nwrite / worker->share->concurrency;
+  /* resume the sleep if we were interrupted by a signal */
+  while (nanosleep(&req, &rem) == -1)
+    req = rem;
+}
+
+uint64_t rows_to_write(SKY_WORKER *worker){
+  assert(worker && worker->table);
+
+  uint64_t count = worker->table->nwrite / worker->share->concurrency;
 
   if (worker->unique_id == worker->share->concurrency)
-    count += worker->share->nwrite % worker->share->concurrency;
+    count += worker->table->nwrite % worker->share->concurrency;
 
   return count;
 }
 
+/* set from the signal handler, hence not a member of the share */
+static volatile sig_atomic_t stop_signal = 0;
+
+static void handle_stop_signal(int signo) {
+  stop_signal = signo;
+}
+
+bool install_stop_handler(void) {
+  struct sigaction action;
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_stop_signal;
+  action.sa_flags = SA_RESTART | SA_RESETHAND;
+  sigemptyset(&action.sa_mask);
+
+  return (sigaction(SIGINT, &action, NULL) == 0 &&
+          sigaction(SIGTERM, &action, NULL) == 0);
+}
+
+bool stop_requested(void) {
+  return (stop_signal != 0);
+}
+
+bool has_insert_template(SKY_SHARE *share) {
+  assert(share);
+
+  for (int i = 0; i < share->ntables; i++) {
+    if (share->tables[i].insert_tmpl)
+      return true;
+  }
+  return false;
+}
+
+bool has_write_template(SKY_SHARE *share) {
+  assert(share);
+
+  for (int i = 0; i < share->ntables; i++) {
+    for (int j = 0; j < SKY_NWRITES; j++) {
+      if (share->tables[i].write_tmpl[j])
+        return true;
+    }
+  }
+  return false;
+}
+
+const char *read_order_name(sky_read_order order) {
+  static const char *names[] = {"sequential", "offset", "random",
+                                "weighted", "shuffle"};
+  return names[order];
+}
+
+const char *phase_name(sky_phase phase) {
+  static const char *names[] = {"insert", "write", "read", "replay"};
+  return (phase < SKY_NPHASES) ? names[phase] : "unknown";
+}
+
+bool phase_enabled(SKY_SHARE *share, sky_phase phase) {
+  assert(share);
+
+  switch (phase) {
+  case SKY_PHASE_INSERT:
+    return has_insert_template(share);
+  case SKY_PHASE_WRITE:
+    return (share->writes > 0 && has_write_template(share));
+  case SKY_PHASE_READ:
+    /* the concurrency sweep, the search or a scenario takes over the
+       read load */
+    return (share->read_queries && share->read_queries->size > 0 &&
+            !share->sweep_levels && share->search == SKY_SEARCH_NONE &&
+            !share->scenario_path);
+  case SKY_PHASE_REPLAY:
+    return (share->replay != NULL);
+  default:
+    return false;
+  }
+}
+
 bool switch_database(SKY_SHARE *share, drizzle_con_st *conn) {
   assert(share && conn);
 
@@ -271,9 +924,25 @@ bool switch_database(SKY_SHARE *share, drizzle_con_st *conn) {
   return true;
 }
 
-bool drop_database(SKY_SHARE *share) {
-  assert(share);
+bool enable_multi_statements(drizzle_con_st *conn) {
+  assert(conn);
 
+  /* COM_SET_OPTION takes the option as a 2 byte integer */
+  uint8_t option[2] = {SKY_MULTI_STATEMENTS_ON & 0xff,
+                       SKY_MULTI_STATEMENTS_ON >> 8};
+  drizzle_return_t ret;
+  drizzle_result_st result;
+
+  drizzle_con_command_write(conn, &result, DRIZZLE_COMMAND_SET_OPTION,
+                            option, sizeof(option), sizeof(option), &ret);
+
+  if (ret == DRIZZLE_RETURN_OK || ret == DRIZZLE_RETURN_ERROR_CODE)
+    drizzle_result_free(&result);
+
+  return (ret == DRIZZLE_RETURN_OK);
+}
+
+static bool drop_database_on(SKY_SHARE *share, SKY_TARGET *target) {
   drizzle_st drizzle;
   drizzle_con_st connection;
   drizzle_return_t ret;
@@ -281,7 +950,7 @@ bool drop_database(SKY_SHARE *share) {
 
   drizzle_create(&drizzle);
 
-  if (!sky_create_connection(share, &drizzle, &connection)) {
+  if (!sky_connect_target(share, target, &drizzle, &connection)) {
     report_error("failed to initialize connection");
     drizzle_free(&drizzle);
     return false;
@@ -301,11 +970,21 @@ bool drop_database(SKY_SHARE *share) {
   return true;
 }
 
-/* TODO: This function is redundant, refactor the codebase so that
-   the rest of the program runs through a common execution path.
-   Means it's easier to debug and maintain */
-bool preload_database(SKY_SHARE *share) {
-  assert(share && share->load_queries);
+bool drop_database(SKY_SHARE *share) {
+  assert(share);
+
+  /* replicas receive the drop through replication */
+  for (uint16_t i = 0; i < share->nprimaries; i++) {
+    if (!drop_database_on(share, &share->targets[i]))
+      return false;
+  }
+  return true;
+}
+
+/* Runs the load file against a single target and adds the time
+   it took to 'load_time' */
+static bool preload_target(SKY_SHARE *share, SKY_TARGET *target,
+                           uint64_t *load_time) {
   SKY_LIST_NODE *current = share->load_queries->head;
 
   struct timeval start_time;
@@ -317,10 +996,8 @@ bool preload_database(SKY_SHARE *share) {
 
   drizzle_create(&drizzle);
 
-  fprintf(stdout, "Loading data to database: ");
-
   /* one-time connection */
-  if (!sky_create_connection(share, &drizzle, &connection)) {
+  if (!sky_connect_target(share, target, &drizzle, &connection)) {
     report_error("failed to initialize connection");
     drizzle_free(&drizzle);
     return false;
@@ -332,8 +1009,6 @@ bool preload_database(SKY_SHARE *share) {
     return false;
   }
 
-  uint64_t load_time = 0;
-
   for (int i = 0; i < share->load_queries->size; i++) {
     gettimeofday(&start_time, NULL);
     drizzle_query_str(&connection, &result, current->data, &ret);
@@ -345,44 +1020,280 @@ bool preload_database(SKY_SHARE *share) {
       return false;
     }
     gettimeofday(&end_time, NULL);
-    load_time += timediff(end_time, start_time);
+    *load_time += timediff(end_time, start_time);
     drizzle_result_free(&result);
     current = current->next;
   }
 
+  sky_close_connection(&connection);
+  drizzle_free(&drizzle);
+  return true;
+}
+
+/* TODO: This function is redundant, refactor the codebase so that
+   the rest of the program runs through a common execution path.
+   Means it's easier to debug and maintain */
+bool preload_database(SKY_SHARE *share) {
+  assert(share && share->load_queries);
+
+  uint64_t load_time = 0;
+
+  fprintf(stdout, "Loading data to database: ");
+
+  /* every primary gets the full content of the load file */
+  for (uint16_t i = 0; i < share->nprimaries; i++) {
+    if (!preload_target(share, &share->targets[i], &load_time))
+      return false;
+  }
+
   share->file_load_time = load_time;
   share->file_load_time /= 1000000;
 
-  sky_close_connection(&connection);
-  drizzle_free(&drizzle);
   fprintf(stdout, "Done\n");
   return true;
 }
 
+/* Print the transaction statistics of either the INSERT phase or the
+   read load. Nothing is printed if no transaction was committed */
+static void print_txn_result(SKY_WORKER **workers, uint32_t txn_size,
+                             bool read_load) {
+  SKY_SHARE *share = workers[0]->share;
+  uint64_t commits = 0, commit_time = 0, elapsed = 0;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    SKY_WORKER *worker = workers[i];
+    uint64_t worker_elapsed;
+
+    commits += (read_load) ? worker->file_commits : worker->insert_commits;
+    commit_time += (read_load) ? worker->file_commit_time :
+                                 worker->insert_commit_time;
+    worker_elapsed = (read_load) ? worker->file_elapsed :
+                                   worker->insert_elapsed;
+    if (worker_elapsed > elapsed)
+      elapsed = worker_elapsed;
+  }
+
+  if (commits == 0)
+    return;
+
+  if (txn_size > 0)
+    printf("  Transaction Size       : %u\n", txn_size);
+  printf("  Transactions Committed : %llu\n", (unsigned long long)commits);
+  printf("  Transactions/sec       : %.2lf\n",
+         (elapsed) ? (double)commits * 1000000 / elapsed : 0);
+  printf("  Average COMMIT Latency : %.3lf ms\n",
+         (double)commit_time / commits / 1000);
+}
+
+/* Print the amount of data the INSERTs carried, along with the size
+   of the payloads if the rows had any */
+static void print_volume_result(SKY_WORKER **workers) {
+  SKY_SHARE *share = workers[0]->share;
+  uint64_t bytes = 0, elapsed = 0;
+  double megabytes;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    bytes += workers[i]->insert_bytes;
+    if (workers[i]->insert_elapsed > elapsed)
+      elapsed = workers[i]->insert_elapsed;
+  }
+
+  megabytes = (double)bytes / (1024 * 1024);
+
+  printf("  Data Inserted          : %.2lf MB (%.2lf MB/s)\n", megabytes,
+         (elapsed) ? megabytes * 1000000 / elapsed : 0);
+
+  if (share->payload == NULL)
+    return;
+
+  printf("  Payload Size           : %llu",
+         (unsigned long long)share->payload_min);
+  if (share->payload_max > share->payload_min)
+    printf(" - %llu", (unsigned long long)share->payload_max);
+  printf(" bytes from %s\n",
+         (share->payload_path) ? share->payload_path : "a generated pool");
+}
+
+/* Print the UPDATEs and DELETEs run over the populated rows along
+   with the rows they affected */
+static void print_write_result(SKY_WORKER **workers) {
+  static const char *kinds[] = {"UPDATE", "DELETE"};
+  SKY_SHARE *share = workers[0]->share;
+  uint64_t elapsed = 0;
+  double seconds;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    if (workers[i]->write_elapsed > elapsed)
+      elapsed = workers[i]->write_elapsed;
+  }
+  seconds = (double)elapsed / 1000000;
+
+  printf("\n");
+  printf("[ UPDATE AND DELETE RESULT ]\n");
+  printf("  Concurrent Connections : %d\n", share->concurrency);
+  printf("  Task Completion Time   : %.5lf secs\n", seconds);
+  printf("  Key Distribution       : ");
+  if (share->key_dist == SKY_DIST_ZIPFIAN)
+    printf("zipfian (theta %.2lf)\n", share->zipf_theta);
+  else
+    printf("uniform\n");
+
+  for (int k = 0; k < SKY_NWRITES; k++) {
+    SKY_HISTOGRAM latency;
+    uint64_t rows = 0;
+
+    sky_histogram_reset(&latency);
+    for (int i = 0; i < share->concurrency; i++) {
+      if (workers[i]->aborted)
+        continue;
+      sky_histogram_merge(&latency, &workers[i]->write_kind_latency[k]);
+      rows += workers[i]->write_rows[k];
+    }
+
+    if (latency.count == 0)
+      continue;
+
+    printf("  %-6s Statements      : %llu (%.2lf/sec)\n", kinds[k],
+           (unsigned long long)latency.count,
+           (seconds > 0) ? latency.count / seconds : 0);
+    printf("  %-6s Rows Affected   : %llu (%.2lf per statement)\n", kinds[k],
+           (unsigned long long)rows, (double)rows / latency.count);
+    printf("  %-6s Latency         : mean %.3lf ms, p95 %.3lf ms, "
+           "p99 %.3lf ms\n", kinds[k], sky_histogram_mean(&latency) / 1000,
+           (double)sky_histogram_percentile(&latency, 95.0) / 1000,
+           (double)sky_histogram_percentile(&latency, 99.0) / 1000);
+  }
+}
+
+/* Print the number of queries and the latency seen on each target */
+static void print_target_result(SKY_WORKER **workers) {
+  SKY_SHARE *share = workers[0]->share;
+  uint64_t all_queries = 0, all_time = 0;
+
+  printf("\n");
+  printf("[ PER TARGET RESULT ]\n");
+  printf("  %-28s %-8s %12s %11s\n", "Target", "Role", "Queries",
+         "Avg (ms)");
+
+  for (uint16_t t = 0; t < share->ntargets; t++) {
+    SKY_TARGET *target = &share->targets[t];
+    uint64_t queries = 0, time = 0;
+    char name[SKY_STRSIZ];
+
+    for (int i = 0; i < share->concurrency; i++) {
+      queries += workers[i]->target_queries[t];
+      time += workers[i]->target_time[t];
+    }
+
+    all_queries += queries;
+    all_time += time;
+
+    snprintf(name, sizeof(name), "%s:%u", target->host, target->port);
+    printf("  %-28s %-8s %12llu %11.3lf\n", name,
+           (target->replica) ? "replica" : "primary",
+           (unsigned long long)queries,
+           (queries) ? (double)time / queries / 1000 : 0);
+  }
+
+  printf("  %-28s %-8s %12llu %11.3lf\n", "All Targets", "",
+         (unsigned long long)all_queries,
+         (all_queries) ? (double)all_time / all_queries / 1000 : 0);
+}
+
+/* Print the failed and retried statements, over time if any */
+static void print_error_result(SKY_WORKER **workers) {
+  SKY_SHARE *share = workers[0]->share;
+  SKY_TIMELINE timeline = {NULL, 0, 0};
+  uint64_t failed = 0, retries = 0, reconnects = 0, queries = 0;
+  double interval = share->report_interval;
+
+  for (int i = 0; i < share->concurrency; i++) {
+    failed += workers[i]->failed_queries;
+    retries += workers[i]->retries;
+    reconnects += workers[i]->reconnects;
+
+    if (!sky_timeline_merge(&timeline, &workers[i]->timeline)) {
+      report_error("out of memory");
+      sky_timeline_free(&timeline);
+      return;
+    }
+  }
+
+  /* stay quiet on a clean run */
+  if (failed == 0 && retries == 0 && reconnects == 0) {
+    sky_timeline_free(&timeline);
+    return;
+  }
+
+  for (uint32_t i = 0; i < timeline.size; i++)
+    queries += timeline.intervals[i].queries;
+
+  printf("\n");
+  printf("[ ERROR AND RETRY RESULT ]\n");
+  printf("  Successful Statements  : %llu\n", (unsigned long long)queries);
+  printf("  Failed Statements      : %llu\n", (unsigned long long)failed);
+  printf("  Retried Attempts       : %llu\n", (unsigned long long)retries);
+  printf("  Reconnects             : %llu\n",
+         (unsigned long long)reconnects);
+  printf("  Error Rate             : %.3lf%%\n",
+         (queries + failed) ? 100.0 * failed / (queries + failed) : 0);
+
+  /* a soak test writes its intervals to the soak file instead */
+  if (share->soak) {
+    sky_timeline_free(&timeline);
+    return;
+  }
+
+  printf("  %-10s %14s %12s %12s %9s\n", "Time (s)", "Goodput (q/s)",
+         "Errors/s", "Retries/s", "Error %");
+
+  for (uint32_t i = 0; i < timeline.size; i++) {
+    SKY_INTERVAL *iv = &timeline.intervals[i];
+    uint64_t total = iv->queries + iv->errors;
+
+    printf("  %-10.0lf %14.1lf %12.1lf %12.1lf %8.2lf%%\n", i * interval,
+           iv->queries / interval, iv->errors / interval,
+           iv->retries / interval, (total) ? 100.0 * iv->errors / total : 0);
+  }
+
+  sky_timeline_free(&timeline);
+}
+
 void aggregate_worker_result(SKY_WORKER **workers) {
   double data_load_time = 0;
   double file_benchmark_time = 0;
-  bool aborted = false;
+  uint32_t aborted = 0;
 
   SKY_SHARE *share = workers[0]->share;
 
   for (int i = 0; i < share->concurrency; i++) {
     if (workers[i]->aborted) {
-      aborted = true;
-      break;
+      aborted++;
+      continue;
     }
     data_load_time += workers[i]->total_insert_time;
-    data_load_time /= 1000000;
-
     file_benchmark_time += workers[i]->file_benchmark_time;
-    file_benchmark_time /= 1000000; 
   }
+  data_load_time /= 1000000;
+  file_benchmark_time /= 1000000;
 
-  if (aborted) {
+  /* the workers that survived still tell how the server behaved */
+  if (aborted == share->concurrency) {
     report_error("failed to run load test");
     return;
   }
 
+  if (aborted > 0) {
+    fprintf(stderr, "warning: %u of %u workers aborted, the results "
+            "only cover the remaining workers\n", aborted,
+            share->concurrency);
+  }
+
+  if (stop_requested()) {
+    fprintf(stderr, "warning: stopped by a signal, the results only "
+            "cover the load run until then\n");
+  }
+
   /* Here we need to carefully choose what to output based on
      the user supplied options. E.g. Only display relevant information. */
 
@@ -394,22 +1305,128 @@ void aggregate_worker_result(SKY_WORKER **workers) {
     printf("  Task Completion Time   : %.3lf secs\n", share->file_load_time);
   }
 
-  if (share->insert_tmpl) {
+  if (has_insert_template(share)) {
+    uint64_t rows = 0;
+
+    for (int i = 0; i < share->ntables; i++) {
+      if (share->tables[i].insert_tmpl)
+        rows += share->tables[i].nwrite;
+    }
+
+    /* only the rows inserted so far if the load was stopped */
+    if (stop_requested()) {
+      rows = 0;
+      for (int i = 0; i < share->concurrency; i++)
+        rows += workers[i]->rows_inserted;
+    }
+
     printf("\n");
     printf("[ TEMPLATE BASED INSERTION RESULT ]\n");
     printf("  Concurrent Connections : %d\n", share->concurrency);
     printf("  Total Time to INSERT   : %.5lf secs\n", data_load_time);
-    printf("  Rows Loaded            : %d\n", share->nwrite);
+    printf("  Rows Loaded            : %llu\n", (unsigned long long)rows);
+
+    /* break the figures down when more than one table was populated */
+    for (int i = 0; i < share->ntables && share->ntables > 1; i++) {
+      double table_time = 0;
+
+      if (!share->tables[i].insert_tmpl)
+        continue;
+
+      for (int j = 0; j < share->concurrency; j++)
+        table_time += workers[j]->table_insert_time[i];
+
+      printf("  Table[%d] Rows Loaded   : %llu (%.5lf secs)\n", i + 1,
+             (unsigned long long)share->tables[i].nwrite,
+             table_time / 1000000);
+    }
+
+    print_volume_result(workers);
+
+    if (share->key_order != SKY_KEYS_INTERLEAVED) {
+      static const char *orders[] = {"interleaved", "partitioned",
+                                     "descending", "random"};
+      printf("  Key Order              : %s\n", orders[share->key_order]);
+    }
+
+    if (share->pipeline_depth > 1)
+      printf("  Pipeline Depth         : %u\n", share->pipeline_depth);
+
+    if (share->txn_size > 0)
+      print_txn_result(workers, share->txn_size, false);
   }
 
-  if (share->read_file_path) {
+  if (phase_enabled(share, SKY_PHASE_WRITE))
+    print_write_result(workers);
+
+  if (share->read_file_path && !share->sweep_levels &&
+      share->search == SKY_SEARCH_NONE && !share->scenario_path) {
     printf("\n");
     printf("[ READ LOAD EMULATION RESULT ]\n");
     printf("  SQL File               : %s\n", share->read_file_path);
     printf("  Concurrent Connections : %d\n", share->concurrency);
     printf("  Task Completion Time   : %.5lf secs\n", file_benchmark_time);
     printf("  Number of Queries:     : %d\n", (int)share->read_queries->size);
-    printf("  Number of Test Runs:   : %d\n", share->runs);
+    if (share->soak || stop_requested()) {
+      uint64_t runs = 0;
+
+      for (int i = 0; i < share->concurrency; i++) {
+        if (workers[i]->file_runs > runs)
+          runs = workers[i]->file_runs;
+      }
+      printf("  Completed Test Runs    : %llu\n", (unsigned long long)runs);
+    } else {
+      printf("  Number of Test Runs:   : %llu\n",
+             (unsigned long long)share->runs);
+    }
+    printf("  Query Selection        : %s\n",
+           read_order_name(share->read_order));
+    if (share->pipeline_depth > 1)
+      printf("  Pipeline Depth         : %u\n", share->pipeline_depth);
+    print_txn_result(workers, share->txn_size, true);
+  }
+
+  if (share->ntargets > 1)
+    print_target_result(workers);
+
+  print_error_result(workers);
+
+  if (share->replay_file_path) {
+    SKY_REPLAY *replay = share->replay;
+    uint64_t queries = 0, lag_total = 0, lag_max = 0, late = 0;
+    uint64_t end_time = replay->start_time;
+    double replay_time = 0;
+
+    for (int i = 0; i < share->concurrency; i++) {
+      queries += workers[i]->replay_queries;
+      lag_total += workers[i]->replay_lag_total;
+      late += workers[i]->replay_late;
+      replay_time += workers[i]->replay_time;
+      if (workers[i]->replay_lag_max > lag_max)
+        lag_max = workers[i]->replay_lag_max;
+      if (workers[i]->replay_end_time > end_time)
+        end_time = workers[i]->replay_end_time;
+    }
+
+    printf("\n");
+    printf("[ QUERY LOG REPLAY RESULT ]\n");
+    printf("  Query Log              : %s\n", share->replay_file_path);
+    printf("  Scheduler Threads      : %d\n", share->concurrency);
+    printf("  Replay Speed           : %.2lfx\n", share->speed);
+    printf("  Sessions Replayed      : %u\n", replay->sessions);
+    printf("  Queries Replayed       : %llu\n", (unsigned long long)queries);
+    printf("  Original Duration      : %.3lf secs\n",
+           (double)replay->duration / 1000000);
+    printf("  Scheduled Duration     : %.3lf secs\n",
+           (double)replay->duration / share->speed / 1000000);
+    printf("  Actual Duration        : %.3lf secs\n",
+           (double)(end_time - replay->start_time) / 1000000);
+    printf("  Query Execution Time   : %.5lf secs\n", replay_time / 1000000);
+    printf("  Average Schedule Lag   : %.3lf ms\n",
+           (queries) ? (double)lag_total / queries / 1000 : 0);
+    printf("  Maximum Schedule Lag   : %.3lf ms\n", (double)lag_max / 1000);
+    printf("  Late Queries (>%dms)    : %llu\n",
+           REPLAY_LATE_THRESHOLD / 1000, (unsigned long long)late);
   }
 }
 
@@ -417,7 +1434,12 @@ void usage() {
   printf("skyload 0.5.0: Parameters with '=' requires an argument\n");
   printf("\n");
   printf("[ Server Related Options ]\n");
-  printf("  --server=      : Server Hostname (required)\n");
+  printf("  --server=      : Server Hostname (required). A comma separated\n");
+  printf("                   list of host[:port] spreads the load\n");
+  printf("  --replica=     : Comma separated host[:port] list of replicas\n");
+  printf("                   that receive the read load\n");
+  printf("  --route=       : 'worker' (default) or 'key' to route each\n");
+  printf("                   generated row by its first placeholder value\n");
   printf("  --port=        : Server Port\n");
   printf("  --mysql        : Use MySQL Protocol\n");
   printf("\n");
@@ -426,14 +1448,140 @@ void usage() {
   printf("  --insert=      : Insert Statement Template\n");
   printf("  --concurrency= : Number of simultaneous clients\n");
   printf("  --rows=        : Number of rows to insert into the table\n");
+  printf("                   (repeat --table, --insert and --rows for each\n");
+  printf("                    table, %%refN refers to keys of the Nth table)\n");
+  printf("  --key-order=   : Layout of the %%seq keys: 'interleaved' (default)\n");
+  printf("                   where the workers take turns, 'partitioned'\n");
+  printf("                   into a contiguous range per worker,\n");
+  printf("                   'descending' or 'random', a permutation of\n");
+  printf("                   the keys\n");
+  printf("  --update=      : UPDATE Statement Template of the last --table,\n");
+  printf("                   %%key stands for the key of an existing row\n");
+  printf("  --delete=      : DELETE Statement Template of the last --table\n");
+  printf("  --writes=      : Number of UPDATEs and DELETEs to run once the\n");
+  printf("                   tables are populated\n");
+  printf("  --key-dist=    : Distribution of the %%key values: 'uniform'\n");
+  printf("                   (default) or 'zipfian[:THETA]' where the first\n");
+  printf("                   rows inserted are the hottest (theta %.2f)\n",
+         SKY_ZIPF_THETA);
+  printf("  --txn-size=    : Number of operations per transaction\n");
+  printf("  --think-time=  : Pause between the operations of a session, given\n");
+  printf("                   as fixed:MS, uniform:MIN-MAX or exp:MEAN msecs\n");
+  printf("  --pace=        : Operations per minute of every session\n");
+  printf("  --pipeline=    : Number of INSERTs or read file statements sent\n");
+  printf("                   per round trip (MySQL only, default 1)\n");
+  printf("  --payload-size=: Bytes of every %%payload value of a template,\n");
+  printf("                   given as SIZE or MIN-MAX with an optional K or\n");
+  printf("                   M suffix (default %d)\n", SKY_PAYLOAD_SIZE);
+  printf("  --payload-file=: File the %%payload values are taken from instead\n");
+  printf("                   of a generated pool. it must not contain quotes,\n");
+  printf("                   backslashes or null bytes\n");
   printf("\n");
   printf("[ External File Options ]\n");
-  printf("  --load-file=   : Path to the SQL file for test data creation\n");
+  printf("  --load-file=   : Path to the SQL file for test data creation,\n");
+  printf("                   e.g. a mysqldump file. it's split into\n");
+  printf("                   statements like the mysql client does,\n");
+  printf("                   DELIMITER lines included\n");
   printf("  --read-file=   : Path to the SQL file for read load\n");
-  printf("  --runs=        : Number of times to run the tests in the file\n");
+  printf("  --runs=        : Number of times to run the tests in the file,\n");
+  printf("                   reported with their spread if more than one\n");
+  printf("  --run-warmup=  : Seconds to run the file unmeasured before\n");
+  printf("                   every run (default 0)\n");
+  printf("  --read-order=  : Order each worker runs the read file in:\n");
+  printf("                   'sequential' (default), 'offset' to start\n");
+  printf("                   every worker at its own line, 'random',\n");
+  printf("                   'weighted' by a leading /* weight=N */ or\n");
+  printf("                   'shuffle' for a new permutation every run\n");
+  printf("  --replay-file= : Path to the general query log to replay\n");
+  printf("  --speed=       : Replay speed multiplier (default 1.0)\n");
+  printf("\n");
+  printf("[ Scenario Options ]\n");
+  printf("  --scenario=    : Run the phases of a scenario file in place of\n");
+  printf("                   the read load, once the tables are populated.\n");
+  printf("                   Every phase starts with a [name] line followed\n");
+  printf("                   by 'key = value' lines:\n");
+  printf("                     duration    : secs the phase lasts\n");
+  printf("                     ops         : operations after which it ends\n");
+  printf("                     concurrency : connections (default --concurrency)\n");
+  printf("                     rate        : operations/sec of all connections\n");
+  printf("                     rate_end    : rate ramped to by the end\n");
+  printf("                     mix         : weighted operations, e.g.\n");
+  printf("                                   read:80,insert:20\n");
+  printf("                     table       : table the INSERTs go to (default\n");
+  printf("                                   the first with a template)\n");
+  printf("                     measure     : 'no' for a warmup phase\n");
+  printf("\n");
+  printf("[ Concurrency Sweep Options ]\n");
+  printf("  --sweep=       : Comma separated concurrency levels for the\n");
+  printf("                   read load, e.g. 1,2,4,8,16\n");
+  printf("  --search=      : 'rate' or 'concurrency' to search for the\n");
+  printf("                   highest read load throughput within --slo by\n");
+  printf("                   adjusting the rate offered by --concurrency\n");
+  printf("                   workers or the number of workers up to it\n");
+  printf("  --slo=         : Latency target of --search given as MS or\n");
+  printf("                   pPERCENTILE:MS (default percentile %.0lf)\n",
+         SKY_SLO_PERCENTILE);
+  printf("  --sweep-time=  : Seconds to measure at each level (default %d)\n",
+         SKY_SWEEP_TIME);
+  printf("  --warmup=      : Seconds to warm up at each level (default %d)\n",
+         SKY_SWEEP_WARMUP);
+  printf("\n");
+  printf("[ Error Handling Options ]\n");
+  printf("  --max-retries= : Attempts to repeat a statement or transaction\n");
+  printf("                   that hit a deadlock, lock wait timeout or\n");
+  printf("                   dropped connection (default %d)\n",
+         SKY_MAX_RETRIES);
+  printf("  --retry-backoff= : Msecs to wait before the first retry, doubled\n");
+  printf("                   on every further attempt (default %d)\n",
+         SKY_RETRY_BACKOFF);
+  printf("  --report-interval= : Seconds per line of the error rate report\n");
+  printf("                   (default %d)\n", SKY_REPORT_INTERVAL);
+  printf("\n");
+  printf("[ Server Status Options ]\n");
+  printf("  --status       : Sample SHOW GLOBAL STATUS on a side connection at\n");
+  printf("                   every phase boundary and --report-interval and\n");
+  printf("                   report the deltas next to the client figures\n");
+  printf("  --status-vars= : Comma separated status variables to sample\n");
+  printf("  --engine-status : Also sample the InnoDB history list length and\n");
+  printf("                   log sequence number\n");
+  printf("\n");
+  printf("[ Soak Test Options ]\n");
+  printf("  --soak         : Repeat the read file until SIGINT or SIGTERM\n");
+  printf("                   and sample every --report-interval (default\n");
+  printf("                   %d secs with --soak)\n", SKY_SOAK_INTERVAL);
+  printf("  --soak-file=   : Path to write a CSV line per interval to\n");
+  printf("  --soak-rotate= : MB written to the soak file before it's rotated\n");
+  printf("                   (default %d, %d rotated files are kept)\n",
+         SKY_SOAK_ROTATE, SKY_SOAK_KEEP);
+  printf("\n");
+  printf("[ Live Metrics Options ]\n");
+  printf("  --metrics=     : Serve the client counters in the Prometheus text\n");
+  printf("                   format while the load runs, on [host:]port\n");
+  printf("                   (host %s by default) or on a Unix domain\n",
+         SKY_METRICS_HOST);
+  printf("                   socket if given a path\n");
+  printf("\n");
+  printf("[ Result Comparison Options ]\n");
+  printf("  --json=        : Write the throughput and latency of every phase\n");
+  printf("                   and read query fingerprint to a JSON file\n");
+  printf("  --compare=     : Compare the results with a file written by\n");
+  printf("                   --json and exit with status 2 on regression\n");
+  printf("  --tolerance=   : Percent of change tolerated (default %.0lf)\n",
+         SKY_TOLERANCE);
+  printf("  --noise-floor= : Usecs a latency percentile must grow by to\n");
+  printf("                   count as a regression (default %d)\n",
+         SKY_NOISE_FLOOR);
+  printf("  --noise-z=     : Standard errors the mean latency must grow by\n");
+  printf("                   to count as a regression (default %.1lf)\n",
+         SKY_NOISE_Z);
   printf("\n");
   printf("[ Extra Options ]\n");
   printf("  --db=          : Specify the database to run the test on\n");
+  printf("  --slowest=     : Number of the slowest statements to report with\n");
+  printf("                   the time they ran at and their connection\n");
+  printf("  --trace=       : Write every statement's span to a file in the\n");
+  printf("                   Chrome trace format, see chrome://tracing\n");
+  printf("  --trace-sample=: Trace 1 in every N statements (default 1)\n");
   printf("  --keep         : Don't delete the database after the test\n");
   printf("  --help         : Print this help\n");
   exit(EXIT_SUCCESS);